@@ -102,6 +102,21 @@ typedef struct
 #endif
 } NETSOCKET_BUFFER;
 
+#ifdef CONF_PLATFORM_LINUX
+typedef struct
+{
+	bool batching;
+	int size;
+	int socks[VLEN];
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	char sockaddrs[VLEN][128];
+	int num_queued;
+	int num_syscalls;
+} NETSOCKET_SEND_BUFFER;
+#endif
+
 void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
@@ -114,6 +129,9 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+#ifdef CONF_PLATFORM_LINUX
+	NETSOCKET_SEND_BUFFER send_buffer;
+#endif
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -1666,15 +1684,109 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	{
 		net_set_non_blocking(sock);
 		net_buffer_init(&sock->buffer);
+#if defined(CONF_PLATFORM_LINUX)
+		mem_zero(&sock->send_buffer, sizeof(sock->send_buffer));
+#endif
 	}
 
 	return sock;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static void net_udp_flush_queue(NETSOCKET sock)
+{
+	NETSOCKET_SEND_BUFFER *buffer = &sock->send_buffer;
+	int pos = 0;
+	while(pos < buffer->size)
+	{
+		// packets for the ipv4 and ipv6 socket can't share a syscall
+		int end = pos + 1;
+		while(end < buffer->size && buffer->socks[end] == buffer->socks[pos])
+			end++;
+		int sent = sendmmsg(buffer->socks[pos], &buffer->msgs[pos], end - pos, 0);
+		buffer->num_syscalls++;
+		// drop the failing packet like a single sendto would
+		pos += sent > 0 ? sent : 1;
+	}
+	buffer->num_queued += buffer->size;
+	buffer->size = 0;
+}
+
+static bool net_udp_queue(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
+{
+	NETSOCKET_SEND_BUFFER *buffer = &sock->send_buffer;
+	if(size > PACKETSIZE || (addr->type & (NETTYPE_LINK_BROADCAST | NETTYPE_WEBSOCKET_IPV4)))
+		return false;
+
+	int fd;
+	socklen_t namelen;
+	if((addr->type & (NETTYPE_IPV4 | NETTYPE_IPV6)) == NETTYPE_IPV4 && sock->ipv4sock >= 0)
+	{
+		fd = sock->ipv4sock;
+		namelen = sizeof(struct sockaddr_in);
+		netaddr_to_sockaddr_in(addr, (struct sockaddr_in *)buffer->sockaddrs[buffer->size]);
+	}
+	else if((addr->type & (NETTYPE_IPV4 | NETTYPE_IPV6)) == NETTYPE_IPV6 && sock->ipv6sock >= 0)
+	{
+		fd = sock->ipv6sock;
+		namelen = sizeof(struct sockaddr_in6);
+		netaddr_to_sockaddr_in6(addr, (struct sockaddr_in6 *)buffer->sockaddrs[buffer->size]);
+	}
+	else
+		return false;
+
+	const int i = buffer->size;
+	buffer->socks[i] = fd;
+	mem_copy(buffer->bufs[i], data, size);
+	buffer->iovecs[i].iov_base = buffer->bufs[i];
+	buffer->iovecs[i].iov_len = size;
+	buffer->msgs[i].msg_hdr.msg_iov = &buffer->iovecs[i];
+	buffer->msgs[i].msg_hdr.msg_iovlen = 1;
+	buffer->msgs[i].msg_hdr.msg_name = buffer->sockaddrs[i];
+	buffer->msgs[i].msg_hdr.msg_namelen = namelen;
+	buffer->size++;
+
+	if(buffer->size == VLEN)
+		net_udp_flush_queue(sock);
+	return true;
+}
+#endif
+
+void net_udp_batch_begin(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	sock->send_buffer.batching = true;
+#endif
+}
+
+int net_udp_batch_end(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	NETSOCKET_SEND_BUFFER *buffer = &sock->send_buffer;
+	net_udp_flush_queue(sock);
+	int saved = buffer->num_queued - buffer->num_syscalls;
+	buffer->batching = false;
+	buffer->num_queued = 0;
+	buffer->num_syscalls = 0;
+	return saved;
+#else
+	return 0;
+#endif
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
 
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_buffer.batching && net_udp_queue(sock, addr, data, size))
+	{
+		network_stats.sent_bytes += size;
+		network_stats.sent_packets++;
+		return size;
+	}
+#endif
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock->ipv4sock >= 0)
@@ -1876,6 +1988,9 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 int net_udp_close(NETSOCKET sock)
 {
+#if defined(CONF_PLATFORM_LINUX)
+	net_udp_flush_queue(sock);
+#endif
 	return priv_net_close_all_sockets(sock);
 }
 
@@ -952,6 +952,31 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Queues packets sent over an UDP socket until @link net_udp_batch_end @endlink
+ * instead of sending each of them with its own syscall.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to batch packets on.
+ *
+ * @remark Only has an effect on Linux, where `sendmmsg` is available.
+ * @remark Broadcast and websocket packets are always sent right away.
+ */
+void net_udp_batch_begin(NETSOCKET sock);
+
+/**
+ * Sends all packets queued since @link net_udp_batch_begin @endlink and
+ * stops batching.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to flush.
+ *
+ * @return Number of send syscalls that were saved by batching.
+ */
+int net_udp_batch_end(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
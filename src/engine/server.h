@@ -36,6 +36,10 @@ public:
 	virtual const char *GetRandomMapFromPool() = 0;
 	// ddnet-insta method that force stops the server
 	virtual void ShutdownServer() = 0;
+	// times the handling of finished database requests in the frame profiler,
+	// see CSqlResultsProfileScope
+	virtual void BeginSqlResultsProfile() = 0;
+	virtual void EndSqlResultsProfile() = 0;
 
 	MACRO_INTERFACE("server")
 protected:
@@ -300,6 +304,20 @@ public:
 	virtual bool IsSixup(int ClientId) const = 0;
 };
 
+// times the handling of finished database requests until it goes out of scope
+class CSqlResultsProfileScope
+{
+	IServer *m_pServer;
+
+public:
+	CSqlResultsProfileScope(IServer *pServer) :
+		m_pServer(pServer)
+	{
+		m_pServer->BeginSqlResultsProfile();
+	}
+	~CSqlResultsProfileScope() { m_pServer->EndSqlResultsProfile(); }
+};
+
 class IGameServer : public IInterface
 {
 	MACRO_INTERFACE("gameserver")
@@ -321,6 +339,9 @@ public:
 	virtual void OnTick() = 0;
 	virtual void OnPreSnap() = 0;
 	virtual void OnSnap(int ClientId) = 0;
+	// snaps the client a second time in the same tick for
+	// sv_snapshot_parallel_check without repeating the side effects
+	virtual void OnSnapCheck(int ClientId) = 0;
 	virtual void OnPostSnap() = 0;
 
 	virtual void OnMessage(int MsgId, CUnpacker *pUnpacker, int ClientId) = 0;
@@ -10,11 +10,14 @@ enum
 {
 	// MAX_NAME_LENGTH includes the size with \0, which is not necessary in SQL
 	MAX_NAME_LENGTH_SQL = MAX_NAME_LENGTH - 1,
+	// prepared statements kept alive per connection
+	STATEMENT_CACHE_SIZE = 32,
 };
 
 class IConsole;
 
-// can hold one PreparedStatement with Results
+// keeps up to STATEMENT_CACHE_SIZE PreparedStatements alive, the last
+// prepared one is used for binding and holds the Results
 class IDbConnection
 {
 public:
@@ -36,6 +39,15 @@ public:
 	virtual const char *CollateNocase() const = 0;
 	// syntax to insert a row into table or ignore if it already exists
 	virtual const char *InsertIgnore() const = 0;
+	// syntax to add an index to an existing table unless it already has it,
+	// nullptr if the database doesn't support it
+	virtual const char *CreateIndexIfNotExists() const = 0;
+	// can be appended to an INSERT to assign columns instead if a row with the same pKey
+	// already exists, has to be followed by the assignments
+	virtual void OnConflictUpdate(const char *pKey, char *aBuf, unsigned int BufferSize) const = 0;
+	// can be used in the assignments after OnConflictUpdate to refer to the value that
+	// would have been inserted into pColumn
+	virtual void InsertedValue(const char *pColumn, char *aBuf, unsigned int BufferSize) const = 0;
 	// ORDER BY RANDOM()/RAND()
 	virtual const char *Random() const = 0;
 	// Get Median Map Time from l.Map
@@ -50,10 +62,14 @@ public:
 	// has to be called to return the connection back to the pool
 	virtual void Disconnect() = 0;
 
-	// ? for Placeholders, connection has to be established, can overwrite previous prepared statements
+	// ? for Placeholders, connection has to be established, resets the results of the previous
+	// statement. Reuses the cached statement if the same SQL text was prepared before.
 	//
 	// returns true on failure
 	virtual bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) = 0;
+	// number of PrepareStatement calls that were served from or missed the statement cache
+	virtual uint64_t StatementCacheHits() const = 0;
+	virtual uint64_t StatementCacheMisses() const = 0;
 
 	// PrepareStatement has to be called beforehand,
 	virtual void BindString(int Idx, const char *pString) = 0;
@@ -85,6 +101,19 @@ public:
 	// returns number of bytes read into the buffer
 	virtual int GetBlob(int Col, unsigned char *pBuffer, int BufferSize) = 0;
 
+	// groups the following statements until CommitTransaction or RollbackTransaction
+	//
+	// returns true on failure
+	virtual bool BeginTransaction(char *pError, int ErrorSize) = 0;
+	virtual bool CommitTransaction(char *pError, int ErrorSize) = 0;
+	virtual bool RollbackTransaction(char *pError, int ErrorSize) = 0;
+
+	// moves the write-ahead log of sqlite into the database, does nothing
+	// for other databases
+	//
+	// returns true on failure
+	virtual bool Checkpoint(char *pError, int ErrorSize) = 0;
+
 	// SQL statements, that can't be abstracted, has side effects to the result
 	virtual bool AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize) = 0;
 
@@ -103,7 +132,8 @@ bool MysqlAvailable();
 int MysqlInit();
 void MysqlUninit();
 
-std::unique_ptr<IDbConnection> CreateSqliteConnection(const char *pFilename, bool Setup);
+// AutoCheckpoint=false mostly leaves the checkpoints of the write-ahead log to Checkpoint()
+std::unique_ptr<IDbConnection> CreateSqliteConnection(const char *pFilename, bool Setup, bool AutoCheckpoint = true);
 // Returns nullptr if MySQL support is not compiled in.
 std::unique_ptr<IDbConnection> CreateMysqlConnection(CMysqlConfig Config);
 
@@ -7,6 +7,7 @@
 #include <engine/console.h>
 
 #include <chrono>
+#include <cinttypes>
 #include <iterator>
 #include <memory>
 #include <thread>
@@ -55,6 +56,7 @@ struct CSqlExecData
 		{
 			CDbConnectionPool::Mode m_Mode;
 			char m_FileName[64];
+			bool m_AutoCheckpoint;
 		} m_Sqlite;
 		struct
 		{
@@ -65,6 +67,8 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	// for the queue latency
+	int64_t m_QueueTime = time_get_nanoseconds().count();
 };
 
 CSqlExecData::CSqlExecData(
@@ -98,6 +102,7 @@ CSqlExecData::CSqlExecData(
 {
 	m_Ptr.m_Sqlite.m_Mode = m;
 	str_copy(m_Ptr.m_Sqlite.m_FileName, aFileName);
+	m_Ptr.m_Sqlite.m_AutoCheckpoint = true;
 }
 CSqlExecData::CSqlExecData(CDbConnectionPool::Mode m,
 	const CMysqlConfig *pMysqlConfig) :
@@ -118,8 +123,34 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
+void CDbConnectionPool::CQueueStats::Print(IConsole *pConsole, const char *pName, int NumWorkers) const
+{
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf),
+		"%s queue: workers=%d depth=%d done=%" PRIu64 " latency mean=%.2fms p50=%.2fms p99=%.2fms max=%.2fms",
+		pName, NumWorkers, m_Depth.load(), m_Latency.Count(), m_Latency.Mean() / 1e6,
+		m_Latency.Percentile(0.5) / 1e6, m_Latency.Percentile(0.99) / 1e6, m_Latency.Max() / 1e6);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
+	// the stats are printed right away to also show them while the
+	// workers are busy
+	if(DatabaseMode == Mode::READ)
+	{
+		StartReadWorkers();
+		m_pReadShared->m_Stats.Print(pConsole, "Read", m_vpReadThreads.size());
+		{
+			const CLockScope LockScope(m_pReadShared->m_QueriesLock);
+			m_pReadShared->m_Queries.push_back(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+		}
+		m_pReadShared->m_NumQueries.Signal();
+		return;
+	}
+
+	if(DatabaseMode == Mode::WRITE)
+		m_pShared->m_Stats.Print(pConsole, "Write", 1);
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
@@ -127,13 +158,33 @@ void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
+	if(DatabaseMode == Mode::READ)
+	{
+		const CLockScope LockScope(m_pReadShared->m_ServersLock);
+		m_pReadShared->m_vpServers.push_back(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
+		return;
+	}
+	auto pData = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
+	// the read workers are connected to the same file and checkpoint it
+	// instead, so that the writes don't wait for it
+	if(DatabaseMode == Mode::WRITE && g_Config.m_SvSqliteCheckpointInterval > 0)
+	{
+		pData->m_Ptr.m_Sqlite.m_AutoCheckpoint = false;
+		m_CheckpointInterval = g_Config.m_SvSqliteCheckpointInterval;
+	}
+	m_pShared->m_aQueries[m_InsertIdx++] = std::move(pData);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
 }
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
+	if(DatabaseMode == Mode::READ)
+	{
+		const CLockScope LockScope(m_pReadShared->m_ServersLock);
+		m_pReadShared->m_vpServers.push_back(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
+		return;
+	}
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
@@ -144,9 +195,18 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	StartReadWorkers();
+	m_pReadShared->m_Stats.m_Depth++;
+	{
+		const CLockScope LockScope(m_pReadShared->m_QueriesLock);
+		m_pReadShared->m_Queries.push_back(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
+	}
+	m_pReadShared->m_NumQueries.Signal();
+}
+
+static bool CheckpointThread(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	return pSqlServer->Checkpoint(pError, ErrorSize);
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -154,6 +214,13 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
+	// only the writes grow the write-ahead log
+	if(m_CheckpointInterval > 0 && time_get() >= m_NextCheckpoint)
+	{
+		m_NextCheckpoint = time_get() + m_CheckpointInterval * time_freq();
+		Execute(CheckpointThread, std::make_unique<ISqlData>(nullptr), "checkpoint");
+	}
+	m_pShared->m_Stats.m_Depth++;
 	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
@@ -166,6 +233,11 @@ void CDbConnectionPool::OnShutdown()
 	m_Shutdown = true;
 	m_pShared->m_Shutdown.store(true);
 	m_pShared->m_NumBackup.Signal();
+	// the read workers dismiss the remaining queries and each of them
+	// exits on one of these signals
+	m_pReadShared->m_Shutdown.store(true);
+	for(size_t i = 0; i < m_vpReadThreads.size(); i++)
+		m_pReadShared->m_NumQueries.Signal();
 	int i = 0;
 	while(m_pShared->m_Shutdown.load())
 	{
@@ -262,8 +334,8 @@ private:
 	//                most one WRITE server. The WRITE server for all DDNet
 	//                Servers must be the same (to counteract double loads).
 	//                There may be one WRITE_BACKUP sqlite server.
+	// The READ servers are used by the CReadWorker threads.
 	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -280,10 +352,8 @@ void CWorker::Start(void *pUser)
 
 void CWorker::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails and write to the backup
+	// database until all requests are handled
 	bool FailMode = false;
 	for(int JobNum = 0;; JobNum++)
 	{
@@ -303,35 +373,8 @@ void CWorker::ProcessQueries()
 		switch(pThreadData->m_Mode)
 		{
 		case CSqlExecData::READ_ACCESS:
-		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
-			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
-				{
-					ReadServer = CurServer;
-					if(m_DebugSql)
-						dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
-			}
-			if(!Success)
-			{
-				FailMode = true;
-			}
-		}
-		break;
+			dbg_assert(false, "read queries are run by the read workers");
+			break;
 		case CSqlExecData::WRITE_ACCESS:
 		{
 			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
@@ -357,6 +400,8 @@ void CWorker::ProcessQueries()
 					dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
 				Success = true;
 			}
+			m_pShared->m_Stats.m_Depth--;
+			m_pShared->m_Stats.m_Latency.Add(time_get_nanoseconds().count() - pThreadData->m_QueueTime);
 		}
 		break;
 		case CSqlExecData::ADD_MYSQL:
@@ -364,8 +409,7 @@ void CWorker::ProcessQueries()
 			auto pMysql = CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
 			switch(pThreadData->m_Ptr.m_Mysql.m_Mode)
 			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
+			case CDbConnectionPool::Mode::READ: // added to the read workers
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pMysql);
@@ -381,11 +425,10 @@ void CWorker::ProcessQueries()
 		}
 		case CSqlExecData::ADD_SQLITE:
 		{
-			auto pSqlite = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_FileName, true);
+			auto pSqlite = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_FileName, true, pThreadData->m_Ptr.m_Sqlite.m_AutoCheckpoint);
 			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
 			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
+			case CDbConnectionPool::Mode::READ: // added to the read workers
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pSqlite);
@@ -416,14 +459,7 @@ void CWorker::ProcessQueries()
 
 void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 {
-	if(DatabaseMode == CDbConnectionPool::Mode::READ)
-	{
-		for(auto &pReadConnection : m_vpReadConnections)
-			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
-			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
-	}
-	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
+	if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
 		if(m_pWriteConnection)
 			m_pWriteConnection->Print(pConsole, "Write");
@@ -439,6 +475,141 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// The read workers take read queries from a shared queue, so that a slow
+// query only blocks one of them. Each one connects to all read servers.
+class CReadWorker
+{
+public:
+	CReadWorker(std::shared_ptr<CDbConnectionPool::CReadShared> pShared, int Id, int DebugSql) :
+		m_Id(Id), m_DebugSql(DebugSql), m_pShared(std::move(pShared)) {}
+	static void Start(void *pUser);
+	void ProcessQueries();
+
+private:
+	void UpdateConnections();
+	void Print(IConsole *pConsole);
+
+	int m_Id;
+	bool m_DebugSql;
+
+	std::vector<std::unique_ptr<IDbConnection>> m_vpConnections;
+
+	std::shared_ptr<CDbConnectionPool::CReadShared> m_pShared;
+};
+
+/* static */
+void CReadWorker::Start(void *pUser)
+{
+	CReadWorker *pThis = (CReadWorker *)pUser;
+	pThis->ProcessQueries();
+	delete pThis;
+}
+
+void CReadWorker::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	// enter fail mode when a sql request fails, skip read requests during
+	// it until all requests are handled
+	bool FailMode = false;
+	for(int JobNum = 0;; JobNum++)
+	{
+		if(FailMode && m_pShared->m_NumQueries.GetApproximateValue() == 0)
+		{
+			FailMode = false;
+		}
+		m_pShared->m_NumQueries.Wait();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		{
+			const CLockScope LockScope(m_pShared->m_QueriesLock);
+			if(!m_pShared->m_Queries.empty())
+			{
+				pThreadData = std::move(m_pShared->m_Queries.front());
+				m_pShared->m_Queries.pop_front();
+			}
+		}
+		// only the shutdown signals without a query
+		if(pThreadData == nullptr)
+		{
+			return;
+		}
+		UpdateConnections();
+
+		bool Success = false;
+		if(pThreadData->m_Mode == CSqlExecData::PRINT)
+		{
+			Print(pThreadData->m_Ptr.m_Print.m_pConsole);
+			Success = true;
+		}
+		else
+		{
+			for(size_t i = 0; i < m_vpConnections.size(); i++)
+			{
+				if(m_pShared->m_Shutdown)
+				{
+					dbg_msg("sql", "[%i:%i] %s dismissed read request during shutdown", m_Id, JobNum, pThreadData->m_pName);
+					break;
+				}
+				if(FailMode)
+				{
+					dbg_msg("sql", "[%i:%i] %s dismissed read request during FailMode", m_Id, JobNum, pThreadData->m_pName);
+					break;
+				}
+				int CurServer = (ReadServer + i) % (int)m_vpConnections.size();
+				if(CDbConnectionPool::ExecSqlFunc(m_vpConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+				{
+					ReadServer = CurServer;
+					if(m_DebugSql)
+						dbg_msg("sql", "[%i:%i] %s done on read database %d", m_Id, JobNum, pThreadData->m_pName, CurServer);
+					Success = true;
+					break;
+				}
+			}
+			if(!Success)
+			{
+				FailMode = true;
+				dbg_msg("sql", "[%i:%i] %s failed on all databases", m_Id, JobNum, pThreadData->m_pName);
+			}
+			m_pShared->m_Stats.m_Depth--;
+			m_pShared->m_Stats.m_Latency.Add(time_get_nanoseconds().count() - pThreadData->m_QueueTime);
+		}
+		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		{
+			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
+			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+		}
+	}
+}
+
+void CReadWorker::UpdateConnections()
+{
+	const CLockScope LockScope(m_pShared->m_ServersLock);
+	for(size_t i = m_vpConnections.size(); i < m_pShared->m_vpServers.size(); i++)
+	{
+		const CSqlExecData *pServer = m_pShared->m_vpServers[i].get();
+		if(pServer->m_Mode == CSqlExecData::ADD_MYSQL)
+			m_vpConnections.push_back(CreateMysqlConnection(pServer->m_Ptr.m_Mysql.m_Config));
+		else
+			m_vpConnections.push_back(CreateSqliteConnection(pServer->m_Ptr.m_Sqlite.m_FileName, true));
+	}
+}
+
+void CReadWorker::Print(IConsole *pConsole)
+{
+	for(auto &pReadConnection : m_vpConnections)
+		pReadConnection->Print(pConsole, "Read");
+	if(m_vpConnections.empty())
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+}
+
+void CDbConnectionPool::StartReadWorkers()
+{
+	if(!m_vpReadThreads.empty())
+		return;
+	for(int i = 0; i < g_Config.m_SvSqlReadWorkers; i++)
+		m_vpReadThreads.push_back(thread_init(CReadWorker::Start, new CReadWorker(m_pReadShared, i, g_Config.m_DbgSql), "database read worker thread"));
+}
+
 /* static */
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
 {
@@ -476,6 +647,7 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 CDbConnectionPool::CDbConnectionPool()
 {
 	m_pShared = std::make_shared<CSharedData>();
+	m_pReadShared = std::make_shared<CReadShared>();
 	m_pWorkerThread = thread_init(CWorker::Start, new CWorker(m_pShared, g_Config.m_DbgSql), "database worker thread");
 	m_pBackupThread = thread_init(CBackup::Start, new CBackup(m_pShared, g_Config.m_DbgSql), "database backup worker thread");
 }
@@ -487,4 +659,6 @@ CDbConnectionPool::~CDbConnectionPool()
 		thread_wait(m_pWorkerThread);
 	if(m_pBackupThread)
 		thread_wait(m_pBackupThread);
+	for(void *pReadThread : m_vpReadThreads)
+		thread_wait(pReadThread);
 }
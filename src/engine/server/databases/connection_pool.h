@@ -2,7 +2,10 @@
 #define ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 
 #include <atomic>
+#include <base/lock.h>
 #include <base/tl/threading.h>
+#include <deque>
+#include <engine/server/frame_profiler.h>
 #include <memory>
 #include <vector>
 
@@ -96,16 +99,33 @@ public:
 
 	friend class CWorker;
 	friend class CBackup;
+	friend class CReadWorker;
 
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
 
+	// depth and latency from adding a query until it is done, updated by
+	// the main thread and the workers
+	struct CQueueStats
+	{
+		std::atomic_int m_Depth{0};
+		CFrameProfiler::CHistogram m_Latency;
+
+		void Print(IConsole *pConsole, const char *pName, int NumWorkers) const;
+	};
+	void StartReadWorkers();
+
 	// Only the main thread accesses this variable. It points to the index,
 	// where the next query is added to the queue.
 	int m_InsertIdx = 0;
 
 	bool m_Shutdown = false;
 
+	// seconds between the checkpoints of the sqlite write database, which
+	// are run by the read workers, 0 if sqlite checkpoints while writing
+	int m_CheckpointInterval = 0;
+	int64_t m_NextCheckpoint = 0;
+
 	struct CSharedData
 	{
 		// Used as signal that shutdown is in progress from main thread to
@@ -123,11 +143,33 @@ private:
 
 		// spsc queue with additional backup worker to look at queries first.
 		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
+		CQueueStats m_Stats;
 	};
 
 	std::shared_ptr<CSharedData> m_pShared;
 	void *m_pWorkerThread = nullptr;
 	void *m_pBackupThread = nullptr;
+
+	// Read queries don't need to be ordered with the writes, they are
+	// run by several read workers so that a slow one doesn't block the
+	// others. Each worker has its own connections to all read servers.
+	struct CReadShared
+	{
+		std::atomic_bool m_Shutdown{false};
+		// signals new queries or the shutdown
+		CSemaphore m_NumQueries;
+		CLock m_QueriesLock;
+		// mpmc queue, the main thread adds and any worker takes queries
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_Queries GUARDED_BY(m_QueriesLock);
+		CLock m_ServersLock;
+		// ADD_MYSQL and ADD_SQLITE queries of the read servers, the
+		// workers connect to new ones before taking the next query
+		std::vector<std::unique_ptr<struct CSqlExecData>> m_vpServers GUARDED_BY(m_ServersLock);
+		CQueueStats m_Stats;
+	};
+
+	std::shared_ptr<CReadShared> m_pReadShared;
+	std::vector<void *> m_vpReadThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
@@ -1,4 +1,5 @@
 #include "connection.h"
+#include "statement_cache.h"
 
 #include <engine/server/databases/connection_pool.h>
 
@@ -9,6 +10,7 @@
 #include <engine/console.h>
 
 #include <atomic>
+#include <cinttypes>
 #include <memory>
 #include <vector>
 
@@ -74,6 +76,10 @@ public:
 	const char *InsertTimestampAsUtc() const override { return "?"; }
 	const char *CollateNocase() const override { return "CONVERT(? USING utf8mb4) COLLATE utf8mb4_general_ci"; }
 	const char *InsertIgnore() const override { return "INSERT IGNORE"; }
+	// only MariaDB knows CREATE INDEX IF NOT EXISTS
+	const char *CreateIndexIfNotExists() const override { return nullptr; }
+	void OnConflictUpdate(const char *pKey, char *aBuf, unsigned int BufferSize) const override;
+	void InsertedValue(const char *pColumn, char *aBuf, unsigned int BufferSize) const override;
 	const char *Random() const override { return "RAND()"; }
 	const char *MedianMapTime(char *pBuffer, int BufferSize) const override;
 	const char *False() const override { return "FALSE"; }
@@ -83,6 +89,8 @@ public:
 	void Disconnect() override;
 
 	bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) override;
+	uint64_t StatementCacheHits() const override { return m_Statements.Hits(); }
+	uint64_t StatementCacheMisses() const override { return m_Statements.Misses(); }
 
 	void BindString(int Idx, const char *pString) override;
 	void BindBlob(int Idx, unsigned char *pBlob, int Size) override;
@@ -102,6 +110,12 @@ public:
 	void GetString(int Col, char *pBuffer, int BufferSize) override;
 	int GetBlob(int Col, unsigned char *pBuffer, int BufferSize) override;
 
+	bool BeginTransaction(char *pError, int ErrorSize) override;
+	bool CommitTransaction(char *pError, int ErrorSize) override;
+	bool RollbackTransaction(char *pError, int ErrorSize) override;
+
+	bool Checkpoint(char *pError, int ErrorSize) override { return false; }
+
 	bool AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize) override;
 
 private:
@@ -113,7 +127,8 @@ private:
 
 	char m_aErrorDetail[128];
 	void StoreErrorMysql(const char *pContext);
-	void StoreErrorStmt(const char *pContext);
+	void StoreErrorStmt(const char *pContext) { StoreErrorStmt(pContext, m_pStmt); }
+	void StoreErrorStmt(const char *pContext, MYSQL_STMT *pStmt);
 	bool ConnectImpl();
 	bool PrepareAndExecuteStatement(const char *pStmt);
 	//static void DeleteResult(MYSQL_RES *pResult);
@@ -127,8 +142,14 @@ private:
 
 	bool m_NewQuery = false;
 	bool m_HaveConnection = false;
+	// the prepared statements don't survive a reconnect
+	unsigned long m_ConnectionId = 0;
 	MYSQL m_Mysql;
-	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pStmt = nullptr;
+	// the current statement, owned by m_Statements or m_pSetupStmt
+	MYSQL_STMT *m_pStmt = nullptr;
+	CStatementCache<MYSQL_STMT, CStmtDeleter> m_Statements{STATEMENT_CACHE_SIZE};
+	// for the statements run while connecting
+	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pSetupStmt = nullptr;
 	std::vector<MYSQL_BIND> m_vStmtParameters;
 	std::vector<UParameterExtra> m_vStmtParameterExtras;
 
@@ -158,6 +179,9 @@ CMysqlConnection::CMysqlConnection(CMysqlConfig Config) :
 
 CMysqlConnection::~CMysqlConnection()
 {
+	m_pStmt = nullptr;
+	m_Statements.Clear();
+	m_pSetupStmt = nullptr;
 	mysql_close(&m_Mysql);
 	g_MysqlNumConnections -= 1;
 }
@@ -167,19 +191,20 @@ void CMysqlConnection::StoreErrorMysql(const char *pContext)
 	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:mysql:%d): %s", pContext, mysql_errno(&m_Mysql), mysql_error(&m_Mysql));
 }
 
-void CMysqlConnection::StoreErrorStmt(const char *pContext)
+void CMysqlConnection::StoreErrorStmt(const char *pContext, MYSQL_STMT *pStmt)
 {
-	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt.get()), mysql_stmt_error(m_pStmt.get()));
+	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(pStmt), mysql_stmt_error(pStmt));
 }
 
 bool CMysqlConnection::PrepareAndExecuteStatement(const char *pStmt)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	m_pStmt = m_pSetupStmt.get();
+	if(mysql_stmt_prepare(m_pStmt, pStmt, str_length(pStmt)))
 	{
 		StoreErrorStmt("prepare");
 		return true;
 	}
-	if(mysql_stmt_execute(m_pStmt.get()))
+	if(mysql_stmt_execute(m_pStmt))
 	{
 		StoreErrorStmt("execute");
 		return true;
@@ -191,8 +216,9 @@ void CMysqlConnection::Print(IConsole *pConsole, const char *pMode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d",
-		pMode, m_Config.m_aDatabase, GetPrefix(), m_Config.m_aUser, m_Config.m_aIp, m_Config.m_Port);
+		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d Statements: %d cached, %" PRIu64 " hits, %" PRIu64 " misses",
+		pMode, m_Config.m_aDatabase, GetPrefix(), m_Config.m_aUser, m_Config.m_aIp, m_Config.m_Port,
+		m_Statements.Size(), m_Statements.Hits(), m_Statements.Misses());
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
@@ -201,6 +227,17 @@ void CMysqlConnection::ToUnixTimestamp(const char *pTimestamp, char *aBuf, unsig
 	str_format(aBuf, BufferSize, "UNIX_TIMESTAMP(%s)", pTimestamp);
 }
 
+void CMysqlConnection::OnConflictUpdate(const char *pKey, char *aBuf, unsigned int BufferSize) const
+{
+	// the key is implied by the duplicate primary key
+	str_copy(aBuf, "ON DUPLICATE KEY UPDATE", BufferSize);
+}
+
+void CMysqlConnection::InsertedValue(const char *pColumn, char *aBuf, unsigned int BufferSize) const
+{
+	str_format(aBuf, BufferSize, "VALUES(%s)", pColumn);
+}
+
 bool CMysqlConnection::Connect(char *pError, int ErrorSize)
 {
 	if(m_InUse.exchange(true))
@@ -222,7 +259,7 @@ bool CMysqlConnection::ConnectImpl()
 {
 	if(m_HaveConnection)
 	{
-		if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+		if(m_pStmt && mysql_stmt_free_result(m_pStmt))
 		{
 			StoreErrorStmt("free_result");
 			dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
@@ -230,16 +267,29 @@ bool CMysqlConnection::ConnectImpl()
 		if(!mysql_select_db(&m_Mysql, m_Config.m_aDatabase))
 		{
 			// Success.
+			if(mysql_thread_id(&m_Mysql) != m_ConnectionId)
+			{
+				// reconnected automatically, the server forgot our statements
+				m_pStmt = nullptr;
+				m_Statements.Clear();
+				m_pSetupStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
+				m_ConnectionId = mysql_thread_id(&m_Mysql);
+			}
 			return false;
 		}
 		StoreErrorMysql("select_db");
 		dbg_msg("mysql", "ping error, trying to reconnect %s", m_aErrorDetail);
+		m_pStmt = nullptr;
+		m_Statements.Clear();
+		m_pSetupStmt = nullptr;
 		mysql_close(&m_Mysql);
 		mem_zero(&m_Mysql, sizeof(m_Mysql));
 		mysql_init(&m_Mysql);
 	}
 
 	m_pStmt = nullptr;
+	m_Statements.Clear();
+	m_pSetupStmt = nullptr;
 	unsigned int OptConnectTimeout = 60;
 	unsigned int OptReadTimeout = 60;
 	unsigned int OptWriteTimeout = 120;
@@ -260,8 +310,9 @@ bool CMysqlConnection::ConnectImpl()
 		return true;
 	}
 	m_HaveConnection = true;
+	m_ConnectionId = mysql_thread_id(&m_Mysql);
 
-	m_pStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
+	m_pSetupStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
 
 	// Apparently MYSQL_SET_CHARSET_NAME is not enough
 	if(PrepareAndExecuteStatement("SET CHARACTER SET utf8mb4"))
@@ -321,14 +372,32 @@ void CMysqlConnection::Disconnect()
 
 bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	// the unread rows of the previous statement would block the next one
+	if(m_pStmt != nullptr && mysql_stmt_free_result(m_pStmt))
 	{
-		StoreErrorStmt("prepare");
-		str_copy(pError, m_aErrorDetail, ErrorSize);
-		return true;
+		StoreErrorStmt("free_result");
+		dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
+	}
+	m_pStmt = m_Statements.Get(pStmt);
+	if(m_pStmt == nullptr)
+	{
+		std::unique_ptr<MYSQL_STMT, CStmtDeleter> pNewStmt(mysql_stmt_init(&m_Mysql));
+		if(pNewStmt == nullptr)
+		{
+			StoreErrorMysql("stmt_init");
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			return true;
+		}
+		if(mysql_stmt_prepare(pNewStmt.get(), pStmt, str_length(pStmt)))
+		{
+			StoreErrorStmt("prepare", pNewStmt.get());
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			return true;
+		}
+		m_pStmt = m_Statements.Add(pStmt, std::move(pNewStmt));
 	}
 	m_NewQuery = true;
-	unsigned NumParameters = mysql_stmt_param_count(m_pStmt.get());
+	unsigned NumParameters = mysql_stmt_param_count(m_pStmt);
 	m_vStmtParameters.resize(NumParameters);
 	m_vStmtParameterExtras.resize(NumParameters);
 	if(NumParameters)
@@ -446,20 +515,20 @@ bool CMysqlConnection::Step(bool *pEnd, char *pError, int ErrorSize)
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), m_vStmtParameters.data()))
+		if(mysql_stmt_bind_param(m_pStmt, m_vStmtParameters.data()))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
 	}
-	int Result = mysql_stmt_fetch(m_pStmt.get());
+	int Result = mysql_stmt_fetch(m_pStmt);
 	if(Result == 1)
 	{
 		StoreErrorStmt("fetch");
@@ -477,19 +546,19 @@ bool CMysqlConnection::ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSi
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), m_vStmtParameters.data()))
+		if(mysql_stmt_bind_param(m_pStmt, m_vStmtParameters.data()))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt.get());
+		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt);
 		return false;
 	}
 	str_copy(pError, "tried to execute update without query", ErrorSize);
@@ -510,7 +579,7 @@ bool CMysqlConnection::IsNull(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:null");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -534,7 +603,7 @@ float CMysqlConnection::GetFloat(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:float");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -562,7 +631,7 @@ int CMysqlConnection::GetInt(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:int");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -590,7 +659,7 @@ int64_t CMysqlConnection::GetInt64(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:int64");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -625,7 +694,7 @@ void CMysqlConnection::GetString(int Col, char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:string");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -657,7 +726,7 @@ int CMysqlConnection::GetBlob(int Col, unsigned char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:blob");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -686,6 +755,60 @@ const char *CMysqlConnection::MedianMapTime(char *pBuffer, int BufferSize) const
 	return pBuffer;
 }
 
+bool CMysqlConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	if(mysql_autocommit(&m_Mysql, false))
+	{
+		StoreErrorMysql("autocommit");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	return false;
+}
+
+bool CMysqlConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	if(m_pStmt && mysql_stmt_free_result(m_pStmt))
+	{
+		StoreErrorStmt("free_result");
+		dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
+	}
+	if(mysql_commit(&m_Mysql))
+	{
+		StoreErrorMysql("commit");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	if(mysql_autocommit(&m_Mysql, true))
+	{
+		StoreErrorMysql("autocommit");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	return false;
+}
+
+bool CMysqlConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	if(m_pStmt && mysql_stmt_free_result(m_pStmt))
+	{
+		StoreErrorStmt("free_result");
+		dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
+	}
+	// enable autocommit again even if the rollback fails
+	bool Failed = mysql_rollback(&m_Mysql);
+	if(Failed)
+		StoreErrorMysql("rollback");
+	if(mysql_autocommit(&m_Mysql, true) && !Failed)
+	{
+		StoreErrorMysql("autocommit");
+		Failed = true;
+	}
+	if(Failed)
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+	return Failed;
+}
+
 bool CMysqlConnection::AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize)
 {
 	char aBuf[512];
@@ -1,16 +1,19 @@
 #include "connection.h"
+#include "statement_cache.h"
 
 #include <sqlite3.h>
 
 #include <base/math.h>
 #include <engine/console.h>
+#include <engine/shared/config.h>
 
 #include <atomic>
+#include <cinttypes>
 
 class CSqliteConnection : public IDbConnection
 {
 public:
-	CSqliteConnection(const char *pFilename, bool Setup);
+	CSqliteConnection(const char *pFilename, bool Setup, bool AutoCheckpoint);
 	~CSqliteConnection() override;
 	void Print(IConsole *pConsole, const char *pMode) override;
 
@@ -19,6 +22,9 @@ public:
 	const char *InsertTimestampAsUtc() const override { return "DATETIME(?, 'utc')"; }
 	const char *CollateNocase() const override { return "? COLLATE NOCASE"; }
 	const char *InsertIgnore() const override { return "INSERT OR IGNORE"; }
+	const char *CreateIndexIfNotExists() const override { return "CREATE INDEX IF NOT EXISTS"; }
+	void OnConflictUpdate(const char *pKey, char *aBuf, unsigned int BufferSize) const override;
+	void InsertedValue(const char *pColumn, char *aBuf, unsigned int BufferSize) const override;
 	const char *Random() const override { return "RANDOM()"; }
 	const char *MedianMapTime(char *pBuffer, int BufferSize) const override;
 	// Since SQLite 3.23.0 true/false literals are recognized, but still cleaner to use 1/0, because:
@@ -31,6 +37,8 @@ public:
 	void Disconnect() override;
 
 	bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) override;
+	uint64_t StatementCacheHits() const override { return m_Statements.Hits(); }
+	uint64_t StatementCacheMisses() const override { return m_Statements.Misses(); }
 
 	void BindString(int Idx, const char *pString) override;
 	void BindBlob(int Idx, unsigned char *pBlob, int Size) override;
@@ -51,6 +59,12 @@ public:
 	// passing a negative buffer size is undefined behavior
 	int GetBlob(int Col, unsigned char *pBuffer, int BufferSize) override;
 
+	bool BeginTransaction(char *pError, int ErrorSize) override;
+	bool CommitTransaction(char *pError, int ErrorSize) override;
+	bool RollbackTransaction(char *pError, int ErrorSize) override;
+
+	bool Checkpoint(char *pError, int ErrorSize) override;
+
 	bool AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize) override;
 
 	// fail safe
@@ -60,14 +74,25 @@ private:
 	// copy of config vars
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	bool m_Setup;
+	bool m_AutoCheckpoint;
+
+	class CStmtDeleter
+	{
+	public:
+		void operator()(sqlite3_stmt *pStmt) const { sqlite3_finalize(pStmt); }
+	};
 
 	sqlite3 *m_pDb;
+	// the current statement, owned by m_Statements
 	sqlite3_stmt *m_pStmt;
+	CStatementCache<sqlite3_stmt, CStmtDeleter> m_Statements;
 	bool m_Done; // no more rows available for Step
 	// returns false, if the query succeeded
 	bool Execute(const char *pQuery, char *pError, int ErrorSize);
 	// returns true on failure
 	bool ConnectImpl(char *pError, int ErrorSize);
+	// applies the sv_sqlite_* settings, returns true on failure
+	bool ConfigureConnection(char *pError, int ErrorSize);
 
 	// returns true if an error was formatted
 	bool FormatError(int Result, char *pError, int ErrorSize);
@@ -76,11 +101,13 @@ private:
 	std::atomic_bool m_InUse;
 };
 
-CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup) :
+CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup, bool AutoCheckpoint) :
 	IDbConnection("record"),
 	m_Setup(Setup),
+	m_AutoCheckpoint(AutoCheckpoint),
 	m_pDb(nullptr),
 	m_pStmt(nullptr),
+	m_Statements(STATEMENT_CACHE_SIZE),
 	m_Done(true),
 	m_InUse(false)
 {
@@ -89,8 +116,7 @@ CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup) :
 
 CSqliteConnection::~CSqliteConnection()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	m_Statements.Clear();
 	sqlite3_close(m_pDb);
 	m_pDb = nullptr;
 }
@@ -99,8 +125,8 @@ void CSqliteConnection::Print(IConsole *pConsole, const char *pMode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"SQLite-%s: DB: '%s'",
-		pMode, m_aFilename);
+		"SQLite-%s: DB: '%s' Statements: %d cached, %" PRIu64 " hits, %" PRIu64 " misses",
+		pMode, m_aFilename, m_Statements.Size(), m_Statements.Hits(), m_Statements.Misses());
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
@@ -109,6 +135,16 @@ void CSqliteConnection::ToUnixTimestamp(const char *pTimestamp, char *aBuf, unsi
 	str_format(aBuf, BufferSize, "strftime('%%s', %s)", pTimestamp);
 }
 
+void CSqliteConnection::OnConflictUpdate(const char *pKey, char *aBuf, unsigned int BufferSize) const
+{
+	str_format(aBuf, BufferSize, "ON CONFLICT(%s) DO UPDATE SET", pKey);
+}
+
+void CSqliteConnection::InsertedValue(const char *pColumn, char *aBuf, unsigned int BufferSize) const
+{
+	str_format(aBuf, BufferSize, "excluded.%s", pColumn);
+}
+
 bool CSqliteConnection::Connect(char *pError, int ErrorSize)
 {
 	if(m_InUse.exchange(true))
@@ -145,6 +181,9 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors
 	sqlite3_busy_timeout(m_pDb, -1);
 
+	if(ConfigureConnection(pError, ErrorSize))
+		return true;
+
 	if(m_Setup)
 	{
 		if(Execute("PRAGMA journal_mode=WAL", pError, ErrorSize))
@@ -180,10 +219,41 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 	return false;
 }
 
+bool CSqliteConnection::ConfigureConnection(char *pError, int ErrorSize)
+{
+	// with the write-ahead log the commits are only appended to the log and
+	// synchronous=NORMAL only waits for the disk when the log is checkpointed
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "PRAGMA synchronous=%d", g_Config.m_SvSqliteSynchronous);
+	if(Execute(aBuf, pError, ErrorSize))
+		return true;
+	// negative values are KiB instead of pages
+	if(g_Config.m_SvSqliteCacheSize > 0)
+	{
+		str_format(aBuf, sizeof(aBuf), "PRAGMA cache_size=-%d", g_Config.m_SvSqliteCacheSize);
+		if(Execute(aBuf, pError, ErrorSize))
+			return true;
+	}
+	str_format(aBuf, sizeof(aBuf), "PRAGMA mmap_size=%" PRId64, (int64_t)g_Config.m_SvSqliteMmapSize * 1024 * 1024);
+	if(Execute(aBuf, pError, ErrorSize))
+		return true;
+	// another connection runs Checkpoint() regularly, the writer only does it
+	// itself if that falls behind and the log grows ten times the default size
+	// since the log isn't restarted while every checkpoint is followed by writes
+	if(!m_AutoCheckpoint && Execute("PRAGMA wal_autocheckpoint=10000", pError, ErrorSize))
+		return true;
+	return false;
+}
+
 void CSqliteConnection::Disconnect()
 {
+	// cached statements stay prepared, but must not keep the database locked
+	// or point to the bound buffers of the caller
 	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	{
+		sqlite3_reset(m_pStmt);
+		sqlite3_clear_bindings(m_pStmt);
+	}
 	m_pStmt = nullptr;
 	m_InUse.store(false);
 }
@@ -191,18 +261,30 @@ void CSqliteConnection::Disconnect()
 bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
 {
 	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
-	m_pStmt = nullptr;
+		sqlite3_reset(m_pStmt);
+	m_pStmt = m_Statements.Get(pStmt);
+	if(m_pStmt != nullptr)
+	{
+		// errors of the last execution are returned by sqlite3_reset again
+		sqlite3_reset(m_pStmt);
+		sqlite3_clear_bindings(m_pStmt);
+		m_Done = false;
+		return false;
+	}
+
+	sqlite3_stmt *pNewStmt = nullptr;
 	int Result = sqlite3_prepare_v2(
 		m_pDb,
 		pStmt,
 		-1, // pStmt can be any length
-		&m_pStmt,
+		&pNewStmt,
 		NULL);
 	if(FormatError(Result, pError, ErrorSize))
 	{
+		sqlite3_finalize(pNewStmt);
 		return true;
 	}
+	m_pStmt = m_Statements.Add(pStmt, CStatementCache<sqlite3_stmt, CStmtDeleter>::CStmtPtr(pNewStmt));
 	m_Done = false;
 	return false;
 }
@@ -393,6 +475,41 @@ void CSqliteConnection::AssertNoError(int Result)
 	}
 }
 
+bool CSqliteConnection::BeginTransaction(char *pError, int ErrorSize)
+{
+	// a statement that wasn't stepped to the end would keep its own transaction
+	if(m_pStmt != nullptr)
+		sqlite3_reset(m_pStmt);
+	// take the write lock right away instead of failing to upgrade a read lock later
+	return Execute("BEGIN IMMEDIATE", pError, ErrorSize);
+}
+
+bool CSqliteConnection::CommitTransaction(char *pError, int ErrorSize)
+{
+	// pending statements prevent the commit
+	if(m_pStmt != nullptr)
+		sqlite3_reset(m_pStmt);
+	return Execute("COMMIT", pError, ErrorSize);
+}
+
+bool CSqliteConnection::RollbackTransaction(char *pError, int ErrorSize)
+{
+	if(m_pStmt != nullptr)
+		sqlite3_reset(m_pStmt);
+	return Execute("ROLLBACK", pError, ErrorSize);
+}
+
+bool CSqliteConnection::Checkpoint(char *pError, int ErrorSize)
+{
+	// copies as much of the log into the database as possible without
+	// waiting for readers or the writer
+	int Result = sqlite3_wal_checkpoint_v2(m_pDb, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+	// the writer is checkpointing on its own right now
+	if(Result == SQLITE_BUSY)
+		return false;
+	return FormatError(Result, pError, ErrorSize);
+}
+
 bool CSqliteConnection::AddPoints(const char *pPlayer, int Points, char *pError, int ErrorSize)
 {
 	char aBuf[512];
@@ -412,7 +529,7 @@ bool CSqliteConnection::AddPoints(const char *pPlayer, int Points, char *pError,
 	return Step(&End, pError, ErrorSize);
 }
 
-std::unique_ptr<IDbConnection> CreateSqliteConnection(const char *pFilename, bool Setup)
+std::unique_ptr<IDbConnection> CreateSqliteConnection(const char *pFilename, bool Setup, bool AutoCheckpoint)
 {
-	return std::make_unique<CSqliteConnection>(pFilename, Setup);
+	return std::make_unique<CSqliteConnection>(pFilename, Setup, AutoCheckpoint);
 }
@@ -0,0 +1,83 @@
+#ifndef ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
+#define ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
+
+#include <base/system.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Keeps the prepared statements of a connection alive, keyed by their SQL
+// text, so that repeated queries skip parsing and planning. The least
+// recently used statement is freed when the cache is full.
+template<typename TStmt, typename TDeleter>
+class CStatementCache
+{
+public:
+	typedef std::unique_ptr<TStmt, TDeleter> CStmtPtr;
+
+	explicit CStatementCache(int Capacity) :
+		m_Capacity(Capacity)
+	{
+		dbg_assert(Capacity > 0, "statement cache needs room for at least one statement");
+	}
+
+	// returns nullptr if the statement isn't cached yet
+	TStmt *Get(const char *pSql)
+	{
+		auto It = m_Lookup.find(pSql);
+		if(It == m_Lookup.end())
+		{
+			m_Misses++;
+			return nullptr;
+		}
+		m_Hits++;
+		m_lEntries.splice(m_lEntries.begin(), m_lEntries, It->second);
+		return It->second->m_pStmt.get();
+	}
+
+	// the returned statement stays valid until it is evicted by the next Add
+	TStmt *Add(const char *pSql, CStmtPtr pStmt)
+	{
+		if((int)m_lEntries.size() >= m_Capacity)
+		{
+			m_Lookup.erase(m_lEntries.back().m_Sql);
+			m_lEntries.pop_back();
+		}
+		m_lEntries.push_front(CEntry{pSql, std::move(pStmt)});
+		m_Lookup[m_lEntries.front().m_Sql] = m_lEntries.begin();
+		return m_lEntries.front().m_pStmt.get();
+	}
+
+	// has to be called before the connection of the statements is closed
+	void Clear()
+	{
+		m_Lookup.clear();
+		m_lEntries.clear();
+	}
+
+	int Size() const { return m_lEntries.size(); }
+	uint64_t Hits() const { return m_Hits; }
+	uint64_t Misses() const { return m_Misses; }
+
+private:
+	struct CEntry
+	{
+		std::string m_Sql;
+		CStmtPtr m_pStmt;
+	};
+
+	int m_Capacity;
+	// most recently used first
+	std::list<CEntry> m_lEntries;
+	// points into the strings of m_lEntries, which don't move
+	std::unordered_map<std::string_view, typename std::list<CEntry>::iterator> m_Lookup;
+
+	uint64_t m_Hits = 0;
+	uint64_t m_Misses = 0;
+};
+
+#endif // ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
@@ -0,0 +1,190 @@
+#include "frame_profiler.h"
+
+#include <base/math.h>
+
+#include <engine/shared/csv.h>
+
+CFrameProfiler::CHistogram::CHistogram()
+{
+	Reset();
+}
+
+int CFrameProfiler::CHistogram::Bucket(int64_t Value)
+{
+	if(Value < (1 << SUB_BUCKET_BITS))
+		return maximum<int64_t>(Value, 0);
+
+	int Msb = 0;
+	for(uint64_t Rest = Value; Rest >>= 1;)
+		Msb++;
+	const int Sub = (Value >> (Msb - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+	return minimum(((Msb - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) | Sub, (int)NUM_BUCKETS - 1);
+}
+
+int64_t CFrameProfiler::CHistogram::BucketUpperBound(int Bucket)
+{
+	if(Bucket < (1 << SUB_BUCKET_BITS))
+		return Bucket;
+
+	const int Msb = (Bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+	const int64_t Sub = Bucket & ((1 << SUB_BUCKET_BITS) - 1);
+	const int Shift = Msb - SUB_BUCKET_BITS;
+	return (((int64_t)(1 << SUB_BUCKET_BITS) + Sub + 1) << Shift) - 1;
+}
+
+void CFrameProfiler::CHistogram::Add(int64_t Value)
+{
+	m_aBuckets[Bucket(Value)].fetch_add(1, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+	m_Sum.fetch_add(Value, std::memory_order_relaxed);
+	int64_t Max = m_Max.load(std::memory_order_relaxed);
+	while(Value > Max && !m_Max.compare_exchange_weak(Max, Value, std::memory_order_relaxed))
+		;
+}
+
+void CFrameProfiler::CHistogram::Reset()
+{
+	for(auto &Bucket : m_aBuckets)
+		Bucket.store(0, std::memory_order_relaxed);
+	m_Count.store(0, std::memory_order_relaxed);
+	m_Sum.store(0, std::memory_order_relaxed);
+	m_Max.store(0, std::memory_order_relaxed);
+}
+
+int64_t CFrameProfiler::CHistogram::Mean() const
+{
+	const uint64_t Count = m_Count.load(std::memory_order_relaxed);
+	return Count ? m_Sum.load(std::memory_order_relaxed) / Count : 0;
+}
+
+int64_t CFrameProfiler::CHistogram::Percentile(double Fraction) const
+{
+	const uint64_t Count = m_Count.load(std::memory_order_relaxed);
+	if(!Count)
+		return 0;
+
+	const uint64_t Rank = maximum<uint64_t>(1, Fraction * Count + 0.5);
+	uint64_t Seen = 0;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+	{
+		Seen += m_aBuckets[i].load(std::memory_order_relaxed);
+		if(Seen >= Rank)
+			return minimum(BucketUpperBound(i), Max());
+	}
+	return Max();
+}
+
+CFrameProfiler::CFrameProfiler() :
+	m_Enabled(false), m_pCurrentScope(nullptr), m_CsvFile(nullptr)
+{
+	ResetFrame();
+}
+
+CFrameProfiler::~CFrameProfiler()
+{
+	SetCsvFile(nullptr);
+}
+
+void CFrameProfiler::AddTime(int Phase, int ClientId, int64_t Time)
+{
+	// client scopes are nested in a scope of their phase which already counts their time
+	if(ClientId >= 0)
+	{
+		m_aClientFrameTime[ClientId] += Time;
+		m_aClientFrameHasSnap[ClientId] = true;
+		return;
+	}
+	m_aFrameTime[Phase] += Time;
+	m_aFrameHasPhase[Phase] = true;
+}
+
+void CFrameProfiler::ResetFrame()
+{
+	mem_zero(m_aFrameTime, sizeof(m_aFrameTime));
+	mem_zero(m_aFrameHasPhase, sizeof(m_aFrameHasPhase));
+	mem_zero(m_aClientFrameTime, sizeof(m_aClientFrameTime));
+	mem_zero(m_aClientFrameHasSnap, sizeof(m_aClientFrameHasSnap));
+}
+
+void CFrameProfiler::SetEnabled(bool Enabled)
+{
+	m_Enabled = Enabled;
+	ResetFrame();
+}
+
+void CFrameProfiler::Reset()
+{
+	for(auto &Histogram : m_aPhases)
+		Histogram.Reset();
+	for(auto &Histogram : m_aClients)
+		Histogram.Reset();
+}
+
+void CFrameProfiler::EndFrame(int Tick)
+{
+	if(!m_Enabled)
+		return;
+
+	for(int Phase = 0; Phase < NUM_PHASES; Phase++)
+	{
+		if(m_aFrameHasPhase[Phase])
+			m_aPhases[Phase].Add(m_aFrameTime[Phase]);
+	}
+	for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+	{
+		if(m_aClientFrameHasSnap[ClientId])
+			m_aClients[ClientId].Add(m_aClientFrameTime[ClientId]);
+	}
+
+	if(m_CsvFile)
+	{
+		char aaBuf[NUM_PHASES + 1][32];
+		const char *apColumns[NUM_PHASES + 1];
+		str_format(aaBuf[0], sizeof(aaBuf[0]), "%d", Tick);
+		apColumns[0] = aaBuf[0];
+		for(int Phase = 0; Phase < NUM_PHASES; Phase++)
+		{
+			if(m_aFrameHasPhase[Phase])
+				str_format(aaBuf[Phase + 1], sizeof(aaBuf[Phase + 1]), "%" PRId64, m_aFrameTime[Phase]);
+			else
+				aaBuf[Phase + 1][0] = '\0';
+			apColumns[Phase + 1] = aaBuf[Phase + 1];
+		}
+		CsvWrite(m_CsvFile, NUM_PHASES + 1, apColumns);
+		io_write_newline(m_CsvFile);
+	}
+
+	ResetFrame();
+}
+
+void CFrameProfiler::SetCsvFile(IOHANDLE File)
+{
+	if(m_CsvFile)
+		io_close(m_CsvFile);
+	m_CsvFile = File;
+	if(!m_CsvFile)
+		return;
+
+	// times are in nanoseconds, empty if the phase did not run in that frame
+	const char *apHeader[NUM_PHASES + 1];
+	apHeader[0] = "tick";
+	for(int Phase = 0; Phase < NUM_PHASES; Phase++)
+		apHeader[Phase + 1] = PhaseName(Phase);
+	CsvWrite(m_CsvFile, NUM_PHASES + 1, apHeader);
+	io_write_newline(m_CsvFile);
+}
+
+const char *CFrameProfiler::PhaseName(int Phase)
+{
+	switch(Phase)
+	{
+	case PHASE_NETWORK: return "network";
+	case PHASE_INPUT: return "input";
+	case PHASE_GAME_TICK: return "game_tick";
+	case PHASE_SQL_RESULTS: return "sql_results";
+	case PHASE_SNAPSHOT: return "snapshot";
+	case PHASE_REGISTER: return "register";
+	}
+	dbg_assert(false, "invalid frame profiler phase");
+	return "";
+}
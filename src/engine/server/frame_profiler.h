@@ -0,0 +1,133 @@
+#ifndef ENGINE_SERVER_FRAME_PROFILER_H
+#define ENGINE_SERVER_FRAME_PROFILER_H
+
+#include <base/system.h>
+
+#include <engine/shared/protocol.h>
+
+#include <atomic>
+#include <cstdint>
+
+// times the phases of each server tick and collects them in histograms
+// scopes and EndFrame must be used from the main thread, the histograms
+// can be read from any thread
+class CFrameProfiler
+{
+public:
+	enum
+	{
+		PHASE_NETWORK = 0,
+		PHASE_INPUT,
+		PHASE_GAME_TICK,
+		PHASE_SQL_RESULTS,
+		PHASE_SNAPSHOT,
+		PHASE_REGISTER,
+		NUM_PHASES,
+	};
+
+	// log-linear buckets with 8 sub-buckets per power of two,
+	// percentiles are accurate to 12.5%
+	class CHistogram
+	{
+		enum
+		{
+			SUB_BUCKET_BITS = 3,
+			NUM_BUCKETS = (40 - SUB_BUCKET_BITS + 2) << SUB_BUCKET_BITS,
+		};
+
+		std::atomic<uint64_t> m_aBuckets[NUM_BUCKETS];
+		std::atomic<uint64_t> m_Count;
+		std::atomic<uint64_t> m_Sum;
+		std::atomic<int64_t> m_Max;
+
+		static int Bucket(int64_t Value);
+		static int64_t BucketUpperBound(int Bucket);
+
+	public:
+		CHistogram();
+		void Add(int64_t Value);
+		void Reset();
+		uint64_t Count() const { return m_Count.load(std::memory_order_relaxed); }
+		int64_t Max() const { return m_Max.load(std::memory_order_relaxed); }
+		int64_t Mean() const;
+		// upper bound of the bucket containing the given fraction of samples
+		int64_t Percentile(double Fraction) const;
+	};
+
+	// adds the time until it goes out of scope to the phase of the current frame,
+	// the time of phase scopes nested in it is only added to their own phase,
+	// with a client id it only adds it to that client's snapshot time and has to
+	// be nested in a scope of the phase
+	class CScope
+	{
+		CFrameProfiler *m_pProfiler;
+		CScope *m_pParent;
+		int m_Phase;
+		int m_ClientId;
+		int64_t m_Start;
+		int64_t m_NestedTime;
+
+	public:
+		CScope(CFrameProfiler *pProfiler, int Phase, int ClientId = -1) :
+			m_pProfiler(pProfiler->Enabled() ? pProfiler : nullptr), m_pParent(nullptr), m_Phase(Phase), m_ClientId(ClientId), m_Start(0), m_NestedTime(0)
+		{
+			if(!m_pProfiler)
+				return;
+			if(m_ClientId < 0)
+			{
+				m_pParent = m_pProfiler->m_pCurrentScope;
+				m_pProfiler->m_pCurrentScope = this;
+			}
+			m_Start = time_get_nanoseconds().count();
+		}
+		~CScope()
+		{
+			if(!m_pProfiler)
+				return;
+			const int64_t Time = time_get_nanoseconds().count() - m_Start;
+			if(m_ClientId < 0)
+			{
+				m_pProfiler->m_pCurrentScope = m_pParent;
+				if(m_pParent)
+					m_pParent->m_NestedTime += Time;
+			}
+			m_pProfiler->AddTime(m_Phase, m_ClientId, Time - m_NestedTime);
+		}
+	};
+
+private:
+	bool m_Enabled;
+	// innermost running phase scope
+	CScope *m_pCurrentScope;
+	int64_t m_aFrameTime[NUM_PHASES];
+	bool m_aFrameHasPhase[NUM_PHASES];
+	int64_t m_aClientFrameTime[MAX_CLIENTS];
+	bool m_aClientFrameHasSnap[MAX_CLIENTS];
+
+	CHistogram m_aPhases[NUM_PHASES];
+	CHistogram m_aClients[MAX_CLIENTS];
+
+	IOHANDLE m_CsvFile;
+
+	void AddTime(int Phase, int ClientId, int64_t Time);
+	void ResetFrame();
+
+public:
+	CFrameProfiler();
+	~CFrameProfiler();
+
+	bool Enabled() const { return m_Enabled; }
+	void SetEnabled(bool Enabled);
+	void Reset();
+	// records the phases of the current frame and starts the next one
+	void EndFrame(int Tick);
+
+	// takes ownership of the file and writes one line per frame to it
+	void SetCsvFile(IOHANDLE File);
+
+	static const char *PhaseName(int Phase);
+	const CHistogram &PhaseHistogram(int Phase) const { return m_aPhases[Phase]; }
+	const CHistogram &ClientHistogram(int ClientId) const { return m_aClients[ClientId]; }
+};
+
+#endif
@@ -238,6 +238,11 @@ CServer::CServer()
 	m_CurrentGameTick = MIN_TICK;
 	m_RunServer = UNINITIALIZED;
 
+	m_NumSnapDeltaThreads = 0;
+	m_SnapDeltaCacheLookups = 0;
+	m_SnapDeltaCacheHits = 0;
+	m_SnapBuildMismatches = 0;
+
 	m_aShutdownReason[0] = 0;
 
 	for(int i = 0; i < NUM_MAP_TYPES; i++)
@@ -543,6 +548,7 @@ int CServer::Init()
 		Client.m_aClan[0] = 0;
 		Client.m_Country = -1;
 		Client.m_Snapshots.Init();
+		Client.m_Snapshots.SetSharedPool(&m_SnapshotSharedPool);
 		Client.m_Traffic = 0;
 		Client.m_TrafficSince = 0;
 		Client.m_ShowIps = false;
@@ -765,6 +771,11 @@ int CServer::GetClientVersion(int ClientId) const
 	return VERSION_NONE;
 }
 
+// set on a thread while it builds snapshots for BuildSnapshotsParallel,
+// items go into that builder and messages are sent after the build
+static thread_local CSnapshotBuilder *s_pSnapBuildBuilder = nullptr;
+static thread_local std::vector<CDeferredSnapMsg> *s_pSnapBuildMsgs = nullptr;
+
 static inline bool RepackMsg(const CMsgPacker *pMsg, CPacker &Packer, bool Sixup)
 {
 	int MsgId = pMsg->m_MsgId;
@@ -818,6 +829,18 @@ static inline bool RepackMsg(const CMsgPacker *pMsg, CPacker &Packer, bool Sixup
 
 int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientId)
 {
+	if(s_pSnapBuildMsgs)
+	{
+		CDeferredSnapMsg &Msg = s_pSnapBuildMsgs->emplace_back();
+		Msg.m_MsgId = pMsg->m_MsgId;
+		Msg.m_System = pMsg->m_System;
+		Msg.m_NoTranslate = pMsg->m_NoTranslate;
+		Msg.m_Flags = Flags;
+		Msg.m_ClientId = ClientId;
+		Msg.m_vData.assign(pMsg->Data(), pMsg->Data() + pMsg->Size());
+		return 0;
+	}
+
 	CNetChunk Packet;
 	mem_zero(&Packet, sizeof(CNetChunk));
 	if(Flags & MSGFLAG_VITAL)
@@ -914,6 +937,7 @@ void CServer::SendMsgRaw(int ClientId, const void *pData, int Size, int Flags)
 
 void CServer::DoSnapshot()
 {
+	CFrameProfiler::CScope ProfilerScope(&m_FrameProfiler, CFrameProfiler::PHASE_SNAPSHOT);
 	GameServer()->OnPreSnap();
 
 	if(m_aDemoRecorder[RECORDER_MANUAL].IsRecording() || m_aDemoRecorder[RECORDER_AUTO].IsRecording())
@@ -934,6 +958,17 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	int aDeltaTick[MAX_CLIENTS];
+	int aCrc[MAX_CLIENTS];
+	bool aDeltaJobQueued[MAX_CLIENTS] = {false};
+	int NumDeltaJobs = 0;
+	// clients that get the same delta as an earlier client this tick reuse its result,
+	// stored snapshots are shared by content so comparing the pointers is enough
+	int aDeltaSource[MAX_CLIENTS];
+	CSnapDeltaKey aDeltaKeys[MAX_CLIENTS];
+	int NumDeltaKeys = 0;
+	int aSnapClients[MAX_CLIENTS];
+	int NumSnapClients = 0;
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -948,20 +983,56 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick() % 10) != 0)
 			continue;
 
-		{
-			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+		aSnapClients[NumSnapClients++] = i;
+	}
+
+	// the snapshots of different clients only read the game state, so the
+	// workers can build them all before the first one is sent
+	const bool ParallelBuild = m_NumSnapDeltaThreads > 0 && Config()->m_SvSnapshotParallelBuild && NumSnapClients > 1;
+	if(ParallelBuild)
+		BuildSnapshotsParallel(aSnapClients, NumSnapClients);
 
-			GameServer()->OnSnap(i);
+	for(int SnapClient = 0; SnapClient < NumSnapClients; SnapClient++)
+	{
+		const int i = aSnapClients[SnapClient];
+		{
+			CFrameProfiler::CScope ClientProfilerScope(&m_FrameProfiler, CFrameProfiler::PHASE_SNAPSHOT, i);
 
-			// finish snapshot
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
-			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+			int SnapshotSize;
+			if(ParallelBuild)
+			{
+				CSnapBuildResult *pBuild = m_apSnapBuildResults[i].get();
+				if(Config()->m_SvSnapshotParallelCheck)
+					CheckParallelSnapshot(i, pBuild);
+
+				// messages sent while snapping go out before the snapshot, like on the main thread
+				for(const CDeferredSnapMsg &DeferredMsg : pBuild->m_vMsgs)
+				{
+					CMsgPacker Msg(DeferredMsg.m_MsgId, DeferredMsg.m_System, DeferredMsg.m_NoTranslate);
+					Msg.AddRaw(DeferredMsg.m_vData.data(), DeferredMsg.m_vData.size());
+					SendMsg(&Msg, DeferredMsg.m_Flags, DeferredMsg.m_ClientId);
+				}
+				pBuild->m_vMsgs.clear();
+
+				SnapshotSize = pBuild->m_Size;
+				pData = (CSnapshot *)pBuild->m_aData;
+			}
+			else
+			{
+				m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+
+				GameServer()->OnSnap(i);
+
+				// finish snapshot
+				SnapshotSize = m_SnapshotBuilder.Finish(pData);
+			}
 
 			if(m_aDemoRecorder[i].IsRecording())
 			{
 				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
+				m_aDemoRecorder[i].RecordSnapshot(Tick(), pData, SnapshotSize);
 			}
 
 			int Crc = pData->Crc();
@@ -988,63 +1059,177 @@ void CServer::DoSnapshot()
 				}
 			}
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			// the stored copy stays valid until the old snapshots are purged next tick
+			const CSnapshot *pStoredSnapshot = m_aClients[i].m_Snapshots.m_pLast->m_pSnap;
+			const bool Sixup = m_aClients[i].m_Sixup;
+			aDeltaTick[i] = DeltaTick;
+			aCrc[i] = Crc;
 
-			if(DeltaSize)
+			m_SnapDeltaCacheLookups++;
+			int Source = -1;
+			for(int Key = 0; Key < NumDeltaKeys; Key++)
 			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
-
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+				if(aDeltaKeys[Key].m_pFrom == pDeltashot && aDeltaKeys[Key].m_pTo == pStoredSnapshot && aDeltaKeys[Key].m_Sixup == Sixup)
 				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
-
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
+					Source = aDeltaKeys[Key].m_ClientId;
+					break;
 				}
 			}
-			else
+			if(Source >= 0)
+			{
+				m_SnapDeltaCacheHits++;
+				aDeltaSource[i] = Source;
+				if(aDeltaJobQueued[Source])
+				{
+					// send once the worker finished it
+					aDeltaJobQueued[i] = true;
+					continue;
+				}
+				const CSnapDeltaResult *pResult = m_apSnapDeltaResults[Source].get();
+				SendSnapshotDelta(i, DeltaTick, Crc, pResult->m_DeltaSize, pResult->m_aCompressedData, pResult->m_CompressedSize);
+				continue;
+			}
+			aDeltaSource[i] = i;
+			aDeltaKeys[NumDeltaKeys++] = {pDeltashot, pStoredSnapshot, Sixup, i};
+
+			if(!m_apSnapDeltaResults[i])
+				m_apSnapDeltaResults[i] = std::make_unique<CSnapDeltaResult>();
+			CSnapDeltaResult *pResult = m_apSnapDeltaResults[i].get();
+
+			if(m_NumSnapDeltaThreads > 0)
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				m_SnapDeltaPool.Add(std::make_shared<CSnapDeltaJob>(&m_aSnapDeltaJobDeltas[Sixup], pDeltashot, pStoredSnapshot, pResult, &m_SnapDeltaSemaphore));
+				aDeltaJobQueued[i] = true;
+				NumDeltaJobs++;
+				continue;
 			}
+
+			// create delta
+			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, Sixup);
+			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, Sixup);
+			char aDeltaData[CSnapshot::MAX_SIZE];
+			pResult->m_DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+
+			// compress it
+			pResult->m_CompressedSize = 0;
+			if(pResult->m_DeltaSize)
+				pResult->m_CompressedSize = CVariableInt::Compress(aDeltaData, pResult->m_DeltaSize, pResult->m_aCompressedData, sizeof(pResult->m_aCompressedData));
+
+			SendSnapshotDelta(i, DeltaTick, Crc, pResult->m_DeltaSize, pResult->m_aCompressedData, pResult->m_CompressedSize);
 		}
 	}
 
+	// wait for the worker threads and send their results
+	for(int Job = 0; Job < NumDeltaJobs; Job++)
+		sphore_wait(&m_SnapDeltaSemaphore);
+	for(int i = 0; i < MaxClients(); i++)
+	{
+		if(!aDeltaJobQueued[i])
+			continue;
+		const CSnapDeltaResult *pResult = m_apSnapDeltaResults[aDeltaSource[i]].get();
+		SendSnapshotDelta(i, aDeltaTick[i], aCrc[i], pResult->m_DeltaSize, pResult->m_aCompressedData, pResult->m_CompressedSize);
+	}
+
 	GameServer()->OnPostSnap();
 }
 
+void CServer::BuildSnapshotsParallel(const int *pClientIds, int NumClients)
+{
+	const int NumJobs = minimum(m_NumSnapDeltaThreads, NumClients);
+	while((int)m_vpSnapBuilders.size() < NumJobs)
+		m_vpSnapBuilders.push_back(std::make_unique<CSnapshotBuilder>());
+	for(int i = 0; i < NumClients; i++)
+	{
+		if(!m_apSnapBuildResults[pClientIds[i]])
+			m_apSnapBuildResults[pClientIds[i]] = std::make_unique<CSnapBuildResult>();
+	}
+
+	for(int Job = 0; Job < NumJobs; Job++)
+	{
+		m_SnapDeltaPool.Add(std::make_shared<CSnapBuildJob>([this, pClientIds, NumClients, NumJobs, Job]() {
+			CSnapshotBuilder *pBuilder = m_vpSnapBuilders[Job].get();
+			s_pSnapBuildBuilder = pBuilder;
+			for(int i = Job; i < NumClients; i += NumJobs)
+			{
+				const int ClientId = pClientIds[i];
+				CSnapBuildResult *pResult = m_apSnapBuildResults[ClientId].get();
+				s_pSnapBuildMsgs = &pResult->m_vMsgs;
+				pBuilder->Init(m_aClients[ClientId].m_Sixup);
+				GameServer()->OnSnap(ClientId);
+				pResult->m_Size = pBuilder->Finish(pResult->m_aData);
+			}
+			s_pSnapBuildBuilder = nullptr;
+			s_pSnapBuildMsgs = nullptr;
+		},
+			&m_SnapDeltaSemaphore));
+	}
+	for(int Job = 0; Job < NumJobs; Job++)
+		sphore_wait(&m_SnapDeltaSemaphore);
+}
+
+void CServer::CheckParallelSnapshot(int ClientId, const CSnapBuildResult *pResult)
+{
+	// the messages were already queued by the parallel build
+	std::vector<CDeferredSnapMsg> vDiscardedMsgs;
+	s_pSnapBuildMsgs = &vDiscardedMsgs;
+	m_SnapshotBuilder.Init(m_aClients[ClientId].m_Sixup);
+	GameServer()->OnSnapCheck(ClientId);
+	char aData[CSnapshot::MAX_SIZE];
+	const int Size = m_SnapshotBuilder.Finish(aData);
+	s_pSnapBuildMsgs = nullptr;
+
+	if(Size != pResult->m_Size || mem_comp(aData, pResult->m_aData, Size) != 0)
+	{
+		m_SnapBuildMismatches++;
+		log_error("server", "parallel snapshot of client %d differs from the main thread (size %d vs %d, %" PRIu64 " mismatches)",
+			ClientId, pResult->m_Size, Size, m_SnapBuildMismatches);
+	}
+}
+
+void CServer::SendSnapshotDelta(int ClientId, int DeltaTick, int Crc, int DeltaSize, const char *pCompData, int CompSize)
+{
+	if(!DeltaSize)
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+		return;
+	}
+
+	const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+	int NumPackets = (CompSize + MaxSize - 1) / MaxSize;
+
+	for(int n = 0, Left = CompSize; Left > 0; n++)
+	{
+		int Chunk = Left < MaxSize ? Left : MaxSize;
+		Left -= Chunk;
+
+		if(NumPackets == 1)
+		{
+			CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+			Msg.AddInt(m_CurrentGameTick);
+			Msg.AddInt(m_CurrentGameTick - DeltaTick);
+			Msg.AddInt(Crc);
+			Msg.AddInt(Chunk);
+			Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+			SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_SNAP, true);
+			Msg.AddInt(m_CurrentGameTick);
+			Msg.AddInt(m_CurrentGameTick - DeltaTick);
+			Msg.AddInt(NumPackets);
+			Msg.AddInt(n);
+			Msg.AddInt(Crc);
+			Msg.AddInt(Chunk);
+			Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+			SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+		}
+	}
+}
+
 int CServer::ClientRejoinCallback(int ClientId, void *pUser)
 {
 	CServer *pThis = (CServer *)pUser;
@@ -2578,6 +2763,7 @@ void CServer::UpdateServerInfo(bool Resend)
 
 void CServer::PumpNetwork(bool PacketWaiting)
 {
+	CFrameProfiler::CScope ProfilerScope(&m_FrameProfiler, CFrameProfiler::PHASE_NETWORK);
 	CNetChunk Packet;
 	SECURITY_TOKEN ResponseToken;
 
@@ -2842,7 +3028,7 @@ void CServer::UpdateDebugDummies(bool ForceDisconnect)
 }
 #endif
 
-int CServer::Run()
+bool CServer::InitGame()
 {
 	if(m_RunServer == UNINITIALIZED)
 		m_RunServer = RUNNING;
@@ -2868,9 +3054,94 @@ int CServer::Run()
 	if(!LoadMap(Config()->m_SvMap))
 	{
 		log_error("server", "failed to load map. mapname='%s'", Config()->m_SvMap);
-		return -1;
+		return false;
+	}
+	return true;
+}
+
+void CServer::StartGame()
+{
+	m_NumSnapDeltaThreads = Config()->m_SvSnapshotThreads;
+	if(m_NumSnapDeltaThreads > 0)
+	{
+		sphore_init(&m_SnapDeltaSemaphore);
+		m_SnapDeltaPool.Init(m_NumSnapDeltaThreads);
+	}
+
+	Antibot()->Init();
+	GameServer()->OnInit(nullptr);
+}
+
+void CServer::GameTick()
+{
+	{
+		CFrameProfiler::CScope ProfilerScope(&m_FrameProfiler, CFrameProfiler::PHASE_INPUT);
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(m_aClients[c].m_State != CClient::STATE_INGAME)
+				continue;
+			bool ClientHadInput = false;
+			for(auto &Input : m_aClients[c].m_aInputs)
+			{
+				if(Input.m_GameTick == Tick() + 1)
+				{
+					GameServer()->OnClientPredictedEarlyInput(c, Input.m_aData);
+					ClientHadInput = true;
+				}
+			}
+			if(!ClientHadInput)
+				GameServer()->OnClientPredictedEarlyInput(c, nullptr);
+		}
+	}
+
+	m_CurrentGameTick++;
+
+	// apply new input
+	{
+		CFrameProfiler::CScope ProfilerScope(&m_FrameProfiler, CFrameProfiler::PHASE_INPUT);
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(m_aClients[c].m_State != CClient::STATE_INGAME)
+				continue;
+			bool ClientHadInput = false;
+			for(auto &Input : m_aClients[c].m_aInputs)
+			{
+				if(Input.m_GameTick == Tick())
+				{
+					GameServer()->OnClientPredictedInput(c, Input.m_aData);
+					ClientHadInput = true;
+					break;
+				}
+			}
+			if(!ClientHadInput)
+				GameServer()->OnClientPredictedInput(c, nullptr);
+		}
+	}
+
+	{
+		CFrameProfiler::CScope ProfilerScope(&m_FrameProfiler, CFrameProfiler::PHASE_GAME_TICK);
+		GameServer()->OnTick();
+	}
+}
+
+void CServer::StopGame()
+{
+	if(m_NumSnapDeltaThreads > 0)
+	{
+		m_SnapDeltaPool.Shutdown();
+		sphore_destroy(&m_SnapDeltaSemaphore);
 	}
 
+	GameServer()->OnShutdown(nullptr);
+	m_pMap->Unload();
+	DbPool()->OnShutdown();
+}
+
+int CServer::Run()
+{
+	if(!InitGame())
+		return -1;
+
 	if(Config()->m_SvSqliteFile[0] != '\0')
 	{
 		char aFullPath[IO_MAX_PATH_LENGTH];
@@ -2936,8 +3207,7 @@ int CServer::Run()
 	str_format(aBuf, sizeof(aBuf), "server name is '%s'", Config()->m_SvName);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 
-	Antibot()->Init();
-	GameServer()->OnInit(nullptr);
+	StartGame();
 	if(ErrorShutdown())
 	{
 		m_RunServer = STOPPING;
@@ -3058,52 +3328,17 @@ int CServer::Run()
 				UpdateDebugDummies(false);
 #endif
 
-				for(int c = 0; c < MAX_CLIENTS; c++)
-				{
-					if(m_aClients[c].m_State != CClient::STATE_INGAME)
-						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick() + 1)
-						{
-							GameServer()->OnClientPredictedEarlyInput(c, Input.m_aData);
-							ClientHadInput = true;
-						}
-					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedEarlyInput(c, nullptr);
-				}
-
-				m_CurrentGameTick++;
+				GameTick();
 				NewTicks++;
-
-				// apply new input
-				for(int c = 0; c < MAX_CLIENTS; c++)
-				{
-					if(m_aClients[c].m_State != CClient::STATE_INGAME)
-						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick())
-						{
-							GameServer()->OnClientPredictedInput(c, Input.m_aData);
-							ClientHadInput = true;
-							break;
-						}
-					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedInput(c, nullptr);
-				}
-
-				GameServer()->OnTick();
 				if(ErrorShutdown())
 				{
 					break;
 				}
 			}
 
+			// collect the packets of this tick and send them in batches
+			m_NetServer.BeginSendBatch();
+
 			// snap game
 			if(NewTicks)
 			{
@@ -3124,8 +3359,11 @@ int CServer::Run()
 				}
 #endif
 
-				// master server stuff
-				m_pRegister->Update();
+				// master server stuff, hands the register requests to the http thread
+				{
+					CFrameProfiler::CScope ProfilerScope(&m_FrameProfiler, CFrameProfiler::PHASE_REGISTER);
+					m_pRegister->Update();
+				}
 
 				if(m_ServerInfoNeedsUpdate)
 					UpdateServerInfo();
@@ -3187,6 +3425,11 @@ int CServer::Run()
 			if(!NonActive)
 				PumpNetwork(PacketWaiting);
 
+			m_NetServer.EndSendBatch();
+
+			if(NewTicks)
+				m_FrameProfiler.EndFrame(Tick());
+
 			NonActive = true;
 			for(const auto &Client : m_aClients)
 			{
@@ -3253,10 +3496,7 @@ int CServer::Run()
 	m_Econ.Shutdown();
 	m_Fifo.Shutdown();
 	Engine()->ShutdownJobs();
-
-	GameServer()->OnShutdown(nullptr);
-	m_pMap->Unload();
-	DbPool()->OnShutdown();
+	StopGame();
 
 #if defined(CONF_UPNP)
 	m_UPnP.Shutdown();
@@ -3727,6 +3967,95 @@ void CServer::ConShowIps(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConNetSendStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pServer = (CServer *)pUser;
+	const CNetServer &NetServer = pServer->m_NetServer;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "send syscalls saved by batching: last=%d avg=%.2f total=%" PRIu64 " (%" PRIu64 " batches)",
+		NetServer.SendBatchSyscallsSaved(),
+		NetServer.NumSendBatches() ? (double)NetServer.SendBatchSyscallsSavedTotal() / NetServer.NumSendBatches() : 0.0,
+		NetServer.SendBatchSyscallsSavedTotal(), NetServer.NumSendBatches());
+	pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConSnapshotStorageStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pServer = (CServer *)pUser;
+
+	size_t CurrentBytes = 0;
+	size_t PeakBytes = 0;
+	uint64_t NumReused = 0;
+	uint64_t NumAllocated = 0;
+	for(const auto &Client : pServer->m_aClients)
+	{
+		const CSnapshotStorage::CStats &Stats = Client.m_Snapshots.Stats();
+		CurrentBytes += Stats.m_CurrentBytes;
+		PeakBytes += Stats.m_PeakBytes;
+		NumReused += Stats.m_NumReused;
+		NumAllocated += Stats.m_NumAllocated;
+	}
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "snapshot storage: current=%" PRIzu " bytes, peak=%" PRIzu " bytes, reused=%" PRIu64 " allocated=%" PRIu64 " (%.2f%% reuse)",
+		CurrentBytes, PeakBytes, NumReused, NumAllocated,
+		NumReused + NumAllocated ? 100.0 * NumReused / (NumReused + NumAllocated) : 0.0);
+	pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	const CSnapshotSharedPool::CStats &PoolStats = pServer->m_SnapshotSharedPool.Stats();
+	str_format(aBuf, sizeof(aBuf), "shared snapshots: current=%" PRIzu " bytes, peak=%" PRIzu " bytes, saved=%" PRIzu " bytes, shared=%" PRIu64 "/%" PRIu64,
+		PoolStats.m_CurrentBytes, PoolStats.m_PeakBytes, PoolStats.m_SavedBytes, PoolStats.m_NumShared, PoolStats.m_NumAcquired);
+	pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConSnapDeltaCacheStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pServer = (CServer *)pUser;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "snapshot delta cache: hits=%" PRIu64 " lookups=%" PRIu64 " (%.2f%% hit rate)",
+		pServer->m_SnapDeltaCacheHits, pServer->m_SnapDeltaCacheLookups,
+		pServer->m_SnapDeltaCacheLookups ? 100.0 * pServer->m_SnapDeltaCacheHits / pServer->m_SnapDeltaCacheLookups : 0.0);
+	pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConFrameProfilerDump(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pServer = (CServer *)pUser;
+	const CFrameProfiler &Profiler = pServer->m_FrameProfiler;
+	if(!Profiler.Enabled())
+		pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "frame profiler is disabled, enable it with sv_frame_profiler 1");
+
+	char aBuf[256];
+	for(int Phase = 0; Phase < CFrameProfiler::NUM_PHASES; Phase++)
+	{
+		const CFrameProfiler::CHistogram &Histogram = Profiler.PhaseHistogram(Phase);
+		str_format(aBuf, sizeof(aBuf), "%-12s frames=%" PRIu64 " mean=%.1fus p50=%.1fus p99=%.1fus max=%.1fus",
+			CFrameProfiler::PhaseName(Phase), Histogram.Count(), Histogram.Mean() / 1000.0,
+			Histogram.Percentile(0.5) / 1000.0, Histogram.Percentile(0.99) / 1000.0, Histogram.Max() / 1000.0);
+		pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+
+	// snapshot time broken down by client
+	for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+	{
+		const CFrameProfiler::CHistogram &Histogram = Profiler.ClientHistogram(ClientId);
+		if(!Histogram.Count())
+			continue;
+		str_format(aBuf, sizeof(aBuf), "snapshot id=%d name='%s' frames=%" PRIu64 " mean=%.1fus p50=%.1fus p99=%.1fus max=%.1fus",
+			ClientId, pServer->ClientName(ClientId), Histogram.Count(), Histogram.Mean() / 1000.0,
+			Histogram.Percentile(0.5) / 1000.0, Histogram.Percentile(0.99) / 1000.0, Histogram.Max() / 1000.0);
+		pServer->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
+void CServer::ConFrameProfilerReset(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pServer = (CServer *)pUser;
+	pServer->m_FrameProfiler.Reset();
+}
+
 void CServer::ConAddSqlServer(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pSelf = (CServer *)pUserData;
@@ -3975,6 +4304,32 @@ void CServer::ConchainSixupUpdate(IConsole::IResult *pResult, void *pUserData, I
 		pThis->m_MapReload |= (pThis->m_apCurrentMapData[MAP_TYPE_SIXUP] != 0) != (pResult->GetInteger(0) != 0);
 }
 
+void CServer::ConchainFrameProfilerUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	CServer *pThis = static_cast<CServer *>(pUserData);
+	if(pResult->NumArguments() >= 1)
+		pThis->m_FrameProfiler.SetEnabled(pThis->Config()->m_SvFrameProfiler);
+}
+
+void CServer::ConchainFrameProfilerCsvUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments() < 1)
+		return;
+
+	CServer *pThis = static_cast<CServer *>(pUserData);
+	const char *pFilename = pThis->Config()->m_SvFrameProfilerCsv;
+	IOHANDLE File = nullptr;
+	if(pFilename[0] != '\0')
+	{
+		File = pThis->Storage()->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(!File)
+			log_error("server", "failed to open frame profiler csv file '%s'", pFilename);
+	}
+	pThis->m_FrameProfiler.SetCsvFile(File);
+}
+
 void CServer::ConchainLoglevel(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	CServer *pSelf = (CServer *)pUserData;
@@ -4050,6 +4405,11 @@ void CServer::RegisterCommands()
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
+	Console()->Register("net_send_stats", "", CFGFLAG_SERVER, ConNetSendStats, this, "Show how many send syscalls were saved by batching outgoing packets");
+	Console()->Register("snapshot_storage_stats", "", CFGFLAG_SERVER, ConSnapshotStorageStats, this, "Show memory usage, buffer reuse and deduplication of the per-client snapshot storage");
+	Console()->Register("snap_delta_cache_stats", "", CFGFLAG_SERVER, ConSnapDeltaCacheStats, this, "Show how often snapshot deltas were reused between clients");
+	Console()->Register("frame_profiler_dump", "", CFGFLAG_SERVER, ConFrameProfilerDump, this, "Show the time spent in each phase of the server tick (needs sv_frame_profiler 1)");
+	Console()->Register("frame_profiler_reset", "", CFGFLAG_SERVER, ConFrameProfilerReset, this, "Clear the frame profiler histograms");
 
 	Console()->Register("record", "?s[file]", CFGFLAG_SERVER | CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
@@ -4083,6 +4443,8 @@ void CServer::RegisterCommands()
 	Console()->Chain("sv_rcon_helper_password", ConchainRconHelperPasswordChange, this);
 	Console()->Chain("sv_map", ConchainMapUpdate, this);
 	Console()->Chain("sv_sixup", ConchainSixupUpdate, this);
+	Console()->Chain("sv_frame_profiler", ConchainFrameProfilerUpdate, this);
+	Console()->Chain("sv_frame_profiler_csv", ConchainFrameProfilerCsvUpdate, this);
 
 	Console()->Chain("loglevel", ConchainLoglevel, this);
 	Console()->Chain("stdout_output_level", ConchainStdoutOutputLevel, this);
@@ -4101,23 +4463,34 @@ void CServer::RegisterCommands()
 
 int CServer::SnapNewId()
 {
+	dbg_assert(!s_pSnapBuildBuilder, "snap ids can't be allocated while building snapshots in parallel");
 	return m_IdPool.NewId();
 }
 
 void CServer::SnapFreeId(int Id)
 {
+	dbg_assert(!s_pSnapBuildBuilder, "snap ids can't be freed while building snapshots in parallel");
 	m_IdPool.FreeId(Id);
 }
 
 void *CServer::SnapNewItem(int Type, int Id, int Size)
 {
 	dbg_assert(Id >= -1 && Id <= 0xffff, "incorrect id");
-	return Id < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, Id, Size);
+	if(Id < 0)
+		return 0;
+	return s_pSnapBuildBuilder ? s_pSnapBuildBuilder->NewItem(Type, Id, Size) : m_SnapshotBuilder.NewItem(Type, Id, Size);
 }
 
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	for(int Sixup = 0; Sixup < 2; Sixup++)
+	{
+		m_aSnapDeltaJobDeltas[Sixup].SetStaticsize(ItemType, Size);
+		// same overrides the serial path applies per client in DoSnapshot
+		m_aSnapDeltaJobDeltas[Sixup].SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, Sixup);
+		m_aSnapDeltaJobDeltas[Sixup].SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, Sixup);
+	}
 }
 
 CServer *CreateServer() { return new CServer(); }
@@ -12,6 +12,7 @@
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
 #include <engine/shared/http.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
@@ -25,7 +26,10 @@
 
 #include "antibot.h"
 #include "authmanager.h"
+#include "frame_profiler.h"
 #include "name_ban.h"
+#include "snap_build_job.h"
+#include "snap_delta_job.h"
 #include "snap_id_pool.h"
 
 #if defined(CONF_UPNP)
@@ -70,6 +74,9 @@ public:
 	void ClearRandomMapPool() override;
 	const char *GetRandomMapFromPool() override;
 	void ShutdownServer() override { m_RunServer = STOPPING; };
+	CFrameProfiler *FrameProfiler() { return &m_FrameProfiler; }
+	void BeginSqlResultsProfile() override { m_SqlResultsProfileScope.emplace(&m_FrameProfiler, CFrameProfiler::PHASE_SQL_RESULTS); }
+	void EndSqlResultsProfile() override { m_SqlResultsProfileScope.reset(); }
 	static void ConRedirect(IConsole::IResult *pResult, void *pUser);
 
 private:
@@ -217,11 +224,31 @@ public:
 		}
 	};
 
+	// identical snapshots of different clients are only stored once,
+	// declared before the clients so it outlives their storages
+	CSnapshotSharedPool m_SnapshotSharedPool;
 	CClient m_aClients[MAX_CLIENTS];
 	int m_aIdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// snapshot deltas are created on worker threads if sv_snapshot_threads is set
+	int m_NumSnapDeltaThreads;
+	CJobPool m_SnapDeltaPool;
+	SEMAPHORE m_SnapDeltaSemaphore;
+	CSnapshotDelta m_aSnapDeltaJobDeltas[2]; // index 1 is used for sixup clients
+	std::unique_ptr<CSnapDeltaResult> m_apSnapDeltaResults[MAX_CLIENTS];
+	// with sv_snapshot_parallel_build the snapshots are built on the same workers
+	std::vector<std::unique_ptr<CSnapshotBuilder>> m_vpSnapBuilders;
+	std::unique_ptr<CSnapBuildResult> m_apSnapBuildResults[MAX_CLIENTS];
+	// parallel builds that differed from the main thread, see sv_snapshot_parallel_check
+	uint64_t m_SnapBuildMismatches;
+	CFrameProfiler m_FrameProfiler;
+	std::optional<CFrameProfiler::CScope> m_SqlResultsProfileScope;
+	// deltas reused from another client with the same base and target snapshot
+	uint64_t m_SnapDeltaCacheLookups;
+	uint64_t m_SnapDeltaCacheHits;
 	CSnapIdPool m_IdPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -341,6 +368,9 @@ public:
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientId) override;
 
 	void DoSnapshot();
+	void BuildSnapshotsParallel(const int *pClientIds, int NumClients);
+	void CheckParallelSnapshot(int ClientId, const CSnapBuildResult *pResult);
+	void SendSnapshotDelta(int ClientId, int DeltaTick, int Crc, int DeltaSize, const char *pCompData, int CompSize);
 
 	static int NewClientCallback(int ClientId, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientId, void *pUser);
@@ -426,6 +456,12 @@ public:
 	void ReloadMap() override;
 	int LoadMap(const char *pMapName);
 
+	// the game parts of Run, also used to run the game without the network
+	bool InitGame();
+	void StartGame();
+	void GameTick();
+	void StopGame();
+
 	void SaveDemo(int ClientId, float Time) override;
 	void StartRecord(int ClientId) override;
 	void StopRecord(int ClientId) override;
@@ -442,6 +478,11 @@ public:
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConShowIps(IConsole::IResult *pResult, void *pUser);
+	static void ConNetSendStats(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapshotStorageStats(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapDeltaCacheStats(IConsole::IResult *pResult, void *pUser);
+	static void ConFrameProfilerDump(IConsole::IResult *pResult, void *pUser);
+	static void ConFrameProfilerReset(IConsole::IResult *pResult, void *pUser);
 
 	static void ConAuthAdd(IConsole::IResult *pResult, void *pUser);
 	static void ConAuthAddHashed(IConsole::IResult *pResult, void *pUser);
@@ -470,6 +511,8 @@ public:
 	static void ConchainRconHelperPasswordChange(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMapUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainSixupUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainFrameProfilerUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainFrameProfilerCsvUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainLoglevel(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainStdoutOutputLevel(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainAnnouncementFileName(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
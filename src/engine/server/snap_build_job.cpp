@@ -0,0 +1,13 @@
+#include "snap_build_job.h"
+
+CSnapBuildJob::CSnapBuildJob(std::function<void()> &&fnBuild, SEMAPHORE *pDoneSemaphore) :
+	m_fnBuild(std::move(fnBuild)),
+	m_pDoneSemaphore(pDoneSemaphore)
+{
+}
+
+void CSnapBuildJob::Run()
+{
+	m_fnBuild();
+	sphore_signal(m_pDoneSemaphore);
+}
@@ -0,0 +1,47 @@
+#ifndef ENGINE_SERVER_SNAP_BUILD_JOB_H
+#define ENGINE_SERVER_SNAP_BUILD_JOB_H
+
+#include <base/system.h>
+
+#include <engine/shared/jobs.h>
+#include <engine/shared/snapshot.h>
+
+#include <functional>
+#include <vector>
+
+// message the game sent while a worker thread built a snapshot,
+// the main thread sends it before the snapshot of that client
+class CDeferredSnapMsg
+{
+public:
+	int m_MsgId;
+	bool m_System;
+	bool m_NoTranslate;
+	int m_Flags;
+	int m_ClientId;
+	std::vector<unsigned char> m_vData;
+};
+
+// snapshot of one client built by a worker thread
+class CSnapBuildResult
+{
+public:
+	int m_Size;
+	char m_aData[CSnapshot::MAX_SIZE];
+	std::vector<CDeferredSnapMsg> m_vMsgs;
+};
+
+// builds the snapshots of a set of clients, the sets of concurrent jobs must be disjoint
+// the game state must not be modified until the job signaled the semaphore
+class CSnapBuildJob : public IJob
+{
+	std::function<void()> m_fnBuild;
+	SEMAPHORE *m_pDoneSemaphore;
+
+	void Run() override;
+
+public:
+	CSnapBuildJob(std::function<void()> &&fnBuild, SEMAPHORE *pDoneSemaphore);
+};
+
+#endif
@@ -0,0 +1,24 @@
+#include "snap_delta_job.h"
+
+#include <engine/shared/compression.h>
+
+CSnapDeltaJob::CSnapDeltaJob(const CSnapshotDelta *pSnapshotDelta, const CSnapshot *pFrom, const CSnapshot *pTo, CSnapDeltaResult *pResult, SEMAPHORE *pDoneSemaphore) :
+	m_pSnapshotDelta(pSnapshotDelta),
+	m_pFrom(pFrom),
+	m_pTo(pTo),
+	m_pResult(pResult),
+	m_pDoneSemaphore(pDoneSemaphore)
+{
+}
+
+void CSnapDeltaJob::Run()
+{
+	// scratch buffer is owned by the worker thread
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	m_pResult->m_DeltaSize = m_pSnapshotDelta->CreateDelta(m_pFrom, m_pTo, aDeltaData);
+	m_pResult->m_CompressedSize = 0;
+	if(m_pResult->m_DeltaSize)
+		m_pResult->m_CompressedSize = CVariableInt::Compress(aDeltaData, m_pResult->m_DeltaSize, m_pResult->m_aCompressedData, sizeof(m_pResult->m_aCompressedData));
+
+	sphore_signal(m_pDoneSemaphore);
+}
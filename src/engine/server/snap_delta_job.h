@@ -0,0 +1,46 @@
+#ifndef ENGINE_SERVER_SNAP_DELTA_JOB_H
+#define ENGINE_SERVER_SNAP_DELTA_JOB_H
+
+#include <base/system.h>
+
+#include <engine/shared/jobs.h>
+#include <engine/shared/snapshot.h>
+
+// output of one client's snapshot delta, written by a worker thread
+// and read by the main thread after the send barrier of the tick
+class CSnapDeltaResult
+{
+public:
+	int m_DeltaSize;
+	int m_CompressedSize;
+	char m_aCompressedData[CSnapshot::MAX_SIZE];
+};
+
+// identifies a delta computed for a client during one tick, the snapshot
+// pointers must stay valid until the tick's deltas are sent
+class CSnapDeltaKey
+{
+public:
+	const CSnapshot *m_pFrom;
+	const CSnapshot *m_pTo;
+	bool m_Sixup;
+	int m_ClientId;
+};
+
+// creates and compresses the delta between two snapshots
+// the snapshots and the delta sizes must not be modified until the job signaled the semaphore
+class CSnapDeltaJob : public IJob
+{
+	const CSnapshotDelta *m_pSnapshotDelta;
+	const CSnapshot *m_pFrom;
+	const CSnapshot *m_pTo;
+	CSnapDeltaResult *m_pResult;
+	SEMAPHORE *m_pDoneSemaphore;
+
+	void Run() override;
+
+public:
+	CSnapDeltaJob(const CSnapshotDelta *pSnapshotDelta, const CSnapshot *pFrom, const CSnapshot *pTo, CSnapDeltaResult *pResult, SEMAPHORE *pDoneSemaphore);
+};
+
+#endif
@@ -94,110 +94,94 @@ void CHuffman::Init(const unsigned *pFrequencies)
 {
 	// make sure to cleanout every thing
 	mem_zero(m_aNodes, sizeof(m_aNodes));
-	mem_zero(m_apDecodeLut, sizeof(m_apDecodeLut));
+	mem_zero(m_aDecodeLut, sizeof(m_aDecodeLut));
 	m_pStartNode = 0x0;
 	m_NumNodes = 0;
 
 	// construct the tree
 	ConstructTree(pFrequencies);
 
-	// build decode LUT
+	// build decode LUT, decoding as many symbols as fit into the lut bits
 	for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
-		unsigned Bits = i;
-		int k;
-		CNode *pNode = m_pStartNode;
-		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+		CDecodeEntry &Entry = m_aDecodeLut[i];
+		const CNode *pNode = m_pStartNode;
+		for(int k = 0; k < HUFFMAN_LUTBITS; k++)
 		{
-			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
-			Bits >>= 1;
-
-			if(!pNode)
-				break;
+			pNode = &m_aNodes[pNode->m_aLeafs[(i >> k) & 1]];
+			if(!pNode->m_NumBits)
+				continue;
 
-			if(pNode->m_NumBits)
+			Entry.m_NumBits = k + 1;
+			if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
 			{
-				m_apDecodeLut[i] = pNode;
+				Entry.m_Eof = true;
 				break;
 			}
+			Entry.m_aSymbols[Entry.m_NumSymbols++] = pNode->m_Symbol;
+			if(Entry.m_NumSymbols == HUFFMAN_LUTSYMBOLS)
+				break;
+			pNode = m_pStartNode;
 		}
 
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
+		if(!Entry.m_NumBits)
+			Entry.m_Node = pNode - m_aNodes;
 	}
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	do \
-	{ \
-		Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-		Bitcount += m_aNodes[Sym].m_NumBits; \
-	} while(0)
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	do \
-	{ \
-		while(Bitcount >= 8) \
-		{ \
-			*pDst++ = (unsigned char)(Bits & 0xff); \
-			if(pDst == pDstEnd) \
-				return -1; \
-			Bits >>= 8; \
-			Bitcount -= 8; \
-		} \
-	} while(0)
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	// codes are at most 32 bits, so a word always has room for the next one
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	// there always has to be space left for the trailing byte
+	while(pSrc != pSrcEnd)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		const CNode &Node = m_aNodes[*pSrc++];
+		Bits |= (uint64_t)Node.m_Bits << Bitcount;
+		Bitcount += Node.m_NumBits;
 
-		while(pSrc != pSrcEnd)
+		if(Bitcount >= 32)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE();
+			if(pDstEnd - pDst <= 4)
+				return -1;
+			pDst[0] = (unsigned char)Bits;
+			pDst[1] = (unsigned char)(Bits >> 8);
+			pDst[2] = (unsigned char)(Bits >> 16);
+			pDst[3] = (unsigned char)(Bits >> 24);
+			pDst += 4;
+			Bits >>= 32;
+			Bitcount -= 32;
 		}
-
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-		HUFFMAN_MACRO_WRITE();
 	}
 
 	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL);
-	HUFFMAN_MACRO_WRITE();
+	Bits |= (uint64_t)m_aNodes[HUFFMAN_EOF_SYMBOL].m_Bits << Bitcount;
+	Bitcount += m_aNodes[HUFFMAN_EOF_SYMBOL].m_NumBits;
+	while(Bitcount >= 8)
+	{
+		if(pDstEnd - pDst <= 1)
+			return -1;
+		*pDst++ = (unsigned char)Bits;
+		Bits >>= 8;
+		Bitcount -= 8;
+	}
 
 	// write out the last bits
-	*pDst++ = Bits;
+	if(pDst == pDstEnd)
+		return -1;
+	*pDst++ = (unsigned char)Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -205,71 +189,61 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
-
 	while(true)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		const CNode *pNode = 0;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
+		// fill with new bits
+		while(Bitcount <= 56 && pSrc != pSrcEnd)
 		{
-			Bits |= (*pSrc++) << Bitcount;
+			Bits |= (uint64_t)(*pSrc++) << Bitcount;
 			Bitcount += 8;
 		}
 
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		if(!pNode)
-			return -1;
-
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
+		const CDecodeEntry &Entry = m_aDecodeLut[Bits & HUFFMAN_LUTMASK];
+		if(Entry.m_NumBits)
 		{
-			// remove the bits for that symbol
-			Bits >>= pNode->m_NumBits;
-			Bitcount -= pNode->m_NumBits;
+			// the symbols were decoded from bits past the end of the input
+			if(Entry.m_NumBits > Bitcount)
+				return -1;
+			Bits >>= Entry.m_NumBits;
+			Bitcount -= Entry.m_NumBits;
+
+			if(pDstEnd - pDst < Entry.m_NumSymbols)
+				return -1;
+			for(int i = 0; i < Entry.m_NumSymbols; i++)
+				*pDst++ = Entry.m_aSymbols[i];
+
+			if(Entry.m_Eof)
+				break;
+			continue;
 		}
-		else
-		{
-			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
 
-			// walk the tree bit by bit
-			while(true)
-			{
-				// traverse tree
-				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
-
-				// remove bit
-				Bitcount--;
-				Bits >>= 1;
+		// the code is longer than the lut, walk the rest of the tree bit by bit
+		if(Bitcount < HUFFMAN_LUTBITS)
+			return -1;
+		Bits >>= HUFFMAN_LUTBITS;
+		Bitcount -= HUFFMAN_LUTBITS;
 
-				// check if we hit a symbol
-				if(pNode->m_NumBits)
-					break;
+		const CNode *pNode = &m_aNodes[Entry.m_Node];
+		while(!pNode->m_NumBits)
+		{
+			// no more bits, decoding error
+			if(Bitcount == 0)
+				return -1;
 
-				// no more bits, decoding error
-				if(Bitcount == 0)
-					return -1;
-			}
+			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+			Bitcount--;
+			Bits >>= 1;
 		}
 
 		// check for eof
-		if(pNode == pEof)
+		if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
 			break;
 
 		// output character
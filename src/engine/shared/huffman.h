@@ -12,9 +12,10 @@ class CHuffman
 		HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
 		HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
 
-		HUFFMAN_LUTBITS = 10,
+		HUFFMAN_LUTBITS = 12,
 		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1),
+		HUFFMAN_LUTSYMBOLS = 3
 	};
 
 	struct CNode
@@ -30,10 +31,23 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	// everything that can be decoded from the next HUFFMAN_LUTBITS bits
+	struct CDecodeEntry
+	{
+		// bits taken by the decoded symbols, 0 if the first code is longer than the lut
+		unsigned char m_NumBits;
+		unsigned char m_NumSymbols;
+		// the last decoded symbol is the eof symbol, it's not part of m_aSymbols
+		bool m_Eof;
+		unsigned char m_aSymbols[HUFFMAN_LUTSYMBOLS];
+		// node to continue walking the tree from if m_NumBits is 0
+		unsigned short m_Node;
+	};
+
 	static const unsigned ms_aFreqTable[HUFFMAN_MAX_SYMBOLS];
 
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
-	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CDecodeEntry m_aDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
 
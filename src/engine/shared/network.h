@@ -10,6 +10,7 @@
 #include <base/system.h>
 
 #include <array>
+#include <unordered_map>
 
 class CHuffman;
 class CNetBan;
@@ -414,6 +415,9 @@ class CNetServer
 	int m_MaxClients;
 	int m_MaxClientsPerIp;
 
+	// peer address -> slot, so packets don't have to be matched against every slot
+	std::unordered_map<NETADDR, int> m_SlotsByAddr;
+
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_NEWCLIENT_NOAUTH m_pfnNewClientNoAuth;
 	NETFUNC_DELCLIENT m_pfnDelClient;
@@ -430,6 +434,11 @@ class CNetServer
 
 	CSpamConn m_aSpamConns[NET_CONNLIMIT_IPS];
 
+	// send batching
+	int m_SendBatchSyscallsSaved;
+	uint64_t m_SendBatchSyscallsSavedTotal;
+	uint64_t m_NumSendBatches;
+
 	CNetRecvUnpacker m_RecvUnpacker;
 
 	void OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketConstruct &Packet);
@@ -438,6 +447,8 @@ class CNetServer
 	void OnConnCtrlMsg(NETADDR &Addr, int ClientId, int ControlMsg, const CNetPacketConstruct &Packet);
 	bool ClientExists(const NETADDR &Addr) { return GetClientSlot(Addr) != -1; }
 	int GetClientSlot(const NETADDR &Addr);
+	void IndexSlot(int Slot);
+	void UnindexSlot(int Slot);
 	void SendControl(NETADDR &Addr, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken);
 
 	int TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, bool VanillaAuth = false, bool Sixup = false, SECURITY_TOKEN Token = 0);
@@ -461,6 +472,13 @@ public:
 	//
 	int Drop(int ClientId, const char *pReason);
 
+	// queues outgoing packets until EndSendBatch sends them with as few syscalls as possible
+	void BeginSendBatch();
+	void EndSendBatch();
+	int SendBatchSyscallsSaved() const { return m_SendBatchSyscallsSaved; }
+	uint64_t SendBatchSyscallsSavedTotal() const { return m_SendBatchSyscallsSavedTotal; }
+	uint64_t NumSendBatches() const { return m_NumSendBatches; }
+
 	// status requests
 	const NETADDR *ClientAddr(int ClientId) const { return m_aSlots[ClientId].m_Connection.PeerAddress(); }
 	const std::array<char, NETADDR_MAXSTRSIZE> &ClientAddrString(int ClientId, bool IncludePort) const { return m_aSlots[ClientId].m_Connection.PeerAddressString(IncludePort); }
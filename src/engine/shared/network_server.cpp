@@ -100,10 +100,23 @@ int CNetServer::Drop(int ClientId, const char *pReason)
 		m_pfnDelClient(ClientId, pReason, m_pUser);
 
 	m_aSlots[ClientId].m_Connection.Disconnect(pReason);
+	UnindexSlot(ClientId);
 
 	return 0;
 }
 
+void CNetServer::BeginSendBatch()
+{
+	net_udp_batch_begin(m_Socket);
+}
+
+void CNetServer::EndSendBatch()
+{
+	m_SendBatchSyscallsSaved = net_udp_batch_end(m_Socket);
+	m_SendBatchSyscallsSavedTotal += m_SendBatchSyscallsSaved;
+	m_NumSendBatches++;
+}
+
 int CNetServer::Update()
 {
 	for(int i = 0; i < MaxClients(); i++)
@@ -241,7 +254,9 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 	}
 
 	// init connection slot
+	UnindexSlot(Slot);
 	m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken, Token, Sixup);
+	IndexSlot(Slot);
 
 	if(VanillaAuth)
 	{
@@ -571,20 +586,32 @@ int CNetServer::OnSixupCtrlMsg(NETADDR &Addr, CNetChunk *pChunk, int ControlMsg,
 
 int CNetServer::GetClientSlot(const NETADDR &Addr)
 {
-	int Slot = -1;
+	auto It = m_SlotsByAddr.find(Addr);
+	if(It == m_SlotsByAddr.end())
+		return -1;
 
-	for(int i = 0; i < MaxClients(); i++)
-	{
-		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
-			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_ERROR &&
-			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
+	// connections can go offline or time out on their own, so verify the slot
+	const CNetConnection &Connection = m_aSlots[It->second].m_Connection;
+	if(Connection.State() == NET_CONNSTATE_OFFLINE ||
+		Connection.State() == NET_CONNSTATE_ERROR ||
+		net_addr_comp(Connection.PeerAddress(), &Addr) != 0)
+		return -1;
 
-		{
-			Slot = i;
-		}
-	}
+	return It->second;
+}
 
-	return Slot;
+void CNetServer::IndexSlot(int Slot)
+{
+	m_SlotsByAddr[*m_aSlots[Slot].m_Connection.PeerAddress()] = Slot;
+}
+
+void CNetServer::UnindexSlot(int Slot)
+{
+	// the peer address is kept until the slot is reused, an entry might
+	// already point to a newer slot with the same address though
+	auto It = m_SlotsByAddr.find(*m_aSlots[Slot].m_Connection.PeerAddress());
+	if(It != m_SlotsByAddr.end() && It->second == Slot)
+		m_SlotsByAddr.erase(It);
 }
 
 static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
@@ -792,8 +819,11 @@ bool CNetServer::SetTimedOut(int ClientId, int OrigId)
 	if(m_aSlots[ClientId].m_Connection.State() != NET_CONNSTATE_ERROR)
 		return false;
 
+	UnindexSlot(ClientId);
+	UnindexSlot(OrigId);
 	m_aSlots[ClientId].m_Connection.SetTimedOut(ClientAddr(OrigId), m_aSlots[OrigId].m_Connection.SeqSequence(), m_aSlots[OrigId].m_Connection.AckSequence(), m_aSlots[OrigId].m_Connection.SecurityToken(), m_aSlots[OrigId].m_Connection.ResendBuffer(), m_aSlots[OrigId].m_Connection.m_Sixup);
 	m_aSlots[OrigId].m_Connection.Reset();
+	IndexSlot(ClientId);
 	return true;
 }
 
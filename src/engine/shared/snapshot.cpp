@@ -4,9 +4,19 @@
 #include "compression.h"
 #include "uuid_manager.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <limits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #include <base/math.h>
 #include <base/system.h>
 
@@ -161,70 +171,75 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 
 // CSnapshotDelta
 
-enum
+// item keys in the upper and item indices in the lower half, sorted by key
+static void SortItemKeys(const CSnapshot *pSnapshot, uint64_t *pSorted)
 {
-	HASHLIST_SIZE = 256,
-	HASHLIST_BUCKET_SIZE = 64,
-};
+	const int NumItems = pSnapshot->NumItems();
+	for(int i = 0; i < NumItems; i++)
+		pSorted[i] = ((uint64_t)(uint32_t)pSnapshot->GetItem(i)->Key() << 32) | (uint32_t)i;
+	std::sort(pSorted, pSorted + NumItems);
+}
 
-struct CItemList
-{
-	int m_Num;
-	int m_aKeys[HASHLIST_BUCKET_SIZE];
-	int m_aIndex[HASHLIST_BUCKET_SIZE];
-};
+static int SortedKey(uint64_t Sorted) { return (int)(Sorted >> 32); }
+static int SortedIndex(uint64_t Sorted) { return (int)(Sorted & 0xffffffff); }
 
-inline size_t CalcHashId(int Key)
+// size of a packed int in bits, as counted by the data rate statistics
+static uint64_t PackedDiffBits(int Diff)
 {
-	// djb2 (http://www.cse.yorku.ca/~oz/hash.html)
-	unsigned Hash = 5381;
-	for(unsigned Shift = 0; Shift < sizeof(int); Shift++)
-		Hash = ((Hash << 5) + Hash) + ((Key >> (Shift * 8)) & 0xFF);
-	return Hash % HASHLIST_SIZE;
+	if(Diff == 0)
+		return 1;
+	const unsigned Value = Diff < 0 ? ~(unsigned)Diff : (unsigned)Diff;
+	if(Value < (1u << 6))
+		return 8;
+	if(Value < (1u << 13))
+		return 16;
+	if(Value < (1u << 20))
+		return 24;
+	if(Value < (1u << 27))
+		return 32;
+	return 40;
 }
 
-static void GenerateHash(CItemList *pHashlist, const CSnapshot *pSnapshot)
+int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
-
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	int Needed = 0;
+	int i = 0;
+#if defined(__SSE2__)
+	__m128i Needed4 = _mm_setzero_si128();
+#if defined(__AVX2__)
+	__m256i Needed8 = _mm256_setzero_si256();
+	for(; i + 8 <= Size; i += 8)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		size_t HashId = CalcHashId(Key);
-		if(pHashlist[HashId].m_Num < HASHLIST_BUCKET_SIZE)
-		{
-			pHashlist[HashId].m_aIndex[pHashlist[HashId].m_Num] = i;
-			pHashlist[HashId].m_aKeys[pHashlist[HashId].m_Num] = Key;
-			pHashlist[HashId].m_Num++;
-		}
+		const __m256i Diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(pCurrent + i)), _mm256_loadu_si256((const __m256i *)(pPast + i)));
+		_mm256_storeu_si256((__m256i *)(pOut + i), Diff);
+		Needed8 = _mm256_or_si256(Needed8, Diff);
 	}
-}
-
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
-{
-	size_t HashId = CalcHashId(Key);
-	for(int i = 0; i < pHashlist[HashId].m_Num; i++)
+	Needed4 = _mm_or_si128(_mm256_castsi256_si128(Needed8), _mm256_extracti128_si256(Needed8, 1));
+#endif
+	for(; i + 4 <= Size; i += 4)
 	{
-		if(pHashlist[HashId].m_aKeys[i] == Key)
-			return pHashlist[HashId].m_aIndex[i];
+		const __m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent + i)), _mm_loadu_si128((const __m128i *)(pPast + i)));
+		_mm_storeu_si128((__m128i *)(pOut + i), Diff);
+		Needed4 = _mm_or_si128(Needed4, Diff);
 	}
-
-	return -1;
-}
-
-int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
-{
-	int Needed = 0;
-	while(Size)
+	Needed4 = _mm_or_si128(Needed4, _mm_shuffle_epi32(Needed4, _MM_SHUFFLE(1, 0, 3, 2)));
+	Needed4 = _mm_or_si128(Needed4, _mm_shuffle_epi32(Needed4, _MM_SHUFFLE(2, 3, 0, 1)));
+	Needed = _mm_cvtsi128_si32(Needed4);
+#elif defined(__ARM_NEON)
+	int32x4_t Needed4 = vdupq_n_s32(0);
+	for(; i + 4 <= Size; i += 4)
+	{
+		const int32x4_t Diff = vsubq_s32(vld1q_s32(pCurrent + i), vld1q_s32(pPast + i));
+		vst1q_s32(pOut + i, Diff);
+		Needed4 = vorrq_s32(Needed4, Diff);
+	}
+	Needed = vgetq_lane_s32(Needed4, 0) | vgetq_lane_s32(Needed4, 1) | vgetq_lane_s32(Needed4, 2) | vgetq_lane_s32(Needed4, 3);
+#endif
+	for(; i < Size; i++)
 	{
 		// subtraction with wrapping by casting to unsigned
-		*pOut = (unsigned)*pCurrent - (unsigned)*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		pOut[i] = (unsigned)pCurrent[i] - (unsigned)pPast[i];
+		Needed |= pOut[i];
 	}
 
 	return Needed;
@@ -232,24 +247,42 @@ int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, i
 
 void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate)
 {
-	while(Size)
+	int i = 0;
+#if defined(__SSE2__)
+	for(; i + 4 <= Size; i += 4)
 	{
-		// addition with wrapping by casting to unsigned
-		*pOut = (unsigned)*pPast + (unsigned)*pDiff;
-
-		if(*pDiff == 0)
-			*pDataRate += 1;
+		const __m128i Diff = _mm_loadu_si128((const __m128i *)(pDiff + i));
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast + i)), Diff));
+		// unchanged ints only take one bit each
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(Diff, _mm_setzero_si128())) == 0xffff)
+			*pDataRate += 4;
 		else
 		{
-			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff, sizeof(aBuf));
-			*pDataRate += (uint64_t)(pEnd - (unsigned char *)aBuf) * 8;
+			for(int j = i; j < i + 4; j++)
+				*pDataRate += PackedDiffBits(pDiff[j]);
 		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
+	}
+#elif defined(__ARM_NEON)
+	for(; i + 4 <= Size; i += 4)
+	{
+		const int32x4_t Diff = vld1q_s32(pDiff + i);
+		vst1q_s32(pOut + i, vaddq_s32(vld1q_s32(pPast + i), Diff));
+		// unchanged ints only take one bit each
+		const uint32x4_t NonZero = vtstq_s32(Diff, Diff);
+		if((vgetq_lane_u32(NonZero, 0) | vgetq_lane_u32(NonZero, 1) | vgetq_lane_u32(NonZero, 2) | vgetq_lane_u32(NonZero, 3)) == 0)
+			*pDataRate += 4;
+		else
+		{
+			for(int j = i; j < i + 4; j++)
+				*pDataRate += PackedDiffBits(pDiff[j]);
+		}
+	}
+#endif
+	for(; i < Size; i++)
+	{
+		// addition with wrapping by casting to unsigned
+		pOut[i] = (unsigned)pPast[i] + (unsigned)pDiff[i];
+		*pDataRate += PackedDiffBits(pDiff[i]);
 	}
 }
 
@@ -290,8 +323,7 @@ const CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta() const
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
-int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData)
+int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData) const
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_aData;
@@ -300,34 +332,47 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	// match the items of both snapshots by merging their sorted keys,
+	// with duplicate keys the item with the lowest index is used
+	uint64_t aFromSorted[CSnapshot::MAX_ITEMS];
+	uint64_t aToSorted[CSnapshot::MAX_ITEMS];
+	SortItemKeys(pFrom, aFromSorted);
+	SortItemKeys(pTo, aToSorted);
+
+	bool aFromKept[CSnapshot::MAX_ITEMS] = {false};
+	int aPastIndices[CSnapshot::MAX_ITEMS];
+	const int NumFromItems = pFrom->NumItems();
+	const int NumItems = pTo->NumItems();
+	std::fill(aPastIndices, aPastIndices + NumItems, -1);
+	for(int FromPos = 0, ToPos = 0; FromPos < NumFromItems && ToPos < NumItems;)
+	{
+		const int Key = SortedKey(aToSorted[ToPos]);
+		if((uint32_t)SortedKey(aFromSorted[FromPos]) < (uint32_t)Key)
+			FromPos++;
+		else if((uint32_t)SortedKey(aFromSorted[FromPos]) > (uint32_t)Key)
+			ToPos++;
+		else
+		{
+			const int PastIndex = SortedIndex(aFromSorted[FromPos]);
+			for(; FromPos < NumFromItems && SortedKey(aFromSorted[FromPos]) == Key; FromPos++)
+				aFromKept[SortedIndex(aFromSorted[FromPos])] = true;
+			for(; ToPos < NumItems && SortedKey(aToSorted[ToPos]) == Key; ToPos++)
+				aPastIndices[SortedIndex(aToSorted[ToPos])] = PastIndex;
+		}
+	}
 
 	// pack deleted stuff
-	for(int i = 0; i < pFrom->NumItems(); i++)
+	for(int i = 0; i < NumFromItems; i++)
 	{
-		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		if(!aFromKept[i])
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
-			*pData = pFromItem->Key();
+			*pData = pFrom->GetItem(i)->Key();
 			pData++;
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
-
-	// fetch previous indices
-	// we do this as a separate pass because it helps the cache
-	int aPastIndices[CSnapshot::MAX_ITEMS];
-	const int NumItems = pTo->NumItems();
-	for(int i = 0; i < NumItems; i++)
-	{
-		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
-	}
-
 	for(int i = 0; i < NumItems; i++)
 	{
 		// do delta
@@ -342,6 +387,10 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 
 			const CSnapshotItem *pPastItem = pFrom->GetItem(PastIndex);
 
+			// unchanged items are the common case, skip them before diffing
+			if(mem_comp(pPastItem->Data(), pCurItem->Data(), ItemSize) == 0)
+				continue;
+
 			if(!IncludeSize)
 				pItemDataDst = pData + 2;
 
@@ -609,12 +658,129 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	return Builder.Finish(pTo);
 }
 
+// CSnapshotSharedPool
+
+CSnapshotSharedPool::CSnapshotSharedPool()
+{
+	mem_zero(&m_Stats, sizeof(m_Stats));
+}
+
+CSnapshotSharedPool::~CSnapshotSharedPool()
+{
+	for(auto &[Key, pEntry] : m_Entries)
+	{
+		while(pEntry)
+		{
+			CEntry *pNext = pEntry->m_pNextSame;
+			free(pEntry);
+			pEntry = pNext;
+		}
+	}
+}
+
+const CSnapshot *CSnapshotSharedPool::Acquire(const CSnapshot *pData, int DataSize)
+{
+	const unsigned Crc = pData->Crc();
+	CEntry *&pFirst = m_Entries[((uint64_t)Crc << 32) | (uint32_t)DataSize];
+	m_Stats.m_NumAcquired++;
+
+	// the crc is only a sum, compare the contents to be sure
+	for(CEntry *pEntry = pFirst; pEntry; pEntry = pEntry->m_pNextSame)
+	{
+		if(mem_comp(pEntry + 1, pData, DataSize) == 0)
+		{
+			pEntry->m_RefCount++;
+			m_Stats.m_NumShared++;
+			m_Stats.m_SavedBytes += DataSize;
+			return reinterpret_cast<const CSnapshot *>(pEntry + 1);
+		}
+	}
+
+	CEntry *pEntry = static_cast<CEntry *>(malloc(sizeof(CEntry) + DataSize));
+	pEntry->m_pNextSame = pFirst;
+	pEntry->m_Crc = Crc;
+	pEntry->m_Size = DataSize;
+	pEntry->m_RefCount = 1;
+	mem_copy(pEntry + 1, pData, DataSize);
+	pFirst = pEntry;
+
+	m_Stats.m_CurrentBytes += sizeof(CEntry) + DataSize;
+	m_Stats.m_PeakBytes = maximum(m_Stats.m_PeakBytes, m_Stats.m_CurrentBytes);
+	return reinterpret_cast<const CSnapshot *>(pEntry + 1);
+}
+
+void CSnapshotSharedPool::Release(const CSnapshot *pSnap)
+{
+	CEntry *pEntry = const_cast<CEntry *>(reinterpret_cast<const CEntry *>(pSnap) - 1);
+	dbg_assert(pEntry->m_RefCount > 0, "Shared snapshot released too often");
+	if(--pEntry->m_RefCount > 0)
+	{
+		m_Stats.m_SavedBytes -= pEntry->m_Size;
+		return;
+	}
+
+	auto It = m_Entries.find(((uint64_t)pEntry->m_Crc << 32) | (uint32_t)pEntry->m_Size);
+	dbg_assert(It != m_Entries.end(), "Shared snapshot not found in pool");
+	CEntry **ppLink = &It->second;
+	while(*ppLink != pEntry)
+		ppLink = &(*ppLink)->m_pNextSame;
+	*ppLink = pEntry->m_pNextSame;
+	if(!It->second)
+		m_Entries.erase(It);
+
+	m_Stats.m_CurrentBytes -= sizeof(CEntry) + pEntry->m_Size;
+	free(pEntry);
+}
+
 // CSnapshotStorage
 
 void CSnapshotStorage::Init()
 {
 	m_pFirst = nullptr;
 	m_pLast = nullptr;
+	m_pFirstFree = nullptr;
+	m_pSharedPool = nullptr;
+	mem_zero(m_apTickIndex, sizeof(m_apTickIndex));
+	mem_zero(&m_Stats, sizeof(m_Stats));
+}
+
+CSnapshotStorage::CHolder *CSnapshotStorage::AllocHolder(size_t DataSize)
+{
+	// snapshots usually stay about the same size, so the most recently
+	// purged holder is likely big enough
+	if(m_pFirstFree)
+	{
+		CHolder *pHolder = m_pFirstFree;
+		m_pFirstFree = pHolder->m_pNext;
+		if(pHolder->m_Capacity >= DataSize)
+		{
+			m_Stats.m_NumReused++;
+			return pHolder;
+		}
+		m_Stats.m_CurrentBytes -= sizeof(CHolder) + pHolder->m_Capacity;
+		free(pHolder);
+	}
+
+	// leave some room for the snapshot to grow
+	const size_t Capacity = DataSize + DataSize / 4;
+	CHolder *pHolder = static_cast<CHolder *>(malloc(sizeof(CHolder) + Capacity));
+	pHolder->m_Capacity = Capacity;
+	m_Stats.m_NumAllocated++;
+	m_Stats.m_CurrentBytes += sizeof(CHolder) + Capacity;
+	m_Stats.m_PeakBytes = maximum(m_Stats.m_PeakBytes, m_Stats.m_CurrentBytes);
+	return pHolder;
+}
+
+void CSnapshotStorage::FreeHolder(CHolder *pHolder)
+{
+	CHolder *&pIndexed = m_apTickIndex[pHolder->m_Tick & (TICK_INDEX_SIZE - 1)];
+	if(pIndexed == pHolder)
+		pIndexed = nullptr;
+	if(pHolder->m_Shared)
+		m_pSharedPool->Release(pHolder->m_pSnap);
+
+	pHolder->m_pNext = m_pFirstFree;
+	m_pFirstFree = pHolder;
 }
 
 void CSnapshotStorage::PurgeAll()
@@ -622,12 +788,20 @@ void CSnapshotStorage::PurgeAll()
 	while(m_pFirst)
 	{
 		CHolder *pNext = m_pFirst->m_pNext;
-		free(m_pFirst->m_pSnap);
-		free(m_pFirst->m_pAltSnap);
+		if(m_pFirst->m_Shared)
+			m_pSharedPool->Release(m_pFirst->m_pSnap);
 		free(m_pFirst);
 		m_pFirst = pNext;
 	}
+	while(m_pFirstFree)
+	{
+		CHolder *pNext = m_pFirstFree->m_pNext;
+		free(m_pFirstFree);
+		m_pFirstFree = pNext;
+	}
 	m_pLast = nullptr;
+	mem_zero(m_apTickIndex, sizeof(m_apTickIndex));
+	m_Stats.m_CurrentBytes = 0;
 }
 
 void CSnapshotStorage::PurgeUntil(int Tick)
@@ -639,9 +813,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 		CHolder *pNext = pHolder->m_pNext;
 		if(pHolder->m_Tick >= Tick)
 			return; // no more to remove
-		free(pHolder->m_pSnap);
-		free(pHolder->m_pAltSnap);
-		free(pHolder);
+		FreeHolder(pHolder);
 
 		// did we come to the end of the list?
 		if(!pNext)
@@ -662,17 +834,29 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 	dbg_assert(DataSize <= (size_t)CSnapshot::MAX_SIZE, "Snapshot data size invalid");
 	dbg_assert(AltDataSize <= (size_t)CSnapshot::MAX_SIZE, "Alt snapshot data size invalid");
 
-	CHolder *pHolder = static_cast<CHolder *>(malloc(sizeof(CHolder)));
+	// both snapshots live right behind the holder, unless the snapshot is shared
+	const bool Shared = m_pSharedPool && !AltDataSize;
+	const size_t AlignedDataSize = Shared ? 0 : (DataSize + alignof(CHolder) - 1) & ~(alignof(CHolder) - 1);
+	CHolder *pHolder = AllocHolder(AlignedDataSize + AltDataSize);
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
+	pHolder->m_Shared = Shared;
 
-	pHolder->m_pSnap = static_cast<CSnapshot *>(malloc(DataSize));
-	mem_copy(pHolder->m_pSnap, pData, DataSize);
+	if(Shared)
+	{
+		// the pool never modifies the snapshot, only hands out the same copy
+		pHolder->m_pSnap = const_cast<CSnapshot *>(m_pSharedPool->Acquire(static_cast<const CSnapshot *>(pData), DataSize));
+	}
+	else
+	{
+		pHolder->m_pSnap = reinterpret_cast<CSnapshot *>(pHolder + 1);
+		mem_copy(pHolder->m_pSnap, pData, DataSize);
+	}
 	pHolder->m_SnapSize = DataSize;
 
 	if(AltDataSize) // create alternative if wanted
 	{
-		pHolder->m_pAltSnap = static_cast<CSnapshot *>(malloc(AltDataSize));
+		pHolder->m_pAltSnap = reinterpret_cast<CSnapshot *>(reinterpret_cast<char *>(pHolder->m_pSnap) + AlignedDataSize);
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
 	}
@@ -690,29 +874,37 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 	else
 		m_pFirst = pHolder;
 	m_pLast = pHolder;
+
+	m_apTickIndex[Tick & (TICK_INDEX_SIZE - 1)] = pHolder;
 }
 
-int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const
+void CSnapshotStorage::SetSharedPool(CSnapshotSharedPool *pPool)
 {
-	CHolder *pHolder = m_pFirst;
+	dbg_assert(!m_pFirst, "Shared pool changed while snapshots are stored");
+	m_pSharedPool = pPool;
+}
 
-	while(pHolder)
+int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const
+{
+	// only walk the list if the tick was overwritten in the index
+	CHolder *pHolder = m_apTickIndex[Tick & (TICK_INDEX_SIZE - 1)];
+	if(!pHolder || pHolder->m_Tick != Tick)
 	{
-		if(pHolder->m_Tick == Tick)
-		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
-		}
-
-		pHolder = pHolder->m_pNext;
+		pHolder = m_pFirst;
+		while(pHolder && pHolder->m_Tick != Tick)
+			pHolder = pHolder->m_pNext;
 	}
 
-	return -1;
+	if(!pHolder)
+		return -1;
+
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->m_pSnap;
+	if(ppAltData)
+		*ppAltData = pHolder->m_pAltSnap;
+	return pHolder->m_SnapSize;
 }
 
 // CSnapshotBuilder
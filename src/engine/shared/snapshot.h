@@ -5,6 +5,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <unordered_map>
 
 #include <game/generated/protocol.h>
 #include <game/generated/protocol7.h>
@@ -104,11 +105,55 @@ public:
 	void SetStaticsize(int ItemType, size_t Size);
 	void SetStaticsize7(int ItemType, size_t Size);
 	const CData *EmptyDelta() const;
-	int CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData);
+	int CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData) const;
 	int UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const void *pSrcData, int DataSize, bool Sixup);
 	int DebugDumpDelta(const void *pSrcData, int DataSize);
 };
 
+// CSnapshotSharedPool
+
+// refcounted snapshot buffers shared by several storages, identical
+// snapshots are only kept once
+class CSnapshotSharedPool
+{
+	class CEntry
+	{
+	public:
+		CEntry *m_pNextSame;
+		unsigned m_Crc;
+		int m_Size;
+		int m_RefCount;
+	};
+
+	static_assert(sizeof(CEntry) % alignof(int64_t) == 0, "Snapshot data must stay aligned");
+
+	std::unordered_map<uint64_t, CEntry *> m_Entries;
+
+public:
+	class CStats
+	{
+	public:
+		size_t m_CurrentBytes;
+		size_t m_PeakBytes;
+		size_t m_SavedBytes;
+		uint64_t m_NumShared;
+		uint64_t m_NumAcquired;
+	};
+
+private:
+	CStats m_Stats;
+
+public:
+	CSnapshotSharedPool();
+	~CSnapshotSharedPool();
+	CSnapshotSharedPool(const CSnapshotSharedPool &) = delete;
+	CSnapshotSharedPool &operator=(const CSnapshotSharedPool &) = delete;
+
+	const CSnapshot *Acquire(const CSnapshot *pData, int DataSize);
+	void Release(const CSnapshot *pSnap);
+	const CStats &Stats() const { return m_Stats; }
+};
+
 // CSnapshotStorage
 
 class CSnapshotStorage
@@ -128,11 +173,42 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		// bytes for snapshot data allocated behind the holder
+		size_t m_Capacity;
+		// m_pSnap is owned by the shared pool
+		bool m_Shared;
+	};
+
+	class CStats
+	{
+	public:
+		size_t m_CurrentBytes;
+		size_t m_PeakBytes;
+		uint64_t m_NumReused;
+		uint64_t m_NumAllocated;
 	};
 
 	CHolder *m_pFirst;
 	CHolder *m_pLast;
 
+private:
+	enum
+	{
+		TICK_INDEX_SIZE = 256
+	};
+
+	// most recent holder for each tick slot, checked against the tick on lookup
+	CHolder *m_apTickIndex[TICK_INDEX_SIZE];
+	// purged holders, reused by the next snapshots that fit into them
+	CHolder *m_pFirstFree;
+	CSnapshotSharedPool *m_pSharedPool;
+	CStats m_Stats;
+
+	CHolder *AllocHolder(size_t DataSize);
+	void FreeHolder(CHolder *pHolder);
+
+public:
 	CSnapshotStorage() { Init(); }
 	~CSnapshotStorage() { PurgeAll(); }
 	void Init();
@@ -140,6 +216,9 @@ public:
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64_t Tagtime, size_t DataSize, const void *pData, size_t AltDataSize, const void *pAltData);
 	int Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const;
+	const CStats &Stats() const { return m_Stats; }
+	// snapshots without alternative are stored in the pool, must be set while empty
+	void SetSharedPool(CSnapshotSharedPool *pPool);
 };
 
 class CSnapshotBuilder
@@ -118,4 +118,19 @@ MACRO_CONFIG_INT(SvRoundStatsFormatDiscord, sv_round_stats_format_discord, 1, 0,
 MACRO_CONFIG_INT(SvRoundStatsFormatHttp, sv_round_stats_format_http, 4, 0, 4, CFGFLAG_SERVER, "0=csv 1=psv 2=ascii table 3=markdown table 4=json")
 MACRO_CONFIG_INT(SvRoundStatsFormatFile, sv_round_stats_format_file, 1, 0, 4, CFGFLAG_SERVER, "0=csv 1=psv 2=ascii table 3=markdown table 4=json")
 
+MACRO_CONFIG_INT(SvSnapshotThreads, sv_snapshot_threads, 0, 0, 16, CFGFLAG_SERVER, "Worker threads that delta and compress snapshots (0=main thread only, only works in initial config)")
+MACRO_CONFIG_INT(SvSnapshotParallelBuild, sv_snapshot_parallel_build, 0, 0, 1, CFGFLAG_SERVER, "Build the snapshots of different clients on the sv_snapshot_threads workers")
+MACRO_CONFIG_INT(SvSnapshotParallelCheck, sv_snapshot_parallel_check, 0, 0, 1, CFGFLAG_SERVER, "Also build every parallel snapshot on the main thread and log if they differ (slow, for debugging)")
+MACRO_CONFIG_INT(SvFrameProfiler, sv_frame_profiler, 0, 0, 1, CFGFLAG_SERVER, "Time the phases of each server tick, see frame_profiler_dump")
+MACRO_CONFIG_INT(SvSpawnDangerCache, sv_spawn_danger_cache, 1, 0, 1, CFGFLAG_SERVER, "Keep the spawn point scores between the spawns of a tick instead of summing all characters for every spawn point")
+MACRO_CONFIG_INT(SvSpatialGrid, sv_spatial_grid, 1, 0, 1, CFGFLAG_SERVER, "Look up characters near a position or line in a grid instead of checking all of them")
+MACRO_CONFIG_INT(SvSqlReadWorkers, sv_sql_read_workers, 2, 1, 16, CFGFLAG_SERVER, "Threads that run read queries like /rank, each with its own database connections (only works in initial config)")
+MACRO_CONFIG_INT(SvLeaderboardCache, sv_leaderboard_cache, 1, 0, 1, CFGFLAG_SERVER, "Answer /rank and /top from a ranking kept in memory instead of sorting the stats table for every request")
+MACRO_CONFIG_INT(SvLeaderboardRefresh, sv_leaderboard_refresh, 300, 10, 86400, CFGFLAG_SERVER, "Seconds between reloads of the in memory ranking to pick up stats written by other servers")
+MACRO_CONFIG_INT(SvSqliteSynchronous, sv_sqlite_synchronous, 1, 0, 3, CFGFLAG_SERVER, "SQLite fsync level 0=off 1=normal 2=full 3=extra, with the write-ahead log normal only syncs on checkpoints (only works in initial config)")
+MACRO_CONFIG_INT(SvSqliteCacheSize, sv_sqlite_cache_size, 8192, 0, 1048576, CFGFLAG_SERVER, "Page cache of every SQLite connection in KiB (0=SQLite default, only works in initial config)")
+MACRO_CONFIG_INT(SvSqliteMmapSize, sv_sqlite_mmap_size, 64, 0, 4096, CFGFLAG_SERVER, "MiB of the SQLite file that are memory mapped for reads (0=off, only works in initial config)")
+MACRO_CONFIG_INT(SvSqliteCheckpointInterval, sv_sqlite_checkpoint_interval, 5, 0, 3600, CFGFLAG_SERVER, "Seconds between write-ahead log checkpoints done by a read worker instead of the write worker (0=SQLite checkpoints while writing, only works in initial config)")
+MACRO_CONFIG_STR(SvFrameProfilerCsv, sv_frame_profiler_csv, 512, "", CFGFLAG_SERVER, "If set the frame profiler writes the phase times of every tick to this csv file")
+
 #endif
@@ -0,0 +1,96 @@
+#include "alloc.h"
+
+#include <base/math.h>
+
+#include <algorithm>
+
+CFreeListPool *CFreeListPool::ms_pFirst = nullptr;
+
+CFreeListPool::CFreeListPool(const char *pName, size_t BlockSize) :
+	m_pName(pName), m_BlockSize(BlockSize)
+{
+	m_pNext = ms_pFirst;
+	ms_pFirst = this;
+}
+
+CFreeListPool::~CFreeListPool()
+{
+	for(CFreeListPool **ppPool = &ms_pFirst; *ppPool; ppPool = &(*ppPool)->m_pNext)
+	{
+		if(*ppPool == this)
+		{
+			*ppPool = m_pNext;
+			break;
+		}
+	}
+	for(char *pChunk : m_vpChunks)
+	{
+		ASAN_UNPOISON_MEMORY_REGION(pChunk, m_BlockSize * CHUNK_BLOCKS);
+		free(pChunk);
+	}
+}
+
+void CFreeListPool::AddChunk()
+{
+	char *pChunk = static_cast<char *>(malloc(m_BlockSize * CHUNK_BLOCKS));
+	dbg_assert(pChunk != nullptr, "out of memory");
+	ASAN_POISON_MEMORY_REGION(pChunk, m_BlockSize * CHUNK_BLOCKS);
+	m_vpChunks.push_back(pChunk);
+	// hand out the lowest address first
+	for(int i = CHUNK_BLOCKS - 1; i >= 0; i--)
+		m_vpFree.push_back(pChunk + i * m_BlockSize);
+	m_Stats.m_Capacity += CHUNK_BLOCKS;
+}
+
+void *CFreeListPool::Alloc(size_t Size)
+{
+	dbg_assert(Size <= m_BlockSize, "size error");
+	if(m_vpFree.empty())
+		AddChunk();
+	else
+		m_Stats.m_NumReused++;
+
+	void *pObj = m_vpFree.back();
+	m_vpFree.pop_back();
+	ASAN_UNPOISON_MEMORY_REGION(pObj, m_BlockSize);
+	mem_zero(pObj, m_BlockSize);
+
+	m_Stats.m_NumAllocs++;
+	m_Stats.m_Live++;
+	m_Stats.m_HighWater = maximum(m_Stats.m_HighWater, m_Stats.m_Live);
+	return pObj;
+}
+
+void CFreeListPool::Free(void *pObj)
+{
+	if(!pObj)
+		return;
+	dbg_assert(m_Stats.m_Live > 0, "not used");
+#ifdef CONF_DEBUG
+	// make use after free visible in builds without ASan too
+	std::fill_n(static_cast<unsigned char *>(pObj), m_BlockSize, 0xdd);
+#endif
+	ASAN_POISON_MEMORY_REGION(pObj, m_BlockSize);
+	m_vpFree.push_back(pObj);
+	m_Stats.m_Live--;
+}
+
+void CFreeListPool::Reset()
+{
+	m_Stats.m_HighWater = m_Stats.m_Live;
+	if(m_Stats.m_Live)
+		return;
+
+	m_vpFree.clear();
+	for(auto It = m_vpChunks.rbegin(); It != m_vpChunks.rend(); ++It)
+	{
+		for(int i = CHUNK_BLOCKS - 1; i >= 0; i--)
+			m_vpFree.push_back(*It + i * m_BlockSize);
+	}
+}
+
+void CFreeListPool::ResetAll()
+{
+	for(CFreeListPool *pPool = ms_pFirst; pPool; pPool = pPool->m_pNext)
+		pPool->Reset();
+}
@@ -4,6 +4,7 @@
 #define GAME_ALLOC_H
 
 #include <new>
+#include <vector>
 
 #include <base/system.h>
 #ifndef __has_feature
@@ -77,4 +78,82 @@ private:
 		ASAN_POISON_MEMORY_REGION(gs_PoolData##POOLTYPE[Id], sizeof(gs_PoolData##POOLTYPE[Id])); \
 	}
 
+/*
+	Class: CFreeListPool
+		Fixed size blocks carved from larger chunks. Freed blocks go to
+		a free list and are handed out again, chunks are only returned
+		to the system on destruction. Freed blocks are poisoned when
+		building with ASan.
+*/
+class CFreeListPool
+{
+public:
+	class CStats
+	{
+	public:
+		int m_Live = 0;
+		int m_HighWater = 0;
+		int m_Capacity = 0;
+		uint64_t m_NumAllocs = 0;
+		uint64_t m_NumReused = 0;
+	};
+
+private:
+	enum
+	{
+		CHUNK_BLOCKS = 64,
+	};
+
+	const char *m_pName;
+	size_t m_BlockSize;
+	std::vector<char *> m_vpChunks;
+	std::vector<void *> m_vpFree;
+	CStats m_Stats;
+
+	CFreeListPool *m_pNext;
+	static CFreeListPool *ms_pFirst;
+
+	void AddChunk();
+
+public:
+	CFreeListPool(const char *pName, size_t BlockSize);
+	~CFreeListPool();
+
+	void *Alloc(size_t Size);
+	void Free(void *pObj);
+
+	/*
+		Function: Reset
+			Refills the free list from the chunks in address order if no
+			block is in use and starts a new high-water mark.
+	*/
+	void Reset();
+
+	const char *Name() const { return m_pName; }
+	size_t BlockSize() const { return m_BlockSize; }
+	const CStats &Stats() const { return m_Stats; }
+
+	static CFreeListPool *First() { return ms_pFirst; }
+	CFreeListPool *Next() const { return m_pNext; }
+	static void ResetAll();
+};
+
+#define MACRO_ALLOC_FREELIST() \
+public: \
+	void *operator new(size_t Size); \
+	void operator delete(void *pObj); \
+\
+private:
+
+#define MACRO_ALLOC_FREELIST_IMPL(POOLTYPE) \
+	static CFreeListPool gs_FreeList##POOLTYPE(#POOLTYPE, MACRO_ALLOC_GET_SIZE(POOLTYPE)); \
+	void *POOLTYPE::operator new(size_t Size) \
+	{ \
+		return gs_FreeList##POOLTYPE.Alloc(Size); \
+	} \
+	void POOLTYPE::operator delete(void *pObj) \
+	{ \
+		gs_FreeList##POOLTYPE.Free(pObj); \
+	}
+
 #endif
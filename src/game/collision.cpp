@@ -7,6 +7,7 @@
 #include <antibot/antibot_data.h>
 
 #include <cmath>
+#include <limits>
 #include <engine/map.h>
 
 #include <game/collision.h>
@@ -39,6 +40,7 @@ vec2 ClampVel(int MoveRestriction, vec2 Vel)
 CCollision::CCollision()
 {
 	m_pDoor = nullptr;
+	m_SkipEmptyTiles = true;
 	Unload();
 }
 
@@ -146,6 +148,13 @@ void CCollision::Init(class CLayers *pLayers)
 			}
 		}
 	}
+
+	if(m_pTiles)
+	{
+		InitAccelerationData();
+		InitRayDistance(m_vSolidDistance, true);
+		InitRayDistance(m_vRayDistance, false);
+	}
 }
 
 void CCollision::Unload()
@@ -169,6 +178,163 @@ void CCollision::Unload()
 	m_pTune = nullptr;
 	delete[] m_pDoor;
 	m_pDoor = nullptr;
+
+	m_SolidBlocksWidth = 0;
+	m_vSolidBits.clear();
+	m_vTilePresence.clear();
+	m_vSolidDistance.clear();
+	m_vRayDistance.clear();
+}
+
+void CCollision::InitAccelerationData()
+{
+	m_SolidBlocksWidth = (m_Width + 7) / 8;
+	m_vSolidBits.assign((size_t)m_SolidBlocksWidth * ((m_Height + 7) / 8), 0);
+	m_vTilePresence.assign((size_t)m_Width * m_Height, 0);
+	for(int y = 0; y < m_Height; y++)
+	{
+		for(int x = 0; x < m_Width; x++)
+		{
+			const int Index = y * m_Width + x;
+			SetSolidBit(x, y, m_pTiles[Index].m_Index == TILE_SOLID || m_pTiles[Index].m_Index == TILE_NOHOOK);
+
+			uint8_t Presence = 0;
+			if(m_pFront && m_pFront[Index].m_Index)
+				Presence |= TILEPRESENCE_FRONT;
+			if(m_pTele && m_pTele[Index].m_Type)
+				Presence |= TILEPRESENCE_TELE;
+			if(m_pSpeedup && m_pSpeedup[Index].m_Force > 0)
+				Presence |= TILEPRESENCE_SPEEDUP;
+			if(m_pDoor && m_pDoor[Index].m_Index)
+				Presence |= TILEPRESENCE_DOOR;
+			m_vTilePresence[Index] = Presence;
+		}
+	}
+}
+
+size_t CCollision::AccelerationMemoryUsage() const
+{
+	return m_vSolidBits.size() * sizeof(uint64_t) + m_vTilePresence.size() + m_vSolidDistance.size() + m_vRayDistance.size();
+}
+
+void CCollision::SetSolidBit(int x, int y, bool Solid)
+{
+	uint64_t &Block = m_vSolidBits[(y >> 3) * m_SolidBlocksWidth + (x >> 3)];
+	const uint64_t Bit = (uint64_t)1 << (((y & 7) << 3) | (x & 7));
+	if(Solid)
+		Block |= Bit;
+	else
+		Block &= ~Bit;
+}
+
+bool CCollision::IsRayBlocker(int Index, bool SolidOnly) const
+{
+	const int Tile = m_pTiles[Index].m_Index;
+	if(Tile == TILE_SOLID || Tile == TILE_NOHOOK)
+		return true;
+	if(SolidOnly)
+		return false;
+	if(Tile == TILE_NOLASER || Tile == TILE_THROUGH_ALL || Tile == TILE_THROUGH_DIR)
+		return true;
+	if(m_pFront)
+	{
+		const int Front = m_pFront[Index].m_Index;
+		if(Front == TILE_NOLASER || Front == TILE_THROUGH_ALL || Front == TILE_THROUGH_DIR)
+			return true;
+	}
+	if(m_pTele)
+	{
+		const int Tele = m_pTele[Index].m_Type;
+		if(Tele == TILE_TELEIN || Tele == TILE_TELEINWEAPON || Tele == TILE_TELEINHOOK)
+			return true;
+	}
+	return false;
+}
+
+void CCollision::InitRayDistance(std::vector<uint8_t> &vDistance, bool SolidOnly) const
+{
+	vDistance.assign((size_t)m_Width * m_Height, RAY_DISTANCE_MAX);
+
+	// two pass chamfer over the 8-neighbourhood gives the exact chebyshev distance
+	for(int y = 0; y < m_Height; y++)
+	{
+		for(int x = 0; x < m_Width; x++)
+		{
+			const int Index = y * m_Width + x;
+			if(IsRayBlocker(Index, SolidOnly))
+			{
+				vDistance[Index] = 0;
+				continue;
+			}
+			int Dist = vDistance[Index];
+			if(x > 0)
+				Dist = minimum(Dist, vDistance[Index - 1] + 1);
+			if(y > 0)
+			{
+				for(int Nx = maximum(x - 1, 0); Nx <= minimum(x + 1, m_Width - 1); Nx++)
+					Dist = minimum(Dist, vDistance[(y - 1) * m_Width + Nx] + 1);
+			}
+			vDistance[Index] = Dist;
+		}
+	}
+	for(int y = m_Height - 1; y >= 0; y--)
+	{
+		for(int x = m_Width - 1; x >= 0; x--)
+		{
+			const int Index = y * m_Width + x;
+			int Dist = vDistance[Index];
+			if(x < m_Width - 1)
+				Dist = minimum(Dist, vDistance[Index + 1] + 1);
+			if(y < m_Height - 1)
+			{
+				for(int Nx = maximum(x - 1, 0); Nx <= minimum(x + 1, m_Width - 1); Nx++)
+					Dist = minimum(Dist, vDistance[(y + 1) * m_Width + Nx] + 1);
+			}
+			vDistance[Index] = Dist;
+		}
+	}
+}
+
+void CCollision::UpdateRayDistance(std::vector<uint8_t> &vDistance, int Index) const
+{
+	// only lowers distances, a tile that stops blocking keeps its neighbours
+	// at too small distances which just skips less
+	const int TileX = Index % m_Width;
+	const int TileY = Index / m_Width;
+	for(int y = maximum(TileY - RAY_DISTANCE_MAX, 0); y <= minimum(TileY + RAY_DISTANCE_MAX, m_Height - 1); y++)
+	{
+		for(int x = maximum(TileX - RAY_DISTANCE_MAX, 0); x <= minimum(TileX + RAY_DISTANCE_MAX, m_Width - 1); x++)
+		{
+			const int Dist = maximum(absolute(x - TileX), absolute(y - TileY));
+			uint8_t &Current = vDistance[y * m_Width + x];
+			Current = minimum<int>(Current, Dist);
+		}
+	}
+}
+
+int CCollision::SkippableSamples(const std::vector<uint8_t> &vDistance, int x, int y, float MaxStep) const
+{
+	if(!m_SkipEmptyTiles || vDistance.empty())
+		return 0;
+
+	const int Nx = clamp(x / 32, 0, m_Width - 1);
+	const int Ny = clamp(y / 32, 0, m_Height - 1);
+	const int Dist = vDistance[Ny * m_Width + Nx];
+
+	// all pixels up to Dist - 1 tiles away are in empty tiles, the margin
+	// covers rounding the sample positions to pixels
+	const float Reach = (Dist - 1) * 32.0f - 2.0f;
+	if(Reach < MaxStep)
+		return 0;
+	if(MaxStep <= 0.0f)
+		return std::numeric_limits<int>::max() / 2;
+	return (int)minimum(Reach / MaxStep, (float)(std::numeric_limits<int>::max() / 2));
+}
+
+// largest change of a coordinate between two samples of a ray
+static float RayMaxStep(vec2 Pos0, vec2 Pos1, float NumSteps)
+{
+	return maximum(absolute(Pos1.x - Pos0.x), absolute(Pos1.y - Pos0.y)) / NumSteps;
 }
 
 void CCollision::FillAntibot(CAntibotMapData *pMapData) const
@@ -331,6 +497,7 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
 	vec2 Last = Pos0;
+	const float MaxStep = RayMaxStep(Pos0, Pos1, End);
 	for(int i = 0; i <= End; i++)
 	{
 		float a = i / (float)End;
@@ -349,6 +516,11 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 		}
 
 		Last = Pos;
+		if(int Skip = SkippableSamples(m_vSolidDistance, ix, iy, MaxStep))
+		{
+			i += Skip;
+			Last = mix(Pos0, Pos1, i / (float)End);
+		}
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -364,6 +536,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 	vec2 Last = Pos0;
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	const float MaxStep = RayMaxStep(Pos0, Pos1, End);
 	for(int i = 0; i <= End; i++)
 	{
 		float a = i / (float)End;
@@ -409,6 +582,11 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 		}
 
 		Last = Pos;
+		if(int Skip = SkippableSamples(m_vRayDistance, ix, iy, MaxStep))
+		{
+			i += Skip;
+			Last = mix(Pos0, Pos1, i / (float)End);
+		}
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -422,6 +600,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
 	vec2 Last = Pos0;
+	const float MaxStep = RayMaxStep(Pos0, Pos1, End);
 	for(int i = 0; i <= End; i++)
 	{
 		float a = i / (float)End;
@@ -457,6 +636,11 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 		}
 
 		Last = Pos;
+		if(int Skip = SkippableSamples(m_vRayDistance, ix, iy, MaxStep))
+		{
+			i += Skip;
+			Last = mix(Pos0, Pos1, i / (float)End);
+		}
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -595,12 +779,6 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, vec2 Elast
 
 // DDRace
 
-int CCollision::IsSolid(int x, int y) const
-{
-	int index = GetTile(x, y);
-	return index == TILE_SOLID || index == TILE_NOHOOK;
-}
-
 bool CCollision::IsThrough(int x, int y, int OffsetX, int OffsetY, vec2 Pos0, vec2 Pos1) const
 {
 	int pos = GetPureMapIndex(x, y);
@@ -647,7 +825,7 @@ int CCollision::IsFrontNoLaser(int x, int y) const
 
 int CCollision::IsTeleport(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(!HasTilePresence(Index, TILEPRESENCE_TELE))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEIN)
@@ -658,9 +836,7 @@ int CCollision::IsTeleport(int Index) const
 
 int CCollision::IsEvilTeleport(int Index) const
 {
-	if(Index < 0)
-		return 0;
-	if(!m_pTele)
+	if(!HasTilePresence(Index, TILEPRESENCE_TELE))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEINEVIL)
@@ -671,24 +847,21 @@ int CCollision::IsEvilTeleport(int Index) const
 
 bool CCollision::IsCheckTeleport(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(!HasTilePresence(Index, TILEPRESENCE_TELE))
 		return false;
 	return m_pTele[Index].m_Type == TILE_TELECHECKIN;
 }
 
 bool CCollision::IsCheckEvilTeleport(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(!HasTilePresence(Index, TILEPRESENCE_TELE))
 		return false;
 	return m_pTele[Index].m_Type == TILE_TELECHECKINEVIL;
 }
 
 int CCollision::IsTeleCheckpoint(int Index) const
 {
-	if(Index < 0)
-		return 0;
-
-	if(!m_pTele)
+	if(!HasTilePresence(Index, TILEPRESENCE_TELE))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELECHECK)
@@ -699,7 +872,7 @@ int CCollision::IsTeleCheckpoint(int Index) const
 
 int CCollision::IsTeleportWeapon(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(!HasTilePresence(Index, TILEPRESENCE_TELE))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEINWEAPON)
@@ -710,7 +883,7 @@ int CCollision::IsTeleportWeapon(int Index) const
 
 int CCollision::IsTeleportHook(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(!HasTilePresence(Index, TILEPRESENCE_TELE))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEINHOOK)
@@ -721,13 +894,10 @@ int CCollision::IsTeleportHook(int Index) const
 
 int CCollision::IsSpeedup(int Index) const
 {
-	if(Index < 0 || !m_pSpeedup)
+	if(!HasTilePresence(Index, TILEPRESENCE_SPEEDUP))
 		return 0;
 
-	if(m_pSpeedup[Index].m_Force > 0)
-		return Index;
-
-	return 0;
+	return Index;
 }
 
 int CCollision::IsTune(int Index) const
@@ -971,7 +1141,7 @@ int CCollision::GetTileIndex(int Index) const
 
 int CCollision::GetFrontTileIndex(int Index) const
 {
-	if(Index < 0 || !m_pFront)
+	if(!HasTilePresence(Index, TILEPRESENCE_FRONT))
 		return 0;
 	return m_pFront[Index].m_Index;
 }
@@ -1029,17 +1199,17 @@ int CCollision::GetIndex(vec2 PrevPos, vec2 Pos) const
 
 int CCollision::GetFrontIndex(int Nx, int Ny) const
 {
-	if(!m_pFront)
+	if(!HasTilePresence(Ny * m_Width + Nx, TILEPRESENCE_FRONT))
 		return 0;
 	return m_pFront[Ny * m_Width + Nx].m_Index;
 }
 
 int CCollision::GetFrontTile(int x, int y) const
 {
-	if(!m_pFront)
-		return 0;
 	int Nx = clamp(x / 32, 0, m_Width - 1);
 	int Ny = clamp(y / 32, 0, m_Height - 1);
+	if(!HasTilePresence(Ny * m_Width + Nx, TILEPRESENCE_FRONT))
+		return 0;
 	if(m_pFront[Ny * m_Width + Nx].m_Index == TILE_DEATH || m_pFront[Ny * m_Width + Nx].m_Index == TILE_NOLASER)
 		return m_pFront[Ny * m_Width + Nx].m_Index;
 	else
@@ -1078,6 +1248,12 @@ void CCollision::SetCollisionAt(float x, float y, int Index)
 	int Ny = clamp(round_to_int(y) / 32, 0, m_Height - 1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = Index;
+	SetSolidBit(Nx, Ny, Index == TILE_SOLID || Index == TILE_NOHOOK);
+
+	if(!m_vSolidDistance.empty() && IsRayBlocker(Ny * m_Width + Nx, true))
+		UpdateRayDistance(m_vSolidDistance, Ny * m_Width + Nx);
+	if(!m_vRayDistance.empty() && IsRayBlocker(Ny * m_Width + Nx, false))
+		UpdateRayDistance(m_vRayDistance, Ny * m_Width + Nx);
 }
 
 void CCollision::SetDoorCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1090,11 +1266,16 @@ void CCollision::SetDoorCollisionAt(float x, float y, int Type, int Flags, int N
 	m_pDoor[Ny * m_Width + Nx].m_Index = Type;
 	m_pDoor[Ny * m_Width + Nx].m_Flags = Flags;
 	m_pDoor[Ny * m_Width + Nx].m_Number = Number;
+
+	if(Type)
+		m_vTilePresence[Ny * m_Width + Nx] |= TILEPRESENCE_DOOR;
+	else
+		m_vTilePresence[Ny * m_Width + Nx] &= ~TILEPRESENCE_DOOR;
 }
 
 void CCollision::GetDoorTile(int Index, CDoorTile *pDoorTile) const
 {
-	if(!m_pDoor || Index < 0 || !m_pDoor[Index].m_Index)
+	if(!m_pDoor || !HasTilePresence(Index, TILEPRESENCE_DOOR))
 	{
 		pDoorTile->m_Index = 0;
 		pDoorTile->m_Flags = 0;
@@ -1140,6 +1321,7 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 {
 	float d = distance(Pos0, Pos1);
 	vec2 Last = Pos0;
+	const float MaxStep = RayMaxStep(Pos0, Pos1, d);
 
 	for(int i = 0, id = std::ceil(d); i < id; i++)
 	{
@@ -1159,6 +1341,11 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 				return GetCollisionAt(Pos.x, Pos.y);
 		}
 		Last = Pos;
+		if(int Skip = SkippableSamples(m_vRayDistance, round_to_int(Pos.x), round_to_int(Pos.y), MaxStep))
+		{
+			i += Skip;
+			Last = mix(Pos0, Pos1, i / d);
+		}
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
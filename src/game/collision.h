@@ -6,6 +6,7 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
+#include <cstdint>
 #include <map>
 #include <vector>
 
@@ -40,6 +41,12 @@ public:
 	void Unload();
 	void FillAntibot(CAntibotMapData *pMapData) const;
 
+	// lets the IntersectLine family jump over samples that are known to be
+	// in empty tiles, the results are the same as with per pixel sampling
+	void SetSkipEmptyTiles(bool Skip) { m_SkipEmptyTiles = Skip; }
+	// bytes used by the lookup tables built in Init
+	size_t AccelerationMemoryUsage() const;
+
 	bool CheckPoint(float x, float y) const { return IsSolid(round_to_int(x), round_to_int(y)); }
 	bool CheckPoint(vec2 Pos) const { return CheckPoint(Pos.x, Pos.y); }
 	int GetCollisionAt(float x, float y) const { return GetTile(round_to_int(x), round_to_int(y)); }
@@ -98,7 +105,14 @@ public:
 	int GetSwitchNumber(int Index) const;
 	int GetSwitchDelay(int Index) const;
 
-	int IsSolid(int x, int y) const;
+	int IsSolid(int x, int y) const
+	{
+		if(m_vSolidBits.empty())
+			return 0;
+		const int Nx = clamp(x / 32, 0, m_Width - 1);
+		const int Ny = clamp(y / 32, 0, m_Height - 1);
+		return (m_vSolidBits[(Ny >> 3) * m_SolidBlocksWidth + (Nx >> 3)] >> (((Ny & 7) << 3) | (Nx & 7))) & 1;
+	}
 	bool IsThrough(int x, int y, int OffsetX, int OffsetY, vec2 Pos0, vec2 Pos1) const;
 	bool IsHookBlocker(int x, int y, vec2 Pos0, vec2 Pos1) const;
 	int IsWallJump(int Index) const;
@@ -157,6 +171,43 @@ private:
 	CTuneTile *m_pTune;
 	CDoorTile *m_pDoor;
 
+	// TILE_SOLID and TILE_NOHOOK of the game layer, one bit per tile, each
+	// word holds a block of 8x8 tiles so that nearby lookups share a word
+	int m_SolidBlocksWidth;
+	std::vector<uint64_t> m_vSolidBits;
+
+	// which of the other layers have a tile at an index, checked by the
+	// predicates before they read the layer itself
+	enum
+	{
+		TILEPRESENCE_FRONT = 1 << 0,
+		TILEPRESENCE_TELE = 1 << 1,
+		TILEPRESENCE_SPEEDUP = 1 << 2,
+		TILEPRESENCE_DOOR = 1 << 3,
+	};
+	std::vector<uint8_t> m_vTilePresence;
+
+	void InitAccelerationData();
+	void SetSolidBit(int x, int y, bool Solid);
+	bool HasTilePresence(int Index, int Presence) const { return Index >= 0 && !m_vTilePresence.empty() && (m_vTilePresence[Index] & Presence); }
+
+	// chebyshev distance in tiles to the closest tile that can stop a ray,
+	// capped at RAY_DISTANCE_MAX
+	enum
+	{
+		RAY_DISTANCE_MAX = 32,
+	};
+	bool m_SkipEmptyTiles;
+	// TILE_SOLID and TILE_NOHOOK, for IntersectLine
+	std::vector<uint8_t> m_vSolidDistance;
+	// everything the other intersect functions stop at
+	std::vector<uint8_t> m_vRayDistance;
+
+	bool IsRayBlocker(int Index, bool SolidOnly) const;
+	void InitRayDistance(std::vector<uint8_t> &vDistance, bool SolidOnly) const;
+	void UpdateRayDistance(std::vector<uint8_t> &vDistance, int Index) const;
+	int SkippableSamples(const std::vector<uint8_t> &vDistance, int x, int y, float MaxStep) const;
+
 	// TILE_TELEIN
 	std::map<int, std::vector<vec2>> m_TeleIns;
 	// TILE_TELEOUT
@@ -9,6 +9,7 @@
 #include <base/system.h>
 #include <engine/shared/config.h>
 
+#include <algorithm>
 #include <limits>
 
 const char *CTuningParams::ms_apNames[] =
@@ -347,9 +348,15 @@ void CCharacterCore::Tick(bool UseInput, bool DoDeferredTick)
 		// Check against other players first
 		if(!m_HookHitDisabled && m_pWorld && m_Tuning.m_PlayerHooking && (m_HookState == HOOK_FLYING || !m_NewHook))
 		{
+			// the hook only grabs players close to its path
+			const vec2 Margin = vec2(PhysicalSize() + 3.0f, PhysicalSize() + 3.0f);
+			int aIds[MAX_CLIENTS];
+			const int NumIds = m_pWorld->FindCharacters(vec2(minimum(m_HookPos.x, NewPos.x), minimum(m_HookPos.y, NewPos.y)) - Margin, vec2(maximum(m_HookPos.x, NewPos.x), maximum(m_HookPos.y, NewPos.y)) + Margin, aIds);
+
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			for(int Id = 0; Id < NumIds; Id++)
 			{
+				const int i = aIds[Id];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 				if(!pCharCore || pCharCore == this || (!(m_Super || pCharCore->m_Super) && ((m_Id != -1 && !m_pTeams->CanCollide(i, m_Id)) || pCharCore->m_Solo || m_Solo)))
 					continue;
@@ -461,11 +468,23 @@ void CCharacterCore::TickDeferred()
 {
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		// only the hooked player and players close enough to collide are affected
+		const vec2 Margin = vec2(PhysicalSize() * 1.25f + 1.0f, PhysicalSize() * 1.25f + 1.0f);
+		int aIds[MAX_CLIENTS];
+		int NumIds = m_pWorld->FindCharacters(m_Pos - Margin, m_Pos + Margin, aIds);
+		if(m_HookedPlayer != -1 && m_pWorld->m_apCharacters[m_HookedPlayer] && !std::binary_search(aIds, aIds + NumIds, m_HookedPlayer))
+		{
+			// keep the id order
+			int *pInsert = std::lower_bound(aIds, aIds + NumIds, m_HookedPlayer);
+			std::copy_backward(pInsert, aIds + NumIds, aIds + NumIds + 1);
+			*pInsert = m_HookedPlayer;
+			NumIds++;
+		}
+
+		for(int Id = 0; Id < NumIds; Id++)
 		{
+			const int i = aIds[Id];
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-			if(!pCharCore)
-				continue;
 
 			if(pCharCore == this || (m_Id != -1 && !m_pTeams->CanCollide(m_Id, i)))
 				continue; // make sure that we don't nudge our self
@@ -568,14 +587,20 @@ void CCharacterCore::Move()
 		float Distance = distance(m_Pos, NewPos);
 		if(Distance > 0)
 		{
+			// only players close to the path can block it
+			const vec2 Margin = vec2(PhysicalSize() + 1.0f, PhysicalSize() + 1.0f);
+			int aIds[MAX_CLIENTS];
+			const int NumIds = m_pWorld->FindCharacters(vec2(minimum(m_Pos.x, NewPos.x), minimum(m_Pos.y, NewPos.y)) - Margin, vec2(maximum(m_Pos.x, NewPos.x), maximum(m_Pos.y, NewPos.y)) + Margin, aIds);
+
 			int End = Distance + 1;
 			vec2 LastPos = m_Pos;
-			for(int i = 0; i < End; i++)
+			for(int i = 0; i < End && NumIds > 0; i++)
 			{
 				float a = i / Distance;
 				vec2 Pos = mix(m_Pos, NewPos, a);
-				for(int p = 0; p < MAX_CLIENTS; p++)
+				for(int Id = 0; Id < NumIds; Id++)
 				{
+					const int p = aIds[Id];
 					CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
 					if(!pCharCore || pCharCore == this)
 						continue;
@@ -739,6 +764,102 @@ bool CCharacterCore::IsSwitchActiveCb(int Number, void *pUser)
 	return false;
 }
 
+int CWorldCore::FindCharacters(vec2 Min, vec2 Max, int *pIds) const
+{
+	int Num = 0;
+	if(m_SweepActive && m_FilterCharacters)
+	{
+		for(int Index = std::lower_bound(m_aSweepX, m_aSweepX + m_NumSweep, Min.x) - m_aSweepX; Index < m_NumSweep && m_aSweepX[Index] <= Max.x; Index++)
+		{
+			if(m_aSweepY[Index] >= Min.y && m_aSweepY[Index] <= Max.y)
+				pIds[Num++] = m_aSweepIds[Index];
+		}
+		std::sort(pIds, pIds + Num);
+		return Num;
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CCharacterCore *pCharCore = m_apCharacters[i];
+		if(pCharCore && (!m_FilterCharacters || (pCharCore->m_Pos.x >= Min.x && pCharCore->m_Pos.x <= Max.x && pCharCore->m_Pos.y >= Min.y && pCharCore->m_Pos.y <= Max.y)))
+			pIds[Num++] = i;
+	}
+	return Num;
+}
+
+void CWorldCore::TickCharacters(bool UseInput, bool DoDeferredTick)
+{
+	// positions only change in Move, the sorted arrays stay valid
+	// for Tick and TickDeferred
+	BuildSweep();
+
+	for(CCharacterCore *pCharCore : m_apCharacters)
+	{
+		if(pCharCore)
+			pCharCore->Tick(UseInput, DoDeferredTick);
+	}
+	if(!DoDeferredTick)
+	{
+		for(CCharacterCore *pCharCore : m_apCharacters)
+		{
+			if(pCharCore)
+				pCharCore->TickDeferred();
+		}
+	}
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(!m_apCharacters[i])
+			continue;
+		m_apCharacters[i]->Move();
+		m_apCharacters[i]->Quantize();
+		UpdateSweep(i);
+	}
+
+	m_SweepActive = false;
+}
+
+void CWorldCore::BuildSweep()
+{
+	m_NumSweep = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_apCharacters[i])
+			m_aSweepIds[m_NumSweep++] = i;
+	}
+	std::sort(m_aSweepIds, m_aSweepIds + m_NumSweep, [this](int Id1, int Id2) {
+		return m_apCharacters[Id1]->m_Pos.x < m_apCharacters[Id2]->m_Pos.x;
+	});
+	for(int Index = 0; Index < m_NumSweep; Index++)
+	{
+		const int Id = m_aSweepIds[Index];
+		m_aSweepX[Index] = m_apCharacters[Id]->m_Pos.x;
+		m_aSweepY[Index] = m_apCharacters[Id]->m_Pos.y;
+		m_aSweepIndex[Id] = Index;
+	}
+	m_SweepActive = true;
+}
+
+void CWorldCore::UpdateSweep(int Id)
+{
+	int Index = m_aSweepIndex[Id];
+	m_aSweepX[Index] = m_apCharacters[Id]->m_Pos.x;
+	m_aSweepY[Index] = m_apCharacters[Id]->m_Pos.y;
+	// characters move little per tick, only a few swaps are needed
+	for(; Index > 0 && m_aSweepX[Index - 1] > m_aSweepX[Index]; Index--)
+		SwapSweep(Index - 1, Index);
+	for(; Index < m_NumSweep - 1 && m_aSweepX[Index + 1] < m_aSweepX[Index]; Index++)
+		SwapSweep(Index, Index + 1);
+}
+
+void CWorldCore::SwapSweep(int Index1, int Index2)
+{
+	std::swap(m_aSweepIds[Index1], m_aSweepIds[Index2]);
+	std::swap(m_aSweepX[Index1], m_aSweepX[Index2]);
+	std::swap(m_aSweepY[Index1], m_aSweepY[Index2]);
+	m_aSweepIndex[m_aSweepIds[Index1]] = Index1;
+	m_aSweepIndex[m_aSweepIds[Index2]] = Index2;
+}
+
 void CWorldCore::InitSwitchers(int HighestSwitchNumber)
 {
 	if(HighestSwitchNumber > 0)
@@ -150,6 +150,9 @@ public:
 			pCharacter = nullptr;
 		}
 		m_pPrng = nullptr;
+		m_FilterCharacters = true;
+		m_SweepActive = false;
+		m_NumSweep = 0;
 	}
 
 	int RandomOr0(int BelowThis)
@@ -170,6 +173,40 @@ public:
 
 	void InitSwitchers(int HighestSwitchNumber);
 	std::vector<SSwitchers> m_vSwitchers;
+
+	// writes the ids of the characters inside the box to pIds in ascending
+	// order and returns their number, used to skip far away characters in
+	// the player-player checks of CCharacterCore
+	//
+	// while TickCharacters runs this searches the positions sorted by x,
+	// otherwise it scans all slots: game logic writes m_Pos of the cores
+	// between their steps (teleporters, spawns, /tp), which would leave
+	// the sorted positions behind
+	int FindCharacters(vec2 Min, vec2 Max, int *pIds) const;
+	// the player-player checks visit all characters if this is off,
+	// the tests compare the results of both
+	bool m_FilterCharacters;
+
+	// steps all characters without game logic in between, in id order:
+	// Tick of all, TickDeferred of all unless DoDeferredTick, then Move
+	// and Quantize of all. The results are the same as calling these
+	// functions of every core in this order.
+	void TickCharacters(bool UseInput, bool DoDeferredTick);
+
+private:
+	// the positions of the characters sorted by x while TickCharacters runs
+	bool m_SweepActive;
+	int m_NumSweep;
+	int m_aSweepIds[MAX_CLIENTS];
+	float m_aSweepX[MAX_CLIENTS];
+	float m_aSweepY[MAX_CLIENTS];
+	// index of each character in the sorted arrays
+	int m_aSweepIndex[MAX_CLIENTS];
+
+	void BuildSweep();
+	// keeps the arrays sorted after a character moved
+	void UpdateSweep(int Id);
+	void SwapSweep(int Index1, int Index2);
 };
 
 class CCharacterCore
@@ -384,6 +384,7 @@ void CGameContext::Teleport(CCharacter *pChr, vec2 Pos)
 {
 	pChr->SetPosition(Pos);
 	pChr->m_Pos = Pos;
+	pChr->GameWorld()->OnEntityMoved(pChr);
 	pChr->m_PrevPos = Pos;
 	pChr->m_DDRaceState = DDRACE_CHEAT;
 }
@@ -927,6 +928,19 @@ void CGameContext::ConAntibot(IConsole::IResult *pResult, void *pUserData)
 	pSelf->Antibot()->ConsoleCommand(pResult->GetString(0));
 }
 
+void CGameContext::ConDumpEntityPools(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	for(const CFreeListPool *pPool = CFreeListPool::First(); pPool; pPool = pPool->Next())
+	{
+		const CFreeListPool::CStats &Stats = pPool->Stats();
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%s: live=%d high_water=%d capacity=%d block_size=%d allocs=%" PRIu64 " reused=%" PRIu64,
+			pPool->Name(), Stats.m_Live, Stats.m_HighWater, Stats.m_Capacity, (int)pPool->BlockSize(), Stats.m_NumAllocs, Stats.m_NumReused);
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "entity_pools", aBuf);
+	}
+}
+
 void CGameContext::ConDumpLog(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
@@ -41,6 +41,7 @@ public:
 	void Tick() override;
 	void TickDeferred() override;
 	void TickPaused() override;
+	void PreSnap() override;
 	void Snap(int SnappingClient) override;
 	void PostSnap() override;
 	void SwapClients(int Client1, int Client2) override;
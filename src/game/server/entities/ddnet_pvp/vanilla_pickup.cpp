@@ -11,6 +11,8 @@
 
 #include "vanilla_pickup.h"
 
+MACRO_ALLOC_FREELIST_IMPL(CVanillaPickup)
+
 static constexpr int gs_PickupPhysSize = 14;
 
 CVanillaPickup::CVanillaPickup(CGameWorld *pGameWorld, int Type, int SubType, int Layer, int Number) :
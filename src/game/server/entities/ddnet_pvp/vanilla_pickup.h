@@ -7,6 +7,8 @@
 
 class CVanillaPickup : public CEntity
 {
+	MACRO_ALLOC_FREELIST()
+
 public:
 	static const int ms_CollisionExtraSize = 6;
 
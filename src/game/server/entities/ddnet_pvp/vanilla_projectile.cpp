@@ -11,6 +11,8 @@
 
 #include "vanilla_projectile.h"
 
+MACRO_ALLOC_FREELIST_IMPL(CVanillaProjectile)
+
 CVanillaProjectile::CVanillaProjectile(
 	CGameWorld *pGameWorld,
 	int Type,
@@ -7,6 +7,8 @@
 
 class CVanillaProjectile : public CEntity
 {
+	MACRO_ALLOC_FREELIST()
+
 public:
 	CVanillaProjectile(
 		CGameWorld *pGameWorld,
@@ -121,11 +121,8 @@ void CFlag::TickPaused()
 		++m_GrabTick;
 }
 
-void CFlag::Snap(int SnappingClient)
+void CFlag::PreSnap()
 {
-	if(NetworkClipped(SnappingClient))
-		return;
-
 	// this should not be here ._.
 	// it is also done in TickDeferred and vanilla does not
 	// keep this in here
@@ -135,6 +132,12 @@ void CFlag::Snap(int SnappingClient)
 	// which is not needed on vanilla servers
 	if(m_pCarrier)
 		m_Pos = m_pCarrier->GetPos();
+}
+
+void CFlag::Snap(int SnappingClient)
+{
+	if(NetworkClipped(SnappingClient))
+		return;
 
 	if(Server()->IsSixup(SnappingClient))
 	{
@@ -35,6 +35,7 @@ public:
 	/* CEntity functions */
 	void Reset() override;
 	void TickPaused() override;
+	void PreSnap() override;
 	void Snap(int SnappingClient) override;
 	void TickDeferred() override;
 
@@ -10,6 +10,9 @@
 
 #include <game/server/gamecontext.h>
 #include <game/server/gamemodes/DDRace.h>
+#include <game/server/shared_snapshot.h>
+
+MACRO_ALLOC_FREELIST_IMPL(CLaser)
 
 CLaser::CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEnergy, int Owner, int Type) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
@@ -321,6 +324,55 @@ void CLaser::Snap(int SnappingClient)
 		m_Pos, m_From, m_EvalTick, m_Owner, LaserType, 0, m_Number);
 }
 
+bool CLaser::SnapShared(CSharedSnapshot *pSharedSnapshot)
+{
+	if(!pSharedSnapshot->HasSpace(2, sizeof(CNetObj_DDNetLaser) + sizeof(CNetObj_Laser)))
+		return false;
+
+	CCharacter *pOwnerChar = nullptr;
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+	if(!pOwnerChar)
+		return true;
+
+	CSharedSnapshot::CView View;
+	if(pOwnerChar->IsAlive())
+		View.m_Mask = pOwnerChar->TeamMask();
+	View.m_pClipEntity = this;
+	View.AddClipPosition(m_Pos);
+	View.AddClipPosition(m_From);
+
+	// same items as CGameContext::SnapLaserObject creates for each client version
+	View.m_MinVersion = VERSION_DDNET_MULTI_LASER;
+	CNetObj_DDNetLaser *pDDNetLaser = pSharedSnapshot->NewItem<CNetObj_DDNetLaser>(GetId(), View);
+	if(pDDNetLaser)
+	{
+		pDDNetLaser->m_ToX = (int)m_Pos.x;
+		pDDNetLaser->m_ToY = (int)m_Pos.y;
+		pDDNetLaser->m_FromX = (int)m_From.x;
+		pDDNetLaser->m_FromY = (int)m_From.y;
+		pDDNetLaser->m_StartTick = m_EvalTick;
+		pDDNetLaser->m_Owner = m_Owner;
+		pDDNetLaser->m_Type = m_Type == WEAPON_LASER ? LASERTYPE_RIFLE : m_Type == WEAPON_SHOTGUN ? LASERTYPE_SHOTGUN : -1;
+		pDDNetLaser->m_Subtype = 0;
+		pDDNetLaser->m_SwitchNumber = m_Number;
+		pDDNetLaser->m_Flags = 0;
+	}
+
+	View.m_MinVersion = CSharedSnapshot::CView().m_MinVersion;
+	View.m_MaxVersion = VERSION_DDNET_MULTI_LASER;
+	CNetObj_Laser *pLaser = pSharedSnapshot->NewItem<CNetObj_Laser>(GetId(), View);
+	if(pLaser)
+	{
+		pLaser->m_X = (int)m_Pos.x;
+		pLaser->m_Y = (int)m_Pos.y;
+		pLaser->m_FromX = (int)m_From.x;
+		pLaser->m_FromY = (int)m_From.y;
+		pLaser->m_StartTick = m_EvalTick;
+	}
+	return true;
+}
+
 void CLaser::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
@@ -7,6 +7,8 @@
 
 class CLaser : public CEntity
 {
+	MACRO_ALLOC_FREELIST()
+
 public:
 	CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEnergy, int Owner, int Type);
 
@@ -14,6 +16,7 @@ public:
 	virtual void Tick() override;
 	virtual void TickPaused() override;
 	virtual void Snap(int SnappingClient) override;
+	virtual bool SnapShared(CSharedSnapshot *pSharedSnapshot) override;
 	virtual void SwapClients(int Client1, int Client2) override;
 
 	virtual int GetOwnerId() const override { return m_Owner; }
@@ -10,6 +10,8 @@
 #include <game/server/gamecontext.h>
 #include <game/server/player.h>
 
+MACRO_ALLOC_FREELIST_IMPL(CPickup)
+
 static constexpr int gs_PickupPhysSize = 14;
 
 CPickup::CPickup(CGameWorld *pGameWorld, int Type, int SubType, int Layer, int Number) :
@@ -12,6 +12,8 @@
 #include <game/server/gamemodes/DDRace.h>
 #include <game/server/player.h>
 
+MACRO_ALLOC_FREELIST_IMPL(CProjectile)
+
 CProjectile::CProjectile(
 	CGameWorld *pGameWorld,
 	int Type,
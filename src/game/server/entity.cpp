@@ -22,9 +22,11 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_MarkedForDestroy = false;
 	m_Id = Server()->SnapNewId();
+	m_SnappedShared = false;
+	m_SharedItemsBegin = 0;
+	m_SharedItemsEnd = 0;
 
-	m_pPrevTypeEntity = 0;
-	m_pNextTypeEntity = 0;
+	m_TypeSlot = -1;
 }
 
 CEntity::~CEntity()
@@ -12,6 +12,7 @@
 
 class CCollision;
 class CGameContext;
+class CSharedSnapshot;
 
 /*
 	Class: Entity
@@ -23,8 +24,10 @@ class CEntity
 
 private:
 	friend CGameWorld; // entity list handling
-	CEntity *m_pPrevTypeEntity;
-	CEntity *m_pNextTypeEntity;
+	template<typename T>
+	friend class CEntityList;
+	// index into the entity array of its type, -1 if not in the world
+	int m_TypeSlot;
 
 	/* Identity */
 	CGameWorld *m_pGameWorld;
@@ -33,6 +36,12 @@ private:
 	int m_Id;
 	int m_ObjType;
 
+	// set if SnapShared covered this entity in the current snapshot tick,
+	// Snap copies its shared items in the same place of the snapshot
+	bool m_SnappedShared;
+	int m_SharedItemsBegin;
+	int m_SharedItemsEnd;
+
 	/*
 		Variable: m_ProximityRadius
 			Contains the physical size of the entity.
@@ -50,6 +59,9 @@ public: // TODO: Maybe make protected
 	*/
 	vec2 m_Pos;
 
+	// cell in the game world's spatial grid, see CGameWorld::OnEntityMoved
+	CSpatialGridHandle m_GridHandle;
+
 	/* Getters */
 	int GetId() const { return m_Id; }
 
@@ -71,8 +83,8 @@ public: // TODO: Maybe make protected
 	CCollision *Collision() { return m_pCCollision; }
 
 	/* Getters */
-	CEntity *TypeNext() { return m_pNextTypeEntity; }
-	CEntity *TypePrev() { return m_pPrevTypeEntity; }
+	CEntity *TypeNext() { return m_pGameWorld->NextEntity(m_ObjType, m_TypeSlot); }
+	CEntity *TypePrev() { return m_pGameWorld->PrevEntity(m_ObjType, m_TypeSlot); }
 	const vec2 &GetPos() const { return m_Pos; }
 	float GetProximityRadius() const { return m_ProximityRadius; }
 
@@ -123,6 +135,31 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: PreSnap
+			Called once per snapshot tick before any client is snapped.
+			Snap may run for several clients in parallel, so state that
+			the snapshots depend on has to be updated here instead.
+	*/
+	virtual void PreSnap() {}
+
+	/*
+		Function: SnapShared
+			Called once per snapshot tick before any client is snapped.
+			Entities whose items only differ between clients in the
+			ways described by CSharedSnapshot::CView can add them
+			to the shared snapshot here instead of in Snap.
+
+		Arguments:
+			pSharedSnapshot - Item arena copied into the
+				snapshot of every client.
+
+		Returns:
+			True if the entity was added to the shared snapshot,
+			Snap will then not be called in this snapshot tick.
+	*/
+	virtual bool SnapShared(CSharedSnapshot *pSharedSnapshot) { return false; }
+
 	/*
 		Function: PostSnap
 			Called after all clients received their snapshot.
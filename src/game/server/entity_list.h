@@ -0,0 +1,134 @@
+#ifndef GAME_SERVER_ENTITY_LIST_H
+#define GAME_SERVER_ENTITY_LIST_H
+
+#include <base/system.h>
+
+#include <vector>
+
+/*
+	Class: CEntityList
+		Entities of one type in insertion order, walked back to front
+		so that the newest entity comes first. Removed entities leave
+		an empty slot behind until Compact closes the gaps. T needs an
+		int m_TypeSlot that is -1 while the entity is not in a list.
+*/
+template<typename T>
+class CEntityList
+{
+	std::vector<T *> m_vpEntities;
+	int m_NumEmptySlots = 0;
+	// the array is only compacted while no ForEach walk is running
+	int m_NumTraversals = 0;
+
+public:
+	void Insert(T *pEnt)
+	{
+		dbg_assert(pEnt->m_TypeSlot == -1, "entity is already in a list");
+		// the last slot is walked first
+		pEnt->m_TypeSlot = m_vpEntities.size();
+		m_vpEntities.push_back(pEnt);
+	}
+
+	void Remove(T *pEnt)
+	{
+		// not in the list
+		if(pEnt->m_TypeSlot == -1)
+			return;
+
+		// leave the slot empty, this keeps running walks valid
+		m_vpEntities[pEnt->m_TypeSlot] = nullptr;
+		m_NumEmptySlots++;
+		pEnt->m_TypeSlot = -1;
+	}
+
+	/*
+		Function: Compact
+			Closes the gaps left by removed entities, keeps the order.
+
+		Returns:
+			False if a ForEach walk is running and nothing was done.
+	*/
+	bool Compact()
+	{
+		if(m_NumTraversals != 0)
+			return false;
+		if(!m_NumEmptySlots)
+			return true;
+
+		int Slot = 0;
+		for(T *pEnt : m_vpEntities)
+		{
+			if(!pEnt)
+				continue;
+			pEnt->m_TypeSlot = Slot;
+			m_vpEntities[Slot++] = pEnt;
+		}
+		m_vpEntities.resize(Slot);
+		m_NumEmptySlots = 0;
+		return true;
+	}
+
+	/*
+		Function: ForEach
+			Calls Fn for all entities, newest first. Entities inserted
+			by Fn are not visited, entities removed by Fn are skipped.
+	*/
+	template<typename F>
+	void ForEach(F &&Fn)
+	{
+		m_NumTraversals++;
+		// index every time, Fn may grow the array
+		for(int Slot = (int)m_vpEntities.size() - 1; Slot >= 0; Slot--)
+		{
+			if(T *pEnt = m_vpEntities[Slot])
+				Fn(pEnt);
+		}
+		m_NumTraversals--;
+	}
+
+	/*
+		Function: ForEachConst
+			Calls Fn for all entities, newest first. Fn must not insert
+			or remove entities. The walk changes no state, so several
+			threads can walk the list at the same time.
+	*/
+	template<typename F>
+	void ForEachConst(F &&Fn) const
+	{
+		for(int Slot = (int)m_vpEntities.size() - 1; Slot >= 0; Slot--)
+		{
+			if(T *pEnt = m_vpEntities[Slot])
+				Fn(pEnt);
+		}
+	}
+
+	T *First() const { return Next(m_vpEntities.size()); }
+
+	// the entity that comes after a slot in the walk, nullptr if there is none
+	T *Next(int Slot) const
+	{
+		for(Slot--; Slot >= 0; Slot--)
+		{
+			if(m_vpEntities[Slot])
+				return m_vpEntities[Slot];
+		}
+		return nullptr;
+	}
+
+	T *Prev(int Slot) const
+	{
+		if(Slot < 0)
+			return nullptr;
+		for(Slot++; Slot < (int)m_vpEntities.size(); Slot++)
+		{
+			if(m_vpEntities[Slot])
+				return m_vpEntities[Slot];
+		}
+		return nullptr;
+	}
+
+	// number of slots, including the empty ones
+	int NumSlots() const { return m_vpEntities.size(); }
+};
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "entity.h"
 #include "gamecontext.h"
+#include "shared_snapshot.h"
 
 #include <base/system.h>
 #include <base/vmath.h>
@@ -14,6 +15,9 @@
 CEventHandler::CEventHandler()
 {
 	m_pGameServer = 0;
+	m_pSharedSnapshot = nullptr;
+	m_SharedItemsBegin = 0;
+	m_SharedItemsEnd = 0;
 	Clear();
 }
 
@@ -45,27 +49,43 @@ void CEventHandler::Clear()
 	m_CurrentOffset = 0;
 }
 
-void CEventHandler::Snap(int SnappingClient)
+void CEventHandler::SnapShared(CSharedSnapshot *pSharedSnapshot)
 {
+	m_pSharedSnapshot = pSharedSnapshot;
+	m_SharedItemsBegin = pSharedSnapshot->NumItems();
 	for(int i = 0; i < m_NumEvents; i++)
 	{
-		if(SnappingClient == SERVER_DEMO_CLIENT || m_aClientMasks[i].test(SnappingClient))
+		const CNetEvent_Common *pEvent = (const CNetEvent_Common *)&m_aData[m_aOffsets[i]];
+
+		CSharedSnapshot::CView View;
+		View.m_Mask = m_aClientMasks[i];
+		View.AddClipPosition(vec2(pEvent->m_X, pEvent->m_Y));
+
+		int Type = m_aTypes[i];
+		int Size = m_aSizes[i];
+		const char *pData = &m_aData[m_aOffsets[i]];
+		EventToSixup(&Type, &Size, &pData);
+		if(Type != m_aTypes[i])
 		{
-			CNetEvent_Common *pEvent = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(!NetworkClipped(GameServer(), SnappingClient, vec2(pEvent->m_X, pEvent->m_Y)))
-			{
-				int Type = m_aTypes[i];
-				int Size = m_aSizes[i];
-				const char *pData = &m_aData[m_aOffsets[i]];
-				if(GameServer()->Server()->IsSixup(SnappingClient))
-					EventToSixup(&Type, &Size, &pData);
-
-				void *pItem = GameServer()->Server()->SnapNewItem(Type, i, Size);
-				if(pItem)
-					mem_copy(pItem, pData, Size);
-			}
+			// 0.7 clients get a translated event
+			View.m_Sixup = 1;
+			void *pItem = pSharedSnapshot->NewItem(Type, i, Size, View);
+			if(pItem)
+				mem_copy(pItem, pData, Size);
+			View.m_Sixup = 0;
 		}
+
+		void *pItem = pSharedSnapshot->NewItem(m_aTypes[i], i, m_aSizes[i], View);
+		if(pItem)
+			mem_copy(pItem, &m_aData[m_aOffsets[i]], m_aSizes[i]);
 	}
+	m_SharedItemsEnd = pSharedSnapshot->NumItems();
+}
+
+void CEventHandler::Snap(int SnappingClient) const
+{
+	if(m_pSharedSnapshot)
+		m_pSharedSnapshot->Snap(GameServer(), SnappingClient, m_SharedItemsBegin, m_SharedItemsEnd);
 }
 
 void CEventHandler::EventToSixup(int *pType, int *pSize, const char **ppData)
@@ -7,6 +7,8 @@
 
 #include <engine/shared/protocol.h>
 
+class CSharedSnapshot;
+
 class CEventHandler
 {
 	enum
@@ -26,6 +28,11 @@ class CEventHandler
 	int m_CurrentOffset;
 	int m_NumEvents;
 
+	// the items of the events in the shared snapshot of the current snapshot tick
+	const CSharedSnapshot *m_pSharedSnapshot;
+	int m_SharedItemsBegin;
+	int m_SharedItemsEnd;
+
 public:
 	CGameContext *GameServer() const { return m_pGameServer; }
 	void SetGameServer(CGameContext *pGameServer);
@@ -40,7 +47,8 @@ public:
 	}
 
 	void Clear();
-	void Snap(int SnappingClient);
+	void SnapShared(CSharedSnapshot *pSharedSnapshot);
+	void Snap(int SnappingClient) const;
 
 	void EventToSixup(int *pType, int *pSize, const char **ppData);
 };
@@ -1319,6 +1319,7 @@ void CGameContext::OnTick()
 
 	if(m_SqlRandomMapResult != nullptr && m_SqlRandomMapResult->m_Completed)
 	{
+		CSqlResultsProfileScope ProfilerScope(Server());
 		if(m_SqlRandomMapResult->m_Success)
 		{
 			if(m_SqlRandomMapResult->m_ClientId != -1 && m_apPlayers[m_SqlRandomMapResult->m_ClientId] && m_SqlRandomMapResult->m_aMessage[0] != '\0')
@@ -3748,6 +3749,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("votes", "?i[page]", CFGFLAG_SERVER, ConVotes, this, "Show all votes (page 0 by default, 20 entries per page)");
 	Console()->Register("dump_antibot", "", CFGFLAG_SERVER, ConDumpAntibot, this, "Dumps the antibot status");
 	Console()->Register("antibot", "r[command]", CFGFLAG_SERVER, ConAntibot, this, "Sends a command to the antibot");
+	Console()->Register("dump_entity_pools", "", CFGFLAG_SERVER, ConDumpEntityPools, this, "Dumps the allocation statistics of the entity pools");
 
 	Console()->Chain("sv_motd", ConchainSpecialMotdupdate, this);
 
@@ -4499,7 +4501,26 @@ void CGameContext::OnSnap(int ClientId)
 	m_World.Snap(ClientId);
 	m_Events.Snap(ClientId);
 }
-void CGameContext::OnPreSnap() {}
+
+void CGameContext::OnSnapCheck(int ClientId)
+{
+	// OnSnap writes outside the snapshot builder in two places, both
+	// only to the player of the snapping client:
+	// - FakeSnap counts the snapshots sent to the client in m_SentSnaps,
+	//   which must not count this second snap
+	// - CGameControllerPvp::ForceNetworkClipping forces m_ShowDistance to
+	//   the default view, which writes the same value again
+	const int SentSnaps = m_apPlayers[ClientId]->m_SentSnaps;
+	OnSnap(ClientId);
+	m_apPlayers[ClientId]->m_SentSnaps = SentSnaps;
+}
+void CGameContext::OnPreSnap()
+{
+	m_World.PreSnap();
+	m_SharedSnapshot.Clear();
+	m_World.SnapShared(&m_SharedSnapshot);
+	m_Events.SnapShared(&m_SharedSnapshot);
+}
 void CGameContext::OnPostSnap()
 {
 	m_World.PostSnap();
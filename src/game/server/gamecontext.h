@@ -19,6 +19,7 @@
 
 #include "eventhandler.h"
 #include "gameworld.h"
+#include "shared_snapshot.h"
 #include "teehistorian.h"
 
 #include <memory>
@@ -140,6 +141,7 @@ class CGameContext : public IGameServer
 	static void ConDrySave(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpAntibot(IConsole::IResult *pResult, void *pUserData);
 	static void ConAntibot(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpEntityPools(IConsole::IResult *pResult, void *pUserData);
 	static void ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainSettingUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConDumpLog(IConsole::IResult *pResult, void *pUserData);
@@ -174,6 +176,7 @@ public:
 	IAntibot *Antibot() { return m_pAntibot; }
 	CTeeHistorian *TeeHistorian() { return &m_TeeHistorian; }
 	bool TeeHistorianActive() const { return m_TeeHistorianActive; }
+	CPrng *Prng() { return &m_Prng; }
 
 	CGameContext();
 	CGameContext(int Reset);
@@ -182,6 +185,7 @@ public:
 	void Clear();
 
 	CEventHandler m_Events;
+	CSharedSnapshot m_SharedSnapshot;
 	CPlayer *m_apPlayers[MAX_CLIENTS];
 	// keep last input to always apply when none is sent
 	CNetObj_PlayerInput m_aLastPlayerInput[MAX_CLIENTS];
@@ -299,6 +303,7 @@ public:
 	void OnTick() override;
 	void OnPreSnap() override;
 	void OnSnap(int ClientId) override;
+	void OnSnapCheck(int ClientId) override;
 	void OnPostSnap() override;
 
 	void UpdatePlayerMaps();
@@ -130,70 +130,33 @@ void IGameController::DoActivityCheck()
 	}
 }
 
-float IGameController::EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos, int DDTeam)
+bool IGameController::FreeSpawnPos(vec2 SpawnPoint, int *pOffset)
 {
-	float Score = 0.0f;
-	CCharacter *pC = static_cast<CCharacter *>(GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_CHARACTER));
-	for(; pC; pC = (CCharacter *)pC->TypeNext())
-	{
-		// ignore players in other teams
-		if(GameServer()->GetDDRaceTeam(pC->GetPlayer()->GetCid()) != DDTeam)
-			continue;
-
-		float d = distance(Pos, pC->m_Pos);
-		Score += d == 0 ? 1000000000.0f : 1.0f / d;
-	}
-
-	return Score;
-}
-
-void IGameController::EvaluateSpawnType(CSpawnEval *pEval, int Type, int DDTeam)
-{
-	// j == 0: Find an empty slot, j == 1: Take any slot if no empty one found
-	for(int j = 0; j < 2 && !pEval->m_Got; j++)
-	{
-		// get spawn point
-		for(const vec2 &SpawnPoint : m_avSpawnPoints[Type])
+	// check if the position is occupado
+	CEntity *apEnts[MAX_CLIENTS];
+	int Num = GameServer()->m_World.FindEntities(SpawnPoint, 64, apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
+	int Result = -1;
+	for(int Index = 0; Index < CSpawnDanger::NUM_OFFSETS && Result == -1; ++Index)
+	{
+		Result = Index;
+		if(!GameServer()->m_World.m_Core.m_aTuning[0].m_PlayerCollision)
+			break;
+		for(int c = 0; c < Num; ++c)
 		{
-			vec2 P = SpawnPoint;
-			if(j == 0)
-			{
-				// check if the position is occupado
-				CEntity *apEnts[MAX_CLIENTS];
-				int Num = GameServer()->m_World.FindEntities(SpawnPoint, 64, apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
-				vec2 aPositions[5] = {vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f)}; // start, left, up, right, down
-				int Result = -1;
-				for(int Index = 0; Index < 5 && Result == -1; ++Index)
-				{
-					Result = Index;
-					if(!GameServer()->m_World.m_Core.m_aTuning[0].m_PlayerCollision)
-						break;
-					for(int c = 0; c < Num; ++c)
-					{
-						CCharacter *pChr = static_cast<CCharacter *>(apEnts[c]);
-						if(GameServer()->Collision()->CheckPoint(SpawnPoint + aPositions[Index]) ||
-							distance(pChr->m_Pos, SpawnPoint + aPositions[Index]) <= pChr->GetProximityRadius())
-						{
-							Result = -1;
-							break;
-						}
-					}
-				}
-				if(Result == -1)
-					continue; // try next spawn point
-
-				P += aPositions[Result];
-			}
-
-			float S = EvaluateSpawnPos(pEval, P, DDTeam);
-			if(!pEval->m_Got || (j == 0 && pEval->m_Score > S))
+			CCharacter *pChr = static_cast<CCharacter *>(apEnts[c]);
+			if(GameServer()->Collision()->CheckPoint(SpawnPoint + CSpawnDanger::SpawnOffset(Index)) ||
+				distance(pChr->m_Pos, SpawnPoint + CSpawnDanger::SpawnOffset(Index)) <= pChr->GetProximityRadius())
 			{
-				pEval->m_Got = true;
-				pEval->m_Score = S;
-				pEval->m_Pos = P;
+				Result = -1;
+				break;
 			}
 		}
 	}
+	if(Result == -1)
+		return false;
+
+	*pOffset = Result;
+	return true;
 }
 
 bool IGameController::CanSpawn(int Team, vec2 *pOutPos, int DDTeam)
@@ -202,25 +165,52 @@ bool IGameController::CanSpawn(int Team, vec2 *pOutPos, int DDTeam)
 	if(Team == TEAM_SPECTATORS)
 		return false;
 
+	// characters of the team in list order, the danger of a position is summed in this order
+	CSpawnDanger::CCharacterPos aCharacters[MAX_CLIENTS];
+	int NumCharacters = 0;
+	for(CCharacter *pChr = (CCharacter *)GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pChr; pChr = (CCharacter *)pChr->TypeNext())
+	{
+		const int ClientId = pChr->GetPlayer()->GetCid();
+		if(GameServer()->GetDDRaceTeam(ClientId) == DDTeam)
+			aCharacters[NumCharacters++] = {ClientId, pChr->m_Pos};
+	}
+
+	const CSpawnDanger *pScores = nullptr;
+	if(Config()->m_SvSpawnDangerCache)
+	{
+		// the characters moved since the last tick, start over once per tick
+		if(m_SpawnDanger.Valid(Server()->Tick(), DDTeam))
+			m_SpawnDanger.Update(aCharacters, NumCharacters);
+		else
+			m_SpawnDanger.Rebuild(m_avSpawnPoints, aCharacters, NumCharacters, Server()->Tick(), DDTeam);
+		pScores = &m_SpawnDanger;
+	}
+	else
+		m_SpawnDanger.Invalidate();
+
 	CSpawnEval Eval;
+	const CSpawnDanger::FFreePos FreePos = [this](vec2 SpawnPoint, int *pOffset) { return FreeSpawnPos(SpawnPoint, pOffset); };
+	auto EvaluateSpawnType = [&](int Type) {
+		CSpawnDanger::EvaluateSpawnType(&Eval, m_avSpawnPoints, Type, aCharacters, NumCharacters, pScores, FreePos);
+	};
 	if(IsTeamplay()) // ddnet-insta
 	{
 		Eval.m_FriendlyTeam = Team;
 
 		// first try own team spawn, then normal spawn and then enemy
-		EvaluateSpawnType(&Eval, 1 + (Team & 1), DDTeam);
+		EvaluateSpawnType(1 + (Team & 1));
 		if(!Eval.m_Got)
 		{
-			EvaluateSpawnType(&Eval, 0, DDTeam);
+			EvaluateSpawnType(0);
 			if(!Eval.m_Got)
-				EvaluateSpawnType(&Eval, 1 + ((Team + 1) & 1), DDTeam);
+				EvaluateSpawnType(1 + ((Team + 1) & 1));
 		}
 	}
 	else
 	{
-		EvaluateSpawnType(&Eval, 0, DDTeam);
-		EvaluateSpawnType(&Eval, 1, DDTeam);
-		EvaluateSpawnType(&Eval, 2, DDTeam);
+		EvaluateSpawnType(0);
+		EvaluateSpawnType(1);
+		EvaluateSpawnType(2);
 	}
 
 	*pOutPos = Eval.m_Pos;
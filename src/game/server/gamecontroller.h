@@ -6,6 +6,7 @@
 #include <base/vmath.h>
 #include <engine/map.h>
 #include <engine/shared/protocol.h>
+#include <game/server/spawn_danger.h>
 #include <game/server/teams.h>
 
 #include <engine/shared/http.h> // ddnet-insta
@@ -29,7 +30,9 @@ class IGameController
 
 	friend class CSaveTeam; // need access to GameServer() and Server()
 
-	std::vector<vec2> m_avSpawnPoints[3];
+	std::vector<vec2> m_avSpawnPoints[CSpawnDanger::NUM_SPAWN_TYPES];
+	// scores of the spawn points for the spawns of the current tick
+	CSpawnDanger m_SpawnDanger;
 
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
@@ -44,23 +47,8 @@ protected:
 
 	void DoActivityCheck();
 
-	struct CSpawnEval
-	{
-		CSpawnEval()
-		{
-			m_Got = false;
-			m_FriendlyTeam = -1;
-			m_Pos = vec2(100, 100);
-		}
-
-		vec2 m_Pos;
-		bool m_Got;
-		int m_FriendlyTeam;
-		float m_Score;
-	};
-
-	float EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos, int DDTeam);
-	void EvaluateSpawnType(CSpawnEval *pEval, int Type, int DDTeam);
+	// finds the first position at a spawn point that no character blocks, see CSpawnDanger::SpawnOffset
+	bool FreeSpawnPos(vec2 SpawnPoint, int *pOffset);
 
 	void ResetGame();
 
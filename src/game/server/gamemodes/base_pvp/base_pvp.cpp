@@ -134,6 +134,10 @@ void CGameControllerPvp::OnRoundEnd()
 		if(m_pStatsTable[0] != '\0')
 			SaveStatsOnRoundEnd(pPlayer);
 	}
+
+	// all players are written in one batch
+	if(m_pStatsTable[0] != '\0')
+		m_pSqlStats->FlushRoundStats();
 }
 
 CGameControllerPvp::~CGameControllerPvp()
@@ -720,6 +724,7 @@ void CGameControllerPvp::SaveStatsOnDisconnect(CPlayer *pPlayer)
 
 	dbg_msg("sql", "saving stats of disconnecting player '%s' CountAsLoss=%d (%s)", Server()->ClientName(pPlayer->GetCid()), CountAsLoss, pLossReason);
 	m_pSqlStats->SaveRoundStats(Server()->ClientName(pPlayer->GetCid()), StatsTable(), &pPlayer->m_Stats);
+	m_pSqlStats->FlushRoundStats();
 }
 
 bool CGameControllerPvp::OnVoteNetMessage(const CNetMsg_Cl_Vote *pMsg, int ClientId)
@@ -1017,6 +1022,7 @@ void CGameControllerPvp::CheckForceUnpauseGame()
 void CGameControllerPvp::Tick()
 {
 	CGameControllerDDRace::Tick();
+	m_pSqlStats->Tick();
 
 	if(m_TicksUntilShutdown)
 	{
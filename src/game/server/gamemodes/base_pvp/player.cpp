@@ -83,11 +83,13 @@ void CPlayer::InstagibTick()
 {
 	if(m_StatsQueryResult != nullptr && m_StatsQueryResult->m_Completed)
 	{
+		CSqlResultsProfileScope ProfilerScope(Server());
 		ProcessStatsResult(*m_StatsQueryResult);
 		m_StatsQueryResult = nullptr;
 	}
 	if(m_FastcapQueryResult != nullptr && m_FastcapQueryResult->m_Completed)
 	{
+		CSqlResultsProfileScope ProfilerScope(Server());
 		ProcessStatsResult(*m_FastcapQueryResult);
 		m_FastcapQueryResult = nullptr;
 	}
@@ -29,15 +29,6 @@ public:
 
 	const char *InsertColumns() override { return SelectColumns(); }
 
-	const char *UpdateColumns() override
-	{
-		return
-#define MACRO_ADD_COLUMN(name, sql_name, sql_type, bind_type, default, merge_method) ", " sql_name " = ? "
-#include "sql_columns.h"
-#undef MACRO_ADD_COLUMN
-			;
-	}
-
 	const char *InsertValues() override
 	{
 		return
@@ -54,9 +45,12 @@ public:
 #undef MACRO_ADD_COLUMN
 	}
 
-	void UpdateBindings(int *pOffset, IDbConnection *pSqlServer, const CSqlStatsPlayer *pStats) override
+	void UpsertColumns(char *pBuf, int BufferSize, IDbConnection *pSqlServer) override
 	{
-		InsertBindings(pOffset, pSqlServer, pStats);
+#define MACRO_ADD_COLUMN(name, sql_name, sql_type, bind_type, default, merge_method) \
+	UpsertMerge##merge_method(pBuf, BufferSize, pSqlServer, sql_name);
+#include "sql_columns.h"
+#undef MACRO_ADD_COLUMN
 	}
 
 	void Dump(const CSqlStatsPlayer *pStats, const char *pSystem = "stats") const override
@@ -82,6 +76,19 @@ public:
 #include "sql_columns.h"
 #undef MACRO_ADD_COLUMN
 	}
+
+	bool MergeColumn(const char *pColumn, int Current, const CSqlStatsPlayer *pNewStats, int *pMerged) override
+	{
+#define MACRO_ADD_COLUMN(name, sql_name, sql_type, bind_type, default, merge_method) \
+	if(!str_comp(pColumn, sql_name)) \
+	{ \
+		*pMerged = Merge##bind_type##merge_method(Current, pNewStats->m_##name); \
+		return true; \
+	}
+#include "sql_columns.h"
+#undef MACRO_ADD_COLUMN
+		return false;
+	}
 };
 
 class CGameControllerGCTF : public CGameControllerInstaBaseCTF
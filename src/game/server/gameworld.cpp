@@ -20,19 +20,17 @@ CGameWorld::CGameWorld()
 	m_pGameServer = 0x0;
 	m_pConfig = 0x0;
 	m_pServer = 0x0;
+	m_pSharedSnapshot = nullptr;
 
 	m_Paused = false;
 	m_ResetRequested = false;
-	for(auto &pFirstEntityType : m_apFirstEntityTypes)
-		pFirstEntityType = 0;
 }
 
 CGameWorld::~CGameWorld()
 {
 	// delete all entities
-	for(auto &pFirstEntityType : m_apFirstEntityTypes)
-		while(pFirstEntityType)
-			delete pFirstEntityType; // NOLINT(clang-analyzer-cplusplus.NewDelete)
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		m_aEntities[i].ForEach([](CEntity *pEnt) { delete pEnt; });
 }
 
 void CGameWorld::SetGameServer(CGameContext *pGameServer)
@@ -44,7 +42,35 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 
 CEntity *CGameWorld::FindFirst(int Type)
 {
-	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
+	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_aEntities[Type].First();
+}
+
+// calls Fn for all characters that might be in the box, in the order of
+// the character list, until Fn returns false
+template<typename F>
+void CGameWorld::ForEachCharacterInBox(vec2 Min, vec2 Max, F &&Fn)
+{
+	if(!Config()->m_SvSpatialGrid || !m_CharacterGrid.Initialized())
+	{
+		for(CEntity *pEnt = FindFirst(ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+		{
+			if(!Fn((CCharacter *)pEnt))
+				return;
+		}
+		return;
+	}
+
+#ifdef CONF_DEBUG
+	for(CEntity *pEnt = FindFirst(ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+		dbg_assert(m_CharacterGrid.InCell(pEnt, pEnt->m_Pos), "character moved without calling OnEntityMoved");
+#endif
+
+	m_CharacterGrid.Query(Min, Max, m_vpGridQuery);
+	for(CEntity *pEnt : m_vpGridQuery)
+	{
+		if(!Fn((CCharacter *)pEnt))
+			return;
+	}
 }
 
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
@@ -53,16 +79,28 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	auto Check = [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
+		return true;
+	};
+
+	if(Type == ENTTYPE_CHARACTER)
+	{
+		ForEachCharacterInBox(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), Check);
+		return Num;
+	}
+
+	for(CEntity *pEnt = FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+	{
+		if(!Check(pEnt))
+			break;
 	}
 
 	return Num;
@@ -70,93 +108,88 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 
 void CGameWorld::InsertEntity(CEntity *pEnt)
 {
-#ifdef CONF_DEBUG
-	for(CEntity *pCur = m_apFirstEntityTypes[pEnt->m_ObjType]; pCur; pCur = pCur->m_pNextTypeEntity)
-		dbg_assert(pCur != pEnt, "err");
-#endif
+	m_aEntities[pEnt->m_ObjType].Insert(pEnt);
 
-	// insert it
-	if(m_apFirstEntityTypes[pEnt->m_ObjType])
-		m_apFirstEntityTypes[pEnt->m_ObjType]->m_pPrevTypeEntity = pEnt;
-	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
-	pEnt->m_pPrevTypeEntity = 0x0;
-	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
+	{
+		if(!m_CharacterGrid.Initialized())
+			m_CharacterGrid.Init(GameServer()->Collision()->GetWidth() * 32.0f, GameServer()->Collision()->GetHeight() * 32.0f, GRID_CELL_SIZE);
+		m_CharacterGrid.Insert(pEnt, pEnt->m_Pos, pEnt->m_ProximityRadius, m_NextGridSeq++);
+	}
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
-	// not in the list
-	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
-		return;
-
-	// remove
-	if(pEnt->m_pPrevTypeEntity)
-		pEnt->m_pPrevTypeEntity->m_pNextTypeEntity = pEnt->m_pNextTypeEntity;
-	else
-		m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt->m_pNextTypeEntity;
-	if(pEnt->m_pNextTypeEntity)
-		pEnt->m_pNextTypeEntity->m_pPrevTypeEntity = pEnt->m_pPrevTypeEntity;
-
-	// keep list traversing valid
-	if(m_pNextTraverseEntity == pEnt)
-		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+	m_CharacterGrid.Remove(pEnt);
+	m_aEntities[pEnt->m_ObjType].Remove(pEnt);
+}
 
-	pEnt->m_pNextTypeEntity = 0;
-	pEnt->m_pPrevTypeEntity = 0;
+void CGameWorld::OnEntityMoved(CEntity *pEnt)
+{
+	m_CharacterGrid.Move(pEnt, pEnt->m_Pos);
 }
 
 //
 void CGameWorld::Snap(int SnappingClient)
 {
-	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
-	{
-		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-		pEnt->Snap(SnappingClient);
-		pEnt = m_pNextTraverseEntity;
-	}
+	// the snapshots of several clients can be built at the same time,
+	// so only use walks that do not modify the world
+	auto SnapEntity = [this, SnappingClient](CEntity *pEnt) {
+		if(pEnt->m_SnappedShared)
+			m_pSharedSnapshot->Snap(GameServer(), SnappingClient, pEnt->m_SharedItemsBegin, pEnt->m_SharedItemsEnd);
+		else
+			pEnt->Snap(SnappingClient);
+	};
+
+	m_aEntities[ENTTYPE_CHARACTER].ForEachConst(SnapEntity);
 
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 	{
 		if(i == ENTTYPE_CHARACTER)
 			continue;
 
-		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
-		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
-			pEnt = m_pNextTraverseEntity;
-		}
+		m_aEntities[i].ForEachConst(SnapEntity);
 	}
 }
 
-void CGameWorld::PostSnap()
+void CGameWorld::PreSnap()
 {
-	for(auto *pEnt : m_apFirstEntityTypes)
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		m_aEntities[i].ForEach([](CEntity *pEnt) { pEnt->PreSnap(); });
+}
+
+void CGameWorld::SnapShared(CSharedSnapshot *pSharedSnapshot)
+{
+	m_pSharedSnapshot = pSharedSnapshot;
+	for(int i = 0; i < NUM_ENTTYPES; i++)
 	{
-		for(; pEnt;)
-		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->PostSnap();
-			pEnt = m_pNextTraverseEntity;
-		}
+		m_aEntities[i].ForEach([pSharedSnapshot](CEntity *pEnt) {
+			pEnt->m_SharedItemsBegin = pSharedSnapshot->NumItems();
+			pEnt->m_SnappedShared = pEnt->SnapShared(pSharedSnapshot);
+			pEnt->m_SharedItemsEnd = pSharedSnapshot->NumItems();
+		});
 	}
 }
 
+void CGameWorld::PostSnap()
+{
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		m_aEntities[i].ForEach([](CEntity *pEnt) { pEnt->PostSnap(); });
+}
+
 void CGameWorld::Reset()
 {
 	// reset all entities
-	for(auto *pEnt : m_apFirstEntityTypes)
-		for(; pEnt;)
-		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Reset();
-			pEnt = m_pNextTraverseEntity;
-		}
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		m_aEntities[i].ForEach([](CEntity *pEnt) { pEnt->Reset(); });
 	RemoveEntities();
 
 	GameServer()->m_pController->OnReset();
 	RemoveEntities();
 
+	// all round entities are gone, let the pools hand out blocks in order again
+	CFreeListPool::ResetAll();
+
 	m_ResetRequested = false;
 
 	GameServer()->CreateAllEntities(false);
@@ -169,11 +202,9 @@ void CGameWorld::RemoveEntitiesFromPlayer(int PlayerId)
 
 void CGameWorld::RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers)
 {
-	for(auto *pEnt : m_apFirstEntityTypes)
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
 	{
-		for(; pEnt;)
-		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+		m_aEntities[Type].ForEach([&](CEntity *pEnt) {
 			for(int i = 0; i < NumPlayers; i++)
 			{
 				if(pEnt->GetOwnerId() == PlayerIds[i])
@@ -183,25 +214,28 @@ void CGameWorld::RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers)
 					break;
 				}
 			}
-			pEnt = m_pNextTraverseEntity;
-		}
+		});
 	}
 }
 
 void CGameWorld::RemoveEntities()
 {
 	// destroy objects marked for destruction
-	for(auto *pEnt : m_apFirstEntityTypes)
-		for(; pEnt;)
-		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		m_aEntities[i].ForEach([this](CEntity *pEnt) {
 			if(pEnt->m_MarkedForDestroy)
 			{
 				RemoveEntity(pEnt);
 				pEnt->Destroy();
 			}
-			pEnt = m_pNextTraverseEntity;
-		}
+		});
+	}
+
+	// close the gaps, removals above and during the tick left empty slots.
+	// Lists that are being walked keep them until the next call
+	for(auto &Entities : m_aEntities)
+		Entities.Compact();
 }
 
 void CGameWorld::Tick()
@@ -220,43 +254,19 @@ void CGameWorld::Tick()
 			// It's important to call PreTick() and Tick() after each other.
 			// If we call PreTick() before, and Tick() after other entities have been processed, it causes physics changes such as a stronger shotgun or grenade.
 			if(g_Config.m_SvNoWeakHook && i == ENTTYPE_CHARACTER)
-			{
-				auto *pEnt = m_apFirstEntityTypes[i];
-				for(; pEnt;)
-				{
-					m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-					((CCharacter *)pEnt)->PreTick();
-					pEnt = m_pNextTraverseEntity;
-				}
-			}
+				m_aEntities[i].ForEach([](CEntity *pEnt) { ((CCharacter *)pEnt)->PreTick(); });
 
-			auto *pEnt = m_apFirstEntityTypes[i];
-			for(; pEnt;)
-			{
-				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-				pEnt->Tick();
-				pEnt = m_pNextTraverseEntity;
-			}
+			m_aEntities[i].ForEach([](CEntity *pEnt) { pEnt->Tick(); });
 		}
 
-		for(auto *pEnt : m_apFirstEntityTypes)
-			for(; pEnt;)
-			{
-				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-				pEnt->TickDeferred();
-				pEnt = m_pNextTraverseEntity;
-			}
+		for(int i = 0; i < NUM_ENTTYPES; i++)
+			m_aEntities[i].ForEach([](CEntity *pEnt) { pEnt->TickDeferred(); });
 	}
 	else
 	{
 		// update all objects
-		for(auto *pEnt : m_apFirstEntityTypes)
-			for(; pEnt;)
-			{
-				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-				pEnt->TickPaused();
-				pEnt = m_pNextTraverseEntity;
-			}
+		for(int i = 0; i < NUM_ENTTYPES; i++)
+			m_aEntities[i].ForEach([](CEntity *pEnt) { pEnt->TickPaused(); });
 	}
 
 	RemoveEntities();
@@ -273,28 +283,23 @@ void CGameWorld::Tick()
 ESaveResult CGameWorld::BlocksSave(int ClientId)
 {
 	// check all objects
-	for(auto *pEnt : m_apFirstEntityTypes)
-		for(; pEnt;)
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		for(CEntity *pEnt = FindFirst(i); pEnt; pEnt = pEnt->TypeNext())
 		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 			ESaveResult Result = pEnt->BlocksSave(ClientId);
 			if(Result != ESaveResult::SUCCESS)
 				return Result;
-			pEnt = m_pNextTraverseEntity;
 		}
+	}
 	return ESaveResult::SUCCESS;
 }
 
 void CGameWorld::SwapClients(int Client1, int Client2)
 {
 	// update all objects
-	for(auto *pEnt : m_apFirstEntityTypes)
-		for(; pEnt;)
-		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->SwapClients(Client1, Client2);
-			pEnt = m_pNextTraverseEntity;
-		}
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		m_aEntities[i].ForEach([Client1, Client2](CEntity *pEnt) { pEnt->SwapClients(Client1, Client2); });
 }
 
 // TODO: should be more general
@@ -304,17 +309,15 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	ForEachCharacterInBox(vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius), [&](CCharacter *p) {
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && p != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !p->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, p->m_Pos, IntersectPos))
@@ -331,7 +334,8 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -342,11 +346,9 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	GameServer()->m_World.ForEachCharacterInBox(Pos - vec2(Radius, Radius), Pos + vec2(Radius, Radius), [&](CCharacter *p) {
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		float Len = distance(Pos, p->m_Pos);
 		if(Len < p->m_ProximityRadius + Radius)
@@ -357,7 +359,8 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 				pClosest = p;
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -365,11 +368,9 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	ForEachCharacterInBox(vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Radius, Radius), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Radius, Radius), [&](CCharacter *pChr) {
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -380,7 +381,8 @@ std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1
 				vpCharacters.push_back(pChr);
 			}
 		}
-	}
+		return true;
+	});
 	return vpCharacters;
 }
 
@@ -5,12 +5,15 @@
 
 #include <game/gamecore.h>
 
+#include "entity_list.h"
 #include "save.h"
+#include "spatial_grid.h"
 
 #include <vector>
 
 class CEntity;
 class CCharacter;
+class CSharedSnapshot;
 
 /*
 	Class: Game World
@@ -34,13 +37,28 @@ private:
 	void Reset();
 	void RemoveEntities();
 
-	CEntity *m_pNextTraverseEntity = nullptr;
-	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
+	// removed entities leave an empty slot behind until RemoveEntities compacts the lists
+	CEntityList<CEntity> m_aEntities[NUM_ENTTYPES];
+
+	// characters bucketed by position, kept in the order of the character list
+	enum
+	{
+		GRID_CELL_SIZE = 8 * 32,
+	};
+	CSpatialGrid<CEntity> m_CharacterGrid;
+	uint64_t m_NextGridSeq = 0;
+	std::vector<CEntity *> m_vpGridQuery;
+
+	template<typename F>
+	void ForEachCharacterInBox(vec2 Min, vec2 Max, F &&Fn);
 
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
 
+	// filled by SnapShared in the current snapshot tick
+	const CSharedSnapshot *m_pSharedSnapshot;
+
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
 	class CConfig *Config() { return m_pConfig; }
@@ -57,6 +75,21 @@ public:
 
 	CEntity *FindFirst(int Type);
 
+	/*
+		Function: NextEntity
+			Finds the entity that comes after a slot when walking
+			the entities of a type, newest first.
+
+		Arguments:
+			Type - Type of the entities.
+			Slot - Slot of the current entity, -1 if it is not in the world.
+
+		Returns:
+			The next entity or NULL if there is none.
+	*/
+	CEntity *NextEntity(int Type, int Slot) const { return m_aEntities[Type].Next(Slot); }
+	CEntity *PrevEntity(int Type, int Slot) const { return m_aEntities[Type].Prev(Slot); }
+
 	/*
 		Function: FindEntities
 			Finds entities close to a position and returns them in a list.
@@ -121,6 +154,16 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: OnEntityMoved
+			Has to be called after the position of a character
+			in the world was changed.
+
+		Arguments:
+			pEntity - Entity that moved
+	*/
+	void OnEntityMoved(CEntity *pEntity);
+
 	void RemoveEntitiesFromPlayer(int PlayerId);
 	void RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers);
 
@@ -135,6 +178,26 @@ public:
 	*/
 	void Snap(int SnappingClient);
 
+	/*
+		Function: PreSnap
+			Calls PreSnap on all the entities in the world once
+			per snapshot tick.
+	*/
+	void PreSnap();
+
+	/*
+		Function: SnapShared
+			Calls SnapShared on all the entities in the world once
+			per snapshot tick. Snap copies the shared items of an
+			entity instead of calling its Snap, so the items keep
+			their place in the snapshot.
+
+		Arguments:
+			pSharedSnapshot - Item arena copied into the
+				snapshot of every client.
+	*/
+	void SnapShared(CSharedSnapshot *pSharedSnapshot);
+
 	/*
 		Function: PostSnap
 			Called after all clients received their snapshot.
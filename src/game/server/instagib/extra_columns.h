@@ -1,6 +1,7 @@
 #ifndef GAME_SERVER_INSTAGIB_EXTRA_COLUMNS_H
 #define GAME_SERVER_INSTAGIB_EXTRA_COLUMNS_H
 
+#include <base/system.h>
 #include <engine/server/databases/connection.h>
 
 class CExtraColumns
@@ -37,15 +38,25 @@ public:
 	virtual const char *InsertColumns() = 0;
 
 	/*
-		UpdateColumns
+		UpsertColumns
 
-		Should return a SQL string that will be used within a UPDATE statement
-		only the first part that lists the column assignments and their placeholders
-		that will be set
+		Arguments:
+			pBuf - buffer with the assignments of the base columns, the extra ones are appended
+			BufferSize - size of pBuf
+			pSqlServer - IDbConnection that will run the statement
+
+		Should append the column assignments that merge the inserted values into an
+		existing row, used after IDbConnection::OnConflictUpdate.
+		They have to merge the same way as MergeStats.
+
+		Example: ", kills = kills + excluded.kills, spree = CASE WHEN ..."
 
-		Example: "name = ?, kills = ?, deaths = ?"
+		Use the upsert helpers that match the merge helpers:
+
+		UpsertMergeAdd(pBuf, BufferSize, pSqlServer, "kills");
+		UpsertMergeHighest(pBuf, BufferSize, pSqlServer, "spree");
 	*/
-	virtual const char *UpdateColumns() = 0;
+	virtual void UpsertColumns(char *pBuf, int BufferSize, IDbConnection *pSqlServer) = 0;
 
 	/*
 		InsertValues
@@ -73,22 +84,6 @@ public:
 	*/
 	virtual void InsertBindings(int *pOffset, IDbConnection *pSqlServer, const class CSqlStatsPlayer *pStats) = 0;
 
-	/*
-		UpdateBindings
-
-		Arguments:
-			pOffset - Starting offset to bind the first parameter to. Its value to be increment for every value you bind.
-			pSqlServer - IDbConnection that should be used for binding
-
-		Callback that binds the placeholders set in UpdateColumns()
-
-		Example binding code:
-
-		pSqlServer->BindInt((*pOffset)++, pStats->m_Kills);
-		pSqlServer->BindInt((*pOffset)++, pStats->m_Deaths);
-	*/
-	virtual void UpdateBindings(int *pOffset, IDbConnection *pSqlServer, const class CSqlStatsPlayer *pStats) = 0;
-
 	/*
 		Dump
 
@@ -147,6 +142,22 @@ public:
 	*/
 	virtual void ReadAndMergeStats(int *pOffset, IDbConnection *pSqlServer, class CSqlStatsPlayer *pOutputStats, const class CSqlStatsPlayer *pNewStats) = 0;
 
+	/*
+		MergeColumn
+
+		Arguments:
+			pColumn - sql name of the column
+			Current - value of the column before the round
+			pNewStats - stats object with the stats from the current round
+			pMerged - the merged value is written here
+
+		Callback that merges a single extra column the same way as MergeStats
+		used to keep the leaderboards up to date
+
+		Returns false if pColumn is not one of the extra columns
+	*/
+	virtual bool MergeColumn(const char *pColumn, int Current, const class CSqlStatsPlayer *pNewStats, int *pMerged) = 0;
+
 	int MergeIntAdd(int Current, int Other)
 	{
 		return Current + Other;
@@ -179,6 +190,35 @@ public:
 			return Current;
 		return Other;
 	}
+
+	static void UpsertMergeAdd(char *pBuf, int BufferSize, IDbConnection *pSqlServer, const char *pColumn)
+	{
+		char aInserted[128];
+		pSqlServer->InsertedValue(pColumn, aInserted, sizeof(aInserted));
+		char aAssignment[512];
+		str_format(aAssignment, sizeof(aAssignment), "%s%s = %s + %s", pBuf[0] ? ", " : "", pColumn, pColumn, aInserted);
+		str_append(pBuf, aAssignment, BufferSize);
+	}
+
+	static void UpsertMergeHighest(char *pBuf, int BufferSize, IDbConnection *pSqlServer, const char *pColumn)
+	{
+		char aInserted[128];
+		pSqlServer->InsertedValue(pColumn, aInserted, sizeof(aInserted));
+		char aAssignment[512];
+		str_format(aAssignment, sizeof(aAssignment), "%s%s = CASE WHEN %s > %s THEN %s ELSE %s END",
+			pBuf[0] ? ", " : "", pColumn, aInserted, pColumn, aInserted, pColumn);
+		str_append(pBuf, aAssignment, BufferSize);
+	}
+
+	static void UpsertMergeLowest(char *pBuf, int BufferSize, IDbConnection *pSqlServer, const char *pColumn)
+	{
+		char aInserted[128];
+		pSqlServer->InsertedValue(pColumn, aInserted, sizeof(aInserted));
+		char aAssignment[512];
+		str_format(aAssignment, sizeof(aAssignment), "%s%s = CASE WHEN %s < %s THEN %s ELSE %s END",
+			pBuf[0] ? ", " : "", pColumn, aInserted, pColumn, aInserted, pColumn);
+		str_append(pBuf, aAssignment, BufferSize);
+	}
 };
 
 #endif
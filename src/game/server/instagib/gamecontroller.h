@@ -399,6 +399,8 @@ public:
 			Called for every player on round end once
 			the base_pvp controller implements stats saving
 			you probably do not need to extend this.
+			The stats of all players are written together
+			after the last call.
 			If a player leaves before round end the method
 			SaveStatsOnDisconnect() will be called.
 
@@ -2,6 +2,10 @@
 #include "laser_text.h"
 #include <game/generated/protocol.h>
 #include <game/server/gamecontext.h>
+#include <game/server/shared_snapshot.h>
+
+MACRO_ALLOC_FREELIST_IMPL(CLaserChar)
+MACRO_ALLOC_FREELIST_IMPL(CLaserText)
 
 static const bool asciiTable[256][5][3] = {
 	{{false, false, false}, {false, false, false}, {false, false, false}, {false, false, false}, {false, false, false}}, // ascii 0
@@ -507,3 +511,27 @@ void CLaserText::Snap(int SnappingClient)
 		pObj->m_StartTick = Server()->Tick();
 	}
 }
+
+bool CLaserText::SnapShared(CSharedSnapshot *pSharedSnapshot)
+{
+	if(!pSharedSnapshot->HasSpace(m_CharNum, m_CharNum * sizeof(CNetObj_Laser)))
+		return false;
+
+	CSharedSnapshot::CView View;
+	View.m_pClipEntity = this;
+	View.AddClipPosition(m_Pos);
+
+	for(int i = 0; i < m_CharNum; ++i)
+	{
+		CNetObj_Laser *pObj = pSharedSnapshot->NewItem<CNetObj_Laser>(m_ppChars[i]->GetId(), View);
+		if(!pObj)
+			break;
+
+		pObj->m_X = m_ppChars[i]->m_Pos.x;
+		pObj->m_Y = m_ppChars[i]->m_Pos.y;
+		pObj->m_FromX = m_ppChars[i]->m_FromPos.x;
+		pObj->m_FromY = m_ppChars[i]->m_FromPos.y;
+		pObj->m_StartTick = Server()->Tick();
+	}
+	return true;
+}
@@ -8,6 +8,8 @@
 
 class CLaserChar : public CEntity
 {
+	MACRO_ALLOC_FREELIST()
+
 public:
 	CLaserChar(CGameWorld *pGameWorld) :
 		CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER) {}
@@ -16,6 +18,8 @@ public:
 
 class CLaserText : public CEntity
 {
+	MACRO_ALLOC_FREELIST()
+
 public:
 	CLaserText(CGameWorld *pGameWorld, vec2 Pos, int AliveTicks, const char *pText);
 	CLaserText(CGameWorld *pGameWorld, vec2 Pos, int AliveTicks, const char *pText, float CharPointOffset, float CharOffsetFactor);
@@ -25,6 +29,7 @@ public:
 	void Tick() override;
 	void TickPaused() override;
 	void Snap(int SnappingClient) override;
+	bool SnapShared(CSharedSnapshot *pSharedSnapshot) override;
 
 private:
 	float m_PosOffsetCharPoints;
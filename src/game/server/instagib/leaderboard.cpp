@@ -0,0 +1,166 @@
+#include "leaderboard.h"
+
+#include <base/system.h>
+
+CLeaderboard::CLeaderboard(bool Descending) :
+	m_Descending(Descending)
+{
+}
+
+bool CLeaderboard::Before(const CNode &Node, const CNode &Other) const
+{
+	if(Node.m_Score != Other.m_Score)
+		return Better(Node.m_Score, Other.m_Score);
+	return str_comp(Node.m_Name.c_str(), Other.m_Name.c_str()) < 0;
+}
+
+void CLeaderboard::Update(int Node)
+{
+	CNode &Cur = m_vNodes[Node];
+	Cur.m_Size = 1 + Size(Cur.m_Left) + Size(Cur.m_Right);
+}
+
+void CLeaderboard::Split(int Node, int Key, int *pLeft, int *pRight)
+{
+	if(Node < 0)
+	{
+		*pLeft = -1;
+		*pRight = -1;
+		return;
+	}
+	if(Before(m_vNodes[Node], m_vNodes[Key]))
+	{
+		Split(m_vNodes[Node].m_Right, Key, &m_vNodes[Node].m_Right, pRight);
+		*pLeft = Node;
+	}
+	else
+	{
+		Split(m_vNodes[Node].m_Left, Key, pLeft, &m_vNodes[Node].m_Left);
+		*pRight = Node;
+	}
+	Update(Node);
+}
+
+int CLeaderboard::Merge(int Left, int Right)
+{
+	if(Left < 0)
+		return Right;
+	if(Right < 0)
+		return Left;
+	if(m_vNodes[Left].m_Priority > m_vNodes[Right].m_Priority)
+	{
+		m_vNodes[Left].m_Right = Merge(m_vNodes[Left].m_Right, Right);
+		Update(Left);
+		return Left;
+	}
+	m_vNodes[Right].m_Left = Merge(Left, m_vNodes[Right].m_Left);
+	Update(Right);
+	return Right;
+}
+
+int CLeaderboard::Erase(int Node, int Key)
+{
+	if(Node == Key)
+		return Merge(m_vNodes[Node].m_Left, m_vNodes[Node].m_Right);
+	if(Before(m_vNodes[Key], m_vNodes[Node]))
+		m_vNodes[Node].m_Left = Erase(m_vNodes[Node].m_Left, Key);
+	else
+		m_vNodes[Node].m_Right = Erase(m_vNodes[Node].m_Right, Key);
+	Update(Node);
+	return Node;
+}
+
+uint32_t CLeaderboard::NextPriority()
+{
+	// xorshift, the treap only needs the priorities to be unrelated to the order
+	m_Seed ^= m_Seed << 13;
+	m_Seed ^= m_Seed >> 17;
+	m_Seed ^= m_Seed << 5;
+	return m_Seed;
+}
+
+void CLeaderboard::Set(const char *pName, int Score)
+{
+	int Node;
+	auto It = m_NameToNode.find(pName);
+	if(It != m_NameToNode.end())
+	{
+		Node = It->second;
+		if(m_vNodes[Node].m_Score == Score)
+			return;
+		// take it out and insert it again at the new position
+		m_Root = Erase(m_Root, Node);
+	}
+	else
+	{
+		Node = m_vNodes.size();
+		m_vNodes.push_back(CNode{pName, 0, NextPriority(), 1, -1, -1});
+		m_NameToNode.emplace(pName, Node);
+	}
+
+	CNode &New = m_vNodes[Node];
+	New.m_Score = Score;
+	New.m_Left = -1;
+	New.m_Right = -1;
+	New.m_Size = 1;
+
+	int Left, Right;
+	Split(m_Root, Node, &Left, &Right);
+	m_Root = Merge(Merge(Left, Node), Right);
+}
+
+bool CLeaderboard::Get(const char *pName, int *pScore) const
+{
+	auto It = m_NameToNode.find(pName);
+	if(It == m_NameToNode.end())
+		return false;
+	*pScore = m_vNodes[It->second].m_Score;
+	return true;
+}
+
+int CLeaderboard::Rank(int Score) const
+{
+	int NumBetter = 0;
+	int Node = m_Root;
+	while(Node >= 0)
+	{
+		const CNode &Cur = m_vNodes[Node];
+		if(Better(Cur.m_Score, Score))
+		{
+			NumBetter += Size(Cur.m_Left) + 1;
+			Node = Cur.m_Right;
+		}
+		else
+		{
+			Node = Cur.m_Left;
+		}
+	}
+	return NumBetter + 1;
+}
+
+const char *CLeaderboard::Nth(int Index, int *pScore) const
+{
+	if(Index < 0 || Index >= Size())
+		return nullptr;
+	int Node = m_Root;
+	while(Node >= 0)
+	{
+		const CNode &Cur = m_vNodes[Node];
+		const int LeftSize = Size(Cur.m_Left);
+		if(Index < LeftSize)
+		{
+			Node = Cur.m_Left;
+		}
+		else if(Index == LeftSize)
+		{
+			*pScore = Cur.m_Score;
+			return Cur.m_Name.c_str();
+		}
+		else
+		{
+			Index -= LeftSize + 1;
+			Node = Cur.m_Right;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,69 @@
+#ifndef GAME_SERVER_INSTAGIB_LEADERBOARD_H
+#define GAME_SERVER_INSTAGIB_LEADERBOARD_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Class: CLeaderboard
+		Ranks the scores of all players of one stats column in memory,
+		so /rank and /top don't have to sort the whole sql table.
+
+		The players are kept in a treap that counts the players of every
+		subtree. Looking up the rank of a score, the player at a position
+		and changing a score all take O(log n).
+
+		The order matches the sql queries of CSqlStats: better scores
+		first and equal scores sorted by name.
+*/
+class CLeaderboard
+{
+public:
+	CLeaderboard(bool Descending);
+
+	// inserts the player or replaces the score
+	void Set(const char *pName, int Score);
+	// returns false if the player is not ranked
+	bool Get(const char *pName, int *pScore) const;
+
+	// like RANK() in sql: 1 + the number of players with a better score
+	int Rank(int Score) const;
+	// name of the player at Index, starting at 0 for the best one
+	// returns nullptr if Index is out of range
+	const char *Nth(int Index, int *pScore) const;
+
+	int Size() const { return m_vNodes.size(); }
+	bool Descending() const { return m_Descending; }
+
+private:
+	struct CNode
+	{
+		std::string m_Name;
+		int m_Score;
+		uint32_t m_Priority;
+		int m_Size;
+		int m_Left;
+		int m_Right;
+	};
+
+	bool Better(int Score, int OtherScore) const { return m_Descending ? Score > OtherScore : Score < OtherScore; }
+	// sort order of the nodes
+	bool Before(const CNode &Node, const CNode &Other) const;
+	int Size(int Node) const { return Node < 0 ? 0 : m_vNodes[Node].m_Size; }
+	void Update(int Node);
+	// splits into the nodes before Key and the rest
+	void Split(int Node, int Key, int *pLeft, int *pRight);
+	int Merge(int Left, int Right);
+	int Erase(int Node, int Key);
+	uint32_t NextPriority();
+
+	bool m_Descending;
+	int m_Root = -1;
+	uint32_t m_Seed = 0x9e3779b9;
+	std::vector<CNode> m_vNodes;
+	std::unordered_map<std::string, int> m_NameToNode;
+};
+
+#endif
@@ -159,25 +159,137 @@ CSqlStats::CSqlStats(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 {
 }
 
+CSqlStats::~CSqlStats()
+{
+	FlushRoundStats();
+}
+
 void CSqlStats::SetExtraColumns(CExtraColumns *pExtraColumns)
 {
 	m_pExtraColumns = pExtraColumns;
 }
 
-CSqlInstaData::~CSqlInstaData()
+void CSqlStats::Tick()
 {
-	if(m_DebugStats > 1)
-		dbg_msg("sql-thread", "round stats request destructor called");
+	if(!g_Config.m_SvLeaderboardCache)
+	{
+		// the rankings would miss all stats saved while the cache is off
+		m_vLeaderboardTables.clear();
+		return;
+	}
 
-	if(m_pExtraColumns)
+	for(auto &Table : m_vLeaderboardTables)
 	{
-		if(m_DebugStats > 1)
-			dbg_msg("sql-thread", "free memory at %p", m_pExtraColumns);
-		free(m_pExtraColumns);
-		m_pExtraColumns = nullptr;
+		if(!Table.m_pLoading)
+		{
+			if(Server()->Tick() >= Table.m_NextRefreshTick)
+				LoadLeaderboards(&Table);
+			continue;
+		}
+		if(!Table.m_pLoading->m_Completed)
+			continue;
+
+		Table.m_NextRefreshTick = Server()->Tick() + (int64_t)g_Config.m_SvLeaderboardRefresh * Server()->TickSpeed();
+		if((int)Table.m_pLoading->m_vpLeaderboards.size() == Table.m_NumLoading)
+		{
+			for(int i = 0; i < Table.m_NumLoading; i++)
+				Table.m_vLeaderboards[i].m_pLeaderboard = std::move(Table.m_pLoading->m_vpLeaderboards[i]);
+			for(const auto &[Name, Stats] : Table.m_vPendingStats)
+				UpdateLeaderboards(&Table, Name.c_str(), &Stats);
+			// columns that were requested while the load was running
+			if(Table.m_NumLoading < (int)Table.m_vLeaderboards.size())
+				Table.m_NextRefreshTick = 0;
+		}
+		else
+		{
+			dbg_msg("sql", "failed to load the leaderboards of table %s", Table.m_aTable);
+		}
+		Table.m_pLoading = nullptr;
+		Table.m_NumLoading = 0;
+		Table.m_vPendingStats.clear();
 	}
 }
 
+const CLeaderboard *CSqlStats::CachedLeaderboard(const char *pTable, const char *pColumn, bool Descending)
+{
+	if(!g_Config.m_SvLeaderboardCache || pTable[0] == '\0')
+		return nullptr;
+
+	CCachedTable *pCachedTable = nullptr;
+	for(auto &Table : m_vLeaderboardTables)
+	{
+		if(str_comp(Table.m_aTable, pTable))
+			continue;
+		pCachedTable = &Table;
+		for(const auto &Entry : Table.m_vLeaderboards)
+			if(Entry.m_Descending == Descending && !str_comp(Entry.m_aColumn, pColumn))
+				return Entry.m_pLeaderboard.get();
+	}
+
+	// columns that can not be merged in memory would get out of date
+	CSqlStatsPlayer Empty;
+	Empty.Reset();
+	int Merged;
+	if(!MergeColumn(pColumn, 0, &Empty, &Merged))
+		return nullptr;
+
+	if(!pCachedTable)
+	{
+		pCachedTable = &m_vLeaderboardTables.emplace_back();
+		str_copy(pCachedTable->m_aTable, pTable);
+	}
+
+	// the next tick loads all columns that were registered until then in one query
+	CCachedLeaderboard &Entry = pCachedTable->m_vLeaderboards.emplace_back();
+	str_copy(Entry.m_aColumn, pColumn);
+	Entry.m_Descending = Descending;
+	if(!pCachedTable->m_pLoading)
+		pCachedTable->m_NextRefreshTick = 0;
+	return nullptr;
+}
+
+void CSqlStats::LoadLeaderboards(CCachedTable *pTable)
+{
+	// the load is queued behind the round stats that were saved so far
+	// everything saved from now on is collected in m_vPendingStats
+	FlushRoundStats();
+
+	pTable->m_pLoading = std::make_shared<CLeaderboardResult>();
+	pTable->m_NumLoading = pTable->m_vLeaderboards.size();
+	pTable->m_vPendingStats.clear();
+
+	auto Tmp = std::make_unique<CSqlLoadLeaderboardRequest>(pTable->m_pLoading);
+	str_copy(Tmp->m_aTable, pTable->m_aTable);
+	for(const auto &Entry : pTable->m_vLeaderboards)
+	{
+		CLeaderboardColumn &Column = Tmp->m_vColumns.emplace_back();
+		str_copy(Column.m_aColumn, Entry.m_aColumn);
+		Column.m_Descending = Entry.m_Descending;
+	}
+	m_pPool->ExecuteWrite(CSqlStatsWorker::LoadLeaderboard, std::move(Tmp), "load leaderboards");
+}
+
+void CSqlStats::UpdateLeaderboards(CCachedTable *pTable, const char *pName, const CSqlStatsPlayer *pStats)
+{
+	for(auto &Entry : pTable->m_vLeaderboards)
+	{
+		if(!Entry.m_pLeaderboard)
+			continue;
+		int Current = 0;
+		Entry.m_pLeaderboard->Get(pName, &Current);
+		int Merged;
+		if(MergeColumn(Entry.m_aColumn, Current, pStats, &Merged))
+			Entry.m_pLeaderboard->Set(pName, Merged);
+	}
+}
+
+bool CSqlStats::MergeColumn(const char *pColumn, int Current, const CSqlStatsPlayer *pStats, int *pMerged)
+{
+	if(pStats->MergeColumn(pColumn, Current, pMerged))
+		return true;
+	return m_pExtraColumns && m_pExtraColumns->MergeColumn(pColumn, Current, pStats, pMerged);
+}
+
 void CSqlStats::LoadInstaPlayerData(int ClientId, const char *pTable)
 {
 	const char *pName = Server()->ClientName(ClientId);
@@ -201,6 +313,35 @@ void CSqlStats::ShowRank(
 {
 	if(RateLimitPlayer(ClientId))
 		return;
+
+	const CLeaderboard *pLeaderboard = CachedLeaderboard(pTable, pRankColumnSql, str_comp_nocase(pOrderBy, "ASC") != 0);
+	if(pLeaderboard)
+	{
+		auto pResult = NewInstaSqlResult(ClientId);
+		if(pResult == nullptr)
+			return;
+
+		// same messages as ShowRankWorker
+		int Score;
+		if(pLeaderboard->Get(pName, &Score))
+		{
+			pResult->m_MessageKind = EInstaSqlRequestType::CHAT_CMD_RANK;
+			str_copy(pResult->m_Info.m_aRequestedPlayer, pName, sizeof(pResult->m_Info.m_aRequestedPlayer));
+			str_copy(pResult->m_aRankColumnDisplay, pRankColumnDisplay, sizeof(pResult->m_aRankColumnDisplay));
+			pResult->m_RankedScore = Score;
+			pResult->m_Rank = pLeaderboard->Rank(Score);
+		}
+		else
+		{
+			str_format(pResult->m_aaMessages[0], sizeof(pResult->m_aaMessages[0]),
+				"'%s' is unranked",
+				pName);
+		}
+		pResult->m_Success = true;
+		pResult->m_Completed = true;
+		return;
+	}
+
 	ExecPlayerRankOrTopThread(
 		ShowRankWorker,
 		"show rank",
@@ -224,6 +365,36 @@ void CSqlStats::ShowTop(
 {
 	if(RateLimitPlayer(ClientId))
 		return;
+
+	// ShowTopWorker always sorts descending
+	const CLeaderboard *pLeaderboard = CachedLeaderboard(pTable, pRankColumnSql, true);
+	if(pLeaderboard)
+	{
+		auto pResult = NewInstaSqlResult(ClientId);
+		if(pResult == nullptr)
+			return;
+
+		// same messages as ShowTopWorker
+		auto *paMessages = pResult->m_aaMessages;
+		int LimitStart = maximum(Offset - 1, 0);
+		str_format(paMessages[0], sizeof(paMessages[0]), "-------- Top %s --------", pRankColumnDisplay);
+		int Line = 1;
+		for(int i = LimitStart; i < LimitStart + 5; i++)
+		{
+			int Score;
+			const char *pRankedName = pLeaderboard->Nth(i, &Score);
+			if(!pRankedName)
+				break;
+			str_format(paMessages[Line], sizeof(paMessages[Line]),
+				"%d. '%s' - %s: %d", pLeaderboard->Rank(Score), pRankedName, pRankColumnDisplay, Score);
+			Line++;
+		}
+		str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+		pResult->m_Success = true;
+		pResult->m_Completed = true;
+		return;
+	}
+
 	ExecPlayerRankOrTopThread(
 		ShowTopWorker,
 		"show top",
@@ -284,20 +455,25 @@ void CSqlStats::ShowFastcapTop(
 
 void CSqlStats::SaveRoundStats(const char *pName, const char *pTable, CSqlStatsPlayer *pStats)
 {
-	auto Tmp = std::make_unique<CSqlSaveRoundStatsData>(g_Config.m_SvDebugStats);
+	if(auto pFull = m_RoundStats.Add(pName, pTable, pStats, m_pExtraColumns, g_Config.m_SvDebugStats))
+		m_pPool->ExecuteWrite(CSqlStatsWorker::SaveRoundStats, std::move(pFull), "save round stats");
 
-	if(m_pExtraColumns)
+	for(auto &Table : m_vLeaderboardTables)
 	{
-		Tmp->m_pExtraColumns = (CExtraColumns *)malloc(sizeof(CExtraColumns));
-		mem_copy(Tmp->m_pExtraColumns, m_pExtraColumns, sizeof(CExtraColumns));
-		if(g_Config.m_SvDebugStats > 1)
-			dbg_msg("sql", "allocated memory at %p", Tmp->m_pExtraColumns);
+		if(str_comp(Table.m_aTable, pTable))
+			continue;
+		UpdateLeaderboards(&Table, pName, pStats);
+		if(Table.m_pLoading)
+			Table.m_vPendingStats.emplace_back(pName, *pStats);
 	}
+}
 
-	str_copy(Tmp->m_aName, pName);
-	str_copy(Tmp->m_aTable, pTable);
-	mem_copy(&Tmp->m_Stats, pStats, sizeof(Tmp->m_Stats));
-	m_pPool->ExecuteWrite(SaveRoundStatsThread, std::move(Tmp), "save round stats");
+void CSqlStats::FlushRoundStats()
+{
+	auto pRoundStats = m_RoundStats.Take();
+	if(!pRoundStats)
+		return;
+	m_pPool->ExecuteWrite(CSqlStatsWorker::SaveRoundStats, std::move(pRoundStats), "save round stats");
 }
 
 void CSqlStats::SaveFastcap(int ClientId, int TimeTicks, const char *pTimestamp, bool Grenade, bool StatTrack)
@@ -766,203 +942,6 @@ bool CSqlStats::SaveFastcapWorker(IDbConnection *pSqlServer, const ISqlData *pGa
 	return pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize);
 }
 
-bool CSqlStats::SaveRoundStatsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
-{
-	if(w != Write::NORMAL)
-		return false;
-
-	const CSqlSaveRoundStatsData *pData = dynamic_cast<const CSqlSaveRoundStatsData *>(pGameData);
-	if(pData->m_DebugStats > 1)
-	{
-		dbg_msg("sql-thread", "writing stats of player '%s'", pData->m_aName);
-		dbg_msg("sql-thread", "extra columns %p", pData->m_pExtraColumns);
-	}
-
-	char aBuf[4096];
-	str_format(
-		aBuf,
-		sizeof(aBuf),
-		"SELECT"
-		" name, points, kills, deaths, spree,"
-		" wins, losses, shots_fired, shots_hit %s "
-		"FROM %s "
-		"WHERE name = ?;",
-		!pData->m_pExtraColumns ? "" : pData->m_pExtraColumns->SelectColumns(),
-		pData->m_aTable);
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		dbg_msg("sql-thread", "prepare failed query: %s", aBuf);
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_aName);
-	pSqlServer->Print();
-
-	if(pData->m_DebugStats > 1)
-		dbg_msg("sql-thread", "select query: %s", aBuf);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		dbg_msg("sql-thread", "step failed");
-		return true;
-	}
-	if(End)
-	{
-		if(pData->m_DebugStats > 1)
-			dbg_msg("sql-thread", "inserting new record ...");
-		// the _backup table is not used yet
-		// because we guard the write mode at the top
-		// to avoid complexity for now
-		// but at some point we could write stats to a fallback database
-		// and then merge them later
-		str_format(
-			aBuf,
-			sizeof(aBuf),
-			"%s INTO %s%s(" // INSERT INTO
-			" name,"
-			" points, kills, deaths, spree,"
-			" wins, losses,"
-			" shots_fired, shots_hit  %s"
-			") VALUES ("
-			" ?,"
-			" ?, ?, ?, ?,"
-			" ?, ?,"
-			" ?, ? %s"
-			");",
-			pSqlServer->InsertIgnore(),
-			pData->m_aTable,
-			w == Write::NORMAL ? "" : "_backup",
-			!pData->m_pExtraColumns ? "" : pData->m_pExtraColumns->InsertColumns(),
-			!pData->m_pExtraColumns ? "" : pData->m_pExtraColumns->InsertValues());
-
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			dbg_msg("sql-thread", "prepare insert failed query=%s", aBuf);
-			return true;
-		}
-
-		if(pData->m_DebugStats > 1)
-			dbg_msg("sql-thread", "inserted query: %s", aBuf);
-
-		int Offset = 1;
-		pSqlServer->BindString(Offset++, pData->m_aName);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_Points);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_Kills);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_Deaths);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_BestSpree);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_Wins);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_Losses);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_ShotsFired);
-		pSqlServer->BindInt(Offset++, pData->m_Stats.m_ShotsHit);
-
-		if(pData->m_DebugStats > 1)
-			dbg_msg("sql-thread", "pre extra offset %d", Offset);
-
-		if(pData->m_pExtraColumns)
-			pData->m_pExtraColumns->InsertBindings(&Offset, pSqlServer, &pData->m_Stats);
-
-		if(pData->m_DebugStats > 1)
-			dbg_msg("sql-thread", "final offset %d", Offset);
-
-		pSqlServer->Print();
-
-		int NumInserted;
-		if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
-		{
-			return true;
-		}
-	}
-	else
-	{
-		if(pData->m_DebugStats > 1)
-			dbg_msg("sql-thread", "updating existing record ...");
-
-		CSqlStatsPlayer MergeStats;
-		// 1 is name that we don't really need for now
-		int Offset = 2;
-		MergeStats.m_Points = pSqlServer->GetInt(Offset++);
-		MergeStats.m_Kills = pSqlServer->GetInt(Offset++);
-		MergeStats.m_Deaths = pSqlServer->GetInt(Offset++);
-		MergeStats.m_BestSpree = pSqlServer->GetInt(Offset++);
-		MergeStats.m_Wins = pSqlServer->GetInt(Offset++);
-		MergeStats.m_Losses = pSqlServer->GetInt(Offset++);
-		MergeStats.m_ShotsFired = pSqlServer->GetInt(Offset++);
-		MergeStats.m_ShotsHit = pSqlServer->GetInt(Offset++);
-
-		if(pData->m_DebugStats > 1)
-		{
-			dbg_msg("sql-thread", "loaded stats:");
-			MergeStats.Dump(pData->m_pExtraColumns, "sql-thread");
-		}
-
-		MergeStats.Merge(&pData->m_Stats);
-		if(pData->m_pExtraColumns)
-			pData->m_pExtraColumns->ReadAndMergeStats(&Offset, pSqlServer, &MergeStats, &pData->m_Stats);
-
-		if(pData->m_DebugStats > 1)
-		{
-			dbg_msg("sql-thread", "merged stats:");
-			MergeStats.Dump(pData->m_pExtraColumns, "sql-thread");
-		}
-
-		str_format(
-			aBuf,
-			sizeof(aBuf),
-			"UPDATE %s%s "
-			"SET"
-			" points = ?, kills = ?, deaths = ?, spree = ?,"
-			" wins = ?, losses = ?,"
-			" shots_fired = ?, shots_hit = ? %s"
-			"WHERE name = ?;",
-			pData->m_aTable,
-			w == Write::NORMAL ? "" : "_backup",
-			!pData->m_pExtraColumns ? "" : pData->m_pExtraColumns->UpdateColumns());
-
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			dbg_msg("sql-thread", "prepare update failed query=%s", aBuf);
-			return true;
-		}
-
-		Offset = 1;
-		pSqlServer->BindInt(Offset++, MergeStats.m_Points);
-		pSqlServer->BindInt(Offset++, MergeStats.m_Kills);
-		pSqlServer->BindInt(Offset++, MergeStats.m_Deaths);
-		pSqlServer->BindInt(Offset++, MergeStats.m_BestSpree);
-		pSqlServer->BindInt(Offset++, MergeStats.m_Wins);
-		pSqlServer->BindInt(Offset++, MergeStats.m_Losses);
-		pSqlServer->BindInt(Offset++, MergeStats.m_ShotsFired);
-		pSqlServer->BindInt(Offset++, MergeStats.m_ShotsHit);
-
-		if(pData->m_pExtraColumns)
-			pData->m_pExtraColumns->UpdateBindings(&Offset, pSqlServer, &MergeStats);
-
-		pSqlServer->BindString(Offset++, pData->m_aName);
-
-		pSqlServer->Print();
-
-		int NumUpdated;
-		if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
-		{
-			return true;
-		}
-
-		if(NumUpdated == 0 && pData->m_Stats.HasValues())
-		{
-			dbg_msg("sql-thread", "update failed no rows changed but got the following stats:");
-			pData->m_Stats.Dump(pData->m_pExtraColumns, "sql-thread");
-			return true;
-		}
-		else if(NumUpdated > 1)
-		{
-			dbg_msg("sql-thread", "affected %d rows when trying to update stats of one player!", NumUpdated);
-			dbg_assert(false, "FATAL ERROR: your database is probably corrupted! Time to restore the backup.");
-			return true;
-		}
-	}
-	return false;
-}
-
 void CSqlStats::CreateTable(const char *pName)
 {
 	auto Tmp = std::make_unique<CSqlCreateTableRequest>();
@@ -970,7 +949,13 @@ void CSqlStats::CreateTable(const char *pName)
 	Tmp->m_aColumns[0] = '\0';
 	if(m_pExtraColumns)
 		str_copy(Tmp->m_aColumns, m_pExtraColumns->CreateTable());
-	m_pPool->ExecuteWrite(CreateTableThread, std::move(Tmp), "create table");
+	// the leaderboards answer /top without sorting the table
+	Tmp->m_RankIndexes = !g_Config.m_SvLeaderboardCache;
+	m_pPool->ExecuteWrite(CSqlStatsWorker::CreateTable, std::move(Tmp), "create table");
+
+	// load the most used rankings before the first /rank and /top
+	for(const char *pColumn : {"points", "kills", "wins", "spree"})
+		CachedLeaderboard(pName, pColumn, true);
 }
 
 void CSqlStats::CreateFastcapTable()
@@ -982,56 +967,6 @@ void CSqlStats::CreateFastcapTable()
 	m_pPool->ExecuteWrite(CreateFastcapTableThread, std::move(Tmp), "create fastcap table");
 }
 
-bool CSqlStats::CreateTableThread(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
-{
-	if(w == Write::NORMAL_FAILED)
-	{
-		if(!MysqlAvailable())
-		{
-			dbg_msg("sql-thread", "failed to create table! Make sure to compile with MySQL support if you want to use stats");
-			return true;
-		}
-
-		dbg_assert(false, "CreateTableThread failed to write");
-		return true;
-	}
-	const CSqlCreateTableRequest *pData = dynamic_cast<const CSqlCreateTableRequest *>(pGameData);
-
-	// autoincrement not recommended by sqlite3
-	// also its hard to be portable accross mysql and sqlite3
-	// ddnet also uses any kind of unicode playername in the points update query
-
-	char aBuf[4096];
-	str_format(aBuf, sizeof(aBuf),
-		"CREATE TABLE IF NOT EXISTS %s%s("
-		"name        VARCHAR(%d)   COLLATE %s  NOT NULL,"
-		"first_seen  TIMESTAMP     NOT NULL DEFAULT CURRENT_TIMESTAMP, "
-		"points      INTEGER       DEFAULT 0,"
-		"kills       INTEGER       DEFAULT 0,"
-		"deaths      INTEGER       DEFAULT 0,"
-		"spree       INTEGER       DEFAULT 0,"
-		"wins        INTEGER       DEFAULT 0,"
-		"losses      INTEGER       DEFAULT 0,"
-		"shots_fired INTEGER       DEFAULT 0,"
-		"shots_hit   INTEGER       DEFAULT 0,"
-		"%s"
-		"PRIMARY KEY (name)"
-		");",
-		pData->m_aName,
-		w == Write::NORMAL ? "" : "_backup",
-		MAX_NAME_LENGTH_SQL,
-		pSqlServer->BinaryCollate(),
-		pData->m_aColumns);
-
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->Print();
-	int NumInserted;
-	return pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize);
-}
-
 bool CSqlStats::CreateFastcapTableThread(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
 {
 	if(w == Write::NORMAL_FAILED)
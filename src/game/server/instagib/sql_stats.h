@@ -4,9 +4,15 @@
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/protocol.h>
 #include <game/server/instagib/extra_columns.h>
+#include <game/server/instagib/leaderboard.h>
 #include <game/server/instagib/sql_stats_player.h>
+#include <game/server/instagib/sql_stats_worker.h>
 #include <game/server/scoreworker.h>
 
+#include <string>
+#include <utility>
+#include <vector>
+
 struct ISqlData;
 class IDbConnection;
 class IServer;
@@ -72,19 +78,6 @@ struct CInstaSqlResult : ISqlResult
 	void SetVariant(EInstaSqlRequestType RequestType);
 };
 
-struct CSqlInstaData : ISqlData
-{
-	CSqlInstaData(std::shared_ptr<ISqlResult> pResult) :
-		ISqlData(std::move(pResult))
-	{
-	}
-
-	~CSqlInstaData() override;
-
-	int m_DebugStats = 0;
-	CExtraColumns *m_pExtraColumns = nullptr;
-};
-
 // read request
 struct CSqlPlayerStatsRequest : CSqlInstaData
 {
@@ -159,30 +152,6 @@ struct CSqlPlayerFastcapRequest : CSqlInstaData
 	bool m_OnlyStatTrack = false;
 };
 
-// data to be written
-struct CSqlSaveRoundStatsData : CSqlInstaData
-{
-	CSqlSaveRoundStatsData(int DebugStats) :
-		CSqlInstaData(nullptr)
-	{
-		m_DebugStats = DebugStats;
-	}
-
-	char m_aName[128];
-	char m_aTable[128];
-	CSqlStatsPlayer m_Stats;
-};
-
-struct CSqlCreateTableRequest : ISqlData
-{
-	CSqlCreateTableRequest() :
-		ISqlData(nullptr)
-	{
-	}
-	char m_aName[128];
-	char m_aColumns[2048];
-};
-
 class CSqlStats
 {
 	CDbConnectionPool *m_pPool;
@@ -193,10 +162,50 @@ class CSqlStats
 
 	CExtraColumns *m_pExtraColumns = nullptr;
 
+	// collects the stats until FlushRoundStats()
+	CRoundStatsBatch m_RoundStats;
+
+	// in memory ranking of one column used to answer /rank and /top
+	// it is loaded from the database once and then kept up to date
+	// with the round stats saved by this server
+	struct CCachedLeaderboard
+	{
+		char m_aColumn[128];
+		bool m_Descending;
+
+		// nullptr until the first load finished
+		std::unique_ptr<CLeaderboard> m_pLeaderboard;
+	};
+
+	// the cached rankings of one table, they are all loaded by one query
+	struct CCachedTable
+	{
+		char m_aTable[128];
+		std::vector<CCachedLeaderboard> m_vLeaderboards;
+
+		// reload that is still running on the database worker
+		std::shared_ptr<CLeaderboardResult> m_pLoading;
+		// the first m_NumLoading leaderboards are part of m_pLoading
+		int m_NumLoading = 0;
+		// stats saved after m_pLoading was queued
+		// they are applied again on top of the reloaded rankings
+		std::vector<std::pair<std::string, CSqlStatsPlayer>> m_vPendingStats;
+
+		int64_t m_NextRefreshTick = 0;
+	};
+	std::vector<CCachedTable> m_vLeaderboardTables;
+
+	// returns nullptr if the ranking is not loaded yet
+	// unknown columns are registered and loaded for the next request
+	const CLeaderboard *CachedLeaderboard(const char *pTable, const char *pColumn, bool Descending);
+	void LoadLeaderboards(CCachedTable *pTable);
+	void UpdateLeaderboards(CCachedTable *pTable, const char *pName, const CSqlStatsPlayer *pStats);
+	// merges one base or extra column like the round stats upsert does
+	// returns false if the column is unknown
+	bool MergeColumn(const char *pColumn, int Current, const CSqlStatsPlayer *pStats, int *pMerged);
+
 	// non ratelimited server side queries
-	static bool CreateTableThread(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
 	static bool CreateFastcapTableThread(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
-	static bool SaveRoundStatsThread(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
 
 	// ratelimited user queries
 
@@ -245,13 +254,18 @@ class CSqlStats
 
 public:
 	CSqlStats(CGameContext *pGameServer, CDbConnectionPool *pPool);
-	~CSqlStats() = default;
+	~CSqlStats();
 
 	void SetExtraColumns(CExtraColumns *pExtraColumns);
 
+	// swaps in reloaded leaderboards and starts the periodic reloads
+	void Tick();
+
 	void CreateTable(const char *pName);
 	void CreateFastcapTable();
+	// the stats are only written on FlushRoundStats()
 	void SaveRoundStats(const char *pName, const char *pTable, CSqlStatsPlayer *pStats);
+	void FlushRoundStats();
 	void SaveFastcap(int ClientId, int TimeTicks, const char *pTimestamp, bool Grenade, bool StatTrack);
 
 	void LoadInstaPlayerData(int ClientId, const char *pTable);
@@ -144,6 +144,31 @@ public:
 		// gametype specific is implemented in the gametypes callback
 	}
 
+	// merges a single base column the same way as Merge()
+	// returns false if pColumn is not a base column
+	bool MergeColumn(const char *pColumn, int Current, int *pMerged) const
+	{
+		if(!str_comp(pColumn, "points"))
+			*pMerged = Current + m_Points;
+		else if(!str_comp(pColumn, "kills"))
+			*pMerged = Current + m_Kills;
+		else if(!str_comp(pColumn, "deaths"))
+			*pMerged = Current + m_Deaths;
+		else if(!str_comp(pColumn, "spree"))
+			*pMerged = std::max(Current, m_BestSpree);
+		else if(!str_comp(pColumn, "wins"))
+			*pMerged = Current + m_Wins;
+		else if(!str_comp(pColumn, "losses"))
+			*pMerged = Current + m_Losses;
+		else if(!str_comp(pColumn, "shots_fired"))
+			*pMerged = Current + m_ShotsFired;
+		else if(!str_comp(pColumn, "shots_hit"))
+			*pMerged = Current + m_ShotsHit;
+		else
+			return false;
+		return true;
+	}
+
 	void Dump(CExtraColumns *pExtraColumns, const char *pSystem = "stats") const
 	{
 		dbg_msg(pSystem, "  points: %d", m_Points);
@@ -0,0 +1,294 @@
+#include "sql_stats_worker.h"
+
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+
+#include <cstdlib>
+
+CSqlInstaData::~CSqlInstaData()
+{
+	if(m_DebugStats > 1)
+		dbg_msg("sql-thread", "round stats request destructor called");
+
+	if(m_pExtraColumns)
+	{
+		if(m_DebugStats > 1)
+			dbg_msg("sql-thread", "free memory at %p", m_pExtraColumns);
+		free(m_pExtraColumns);
+		m_pExtraColumns = nullptr;
+	}
+}
+
+std::unique_ptr<CSqlSaveRoundStatsData> CRoundStatsBatch::Add(const char *pName, const char *pTable, const CSqlStatsPlayer *pStats, CExtraColumns *pExtraColumns, int DebugStats)
+{
+	std::unique_ptr<CSqlSaveRoundStatsData> pFull;
+	if(m_pData && (m_pData->m_NumPlayers == MAX_CLIENTS || str_comp(m_pData->m_aTable, pTable)))
+		pFull = std::move(m_pData);
+
+	if(!m_pData)
+	{
+		m_pData = std::make_unique<CSqlSaveRoundStatsData>(DebugStats);
+		if(pExtraColumns)
+		{
+			m_pData->m_pExtraColumns = (CExtraColumns *)malloc(sizeof(CExtraColumns));
+			mem_copy(m_pData->m_pExtraColumns, pExtraColumns, sizeof(CExtraColumns));
+			if(DebugStats > 1)
+				dbg_msg("sql", "allocated memory at %p", m_pData->m_pExtraColumns);
+		}
+		str_copy(m_pData->m_aTable, pTable);
+	}
+
+	const int Index = m_pData->m_NumPlayers++;
+	str_copy(m_pData->m_aaNames[Index], pName);
+	mem_copy(&m_pData->m_aStats[Index], pStats, sizeof(m_pData->m_aStats[Index]));
+	return pFull;
+}
+
+bool CSqlStatsWorker::CreateTable(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	if(w == Write::NORMAL_FAILED)
+	{
+		if(!MysqlAvailable())
+		{
+			dbg_msg("sql-thread", "failed to create table! Make sure to compile with MySQL support if you want to use stats");
+			return true;
+		}
+
+		dbg_assert(false, "CreateTable failed to write");
+		return true;
+	}
+	const CSqlCreateTableRequest *pData = dynamic_cast<const CSqlCreateTableRequest *>(pGameData);
+
+	// autoincrement not recommended by sqlite3
+	// also its hard to be portable accross mysql and sqlite3
+	// ddnet also uses any kind of unicode playername in the points update query
+
+	char aBuf[4096];
+	str_format(aBuf, sizeof(aBuf),
+		"CREATE TABLE IF NOT EXISTS %s%s("
+		"name        VARCHAR(%d)   COLLATE %s  NOT NULL,"
+		"first_seen  TIMESTAMP     NOT NULL DEFAULT CURRENT_TIMESTAMP, "
+		"points      INTEGER       DEFAULT 0,"
+		"kills       INTEGER       DEFAULT 0,"
+		"deaths      INTEGER       DEFAULT 0,"
+		"spree       INTEGER       DEFAULT 0,"
+		"wins        INTEGER       DEFAULT 0,"
+		"losses      INTEGER       DEFAULT 0,"
+		"shots_fired INTEGER       DEFAULT 0,"
+		"shots_hit   INTEGER       DEFAULT 0,"
+		"%s"
+		"PRIMARY KEY (name)"
+		");",
+		pData->m_aName,
+		w == Write::NORMAL ? "" : "_backup",
+		MAX_NAME_LENGTH_SQL,
+		pSqlServer->BinaryCollate(),
+		pData->m_aColumns);
+
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->Print();
+	int NumInserted;
+	if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+		return true;
+	if(w != Write::NORMAL || !pData->m_RankIndexes || !pSqlServer->CreateIndexIfNotExists())
+		return false;
+
+	// name is the primary key and already has an index
+	// the rank columns are sorted by /top, but the indexes slow down the
+	// round stats upserts about three times, see sqlite_stats_bench
+	for(const char *pColumn : {"points", "kills", "wins", "spree"})
+	{
+		str_format(aBuf, sizeof(aBuf),
+			"%s %s_%s ON %s (%s);",
+			pSqlServer->CreateIndexIfNotExists(),
+			pData->m_aName,
+			pColumn,
+			pData->m_aName,
+			pColumn);
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+			return true;
+		if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+			return true;
+	}
+	return false;
+}
+
+void CSqlStatsWorker::RoundStatsUpsert(char *pBuf, int BufferSize, IDbConnection *pSqlServer, const char *pTable, CExtraColumns *pExtraColumns)
+{
+	// inserts the player or adds the stats to the existing row
+	char aAssignments[2048] = "";
+	CExtraColumns::UpsertMergeAdd(aAssignments, sizeof(aAssignments), pSqlServer, "points");
+	CExtraColumns::UpsertMergeAdd(aAssignments, sizeof(aAssignments), pSqlServer, "kills");
+	CExtraColumns::UpsertMergeAdd(aAssignments, sizeof(aAssignments), pSqlServer, "deaths");
+	CExtraColumns::UpsertMergeHighest(aAssignments, sizeof(aAssignments), pSqlServer, "spree");
+	CExtraColumns::UpsertMergeAdd(aAssignments, sizeof(aAssignments), pSqlServer, "wins");
+	CExtraColumns::UpsertMergeAdd(aAssignments, sizeof(aAssignments), pSqlServer, "losses");
+	CExtraColumns::UpsertMergeAdd(aAssignments, sizeof(aAssignments), pSqlServer, "shots_fired");
+	CExtraColumns::UpsertMergeAdd(aAssignments, sizeof(aAssignments), pSqlServer, "shots_hit");
+	if(pExtraColumns)
+		pExtraColumns->UpsertColumns(aAssignments, sizeof(aAssignments), pSqlServer);
+
+	char aOnConflict[128];
+	pSqlServer->OnConflictUpdate("name", aOnConflict, sizeof(aOnConflict));
+
+	str_format(
+		pBuf,
+		BufferSize,
+		"INSERT INTO %s("
+		" name,"
+		" points, kills, deaths, spree,"
+		" wins, losses,"
+		" shots_fired, shots_hit %s"
+		") VALUES ("
+		" ?,"
+		" ?, ?, ?, ?,"
+		" ?, ?,"
+		" ?, ? %s"
+		") %s %s;",
+		pTable,
+		!pExtraColumns ? "" : pExtraColumns->InsertColumns(),
+		!pExtraColumns ? "" : pExtraColumns->InsertValues(),
+		aOnConflict,
+		aAssignments);
+}
+
+bool CSqlStatsWorker::SaveRoundStats(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	// the _backup table is not used yet
+	// to avoid complexity for now
+	// but at some point we could write stats to a fallback database
+	// and then merge them later
+	if(w != Write::NORMAL)
+		return false;
+
+	const CSqlSaveRoundStatsData *pData = dynamic_cast<const CSqlSaveRoundStatsData *>(pGameData);
+	if(pData->m_DebugStats > 1)
+	{
+		dbg_msg("sql-thread", "writing stats of %d players", pData->m_NumPlayers);
+		dbg_msg("sql-thread", "extra columns %p", pData->m_pExtraColumns);
+	}
+
+	// the same statement is used for all players
+	char aBuf[4096];
+	RoundStatsUpsert(aBuf, sizeof(aBuf), pSqlServer, pData->m_aTable, pData->m_pExtraColumns);
+
+	if(pData->m_DebugStats > 1)
+		dbg_msg("sql-thread", "upsert query: %s", aBuf);
+
+	// one transaction instead of one commit per player
+	if(pData->m_NumPlayers > 1)
+	{
+		bool Failed = pSqlServer->BeginTransaction(pError, ErrorSize);
+		if(!Failed)
+		{
+			for(int i = 0; i < pData->m_NumPlayers && !Failed; i++)
+				Failed = SaveRoundStatsRow(pSqlServer, pData, aBuf, i, pError, ErrorSize);
+			if(!Failed)
+				Failed = pSqlServer->CommitTransaction(pError, ErrorSize);
+			if(!Failed)
+				return false;
+
+			char aRollbackError[256];
+			if(pSqlServer->RollbackTransaction(aRollbackError, sizeof(aRollbackError)))
+				dbg_msg("sql-thread", "rollback failed: %s", aRollbackError);
+		}
+		dbg_msg("sql-thread", "saving round stats in one transaction failed, saving players one by one: %s", pError);
+	}
+
+	// a broken row should not lose the stats of everyone else
+	bool Failed = false;
+	for(int i = 0; i < pData->m_NumPlayers; i++)
+	{
+		if(SaveRoundStatsRow(pSqlServer, pData, aBuf, i, pError, ErrorSize))
+		{
+			dbg_msg("sql-thread", "saving stats of player '%s' failed: %s", pData->m_aaNames[i], pError);
+			pData->m_aStats[i].Dump(pData->m_pExtraColumns, "sql-thread");
+			Failed = true;
+		}
+	}
+	return Failed;
+}
+
+bool CSqlStatsWorker::SaveRoundStatsRow(IDbConnection *pSqlServer, const CSqlSaveRoundStatsData *pData, const char *pUpsert, int Index, char *pError, int ErrorSize)
+{
+	const char *pName = pData->m_aaNames[Index];
+	const CSqlStatsPlayer *pStats = &pData->m_aStats[Index];
+	if(pData->m_DebugStats > 1)
+	{
+		dbg_msg("sql-thread", "writing stats of player '%s'", pName);
+		pStats->Dump(pData->m_pExtraColumns, "sql-thread");
+	}
+
+	if(pSqlServer->PrepareStatement(pUpsert, pError, ErrorSize))
+	{
+		dbg_msg("sql-thread", "prepare upsert failed query=%s", pUpsert);
+		return true;
+	}
+
+	int Offset = 1;
+	pSqlServer->BindString(Offset++, pName);
+	pSqlServer->BindInt(Offset++, pStats->m_Points);
+	pSqlServer->BindInt(Offset++, pStats->m_Kills);
+	pSqlServer->BindInt(Offset++, pStats->m_Deaths);
+	pSqlServer->BindInt(Offset++, pStats->m_BestSpree);
+	pSqlServer->BindInt(Offset++, pStats->m_Wins);
+	pSqlServer->BindInt(Offset++, pStats->m_Losses);
+	pSqlServer->BindInt(Offset++, pStats->m_ShotsFired);
+	pSqlServer->BindInt(Offset++, pStats->m_ShotsHit);
+
+	if(pData->m_pExtraColumns)
+		pData->m_pExtraColumns->InsertBindings(&Offset, pSqlServer, pStats);
+
+	if(pData->m_DebugStats > 1)
+		dbg_msg("sql-thread", "final offset %d", Offset);
+
+	pSqlServer->Print();
+
+	int NumUpdated;
+	return pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize);
+}
+
+bool CSqlStatsWorker::LoadLeaderboard(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	// the stats are not written to the backup database
+	if(w != Write::NORMAL)
+		return false;
+
+	const auto *pData = dynamic_cast<const CSqlLoadLeaderboardRequest *>(pGameData);
+	auto *pResult = dynamic_cast<CLeaderboardResult *>(pGameData->m_pResult.get());
+
+	char aColumns[1024] = "";
+	for(const auto &Column : pData->m_vColumns)
+	{
+		str_append(aColumns, ", ");
+		str_append(aColumns, Column.m_aColumn);
+	}
+
+	char aBuf[2048];
+	str_format(aBuf, sizeof(aBuf), "SELECT name%s FROM %s;", aColumns, pData->m_aTable);
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		dbg_msg("sql-thread", "prepare leaderboard failed query: %s", aBuf);
+		return true;
+	}
+
+	std::vector<std::unique_ptr<CLeaderboard>> vpLeaderboards;
+	for(const auto &Column : pData->m_vColumns)
+		vpLeaderboards.push_back(std::make_unique<CLeaderboard>(Column.m_Descending));
+	bool End = false;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(1, aName, sizeof(aName));
+		for(int i = 0; i < (int)vpLeaderboards.size(); i++)
+			vpLeaderboards[i]->Set(aName, pSqlServer->IsNull(i + 2) ? 0 : pSqlServer->GetInt(i + 2));
+	}
+	if(!End)
+		return true;
+
+	pResult->m_vpLeaderboards = std::move(vpLeaderboards);
+	return false;
+}
@@ -0,0 +1,109 @@
+#ifndef GAME_SERVER_INSTAGIB_SQL_STATS_WORKER_H
+#define GAME_SERVER_INSTAGIB_SQL_STATS_WORKER_H
+
+#include <engine/server/databases/connection_pool.h>
+#include <engine/shared/protocol.h>
+#include <game/server/instagib/extra_columns.h>
+#include <game/server/instagib/leaderboard.h>
+#include <game/server/instagib/sql_stats_player.h>
+
+#include <memory>
+#include <vector>
+
+class IDbConnection;
+
+struct CSqlInstaData : ISqlData
+{
+	CSqlInstaData(std::shared_ptr<ISqlResult> pResult) :
+		ISqlData(std::move(pResult))
+	{
+	}
+
+	~CSqlInstaData() override;
+
+	int m_DebugStats = 0;
+	CExtraColumns *m_pExtraColumns = nullptr;
+};
+
+// data to be written
+// the stats of all players of a round are written in one transaction
+struct CSqlSaveRoundStatsData : CSqlInstaData
+{
+	CSqlSaveRoundStatsData(int DebugStats) :
+		CSqlInstaData(nullptr)
+	{
+		m_DebugStats = DebugStats;
+	}
+
+	char m_aTable[128];
+	int m_NumPlayers = 0;
+	char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
+	CSqlStatsPlayer m_aStats[MAX_CLIENTS];
+};
+
+// collects the round stats of the players until they are written
+// one request only holds stats of one table and at most MAX_CLIENTS players
+class CRoundStatsBatch
+{
+	std::unique_ptr<CSqlSaveRoundStatsData> m_pData;
+
+public:
+	// returns the collected stats if they have to be written before pStats,
+	// because they are full or of another table
+	std::unique_ptr<CSqlSaveRoundStatsData> Add(const char *pName, const char *pTable, const CSqlStatsPlayer *pStats, CExtraColumns *pExtraColumns, int DebugStats);
+	// returns the collected stats, nullptr if there are none
+	std::unique_ptr<CSqlSaveRoundStatsData> Take() { return std::move(m_pData); }
+};
+
+struct CLeaderboardColumn
+{
+	char m_aColumn[128];
+	bool m_Descending;
+};
+
+// read request for all scores of some columns of one table
+// all columns are loaded with one query
+// it is queued as a write so it sees all stats this server saved before
+struct CSqlLoadLeaderboardRequest : ISqlData
+{
+	CSqlLoadLeaderboardRequest(std::shared_ptr<ISqlResult> pResult) :
+		ISqlData(std::move(pResult))
+	{
+	}
+	char m_aTable[128];
+	std::vector<CLeaderboardColumn> m_vColumns;
+};
+
+struct CLeaderboardResult : ISqlResult
+{
+	// one ranking per requested column in the same order
+	// empty if the load failed
+	std::vector<std::unique_ptr<CLeaderboard>> m_vpLeaderboards;
+};
+
+struct CSqlCreateTableRequest : ISqlData
+{
+	CSqlCreateTableRequest() :
+		ISqlData(nullptr)
+	{
+	}
+	char m_aName[128];
+	char m_aColumns[2048];
+	bool m_RankIndexes = false;
+};
+
+// the stats table queries that run on the database workers
+// they do not depend on the game server and are used by the tests and tools
+struct CSqlStatsWorker
+{
+	static bool CreateTable(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
+	static bool SaveRoundStats(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
+	static bool SaveRoundStatsRow(IDbConnection *pSqlServer, const CSqlSaveRoundStatsData *pData, const char *pUpsert, int Index, char *pError, int ErrorSize);
+	static bool LoadLeaderboard(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
+
+	// the statement that inserts a player or merges the round into the existing row
+	// the values are bound by SaveRoundStatsRow
+	static void RoundStatsUpsert(char *pBuf, int BufferSize, IDbConnection *pSqlServer, const char *pTable, CExtraColumns *pExtraColumns);
+};
+
+#endif
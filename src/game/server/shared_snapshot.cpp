@@ -0,0 +1,81 @@
+#include "shared_snapshot.h"
+
+#include "entity.h"
+#include "gamecontext.h"
+
+#include <base/system.h>
+
+void CSharedSnapshot::CView::AddClipPosition(vec2 Pos)
+{
+	dbg_assert(m_NumClipPositions < MAX_CLIP_POSITIONS, "too many clip positions");
+	m_aClipPositions[m_NumClipPositions++] = Pos;
+}
+
+CSharedSnapshot::CSharedSnapshot()
+{
+	Clear();
+}
+
+void CSharedSnapshot::Clear()
+{
+	m_NumItems = 0;
+	m_DataSize = 0;
+}
+
+void *CSharedSnapshot::NewItem(int Type, int Id, int Size, const CView &View)
+{
+	dbg_assert(Size % sizeof(int32_t) == 0, "shared snapshot item size must be a multiple of 4");
+	if(Id == -1)
+		return nullptr;
+	if(m_NumItems >= MAX_ITEMS || m_DataSize + Size > MAX_DATASIZE)
+		return nullptr;
+
+	CItem &Item = m_aItems[m_NumItems++];
+	Item.m_Type = Type;
+	Item.m_Id = Id;
+	Item.m_Size = Size;
+	Item.m_DataOffset = m_DataSize;
+	Item.m_View = View;
+
+	void *pData = &m_aData[m_DataSize];
+	m_DataSize += Size;
+	mem_zero(pData, Size);
+	return pData;
+}
+
+bool CSharedSnapshot::Clipped(const CGameContext *pGameServer, const CView &View, int SnappingClient) const
+{
+	for(int i = 0; i < View.m_NumClipPositions; i++)
+	{
+		const bool PosClipped = View.m_pClipEntity ?
+						View.m_pClipEntity->NetworkClipped(SnappingClient, View.m_aClipPositions[i]) :
+						NetworkClipped(pGameServer, SnappingClient, View.m_aClipPositions[i]);
+		if(!PosClipped)
+			return false;
+	}
+	return View.m_NumClipPositions > 0;
+}
+
+void CSharedSnapshot::Snap(CGameContext *pGameServer, int SnappingClient, int Begin, int End) const
+{
+	const int Version = pGameServer->GetClientVersion(SnappingClient);
+	const int Sixup = pGameServer->Server()->IsSixup(SnappingClient);
+
+	for(int i = Begin; i < End; i++)
+	{
+		const CItem &Item = m_aItems[i];
+		const CView &View = Item.m_View;
+		if(SnappingClient != SERVER_DEMO_CLIENT && !View.m_Mask.test(SnappingClient))
+			continue;
+		if(Version < View.m_MinVersion || Version >= View.m_MaxVersion)
+			continue;
+		if(View.m_Sixup != SIXUP_ANY && View.m_Sixup != Sixup)
+			continue;
+		if(Clipped(pGameServer, View, SnappingClient))
+			continue;
+
+		void *pData = pGameServer->Server()->SnapNewItem(Item.m_Type, Item.m_Id, Item.m_Size);
+		if(pData)
+			mem_copy(pData, &m_aData[Item.m_DataOffset], Item.m_Size);
+	}
+}
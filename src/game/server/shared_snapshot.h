@@ -0,0 +1,117 @@
+#ifndef GAME_SERVER_SHARED_SNAPSHOT_H
+#define GAME_SERVER_SHARED_SNAPSHOT_H
+
+#include <base/vmath.h>
+
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/generated/protocol7.h>
+
+#include <limits>
+
+class CEntity;
+class CGameContext;
+
+/*
+	Class: Shared Snapshot
+		Item arena that is filled once per snapshot tick and then
+		copied into the snapshot of every client that can see the items.
+
+		Phase one (CGameContext::OnPreSnap) serializes the items of
+		events and entities that do not depend on the snapping client
+		apart from the view described by CView.
+		Phase two (CGameContext::OnSnap) selects the matching items for
+		one client and copies them into its snapshot.
+*/
+class CSharedSnapshot
+{
+public:
+	enum
+	{
+		MAX_ITEMS = 2 * CSnapshot::MAX_ITEMS,
+		MAX_DATASIZE = CSnapshot::MAX_SIZE,
+		MAX_CLIP_POSITIONS = 2,
+
+		SIXUP_ANY = -1,
+	};
+
+	// the clients an item is meant for
+	class CView
+	{
+	public:
+		CClientMask m_Mask = CClientMask().set();
+
+		// half-open range of ddnet client versions
+		int m_MinVersion = std::numeric_limits<int>::min();
+		int m_MaxVersion = std::numeric_limits<int>::max();
+
+		// 0 for 0.6 clients only, 1 for 0.7 clients only
+		int m_Sixup = SIXUP_ANY;
+
+		// the item is clipped if all positions are clipped
+		// if an entity is set its clipping rules are used
+		CEntity *m_pClipEntity = nullptr;
+		vec2 m_aClipPositions[MAX_CLIP_POSITIONS];
+		int m_NumClipPositions = 0;
+
+		void AddClipPosition(vec2 Pos);
+	};
+
+private:
+	class CItem
+	{
+	public:
+		int m_Type;
+		int m_Id;
+		int m_Size;
+		int m_DataOffset;
+		CView m_View;
+	};
+
+	CItem m_aItems[MAX_ITEMS];
+	int m_NumItems;
+
+	alignas(int) char m_aData[MAX_DATASIZE];
+	int m_DataSize;
+
+	bool Clipped(const CGameContext *pGameServer, const CView &View, int SnappingClient) const;
+
+public:
+	CSharedSnapshot();
+
+	void Clear();
+	int NumItems() const { return m_NumItems; }
+	bool HasSpace(int NumItems, int DataSize) const { return m_NumItems + NumItems <= MAX_ITEMS && m_DataSize + DataSize <= MAX_DATASIZE; }
+
+	/*
+		Function: NewItem
+			Adds an item to the arena. Type and Id are passed to
+			IServer::SnapNewItem as is in phase two.
+
+		Returns:
+			Zeroed item data or nullptr if the arena is full.
+	*/
+	void *NewItem(int Type, int Id, int Size, const CView &View);
+
+	template<typename T>
+	T *NewItem(int Id, const CView &View)
+	{
+		const int Type = protocol7::is_sixup<T>::value ? -T::ms_MsgId : T::ms_MsgId;
+		return static_cast<T *>(NewItem(Type, Id, sizeof(T), View));
+	}
+
+	/*
+		Function: Snap
+			Copies the items visible to the snapping client into its
+			snapshot.
+
+		Arguments:
+			Begin - Index of the first item, NumItems before the
+				items were added in phase one.
+			End - Index after the last item.
+	*/
+	void Snap(CGameContext *pGameServer, int SnappingClient, int Begin, int End) const;
+};
+
+#endif
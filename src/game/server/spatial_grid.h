@@ -0,0 +1,149 @@
+#ifndef GAME_SERVER_SPATIAL_GRID_H
+#define GAME_SERVER_SPATIAL_GRID_H
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+	Class: CSpatialGridHandle
+		Location of an item in a CSpatialGrid, stored in the item itself.
+*/
+class CSpatialGridHandle
+{
+public:
+	int m_Cell = -1;
+	int m_Slot = -1;
+	// items with a higher sequence are returned first
+	uint64_t m_Seq = 0;
+};
+
+/*
+	Class: CSpatialGrid
+		Uniform grid over the map that buckets items by position.
+		Queries return every item whose radius might overlap the
+		queried box, the caller filters them by its exact condition.
+		T needs a public CSpatialGridHandle m_GridHandle.
+*/
+template<typename T>
+class CSpatialGrid
+{
+	float m_CellSize = 1.0f;
+	// largest radius of all inserted items
+	float m_Margin = 0.0f;
+	int m_Width = 0;
+	int m_Height = 0;
+	std::vector<std::vector<T *>> m_vvpCells;
+
+	int CellX(float x) const { return (int)clamp(std::floor(x / m_CellSize), 0.0f, (float)(m_Width - 1)); }
+	int CellY(float y) const { return (int)clamp(std::floor(y / m_CellSize), 0.0f, (float)(m_Height - 1)); }
+	int Cell(vec2 Pos) const { return CellY(Pos.y) * m_Width + CellX(Pos.x); }
+
+public:
+	bool Initialized() const { return m_Width > 0; }
+
+	/*
+		Function: Init
+			Positions outside of the area are put into the closest border cell.
+
+		Arguments:
+			Width - Width of the area in world units.
+			Height - Height of the area in world units.
+			CellSize - Size of a cell in world units.
+	*/
+	void Init(float Width, float Height, float CellSize)
+	{
+		m_CellSize = CellSize;
+		m_Width = maximum(1, (int)std::ceil(Width / CellSize));
+		m_Height = maximum(1, (int)std::ceil(Height / CellSize));
+		m_Margin = 0.0f;
+		m_vvpCells.clear();
+		m_vvpCells.resize((size_t)m_Width * m_Height);
+	}
+
+	void Insert(T *pItem, vec2 Pos, float Radius, uint64_t Seq)
+	{
+		dbg_assert(pItem->m_GridHandle.m_Cell == -1, "item is already in the grid");
+		m_Margin = maximum(m_Margin, Radius);
+		pItem->m_GridHandle.m_Seq = Seq;
+		Place(pItem, Cell(Pos));
+	}
+
+	void Remove(T *pItem)
+	{
+		CSpatialGridHandle &Handle = pItem->m_GridHandle;
+		if(Handle.m_Cell == -1)
+			return;
+
+		// swap with the last item of the cell
+		std::vector<T *> &vpCell = m_vvpCells[Handle.m_Cell];
+		T *pLast = vpCell.back();
+		vpCell[Handle.m_Slot] = pLast;
+		pLast->m_GridHandle.m_Slot = Handle.m_Slot;
+		vpCell.pop_back();
+
+		Handle.m_Cell = -1;
+		Handle.m_Slot = -1;
+	}
+
+	void Move(T *pItem, vec2 Pos)
+	{
+		if(pItem->m_GridHandle.m_Cell == -1)
+			return;
+		const int NewCell = Cell(Pos);
+		if(NewCell == pItem->m_GridHandle.m_Cell)
+			return;
+		Remove(pItem);
+		Place(pItem, NewCell);
+	}
+
+	bool InCell(const T *pItem, vec2 Pos) const
+	{
+		return pItem->m_GridHandle.m_Cell == Cell(Pos);
+	}
+
+	/*
+		Function: Query
+			Collects the items of all cells overlapping the box grown
+			by the largest item radius, ordered by descending sequence.
+	*/
+	void Query(vec2 Min, vec2 Max, std::vector<T *> &vpOut) const
+	{
+		vpOut.clear();
+		// some slack for rounding
+		const vec2 Slack = vec2(m_Margin + 1.0f, m_Margin + 1.0f);
+		Min -= Slack;
+		Max += Slack;
+		const int MinX = CellX(Min.x);
+		const int MaxX = CellX(Max.x);
+		const int MinY = CellY(Min.y);
+		const int MaxY = CellY(Max.y);
+		for(int y = MinY; y <= MaxY; y++)
+		{
+			for(int x = MinX; x <= MaxX; x++)
+			{
+				const std::vector<T *> &vpCell = m_vvpCells[y * m_Width + x];
+				vpOut.insert(vpOut.end(), vpCell.begin(), vpCell.end());
+			}
+		}
+		std::sort(vpOut.begin(), vpOut.end(), [](const T *pA, const T *pB) {
+			return pA->m_GridHandle.m_Seq > pB->m_GridHandle.m_Seq;
+		});
+	}
+
+private:
+	void Place(T *pItem, int CellIndex)
+	{
+		std::vector<T *> &vpCell = m_vvpCells[CellIndex];
+		pItem->m_GridHandle.m_Cell = CellIndex;
+		pItem->m_GridHandle.m_Slot = vpCell.size();
+		vpCell.push_back(pItem);
+	}
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "spawn_danger.h"
+
+#include <base/system.h>
+
+vec2 CSpawnDanger::SpawnOffset(int Index)
+{
+	static const vec2 s_aOffsets[NUM_OFFSETS] = {vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f)}; // start, left, up, right, down
+	return s_aOffsets[Index];
+}
+
+float CSpawnDanger::PositionScore(vec2 Pos, const CCharacterPos *pCharacters, int Num)
+{
+	float Score = 0.0f;
+	for(int i = 0; i < Num; i++)
+	{
+		float d = distance(Pos, pCharacters[i].m_Pos);
+		Score += d == 0 ? 1000000000.0f : 1.0f / d;
+	}
+	return Score;
+}
+
+void CSpawnDanger::CPositionScore::Add(vec2 Pos, vec2 CharacterPos, int Sign)
+{
+	const float d = distance(Pos, CharacterPos);
+	if(d == 0)
+		m_NumOnTop += Sign;
+	else
+		m_Sum += Sign / (double)d;
+}
+
+void CSpawnDanger::EvaluateSpawnType(CSpawnEval *pEval, const std::vector<vec2> *pavSpawnPoints, int Type, const CCharacterPos *pCharacters, int Num, const CSpawnDanger *pScores, const FFreePos &FreePos)
+{
+	// j == 0: Find an empty slot, j == 1: Take any slot if no empty one found
+	for(int j = 0; j < 2 && !pEval->m_Got; j++)
+	{
+		// get spawn point
+		for(size_t i = 0; i < pavSpawnPoints[Type].size(); i++)
+		{
+			const vec2 &SpawnPoint = pavSpawnPoints[Type][i];
+			int Offset = 0;
+			if(j == 0 && !FreePos(SpawnPoint, &Offset))
+				continue; // try next spawn point
+
+			// only the first spawn point counts when taking any slot
+			if(j == 1 && pEval->m_Got)
+				break;
+
+			const vec2 P = SpawnPoint + SpawnOffset(Offset);
+			const double S = pScores ? pScores->Score(Type, i, Offset) : PositionScore(P, pCharacters, Num);
+			if(!pEval->m_Got || (j == 0 && pEval->m_Score > S))
+			{
+				pEval->m_Got = true;
+				pEval->m_Score = S;
+				pEval->m_Pos = P;
+			}
+		}
+	}
+}
+
+void CSpawnDanger::Rebuild(const std::vector<vec2> *pavSpawnPoints, const CCharacterPos *pCharacters, int Num, int Tick, int DDTeam)
+{
+	m_Tick = Tick;
+	m_DDTeam = DDTeam;
+	m_pavSpawnPoints = pavSpawnPoints;
+
+	for(int Type = 0; Type < NUM_SPAWN_TYPES; Type++)
+	{
+		m_avScores[Type].clear();
+		m_avScores[Type].resize(pavSpawnPoints[Type].size() * NUM_OFFSETS);
+	}
+
+	mem_zero(m_aCounted, sizeof(m_aCounted));
+	for(int i = 0; i < Num; i++)
+	{
+		AddCharacter(pCharacters[i].m_Pos, 1);
+		m_aCounted[pCharacters[i].m_ClientId] = true;
+		m_aPositions[pCharacters[i].m_ClientId] = pCharacters[i].m_Pos;
+	}
+}
+
+void CSpawnDanger::Update(const CCharacterPos *pCharacters, int Num)
+{
+	dbg_assert(m_Tick != -1, "spawn danger was not built");
+
+	mem_zero(m_aSeen, sizeof(m_aSeen));
+	for(int i = 0; i < Num; i++)
+	{
+		const int ClientId = pCharacters[i].m_ClientId;
+		const vec2 Pos = pCharacters[i].m_Pos;
+		m_aSeen[ClientId] = true;
+		if(m_aCounted[ClientId] && m_aPositions[ClientId] == Pos)
+			continue;
+
+		if(m_aCounted[ClientId])
+			AddCharacter(m_aPositions[ClientId], -1);
+		AddCharacter(Pos, 1);
+		m_aCounted[ClientId] = true;
+		m_aPositions[ClientId] = Pos;
+	}
+
+	// died or left the team
+	for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+	{
+		if(m_aCounted[ClientId] && !m_aSeen[ClientId])
+		{
+			AddCharacter(m_aPositions[ClientId], -1);
+			m_aCounted[ClientId] = false;
+		}
+	}
+}
+
+void CSpawnDanger::AddCharacter(vec2 Pos, int Sign)
+{
+	for(int Type = 0; Type < NUM_SPAWN_TYPES; Type++)
+	{
+		const std::vector<vec2> &vSpawnPoints = m_pavSpawnPoints[Type];
+		for(size_t i = 0; i < vSpawnPoints.size(); i++)
+		{
+			for(int Offset = 0; Offset < NUM_OFFSETS; Offset++)
+				m_avScores[Type][i * NUM_OFFSETS + Offset].Add(vSpawnPoints[i] + SpawnOffset(Offset), Pos, Sign);
+		}
+	}
+}
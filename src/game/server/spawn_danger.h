@@ -0,0 +1,133 @@
+#ifndef GAME_SERVER_SPAWN_DANGER_H
+#define GAME_SERVER_SPAWN_DANGER_H
+
+#include <base/vmath.h>
+
+#include <engine/shared/protocol.h>
+
+#include <functional>
+#include <vector>
+
+class CSpawnEval
+{
+public:
+	vec2 m_Pos = vec2(100, 100);
+	bool m_Got = false;
+	int m_FriendlyTeam = -1;
+	double m_Score = 0.0;
+};
+
+/*
+	Class: CSpawnDanger
+		Keeps the danger score of every spawn position up to date with
+		the characters of one ddrace team. The score of a position is
+		the sum of 1/distance to all those characters, see
+		PositionScore. The positions are the spawn points and the
+		free positions next to them, see SpawnOffset.
+
+		Rebuild computes the scores from scratch. Update only applies
+		the characters that spawned, died or moved since, which makes
+		many spawns in the same tick O(spawn points) each instead of
+		O(spawn points * characters).
+
+		The scores are summed in doubles, so adding and removing
+		characters does not drift. Characters standing exactly on a
+		position are counted instead of adding a huge term to the sum.
+*/
+class CSpawnDanger
+{
+public:
+	class CCharacterPos
+	{
+	public:
+		int m_ClientId;
+		vec2 m_Pos;
+	};
+
+	enum
+	{
+		NUM_SPAWN_TYPES = 3,
+		// the spawn point and the positions left, up, right and down of it
+		NUM_OFFSETS = 5,
+	};
+
+	static vec2 SpawnOffset(int Index);
+
+	// finds the first free position at a spawn point, false if there is none
+	typedef std::function<bool(vec2 SpawnPoint, int *pOffset)> FFreePos;
+
+	/*
+		Function: PositionScore
+			Danger of a position, summed in floats in the order of the
+			characters like the game did before the scores were cached.
+	*/
+	static float PositionScore(vec2 Pos, const CCharacterPos *pCharacters, int Num);
+
+	/*
+		Function: EvaluateSpawnType
+			Picks the least dangerous free position of a spawn type,
+			or the first spawn point if none of them is free.
+
+		Arguments:
+			pEval - Best position so far, only set if nothing was found.
+			pavSpawnPoints - NUM_SPAWN_TYPES lists of spawn points.
+			Type - Spawn type to look at.
+			pCharacters - Characters of the ddrace team in list order.
+			Num - Number of characters.
+			pScores - Up to date scores of the spawn positions, nullptr
+				to score every position with PositionScore.
+			FreePos - Finds a free position at a spawn point.
+	*/
+	static void EvaluateSpawnType(CSpawnEval *pEval, const std::vector<vec2> *pavSpawnPoints, int Type, const CCharacterPos *pCharacters, int Num, const CSpawnDanger *pScores, const FFreePos &FreePos);
+
+	/*
+		Function: Rebuild
+			Computes the scores of all spawn points from scratch.
+
+		Arguments:
+			pavSpawnPoints - NUM_SPAWN_TYPES lists of spawn points.
+			pCharacters - Characters of the ddrace team.
+			Num - Number of characters.
+			Tick - Tick the scores belong to.
+			DDTeam - DDRace team of the characters.
+	*/
+	void Rebuild(const std::vector<vec2> *pavSpawnPoints, const CCharacterPos *pCharacters, int Num, int Tick, int DDTeam);
+
+	/*
+		Function: Update
+			Brings the scores up to date with the characters of
+			the ddrace team passed to Rebuild.
+	*/
+	void Update(const CCharacterPos *pCharacters, int Num);
+
+	bool Valid(int Tick, int DDTeam) const { return m_Tick == Tick && m_DDTeam == DDTeam; }
+	void Invalidate() { m_Tick = -1; }
+
+	double Score(int Type, int Index, int Offset = 0) const { return m_avScores[Type][Index * NUM_OFFSETS + Offset].Score(); }
+
+private:
+	class CPositionScore
+	{
+	public:
+		double m_Sum = 0.0;
+		// characters at distance 0
+		int m_NumOnTop = 0;
+
+		double Score() const { return m_NumOnTop * 1000000000.0 + m_Sum; }
+		void Add(vec2 Pos, vec2 CharacterPos, int Sign);
+	};
+
+	void AddCharacter(vec2 Pos, int Sign);
+
+	int m_Tick = -1;
+	int m_DDTeam = -1;
+	const std::vector<vec2> *m_pavSpawnPoints = nullptr;
+	// NUM_OFFSETS positions per spawn point
+	std::vector<CPositionScore> m_avScores[NUM_SPAWN_TYPES];
+
+	bool m_aCounted[MAX_CLIENTS] = {};
+	bool m_aSeen[MAX_CLIENTS];
+	vec2 m_aPositions[MAX_CLIENTS];
+};
+
+#endif
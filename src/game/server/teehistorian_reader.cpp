@@ -0,0 +1,258 @@
+#include "teehistorian_reader.h"
+
+#include "teehistorian.h"
+
+#include <base/system.h>
+
+#include <engine/shared/compression.h>
+#include <engine/shared/json.h>
+
+static const CUuid TEEHISTORIAN_UUID = CalculateUuid("teehistorian@ddnet.tw");
+
+CTeeHistorianReader::CTeeHistorianReader() :
+	m_pStart(nullptr),
+	m_pCurrent(nullptr),
+	m_pEnd(nullptr),
+	m_ReadError(false),
+	m_pHeader(nullptr)
+{
+	Rewind();
+}
+
+CTeeHistorianReader::~CTeeHistorianReader()
+{
+	if(m_pHeader)
+		json_value_free(m_pHeader);
+}
+
+bool CTeeHistorianReader::Open(const unsigned char *pData, int Size)
+{
+	if(m_pHeader)
+	{
+		json_value_free(m_pHeader);
+		m_pHeader = nullptr;
+	}
+	m_pStart = nullptr;
+	m_pEnd = nullptr;
+	Rewind();
+
+	if(Size < (int)sizeof(CUuid) || mem_comp(pData, &TEEHISTORIAN_UUID, sizeof(CUuid)) != 0)
+		return Fail("not a teehistorian file");
+
+	// the header is a null terminated json object
+	const char *pJson = (const char *)pData + sizeof(CUuid);
+	const int MaxJsonSize = Size - sizeof(CUuid);
+	int JsonSize = 0;
+	while(JsonSize < MaxJsonSize && pJson[JsonSize])
+		JsonSize++;
+	if(JsonSize == MaxJsonSize)
+		return Fail("header is not terminated");
+
+	m_pHeader = json_parse(pJson, JsonSize);
+	if(!m_pHeader || m_pHeader->type != json_object)
+		return Fail("header is not valid json");
+
+	const char *pVersion = HeaderString("version");
+	if(!pVersion || str_comp(pVersion, "2") != 0)
+		return Fail("unsupported teehistorian version");
+
+	m_pStart = pData + sizeof(CUuid) + JsonSize + 1;
+	m_pEnd = pData + Size;
+	Rewind();
+	return true;
+}
+
+void CTeeHistorianReader::Rewind()
+{
+	m_pCurrent = m_pStart;
+	m_ReadError = false;
+	// tick 0 is implicit at the start, like in the writer
+	m_Tick = 0;
+	m_LastPlayerClientId = MAX_CLIENTS;
+	m_Finished = false;
+	m_aError[0] = '\0';
+	mem_zero(m_aPlayers, sizeof(m_aPlayers));
+}
+
+const char *CTeeHistorianReader::HeaderString(const char *pName) const
+{
+	if(!m_pHeader)
+		return nullptr;
+	const json_value *pValue = json_object_get(m_pHeader, pName);
+	return pValue->type == json_string ? json_string_get(pValue) : nullptr;
+}
+
+bool CTeeHistorianReader::Next(CChunk *pChunk)
+{
+	while(!m_Finished && !Error() && m_pCurrent < m_pEnd)
+	{
+		const int Type = GetInt();
+		if(Type >= 0)
+		{
+			// player position diff, the type is the client id
+			pChunk->m_Type = CHUNK_PLAYER;
+			pChunk->m_ClientId = Type;
+			const int dx = GetInt();
+			const int dy = GetInt();
+			if(Type >= MAX_CLIENTS)
+				return Fail("invalid client id");
+			m_aPlayers[Type].m_X += dx;
+			m_aPlayers[Type].m_Y += dy;
+		}
+		else
+		{
+			switch(-Type)
+			{
+			case TEEHISTORIAN_FINISH:
+				m_Finished = true;
+				return false;
+			case TEEHISTORIAN_TICK_SKIP:
+				m_Tick += 1 + GetInt();
+				m_LastPlayerClientId = -1;
+				continue;
+			case TEEHISTORIAN_PLAYER_NEW:
+				pChunk->m_Type = CHUNK_PLAYER;
+				pChunk->m_ClientId = GetInt();
+				if(pChunk->m_ClientId < 0 || pChunk->m_ClientId >= MAX_CLIENTS)
+					return Fail("invalid client id");
+				m_aPlayers[pChunk->m_ClientId].m_X = GetInt();
+				m_aPlayers[pChunk->m_ClientId].m_Y = GetInt();
+				break;
+			case TEEHISTORIAN_PLAYER_OLD:
+				pChunk->m_Type = CHUNK_PLAYER_DEAD;
+				pChunk->m_ClientId = GetInt();
+				break;
+			case TEEHISTORIAN_INPUT_DIFF:
+			case TEEHISTORIAN_INPUT_NEW:
+			{
+				pChunk->m_Type = CHUNK_INPUT;
+				pChunk->m_ClientId = GetInt();
+				if(pChunk->m_ClientId < 0 || pChunk->m_ClientId >= MAX_CLIENTS)
+					return Fail("invalid client id");
+				int *pInput = (int *)&m_aPlayers[pChunk->m_ClientId].m_Input;
+				for(size_t i = 0; i < sizeof(CNetObj_PlayerInput) / sizeof(int32_t); i++)
+				{
+					if(-Type == TEEHISTORIAN_INPUT_DIFF)
+						pInput[i] += GetInt();
+					else
+						pInput[i] = GetInt();
+				}
+				pChunk->m_Input = m_aPlayers[pChunk->m_ClientId].m_Input;
+				break;
+			}
+			case TEEHISTORIAN_MESSAGE:
+				pChunk->m_Type = CHUNK_MESSAGE;
+				pChunk->m_ClientId = GetInt();
+				pChunk->m_DataSize = GetInt();
+				pChunk->m_pData = GetRaw(pChunk->m_DataSize);
+				break;
+			case TEEHISTORIAN_JOIN:
+				pChunk->m_Type = CHUNK_JOIN;
+				pChunk->m_ClientId = GetInt();
+				break;
+			case TEEHISTORIAN_DROP:
+				pChunk->m_Type = CHUNK_DROP;
+				pChunk->m_ClientId = GetInt();
+				pChunk->m_pString = GetString();
+				break;
+			case TEEHISTORIAN_CONSOLE_COMMAND:
+			{
+				pChunk->m_Type = CHUNK_CONSOLE_COMMAND;
+				pChunk->m_ClientId = GetInt();
+				pChunk->m_FlagMask = GetInt();
+				pChunk->m_pString = GetString();
+				const int NumArgs = GetInt();
+				pChunk->m_vpArgs.clear();
+				for(int i = 0; i < NumArgs && !m_ReadError; i++)
+					pChunk->m_vpArgs.push_back(GetString());
+				break;
+			}
+			case TEEHISTORIAN_EX:
+			{
+				pChunk->m_Type = CHUNK_EX;
+				const unsigned char *pUuid = GetRaw(sizeof(CUuid));
+				if(pUuid)
+					mem_copy(&pChunk->m_Uuid, pUuid, sizeof(CUuid));
+				pChunk->m_DataSize = GetInt();
+				pChunk->m_pData = GetRaw(pChunk->m_DataSize);
+				break;
+			}
+			default:
+				return Fail("unknown chunk type");
+			}
+		}
+
+		if(m_ReadError)
+			return Fail("unexpected end of file");
+		if(pChunk->m_Type == CHUNK_PLAYER || pChunk->m_Type == CHUNK_PLAYER_DEAD)
+		{
+			if(pChunk->m_ClientId < 0 || pChunk->m_ClientId >= MAX_CLIENTS)
+				return Fail("invalid client id");
+
+			// player data with a client id that is not higher than the
+			// previous one starts the next tick, see
+			// CTeeHistorian::EnsureTickWrittenPlayerData
+			if(pChunk->m_ClientId <= m_LastPlayerClientId)
+				m_Tick++;
+			m_LastPlayerClientId = pChunk->m_ClientId;
+			pChunk->m_X = m_aPlayers[pChunk->m_ClientId].m_X;
+			pChunk->m_Y = m_aPlayers[pChunk->m_ClientId].m_Y;
+		}
+		return true;
+	}
+	if(m_ReadError)
+		Fail("unexpected end of file");
+	return false;
+}
+
+int CTeeHistorianReader::GetInt()
+{
+	if(m_ReadError || m_pCurrent >= m_pEnd)
+	{
+		m_ReadError = true;
+		return 0;
+	}
+
+	int i;
+	const unsigned char *pNext = CVariableInt::Unpack(m_pCurrent, &i, m_pEnd - m_pCurrent);
+	if(!pNext)
+	{
+		m_ReadError = true;
+		return 0;
+	}
+	m_pCurrent = pNext;
+	return i;
+}
+
+const char *CTeeHistorianReader::GetString()
+{
+	const unsigned char *pString = m_pCurrent;
+	while(!m_ReadError && m_pCurrent < m_pEnd && *m_pCurrent)
+		m_pCurrent++;
+	if(m_ReadError || m_pCurrent >= m_pEnd)
+	{
+		m_ReadError = true;
+		return "";
+	}
+	m_pCurrent++;
+	return (const char *)pString;
+}
+
+const unsigned char *CTeeHistorianReader::GetRaw(int Size)
+{
+	if(m_ReadError || Size < 0 || Size > m_pEnd - m_pCurrent)
+	{
+		m_ReadError = true;
+		return nullptr;
+	}
+	const unsigned char *pData = m_pCurrent;
+	m_pCurrent += Size;
+	return pData;
+}
+
+bool CTeeHistorianReader::Fail(const char *pMessage)
+{
+	if(!Error())
+		str_format(m_aError, sizeof(m_aError), "%s (offset %d)", pMessage, m_pStart ? (int)(m_pCurrent - m_pStart) : 0);
+	return false;
+}
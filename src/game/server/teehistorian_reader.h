@@ -0,0 +1,127 @@
+#ifndef GAME_SERVER_TEEHISTORIAN_READER_H
+#define GAME_SERVER_TEEHISTORIAN_READER_H
+
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+
+#include <game/generated/protocol.h>
+
+#include <vector>
+
+typedef struct _json_value json_value;
+
+/*
+	Class: CTeeHistorianReader
+		Reads the chunks written by CTeeHistorian back from a
+		complete file in memory.
+
+		Player positions and inputs are stored as differences in the
+		file, the reader undoes them and reports absolute values.
+		Ticks without changes are skipped in the file, Tick() tells
+		which tick the last chunk belongs to.
+
+		The chunks of tick T are the player positions after the game
+		tick T, followed by everything that happened before the next
+		game tick, including the inputs applied to it.
+*/
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		CHUNK_PLAYER, // m_ClientId, m_X, m_Y
+		CHUNK_PLAYER_DEAD, // m_ClientId
+		CHUNK_INPUT, // m_ClientId, m_Input
+		CHUNK_MESSAGE, // m_ClientId, m_pData, m_DataSize
+		CHUNK_JOIN, // m_ClientId
+		CHUNK_DROP, // m_ClientId, m_pString
+		CHUNK_CONSOLE_COMMAND, // m_ClientId, m_FlagMask, m_pString, m_vpArgs
+		CHUNK_EX, // m_Uuid, m_pData, m_DataSize
+	};
+
+	class CChunk
+	{
+	public:
+		int m_Type;
+		int m_ClientId;
+		int m_X;
+		int m_Y;
+		CNetObj_PlayerInput m_Input;
+		int m_FlagMask;
+		const char *m_pString;
+		std::vector<const char *> m_vpArgs;
+		CUuid m_Uuid;
+		const unsigned char *m_pData;
+		int m_DataSize;
+	};
+
+	CTeeHistorianReader();
+	~CTeeHistorianReader();
+
+	/*
+		Function: Open
+			Parses the header and prepares reading the chunks.
+
+		Arguments:
+			pData - Content of the file, must stay valid while reading.
+			Size - Size of the file.
+
+		Returns:
+			False if it is no teehistorian file, see ErrorMessage.
+	*/
+	bool Open(const unsigned char *pData, int Size);
+
+	/*
+		Function: Rewind
+			Starts reading the chunks from the beginning again.
+	*/
+	void Rewind();
+
+	/*
+		Function: Next
+			Reads the next chunk.
+
+		Returns:
+			False at the end of the file or on an error, the file
+			was complete if Finished is set.
+	*/
+	bool Next(CChunk *pChunk);
+
+	// header json, see CTeeHistorian::WriteHeader
+	const json_value *Header() const { return m_pHeader; }
+	// string value of the header, nullptr if not set
+	const char *HeaderString(const char *pName) const;
+
+	int Tick() const { return m_Tick; }
+	bool Finished() const { return m_Finished; }
+	bool Error() const { return m_aError[0] != '\0'; }
+	const char *ErrorMessage() const { return m_aError; }
+
+private:
+	int GetInt();
+	const char *GetString();
+	const unsigned char *GetRaw(int Size);
+	bool Fail(const char *pMessage);
+
+	const unsigned char *m_pStart;
+	const unsigned char *m_pCurrent;
+	const unsigned char *m_pEnd;
+	bool m_ReadError;
+
+	json_value *m_pHeader;
+
+	int m_Tick;
+	int m_LastPlayerClientId;
+	bool m_Finished;
+	char m_aError[128];
+
+	struct CPlayer
+	{
+		int m_X;
+		int m_Y;
+		CNetObj_PlayerInput m_Input;
+	};
+	CPlayer m_aPlayers[MAX_CLIENTS];
+};
+
+#endif
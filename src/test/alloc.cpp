@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <game/alloc.h>
+
+#include <vector>
+
+namespace {
+
+class CPooled
+{
+	MACRO_ALLOC_FREELIST()
+
+public:
+	int m_aData[5];
+	CPooled() {}
+};
+
+MACRO_ALLOC_FREELIST_IMPL(CPooled)
+
+} // namespace
+
+TEST(FreeListPool, ReusesBlocks)
+{
+	CFreeListPool Pool("test", 24);
+	void *pA = Pool.Alloc(24);
+	void *pB = Pool.Alloc(16);
+	EXPECT_NE(pA, pB);
+	EXPECT_EQ(Pool.Stats().m_Live, 2);
+
+	Pool.Free(pA);
+	EXPECT_EQ(Pool.Stats().m_Live, 1);
+	void *pC = Pool.Alloc(24);
+	EXPECT_EQ(pC, pA);
+	EXPECT_EQ(Pool.Stats().m_HighWater, 2);
+	EXPECT_EQ(Pool.Stats().m_NumAllocs, 3u);
+	EXPECT_EQ(Pool.Stats().m_NumReused, 2u);
+
+	Pool.Free(pB);
+	Pool.Free(pC);
+	EXPECT_EQ(Pool.Stats().m_Live, 0);
+}
+
+TEST(FreeListPool, ZeroesBlocks)
+{
+	CFreeListPool Pool("test", sizeof(int) * 4);
+	int *pData = static_cast<int *>(Pool.Alloc(sizeof(int) * 4));
+	pData[0] = pData[3] = 1234;
+	Pool.Free(pData);
+	pData = static_cast<int *>(Pool.Alloc(sizeof(int) * 4));
+	EXPECT_EQ(pData[0], 0);
+	EXPECT_EQ(pData[3], 0);
+	Pool.Free(pData);
+}
+
+TEST(FreeListPool, ResetRestoresOrder)
+{
+	CFreeListPool Pool("test", 32);
+	std::vector<void *> vpBlocks;
+	for(int i = 0; i < 200; i++)
+		vpBlocks.push_back(Pool.Alloc(32));
+	const int Capacity = Pool.Stats().m_Capacity;
+	EXPECT_GE(Capacity, 200);
+	EXPECT_EQ(Pool.Stats().m_HighWater, 200);
+
+	// free in a scrambled order
+	for(int i = 0; i < 200; i++)
+		Pool.Free(vpBlocks[(i * 7) % 200]);
+	Pool.Reset();
+	EXPECT_EQ(Pool.Stats().m_HighWater, 0);
+	EXPECT_EQ(Pool.Stats().m_Capacity, Capacity);
+
+	// the first chunk is handed out front to back again
+	EXPECT_EQ(Pool.Alloc(32), vpBlocks[0]);
+	EXPECT_EQ(Pool.Alloc(32), vpBlocks[1]);
+	EXPECT_EQ(Pool.Stats().m_HighWater, 2);
+
+	// a pool with live blocks keeps its free list
+	void *pFree = Pool.Alloc(32);
+	Pool.Free(pFree);
+	Pool.Reset();
+	EXPECT_EQ(Pool.Stats().m_HighWater, 2);
+	EXPECT_EQ(Pool.Alloc(32), pFree);
+}
+
+TEST(FreeListPool, ClassMacros)
+{
+	std::vector<CPooled *> vpObjects;
+	for(int i = 0; i < 100; i++)
+	{
+		vpObjects.push_back(new CPooled());
+		EXPECT_EQ(vpObjects.back()->m_aData[4], 0);
+		vpObjects.back()->m_aData[4] = i;
+	}
+	for(CPooled *pObject : vpObjects)
+		delete pObject;
+
+	bool Found = false;
+	for(const CFreeListPool *pPool = CFreeListPool::First(); pPool; pPool = pPool->Next())
+	{
+		if(str_comp(pPool->Name(), "CPooled") == 0)
+		{
+			Found = true;
+			EXPECT_EQ(pPool->Stats().m_Live, 0);
+			EXPECT_EQ(pPool->Stats().m_HighWater, 100);
+		}
+	}
+	EXPECT_TRUE(Found);
+}
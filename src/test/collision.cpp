@@ -0,0 +1,226 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <vector>
+
+static const char *const s_apMaps[] = {
+	"data/maps/ctf1.map",
+	"data/maps/ctf5.map",
+	"data/maps/ctf7.map",
+	"data/maps/dm1.map",
+	"data/maps/dm6.map",
+	"data/maps/Gold Mine.map",
+	"data/maps/Sunny Side Up.map",
+	"data/maps/Tutorial.map",
+	"data/maps/coverage.map",
+};
+
+class CRayResult
+{
+public:
+	int m_Hit = -1;
+	vec2 m_Collision = vec2(-1, -1);
+	vec2 m_BeforeCollision = vec2(-1, -1);
+	int m_TeleNr = -1;
+
+	bool operator==(const CRayResult &Other) const
+	{
+		return m_Hit == Other.m_Hit && m_Collision == Other.m_Collision && m_BeforeCollision == Other.m_BeforeCollision && m_TeleNr == Other.m_TeleNr;
+	}
+};
+
+static std::ostream &operator<<(std::ostream &Stream, const CRayResult &Result)
+{
+	return Stream << "hit=" << Result.m_Hit << " collision=(" << Result.m_Collision.x << ", " << Result.m_Collision.y << ") before=(" << Result.m_BeforeCollision.x << ", " << Result.m_BeforeCollision.y << ") tele=" << Result.m_TeleNr;
+}
+
+static CRayResult CastRay(const CCollision &Collision, int Function, vec2 Pos0, vec2 Pos1)
+{
+	CRayResult Result;
+	switch(Function)
+	{
+	case 0: Result.m_Hit = Collision.IntersectLine(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision); break;
+	case 1: Result.m_Hit = Collision.IntersectLineTeleWeapon(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision, &Result.m_TeleNr); break;
+	case 2: Result.m_Hit = Collision.IntersectLineTeleHook(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision, &Result.m_TeleNr); break;
+	case 3: Result.m_Hit = Collision.IntersectNoLaser(Pos0, Pos1, &Result.m_Collision, &Result.m_BeforeCollision); break;
+	}
+	return Result;
+}
+
+static void ExpectSameRays(CCollision &Collision, int NumRays)
+{
+	const float Width = Collision.GetWidth() * 32.0f;
+	const float Height = Collision.GetHeight() * 32.0f;
+	for(int i = 0; i < NumRays; i++)
+	{
+		// some rays start or end outside of the map
+		const vec2 Pos0 = vec2(random_float(-100.0f, Width + 100.0f), random_float(-100.0f, Height + 100.0f));
+		vec2 Pos1;
+		if(i % 8 == 0)
+			Pos1 = vec2(random_float(-100.0f, Width + 100.0f), random_float(-100.0f, Height + 100.0f));
+		else if(i % 8 == 1)
+			Pos1 = Pos0 + direction(random_float(2 * pi)) * random_float(3.0f);
+		else
+			Pos1 = Pos0 + direction(random_float(2 * pi)) * random_float(1500.0f);
+
+		for(int Function = 0; Function < 4; Function++)
+		{
+			Collision.SetSkipEmptyTiles(false);
+			const CRayResult Expected = CastRay(Collision, Function, Pos0, Pos1);
+			Collision.SetSkipEmptyTiles(true);
+			const CRayResult Result = CastRay(Collision, Function, Pos0, Pos1);
+			ASSERT_EQ(Result, Expected) << "function " << Function << " from (" << Pos0.x << ", " << Pos0.y << ") to (" << Pos1.x << ", " << Pos1.y << ")";
+		}
+	}
+}
+
+TEST(Collision, SkipEmptyTilesMatchesPerPixel)
+{
+	CTestMapLoader Loader;
+	for(const char *pMapName : s_apMaps)
+	{
+		ASSERT_TRUE(Loader.Load(pMapName)) << pMapName;
+
+		CLayers Layers;
+		Layers.Init(Loader.Map(), true);
+		CCollision Collision;
+		Collision.Init(&Layers);
+
+		SCOPED_TRACE(pMapName);
+		ExpectSameRays(Collision, 2000);
+
+		// tiles set at runtime, like the laser bouncing off through tiles
+		for(int i = 0; i < 20; i++)
+		{
+			const vec2 Pos = vec2(random_float(Collision.GetWidth() * 32.0f), random_float(Collision.GetHeight() * 32.0f));
+			Collision.SetCollisionAt(Pos.x, Pos.y, i % 2 ? TILE_SOLID : TILE_AIR);
+		}
+		ExpectSameRays(Collision, 500);
+	}
+}
+
+// what IsSolid computed from the game layer before the solid bitmap
+static int LayerIsSolid(const CCollision &Collision, int x, int y)
+{
+	const int Nx = clamp(x / 32, 0, Collision.GetWidth() - 1);
+	const int Ny = clamp(y / 32, 0, Collision.GetHeight() - 1);
+	const int Index = Collision.GameLayer()[Ny * Collision.GetWidth() + Nx].m_Index;
+	return Index == TILE_SOLID || Index == TILE_NOHOOK;
+}
+
+static void ExpectLookupsMatchLayers(const CCollision &Collision)
+{
+	const int Width = Collision.GetWidth();
+	const int Height = Collision.GetHeight();
+	for(int Index = 0; Index < Width * Height; Index++)
+	{
+		const int x = Index % Width * 32;
+		const int y = Index / Width * 32;
+		ASSERT_EQ(Collision.IsSolid(x, y), LayerIsSolid(Collision, x, y)) << "tile " << Index;
+		ASSERT_EQ(Collision.IsSolid(x + 31, y + 31), LayerIsSolid(Collision, x + 31, y + 31)) << "tile " << Index;
+
+		const CTile *pFront = Collision.FrontLayer();
+		EXPECT_EQ(Collision.GetFrontTileIndex(Index), pFront ? pFront[Index].m_Index : 0);
+		const CTeleTile *pTele = Collision.TeleLayer();
+		EXPECT_EQ(Collision.IsTeleport(Index), pTele && pTele[Index].m_Type == TILE_TELEIN ? pTele[Index].m_Number : 0);
+		EXPECT_EQ(Collision.IsCheckTeleport(Index), pTele && pTele[Index].m_Type == TILE_TELECHECKIN);
+		const CSpeedupTile *pSpeedup = Collision.SpeedupLayer();
+		EXPECT_EQ(Collision.IsSpeedup(Index), pSpeedup && pSpeedup[Index].m_Force > 0 ? Index : 0);
+	}
+
+	// positions outside of the map use the closest border tile
+	for(int i = 0; i < 1000; i++)
+	{
+		const int x = random_float(-1000.0f, Width * 32.0f + 1000.0f);
+		const int y = random_float(-1000.0f, Height * 32.0f + 1000.0f);
+		ASSERT_EQ(Collision.IsSolid(x, y), LayerIsSolid(Collision, x, y)) << x << ", " << y;
+	}
+}
+
+TEST(Collision, LookupsMatchLayers)
+{
+	CTestMapLoader Loader;
+	for(const char *pMapName : s_apMaps)
+	{
+		ASSERT_TRUE(Loader.Load(pMapName)) << pMapName;
+
+		CLayers Layers;
+		Layers.Init(Loader.Map(), true);
+		CCollision Collision;
+		Collision.Init(&Layers);
+
+		SCOPED_TRACE(pMapName);
+		ExpectLookupsMatchLayers(Collision);
+
+		for(int i = 0; i < 50; i++)
+		{
+			const vec2 Pos = vec2(random_float(Collision.GetWidth() * 32.0f), random_float(Collision.GetHeight() * 32.0f));
+			const int aTiles[] = {TILE_AIR, TILE_SOLID, TILE_NOHOOK, TILE_DEATH};
+			Collision.SetCollisionAt(Pos.x, Pos.y, aTiles[i % 4]);
+		}
+		ExpectLookupsMatchLayers(Collision);
+
+		const vec2 DoorPos = vec2(random_float(Collision.GetWidth() * 32.0f), random_float(Collision.GetHeight() * 32.0f));
+		const int DoorIndex = Collision.GetPureMapIndex(DoorPos);
+		CDoorTile DoorTile;
+		Collision.SetDoorCollisionAt(DoorPos.x, DoorPos.y, TILE_STOPA, 0, 3);
+		Collision.GetDoorTile(DoorIndex, &DoorTile);
+		if(Collision.SwitchLayer())
+		{
+			EXPECT_EQ(DoorTile.m_Index, TILE_STOPA);
+			EXPECT_EQ(DoorTile.m_Number, 3);
+		}
+		Collision.SetDoorCollisionAt(DoorPos.x, DoorPos.y, 0, 0, 0);
+		Collision.GetDoorTile(DoorIndex, &DoorTile);
+		EXPECT_EQ(DoorTile.m_Index, 0);
+	}
+}
+
+// run with --gtest_also_run_disabled_tests --gtest_filter=Collision.DISABLED_BenchmarkLookups
+TEST(Collision, DISABLED_BenchmarkLookups)
+{
+	CTestMapLoader Loader;
+	for(const char *pMapName : {"data/maps/Tutorial.map", "data/maps/Sunny Side Up.map"})
+	{
+		ASSERT_TRUE(Loader.Load(pMapName)) << pMapName;
+
+		CLayers Layers;
+		Layers.Init(Loader.Map(), true);
+		CCollision Collision;
+		Collision.Init(&Layers);
+
+		const int NUM_LOOKUPS = 1000000;
+		std::vector<ivec2> vPositions(NUM_LOOKUPS);
+		for(auto &Position : vPositions)
+			Position = ivec2(random_float(Collision.GetWidth() * 32.0f), random_float(Collision.GetHeight() * 32.0f));
+
+		int NumLayerSolid = 0;
+		int64_t Start = time_get();
+		for(const auto &Position : vPositions)
+			NumLayerSolid += LayerIsSolid(Collision, Position.x, Position.y);
+		const int64_t LayerTime = time_get() - Start;
+
+		int NumSolid = 0;
+		Start = time_get();
+		for(const auto &Position : vPositions)
+			NumSolid += Collision.IsSolid(Position.x, Position.y);
+		const int64_t BitmapTime = time_get() - Start;
+
+		EXPECT_EQ(NumSolid, NumLayerSolid);
+
+		const size_t LayerSize = (size_t)Collision.GetWidth() * Collision.GetHeight() * sizeof(CTile);
+		dbg_msg("test", "%s (%dx%d): game layer %d KiB, lookup tables %d KiB, solid lookup %.1f ns with layer, %.1f ns with bitmap",
+			pMapName, Collision.GetWidth(), Collision.GetHeight(),
+			(int)(LayerSize / 1024), (int)(Collision.AccelerationMemoryUsage() / 1024),
+			LayerTime * 1e9 / time_freq() / NUM_LOOKUPS,
+			BitmapTime * 1e9 / time_freq() / NUM_LOOKUPS);
+	}
+}
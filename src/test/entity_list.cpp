@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+
+#include <game/server/entity_list.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+class CTestEntity
+{
+public:
+	int m_TypeSlot = -1;
+	int m_Id;
+	int m_X;
+
+	// like CEntity::Snap, clients only get the entities close to them
+	void Snap(CSnapshotBuilder *pBuilder, int SnappingClient) const
+	{
+		if(absolute(m_X - SnappingClient * 10) > 200)
+			return;
+		int *pData = (int *)pBuilder->NewItem(1, m_Id, 2 * sizeof(int));
+		if(!pData)
+			return;
+		pData[0] = m_X;
+		pData[1] = SnappingClient;
+	}
+};
+
+std::vector<int> Walk(const CEntityList<CTestEntity> &List)
+{
+	std::vector<int> vIds;
+	List.ForEachConst([&](CTestEntity *pEnt) { vIds.push_back(pEnt->m_Id); });
+	return vIds;
+}
+
+} // namespace
+
+TEST(EntityList, WalkAndCompact)
+{
+	std::vector<CTestEntity> vEntities(6);
+	CEntityList<CTestEntity> List;
+	for(int i = 0; i < 5; i++)
+	{
+		vEntities[i].m_Id = i;
+		List.Insert(&vEntities[i]);
+	}
+	vEntities[5].m_Id = 5;
+	EXPECT_EQ(Walk(List), std::vector<int>({4, 3, 2, 1, 0}));
+
+	// removed entities are skipped, inserted ones are not visited
+	std::vector<int> vVisited;
+	List.ForEach([&](CTestEntity *pEnt) {
+		vVisited.push_back(pEnt->m_Id);
+		if(pEnt->m_Id == 3)
+		{
+			List.Remove(&vEntities[2]);
+			List.Remove(&vEntities[3]);
+			List.Insert(&vEntities[5]);
+			EXPECT_FALSE(List.Compact());
+		}
+	});
+	EXPECT_EQ(vVisited, std::vector<int>({4, 3, 1, 0}));
+	EXPECT_EQ(vEntities[2].m_TypeSlot, -1);
+	EXPECT_EQ(List.NumSlots(), 6);
+
+	EXPECT_TRUE(List.Compact());
+	EXPECT_EQ(List.NumSlots(), 4);
+	EXPECT_EQ(Walk(List), std::vector<int>({5, 4, 1, 0}));
+	EXPECT_EQ(List.First(), &vEntities[5]);
+	EXPECT_EQ(List.Next(vEntities[4].m_TypeSlot), &vEntities[1]);
+	EXPECT_EQ(List.Prev(vEntities[4].m_TypeSlot), &vEntities[5]);
+	EXPECT_EQ(List.Next(vEntities[0].m_TypeSlot), nullptr);
+	EXPECT_EQ(List.Next(-1), nullptr);
+	EXPECT_EQ(List.Prev(-1), nullptr);
+}
+
+// like CServer::BuildSnapshotsParallel, the workers snap disjoint sets of clients at the same time
+TEST(EntityList, ParallelSnapMatchesSerial)
+{
+	std::vector<CTestEntity> vEntities(512);
+	CEntityList<CTestEntity> List;
+	for(int i = 0; i < (int)vEntities.size(); i++)
+	{
+		vEntities[i].m_Id = i;
+		vEntities[i].m_X = secure_rand_below(MAX_CLIENTS * 10);
+		List.Insert(&vEntities[i]);
+		// leave some empty slots
+		if(secure_rand_below(4) == 0)
+			List.Remove(&vEntities[i]);
+	}
+
+	struct CSnap
+	{
+		int m_Size;
+		char m_aData[CSnapshot::MAX_SIZE];
+	};
+	auto SnapClient = [&](CSnapshotBuilder *pBuilder, int ClientId, CSnap *pSnap) {
+		pBuilder->Init();
+		List.ForEachConst([&](CTestEntity *pEnt) { pEnt->Snap(pBuilder, ClientId); });
+		pSnap->m_Size = pBuilder->Finish(pSnap->m_aData);
+	};
+
+	std::vector<CSnap> vSerial(MAX_CLIENTS);
+	{
+		CSnapshotBuilder Builder;
+		for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+			SnapClient(&Builder, ClientId, &vSerial[ClientId]);
+	}
+
+	const int NumThreads = 4;
+	for(int Round = 0; Round < 10; Round++)
+	{
+		std::vector<CSnap> vParallel(MAX_CLIENTS);
+		std::vector<std::thread> vThreads;
+		for(int Thread = 0; Thread < NumThreads; Thread++)
+		{
+			vThreads.emplace_back([&, Thread]() {
+				CSnapshotBuilder Builder;
+				for(int ClientId = Thread; ClientId < MAX_CLIENTS; ClientId += NumThreads)
+					SnapClient(&Builder, ClientId, &vParallel[ClientId]);
+			});
+		}
+		for(auto &Thread : vThreads)
+			Thread.join();
+
+		for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+		{
+			ASSERT_EQ(vParallel[ClientId].m_Size, vSerial[ClientId].m_Size);
+			EXPECT_EQ(mem_comp(vParallel[ClientId].m_aData, vSerial[ClientId].m_aData, vSerial[ClientId].m_Size), 0);
+		}
+	}
+
+	// the walks left no traversal behind, the gaps can still be closed
+	int NumLive = 0;
+	List.ForEachConst([&](CTestEntity *) { NumLive++; });
+	EXPECT_LT(NumLive, List.NumSlots());
+	EXPECT_TRUE(List.Compact());
+	EXPECT_EQ(List.NumSlots(), NumLive);
+}
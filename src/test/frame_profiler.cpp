@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <engine/server/frame_profiler.h>
+
+#include <chrono>
+#include <thread>
+
+TEST(FrameProfiler, HistogramPercentiles)
+{
+	CFrameProfiler::CHistogram Histogram;
+	EXPECT_EQ(Histogram.Count(), 0u);
+	EXPECT_EQ(Histogram.Percentile(0.5), 0);
+
+	for(int64_t Value = 1; Value <= 1000; Value++)
+		Histogram.Add(Value * 1000);
+
+	EXPECT_EQ(Histogram.Count(), 1000u);
+	EXPECT_EQ(Histogram.Max(), 1000000);
+	EXPECT_EQ(Histogram.Mean(), 500500);
+
+	// the buckets are at most 12.5% wide
+	const int64_t P50 = Histogram.Percentile(0.5);
+	EXPECT_GE(P50, 500000);
+	EXPECT_LE(P50, 500000 * 9 / 8);
+	const int64_t P99 = Histogram.Percentile(0.99);
+	EXPECT_GE(P99, 990000);
+	EXPECT_LE(P99, 1000000);
+	EXPECT_EQ(Histogram.Percentile(1.0), 1000000);
+
+	Histogram.Reset();
+	EXPECT_EQ(Histogram.Count(), 0u);
+	EXPECT_EQ(Histogram.Max(), 0);
+}
+
+TEST(FrameProfiler, SmallValues)
+{
+	CFrameProfiler::CHistogram Histogram;
+	for(int64_t Value = 0; Value < 8; Value++)
+		Histogram.Add(Value);
+	EXPECT_EQ(Histogram.Percentile(0.5), 3);
+	EXPECT_EQ(Histogram.Max(), 7);
+}
+
+TEST(FrameProfiler, CollectsOnlyWhenEnabled)
+{
+	CFrameProfiler Profiler;
+	{
+		CFrameProfiler::CScope Scope(&Profiler, CFrameProfiler::PHASE_GAME_TICK);
+	}
+	Profiler.EndFrame(1);
+	EXPECT_EQ(Profiler.PhaseHistogram(CFrameProfiler::PHASE_GAME_TICK).Count(), 0u);
+
+	Profiler.SetEnabled(true);
+	for(int Tick = 0; Tick < 3; Tick++)
+	{
+		// several scopes of a phase in one frame are one sample
+		for(int i = 0; i < 2; i++)
+		{
+			CFrameProfiler::CScope Scope(&Profiler, CFrameProfiler::PHASE_SNAPSHOT);
+			CFrameProfiler::CScope ClientScope(&Profiler, CFrameProfiler::PHASE_SNAPSHOT, 5);
+		}
+		Profiler.EndFrame(Tick);
+	}
+	EXPECT_EQ(Profiler.PhaseHistogram(CFrameProfiler::PHASE_SNAPSHOT).Count(), 3u);
+	EXPECT_EQ(Profiler.ClientHistogram(5).Count(), 3u);
+	EXPECT_EQ(Profiler.ClientHistogram(4).Count(), 0u);
+	EXPECT_EQ(Profiler.PhaseHistogram(CFrameProfiler::PHASE_NETWORK).Count(), 0u);
+
+	Profiler.Reset();
+	EXPECT_EQ(Profiler.PhaseHistogram(CFrameProfiler::PHASE_SNAPSHOT).Count(), 0u);
+}
+
+TEST(FrameProfiler, NestedClientScope)
+{
+	CFrameProfiler Profiler;
+	Profiler.SetEnabled(true);
+	{
+		CFrameProfiler::CScope Scope(&Profiler, CFrameProfiler::PHASE_SNAPSHOT);
+		CFrameProfiler::CScope ClientScope(&Profiler, CFrameProfiler::PHASE_SNAPSHOT, 3);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	Profiler.EndFrame(1);
+
+	// the client time is part of the phase time and must not be added to it again
+	const CFrameProfiler::CHistogram &Phase = Profiler.PhaseHistogram(CFrameProfiler::PHASE_SNAPSHOT);
+	const CFrameProfiler::CHistogram &Client = Profiler.ClientHistogram(3);
+	EXPECT_EQ(Phase.Count(), 1u);
+	EXPECT_EQ(Client.Count(), 1u);
+	EXPECT_GE(Client.Max(), 20000000);
+	EXPECT_GE(Phase.Max(), Client.Max());
+	EXPECT_LT(Phase.Max(), 2 * Client.Max());
+
+	// a client scope alone does not count as the phase
+	{
+		CFrameProfiler::CScope ClientScope(&Profiler, CFrameProfiler::PHASE_SNAPSHOT, 3);
+	}
+	Profiler.EndFrame(2);
+	EXPECT_EQ(Phase.Count(), 1u);
+	EXPECT_EQ(Client.Count(), 2u);
+}
+
+TEST(FrameProfiler, NestedPhaseScope)
+{
+	CFrameProfiler Profiler;
+	Profiler.SetEnabled(true);
+	{
+		CFrameProfiler::CScope Scope(&Profiler, CFrameProfiler::PHASE_GAME_TICK);
+		CFrameProfiler::CScope NestedScope(&Profiler, CFrameProfiler::PHASE_SQL_RESULTS);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+	{
+		CFrameProfiler::CScope Scope(&Profiler, CFrameProfiler::PHASE_GAME_TICK);
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	Profiler.EndFrame(1);
+
+	// the nested time only counts in its own phase
+	const CFrameProfiler::CHistogram &GameTick = Profiler.PhaseHistogram(CFrameProfiler::PHASE_GAME_TICK);
+	const CFrameProfiler::CHistogram &SqlResults = Profiler.PhaseHistogram(CFrameProfiler::PHASE_SQL_RESULTS);
+	EXPECT_EQ(GameTick.Count(), 1u);
+	EXPECT_EQ(SqlResults.Count(), 1u);
+	EXPECT_GE(SqlResults.Max(), 20000000);
+	EXPECT_GE(GameTick.Max(), 5000000);
+	EXPECT_LT(GameTick.Max(), 20000000);
+}
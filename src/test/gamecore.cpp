@@ -0,0 +1,165 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/teamscore.h>
+
+#include <memory>
+
+namespace {
+
+class CTestWorld
+{
+public:
+	CWorldCore m_Core;
+	CTeamsCore m_Teams;
+	CCharacterCore m_aCharacters[MAX_CLIENTS];
+
+	CTestWorld(CCollision *pCollision, bool FilterCharacters)
+	{
+		m_Core.m_FilterCharacters = FilterCharacters;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aCharacters[i].Init(&m_Core, pCollision, &m_Teams);
+			m_aCharacters[i].Reset();
+			m_aCharacters[i].m_Id = i;
+			m_Core.m_apCharacters[i] = &m_aCharacters[i];
+		}
+	}
+
+	// like CGameWorld::Tick of the server with sv_no_weak_hook
+	void Step(const CNetObj_PlayerInput *pInputs)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aCharacters[i].m_Input = pInputs[i];
+			m_aCharacters[i].Tick(true, false);
+		}
+		for(auto &Character : m_aCharacters)
+			Character.TickDeferred();
+		for(auto &Character : m_aCharacters)
+		{
+			Character.Move();
+			Character.Quantize();
+		}
+	}
+
+	void StepBatch(const CNetObj_PlayerInput *pInputs)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			m_aCharacters[i].m_Input = pInputs[i];
+		m_Core.TickCharacters(true, false);
+	}
+};
+
+bool IsFree(const CCollision &Collision, vec2 Pos)
+{
+	const float Size = CCharacterCore::PhysicalSize() / 2;
+	return !Collision.CheckPoint(Pos.x - Size, Pos.y - Size) && !Collision.CheckPoint(Pos.x + Size, Pos.y - Size) &&
+	       !Collision.CheckPoint(Pos.x - Size, Pos.y + Size) && !Collision.CheckPoint(Pos.x + Size, Pos.y + Size);
+}
+
+// a free position close to Center, so that the characters run into each other
+vec2 FreePos(const CCollision &Collision, vec2 Center)
+{
+	for(int i = 0; i < 1000; i++)
+	{
+		const vec2 Pos = Center + vec2(random_float(-400.0f, 400.0f), random_float(-300.0f, 300.0f));
+		if(IsFree(Collision, Pos))
+			return Pos;
+	}
+	return Center;
+}
+
+} // namespace
+
+// the batch stepper and the filtered checks give the same results as
+// checking all characters one by one
+TEST(CharacterCore, FilterMatchesAllCharacters)
+{
+	CTestMapLoader Loader;
+	for(const char *pMapName : {"data/maps/ctf5.map", "data/maps/dm1.map"})
+	{
+		SCOPED_TRACE(pMapName);
+		ASSERT_TRUE(Loader.Load(pMapName));
+		CLayers Layers;
+		Layers.Init(Loader.Map(), true);
+		CCollision Collision;
+		Collision.Init(&Layers);
+
+		vec2 Center;
+		do
+		{
+			Center = vec2(random_float(Collision.GetWidth() * 32.0f), random_float(Collision.GetHeight() * 32.0f));
+		} while(!IsFree(Collision, Center));
+
+		auto pBatch = std::make_unique<CTestWorld>(&Collision, true);
+		auto pFiltered = std::make_unique<CTestWorld>(&Collision, true);
+		auto pAll = std::make_unique<CTestWorld>(&Collision, false);
+		CTestWorld *apWorlds[] = {pBatch.get(), pFiltered.get(), pAll.get()};
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			const vec2 Pos = FreePos(Collision, Center);
+			for(CTestWorld *pWorld : apWorlds)
+				pWorld->m_aCharacters[i].m_Pos = Pos;
+		}
+
+		CNetObj_PlayerInput aInputs[MAX_CLIENTS] = {};
+		int NumHookedTicks = 0;
+		for(int Tick = 0; Tick < 300; Tick++)
+		{
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				// keep the input for a while so that the hooks can reach someone
+				if((Tick + i) % 12 == 0)
+				{
+					CNetObj_PlayerInput &Input = aInputs[i];
+					Input.m_Direction = (int)random_float(3.0f) - 1;
+					Input.m_Jump = random_float() < 0.2f;
+					Input.m_Hook = random_float() < 0.6f;
+					// aim at another character most of the time
+					const vec2 Target = pAll->m_aCharacters[(int)random_float(MAX_CLIENTS) % MAX_CLIENTS].m_Pos - pAll->m_aCharacters[i].m_Pos;
+					Input.m_TargetX = Target.x != 0.0f ? (int)Target.x : 1;
+					Input.m_TargetY = (int)Target.y;
+				}
+			}
+
+			// game logic moves characters between the steps, like teleporters
+			if(Tick % 50 == 0)
+			{
+				const int i = (int)random_float(MAX_CLIENTS) % MAX_CLIENTS;
+				const vec2 Pos = FreePos(Collision, Center);
+				for(CTestWorld *pWorld : apWorlds)
+					pWorld->m_aCharacters[i].m_Pos = Pos;
+			}
+
+			pBatch->StepBatch(aInputs);
+			pFiltered->Step(aInputs);
+			pAll->Step(aInputs);
+
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				const CCharacterCore &All = pAll->m_aCharacters[i];
+				for(const CTestWorld *pWorld : {pBatch.get(), pFiltered.get()})
+				{
+					const CCharacterCore &Filtered = pWorld->m_aCharacters[i];
+					ASSERT_EQ(Filtered.m_Pos, All.m_Pos) << "tick " << Tick << " character " << i;
+					ASSERT_EQ(Filtered.m_Vel, All.m_Vel) << "tick " << Tick << " character " << i;
+					ASSERT_EQ(Filtered.m_HookPos, All.m_HookPos) << "tick " << Tick << " character " << i;
+					ASSERT_EQ(Filtered.m_HookState, All.m_HookState) << "tick " << Tick << " character " << i;
+					ASSERT_EQ(Filtered.HookedPlayer(), All.HookedPlayer()) << "tick " << Tick << " character " << i;
+				}
+				if(All.HookedPlayer() != -1)
+					NumHookedTicks++;
+			}
+		}
+		// the players did interact
+		EXPECT_GT(NumHookedTicks, 0);
+	}
+}
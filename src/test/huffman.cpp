@@ -1,7 +1,14 @@
 #include <gtest/gtest.h>
 
+#include <base/math.h>
 #include <base/system.h>
+#include <engine/shared/compression.h>
 #include <engine/shared/huffman.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/snapshot.h>
+#include <game/generated/protocol.h>
+
+#include <vector>
 
 TEST(Huffman, CompressionShouldNotChangeData)
 {
@@ -46,3 +53,169 @@ TEST(Huffman, CompressionCompatible)
 	EXPECT_EQ(match, 0) << "The compression is not compatible with older/other implementations anymore";
 	EXPECT_EQ(Size, 15);
 }
+
+TEST(Huffman, RoundTripRandom)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	unsigned char aInput[1024];
+	unsigned char aCompressed[4096];
+	unsigned char aDecompressed[1024];
+
+	for(int Run = 0; Run < 500; Run++)
+	{
+		// mix mostly zero, low entropy and random inputs of all sizes
+		const int Size = secure_rand() % (sizeof(aInput) + 1);
+		const int Mode = Run % 3;
+		for(int i = 0; i < Size; i++)
+		{
+			if(Mode == 0)
+				aInput[i] = secure_rand() % 8 == 0 ? secure_rand() : 0;
+			else if(Mode == 1)
+				aInput[i] = secure_rand() % 16;
+			else
+				aInput[i] = secure_rand();
+		}
+
+		const int CompressedSize = Huffman.Compress(aInput, Size, aCompressed, sizeof(aCompressed));
+		ASSERT_GT(CompressedSize, 0);
+		ASSERT_EQ(Huffman.Decompress(aCompressed, CompressedSize, aDecompressed, sizeof(aDecompressed)), Size);
+		ASSERT_EQ(mem_comp(aInput, aDecompressed, Size), 0);
+
+		// too small buffers must fail instead of overflowing
+		if(CompressedSize > 1)
+		{
+			EXPECT_EQ(Huffman.Compress(aInput, Size, aCompressed, CompressedSize - 1), -1);
+		}
+		if(Size > 0)
+		{
+			EXPECT_EQ(Huffman.Decompress(aCompressed, CompressedSize, aDecompressed, Size - 1), -1);
+		}
+	}
+}
+
+static void BuildSnapshot(CSnapshot *pSnapshot, int Tick)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CNetObj_PlayerInfo *pInfo = static_cast<CNetObj_PlayerInfo *>(Builder.NewItem(NETOBJTYPE_PLAYERINFO, i, sizeof(CNetObj_PlayerInfo)));
+		mem_zero(pInfo, sizeof(*pInfo));
+		pInfo->m_Local = i == 0;
+		pInfo->m_ClientId = i;
+		pInfo->m_Team = i % 2;
+		pInfo->m_Score = i * 3 + Tick / 100;
+		pInfo->m_Latency = 20 + i % 30;
+
+		CNetObj_Character *pChr = static_cast<CNetObj_Character *>(Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character)));
+		mem_zero(pChr, sizeof(*pChr));
+		pChr->m_Tick = Tick;
+		pChr->m_X = 1000 + i * 64 + (Tick * (i % 5)) % 800;
+		pChr->m_Y = 500 + (i % 8) * 32;
+		pChr->m_VelX = (i % 5) * 128;
+		pChr->m_Angle = (Tick * 7 + i * 13) % 1608;
+		pChr->m_Direction = i % 3 - 1;
+		pChr->m_HookState = i % 4 == 0 ? 4 : 0;
+		pChr->m_HookTick = Tick - i;
+		pChr->m_Weapon = 5;
+		pChr->m_Emote = 0;
+		pChr->m_AttackTick = Tick - (i * 11) % 50;
+		pChr->m_Health = 10;
+		pChr->m_Armor = i % 10;
+	}
+	Builder.Finish(pSnapshot);
+}
+
+// snapshot messages as the server sends them, a full snapshot and a delta
+static std::vector<std::vector<unsigned char>> SnapshotPayloads()
+{
+	alignas(CSnapshot) static char s_aEmpty[CSnapshot::MAX_SIZE];
+	alignas(CSnapshot) static char s_aFrom[CSnapshot::MAX_SIZE];
+	alignas(CSnapshot) static char s_aTo[CSnapshot::MAX_SIZE];
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	Builder.Finish(s_aEmpty);
+	BuildSnapshot((CSnapshot *)s_aFrom, 1000);
+	BuildSnapshot((CSnapshot *)s_aTo, 1002);
+
+	CSnapshotDelta Delta;
+	std::vector<std::vector<unsigned char>> vPayloads;
+	const CSnapshot *apPairs[][2] = {{(CSnapshot *)s_aEmpty, (CSnapshot *)s_aTo}, {(CSnapshot *)s_aFrom, (CSnapshot *)s_aTo}};
+	for(const auto &Pair : apPairs)
+	{
+		static char s_aDelta[CSnapshot::MAX_SIZE];
+		static unsigned char s_aCompressed[CSnapshot::MAX_SIZE];
+		const int DeltaSize = Delta.CreateDelta(Pair[0], Pair[1], s_aDelta);
+		const int CompressedSize = CVariableInt::Compress(s_aDelta, DeltaSize, s_aCompressed, sizeof(s_aCompressed));
+		for(int Offset = 0; Offset < CompressedSize; Offset += MAX_SNAPSHOT_PACKSIZE)
+		{
+			const int Size = minimum(CompressedSize - Offset, (int)MAX_SNAPSHOT_PACKSIZE);
+			vPayloads.emplace_back(s_aCompressed + Offset, s_aCompressed + Offset + Size);
+		}
+	}
+	return vPayloads;
+}
+
+TEST(Huffman, RoundTripSnapshotPayloads)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	const std::vector<std::vector<unsigned char>> vPayloads = SnapshotPayloads();
+	ASSERT_FALSE(vPayloads.empty());
+
+	unsigned char aCompressed[2048];
+	unsigned char aDecompressed[2048];
+	for(const auto &Payload : vPayloads)
+	{
+		const int Size = Huffman.Compress(Payload.data(), Payload.size(), aCompressed, sizeof(aCompressed));
+		ASSERT_GT(Size, 0);
+		ASSERT_EQ(Huffman.Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed)), (int)Payload.size());
+		ASSERT_EQ(mem_comp(aDecompressed, Payload.data(), Payload.size()), 0);
+	}
+}
+
+// run with --gtest_also_run_disabled_tests --gtest_filter=Huffman.DISABLED_BenchmarkSnapshotPayloads
+TEST(Huffman, DISABLED_BenchmarkSnapshotPayloads)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	const std::vector<std::vector<unsigned char>> vPayloads = SnapshotPayloads();
+	ASSERT_FALSE(vPayloads.empty());
+
+	static const int NUM_RUNS = 2000;
+	std::vector<std::vector<unsigned char>> vCompressed;
+	int64_t CompressTime = 0;
+	int64_t DecompressTime = 0;
+	int64_t NumBytes = 0;
+	int64_t NumCompressedBytes = 0;
+	unsigned char aBuffer[2048];
+	for(const auto &Payload : vPayloads)
+	{
+		int Size = Huffman.Compress(Payload.data(), Payload.size(), aBuffer, sizeof(aBuffer));
+		ASSERT_GT(Size, 0);
+		vCompressed.emplace_back(aBuffer, aBuffer + Size);
+	}
+
+	for(int Run = 0; Run < NUM_RUNS; Run++)
+	{
+		int64_t Start = time_get();
+		for(const auto &Payload : vPayloads)
+			NumCompressedBytes += Huffman.Compress(Payload.data(), Payload.size(), aBuffer, sizeof(aBuffer));
+		CompressTime += time_get() - Start;
+
+		Start = time_get();
+		for(const auto &Compressed : vCompressed)
+			NumBytes += Huffman.Decompress(Compressed.data(), Compressed.size(), aBuffer, sizeof(aBuffer));
+		DecompressTime += time_get() - Start;
+	}
+
+	dbg_msg("test", "huffman on %d snapshot payloads: compress %.1f MB/s, decompress %.1f MB/s (ratio %.2f)",
+		(int)vPayloads.size(),
+		NumBytes / ((double)CompressTime / time_freq()) / 1000000.0,
+		NumBytes / ((double)DecompressTime / time_freq()) / 1000000.0,
+		(double)NumCompressedBytes / NumBytes);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/instagib/leaderboard.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST(Leaderboard, Empty)
+{
+	CLeaderboard Leaderboard(true);
+	int Score;
+	EXPECT_EQ(Leaderboard.Size(), 0);
+	EXPECT_FALSE(Leaderboard.Get("nameless tee", &Score));
+	EXPECT_EQ(Leaderboard.Rank(10), 1);
+	EXPECT_EQ(Leaderboard.Nth(0, &Score), nullptr);
+}
+
+TEST(Leaderboard, RankTies)
+{
+	CLeaderboard Leaderboard(true);
+	Leaderboard.Set("c", 5);
+	Leaderboard.Set("a", 10);
+	Leaderboard.Set("b", 5);
+	Leaderboard.Set("d", 1);
+
+	// same as RANK() OVER (ORDER BY score DESC)
+	EXPECT_EQ(Leaderboard.Rank(10), 1);
+	EXPECT_EQ(Leaderboard.Rank(5), 2);
+	EXPECT_EQ(Leaderboard.Rank(1), 4);
+
+	// equal scores are sorted by name
+	const char *apExpected[] = {"a", "b", "c", "d"};
+	for(int i = 0; i < 4; i++)
+	{
+		int Score;
+		ASSERT_NE(Leaderboard.Nth(i, &Score), nullptr);
+		EXPECT_STREQ(Leaderboard.Nth(i, &Score), apExpected[i]);
+	}
+}
+
+TEST(Leaderboard, Ascending)
+{
+	CLeaderboard Leaderboard(false);
+	Leaderboard.Set("slow", 30);
+	Leaderboard.Set("fast", 10);
+	int Score;
+	EXPECT_STREQ(Leaderboard.Nth(0, &Score), "fast");
+	EXPECT_EQ(Score, 10);
+	EXPECT_EQ(Leaderboard.Rank(30), 2);
+}
+
+TEST(Leaderboard, Update)
+{
+	CLeaderboard Leaderboard(true);
+	Leaderboard.Set("a", 1);
+	Leaderboard.Set("b", 2);
+	Leaderboard.Set("a", 3);
+	EXPECT_EQ(Leaderboard.Size(), 2);
+	int Score;
+	EXPECT_TRUE(Leaderboard.Get("a", &Score));
+	EXPECT_EQ(Score, 3);
+	EXPECT_STREQ(Leaderboard.Nth(0, &Score), "a");
+	EXPECT_STREQ(Leaderboard.Nth(1, &Score), "b");
+	EXPECT_EQ(Leaderboard.Nth(2, &Score), nullptr);
+}
+
+TEST(Leaderboard, MatchesSorting)
+{
+	CLeaderboard Leaderboard(true);
+	std::vector<std::pair<int, std::string>> vExpected;
+	unsigned Seed = 1;
+	for(int i = 0; i < 1000; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		char aName[16];
+		str_format(aName, sizeof(aName), "tee%d", (Seed >> 8) % 300);
+		int Score = (Seed >> 16) % 50;
+		Leaderboard.Set(aName, Score);
+		auto It = std::find_if(vExpected.begin(), vExpected.end(), [&](const auto &Entry) { return Entry.second == aName; });
+		if(It != vExpected.end())
+			It->first = Score;
+		else
+			vExpected.emplace_back(Score, aName);
+	}
+	std::sort(vExpected.begin(), vExpected.end(), [](const auto &a, const auto &b) {
+		if(a.first != b.first)
+			return a.first > b.first;
+		return a.second < b.second;
+	});
+
+	ASSERT_EQ(Leaderboard.Size(), (int)vExpected.size());
+	for(int i = 0; i < (int)vExpected.size(); i++)
+	{
+		int Score;
+		const char *pName = Leaderboard.Nth(i, &Score);
+		ASSERT_NE(pName, nullptr);
+		EXPECT_STREQ(pName, vExpected[i].second.c_str());
+		EXPECT_EQ(Score, vExpected[i].first);
+		int NumBetter = std::count_if(vExpected.begin(), vExpected.end(), [&](const auto &Entry) { return Entry.first > Score; });
+		EXPECT_EQ(Leaderboard.Rank(Score), NumBetter + 1);
+	}
+}
@@ -2,6 +2,9 @@
 
 #include <base/system.h>
 
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+
 TEST(Net, Ipv4AndIpv6Work)
 {
 	NETADDR Bindaddr = {};
@@ -48,3 +51,180 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, UdpBatchSend)
+{
+	NETADDR BindAddr;
+	ASSERT_FALSE(net_addr_from_str(&BindAddr, "127.0.0.1"));
+	NETSOCKET Sender = net_udp_create(BindAddr);
+	ASSERT_TRUE(Sender);
+	NETSOCKET Receiver;
+	do
+	{
+		BindAddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Receiver = net_udp_create(BindAddr)));
+
+	static const int NUM_PACKETS = 10;
+	net_udp_batch_begin(Sender);
+	for(int i = 0; i < NUM_PACKETS; i++)
+		EXPECT_EQ(net_udp_send(Sender, &BindAddr, &i, sizeof(i)), (int)sizeof(i));
+	int Saved = net_udp_batch_end(Sender);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_EQ(Saved, NUM_PACKETS - 1);
+#else
+	EXPECT_EQ(Saved, 0);
+#endif
+
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		NETADDR Addr;
+		unsigned char *pData;
+		if(net_udp_recv(Receiver, &Addr, &pData) <= 0)
+		{
+			ASSERT_EQ(net_socket_read_wait(Receiver, 1000000), 1);
+			ASSERT_EQ(net_udp_recv(Receiver, &Addr, &pData), (int)sizeof(i));
+		}
+		int Value;
+		mem_copy(&Value, pData, sizeof(Value));
+		EXPECT_EQ(Value, i);
+	}
+
+	net_udp_close(Sender);
+	net_udp_close(Receiver);
+}
+
+static int NetServerNewClient(int ClientId, void *pUser, bool Sixup)
+{
+	(*static_cast<int *>(pUser))++;
+	return 0;
+}
+
+static int NetServerNewClientNoAuth(int ClientId, void *pUser)
+{
+	(*static_cast<int *>(pUser))++;
+	return 0;
+}
+
+static int NetServerClientRejoin(int ClientId, void *pUser)
+{
+	return 0;
+}
+
+static int NetServerDelClient(int ClientId, const char *pReason, void *pUser)
+{
+	(*static_cast<int *>(pUser))--;
+	return 0;
+}
+
+static void SendPeerChunk(NETSOCKET Socket, NETADDR *pServerAddr, int Sequence)
+{
+	CNetPacketConstruct Construct;
+	mem_zero(&Construct, sizeof(Construct));
+	CNetChunkHeader Header;
+	Header.m_Flags = 0;
+	Header.m_Size = sizeof(Sequence);
+	Header.m_Sequence = 0;
+	unsigned char *pData = Header.Pack(Construct.m_aChunkData);
+	mem_copy(pData, &Sequence, sizeof(Sequence));
+	Construct.m_DataSize = (int)(pData + sizeof(Sequence) - Construct.m_aChunkData);
+	Construct.m_NumChunks = 1;
+	CNetBase::SendPacket(Socket, pServerAddr, &Construct, NET_SECURITY_TOKEN_UNSUPPORTED, false, true);
+}
+
+static int DrainServer(CNetServer *pServer, int Expected, int64_t *pRecvTime)
+{
+	int Received = 0;
+	while(Received < Expected && net_socket_read_wait(pServer->Socket(), 1000000) > 0)
+	{
+		CNetChunk Chunk;
+		SECURITY_TOKEN ResponseToken;
+		const int64_t Start = time_get();
+		while(pServer->Recv(&Chunk, &ResponseToken))
+		{
+			if(Chunk.m_ClientId >= 0)
+				Received++;
+		}
+		*pRecvTime += time_get() - Start;
+	}
+	return Received;
+}
+
+static const int NUM_PEERS = 64;
+
+// Sends packets from a full server's peers and checks that `CNetServer::Recv`
+// dispatches them to their connection slots and that dropped peers lose
+// their slot. The time spent in `Recv` is added to `pRecvTime`.
+static void RecvConnectedPeers(int NumRounds, int64_t *pRecvTime)
+{
+	CNetBase::Init();
+	g_Config.m_SvVanillaAntiSpoof = 0;
+	g_Config.m_SvConnlimit = 0;
+	g_Config.m_SvConnlimitTime = 0;
+	g_Config.m_Password[0] = '\0';
+
+	NETADDR BindAddr;
+	ASSERT_FALSE(net_addr_from_str(&BindAddr, "127.0.0.1"));
+	int NumClients = 0;
+	CNetServer Server;
+	do
+	{
+		BindAddr.port = secure_rand() % 64511 + 1024;
+	} while(!Server.Open(BindAddr, nullptr, NUM_PEERS, NUM_PEERS));
+	Server.SetCallbacks(NetServerNewClient, NetServerNewClientNoAuth, NetServerClientRejoin, NetServerDelClient, &NumClients);
+	NETADDR ServerAddr = BindAddr;
+
+	NETADDR PeerBindAddr;
+	ASSERT_FALSE(net_addr_from_str(&PeerBindAddr, "127.0.0.1"));
+	NETSOCKET aPeers[NUM_PEERS];
+	for(auto &Peer : aPeers)
+	{
+		Peer = net_udp_create(PeerBindAddr);
+		ASSERT_TRUE(Peer);
+		CNetBase::SendControlMsg(Peer, &ServerAddr, 0, NET_CTRLMSG_CONNECT, nullptr, 0, NET_SECURITY_TOKEN_UNSUPPORTED);
+	}
+
+	CNetChunk Chunk;
+	SECURITY_TOKEN ResponseToken;
+	while(NumClients < NUM_PEERS && net_socket_read_wait(Server.Socket(), 1000000) > 0)
+	{
+		while(Server.Recv(&Chunk, &ResponseToken))
+			;
+	}
+	ASSERT_EQ(NumClients, NUM_PEERS);
+
+	int Received = 0;
+	for(int Round = 0; Round < NumRounds; Round++)
+	{
+		for(auto &Peer : aPeers)
+			SendPeerChunk(Peer, &ServerAddr, Round);
+		Received += DrainServer(&Server, NUM_PEERS, pRecvTime);
+	}
+	EXPECT_EQ(Received, NUM_PEERS * NumRounds);
+
+	int64_t DropRecvTime = 0;
+	Server.Drop(0, "test");
+	EXPECT_EQ(NumClients, NUM_PEERS - 1);
+	for(auto &Peer : aPeers)
+		SendPeerChunk(Peer, &ServerAddr, NumRounds);
+	EXPECT_EQ(DrainServer(&Server, NUM_PEERS - 1, &DropRecvTime), NUM_PEERS - 1);
+
+	for(auto &Peer : aPeers)
+		net_udp_close(Peer);
+	Server.Close();
+}
+
+TEST(Net, ServerRecvConnectedPeers)
+{
+	int64_t RecvTime = 0;
+	RecvConnectedPeers(5, &RecvTime);
+}
+
+// run with --gtest_also_run_disabled_tests --gtest_filter=Net.DISABLED_BenchmarkServerRecv
+TEST(Net, DISABLED_BenchmarkServerRecv)
+{
+	static const int NUM_ROUNDS = 200;
+	int64_t RecvTime = 0;
+	RecvConnectedPeers(NUM_ROUNDS, &RecvTime);
+	dbg_msg("test", "recv %d packets from %d peers in %.2fms (%.0f packets/s)", NUM_PEERS * NUM_ROUNDS, NUM_PEERS,
+		RecvTime * 1000.0 / time_freq(), NUM_PEERS * NUM_ROUNDS / ((double)RecvTime / time_freq()));
+}
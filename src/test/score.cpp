@@ -1,3 +1,4 @@
+#include "test.h"
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -5,6 +6,7 @@
 #include <engine/server/databases/connection.h>
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/config.h>
+#include <game/server/instagib/sql_stats_worker.h>
 #include <game/server/scoreworker.h>
 
 #include <sqlite3.h>
@@ -627,6 +629,355 @@ TEST_P(RandomMap, UnfinishedDoesntExist)
 	EXPECT_STREQ(m_pRandomMapResult->m_aMessage, "nameless tee has no more unfinished maps on this server!");
 }
 
+struct StatementCache : public Score
+{
+	void ExpectPoints(int Points)
+	{
+		ASSERT_FALSE(m_pConn->PrepareStatement("SELECT Points FROM record_maps WHERE Map = ?", m_aError, sizeof(m_aError))) << m_aError;
+		m_pConn->BindString(1, "Kobra 3");
+		bool End;
+		ASSERT_FALSE(m_pConn->Step(&End, m_aError, sizeof(m_aError))) << m_aError;
+		ASSERT_FALSE(End);
+		EXPECT_EQ(m_pConn->GetInt(1), Points);
+	}
+};
+
+TEST_P(StatementCache, Reuse)
+{
+	ExpectPoints(5);
+	uint64_t Hits = m_pConn->StatementCacheHits();
+	uint64_t Misses = m_pConn->StatementCacheMisses();
+	ExpectPoints(5);
+	EXPECT_EQ(m_pConn->StatementCacheHits(), Hits + 1);
+	EXPECT_EQ(m_pConn->StatementCacheMisses(), Misses);
+}
+
+TEST_P(StatementCache, Evict)
+{
+	ExpectPoints(5);
+	char aBuf[64];
+	for(int i = 0; i < STATEMENT_CACHE_SIZE; i++)
+	{
+		str_format(aBuf, sizeof(aBuf), "SELECT Points + %d FROM record_maps", i);
+		ASSERT_FALSE(m_pConn->PrepareStatement(aBuf, m_aError, sizeof(m_aError))) << m_aError;
+	}
+	uint64_t Misses = m_pConn->StatementCacheMisses();
+	ExpectPoints(5);
+	EXPECT_EQ(m_pConn->StatementCacheMisses(), Misses + 1);
+}
+
+struct Upsert : public Score
+{
+	void AddPoints(const char *pName, int Points)
+	{
+		char aOnConflict[128];
+		char aInserted[128];
+		m_pConn->OnConflictUpdate("Name", aOnConflict, sizeof(aOnConflict));
+		m_pConn->InsertedValue("Points", aInserted, sizeof(aInserted));
+		char aBuf[512];
+		str_format(aBuf, sizeof(aBuf),
+			"INSERT INTO record_points(Name, Points) VALUES (?, ?) %s Points = Points + %s",
+			aOnConflict, aInserted);
+		ASSERT_FALSE(m_pConn->PrepareStatement(aBuf, m_aError, sizeof(m_aError))) << m_aError;
+		m_pConn->BindString(1, pName);
+		m_pConn->BindInt(2, Points);
+		int NumUpdated;
+		ASSERT_FALSE(m_pConn->ExecuteUpdate(&NumUpdated, m_aError, sizeof(m_aError))) << m_aError;
+	}
+
+	// -1 if the player has no row
+	int Points(const char *pName)
+	{
+		EXPECT_FALSE(m_pConn->PrepareStatement("SELECT Points FROM record_points WHERE Name = ?", m_aError, sizeof(m_aError))) << m_aError;
+		m_pConn->BindString(1, pName);
+		bool End;
+		EXPECT_FALSE(m_pConn->Step(&End, m_aError, sizeof(m_aError))) << m_aError;
+		return End ? -1 : m_pConn->GetInt(1);
+	}
+};
+
+TEST_P(Upsert, Add)
+{
+	AddPoints("nameless tee", 3);
+	AddPoints("nameless tee", 4);
+	AddPoints("brainless tee", 1);
+	EXPECT_EQ(Points("nameless tee"), 7);
+	EXPECT_EQ(Points("brainless tee"), 1);
+}
+
+TEST_P(Upsert, Commit)
+{
+	ASSERT_FALSE(m_pConn->BeginTransaction(m_aError, sizeof(m_aError))) << m_aError;
+	AddPoints("nameless tee", 3);
+	AddPoints("brainless tee", 1);
+	ASSERT_FALSE(m_pConn->CommitTransaction(m_aError, sizeof(m_aError))) << m_aError;
+	EXPECT_EQ(Points("nameless tee"), 3);
+	EXPECT_EQ(Points("brainless tee"), 1);
+}
+
+TEST_P(Upsert, Rollback)
+{
+	AddPoints("nameless tee", 3);
+	ASSERT_FALSE(m_pConn->BeginTransaction(m_aError, sizeof(m_aError))) << m_aError;
+	AddPoints("nameless tee", 4);
+	AddPoints("brainless tee", 1);
+	ASSERT_FALSE(m_pConn->RollbackTransaction(m_aError, sizeof(m_aError))) << m_aError;
+	EXPECT_EQ(Points("nameless tee"), 3);
+	EXPECT_EQ(Points("brainless tee"), -1);
+}
+
+struct Schema : public Score
+{
+};
+
+TEST_P(Schema, CreateIndexTwice)
+{
+	if(!m_pConn->CreateIndexIfNotExists())
+		GTEST_SKIP() << "no CREATE INDEX IF NOT EXISTS";
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%s record_points_points ON record_points (Points)", m_pConn->CreateIndexIfNotExists());
+	int NumUpdated;
+	for(int i = 0; i < 2; i++)
+	{
+		ASSERT_FALSE(m_pConn->PrepareStatement(aBuf, m_aError, sizeof(m_aError))) << m_aError;
+		ASSERT_FALSE(m_pConn->ExecuteUpdate(&NumUpdated, m_aError, sizeof(m_aError))) << m_aError;
+	}
+}
+
+static int64_t FileSize(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+		return 0;
+	int64_t Size = io_length(File);
+	io_close(File);
+	return Size;
+}
+
+// in-memory databases have no write-ahead log, so this needs a file
+TEST(SQLite, Checkpoint)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	char aWal[IO_MAX_PATH_LENGTH];
+	char aShm[IO_MAX_PATH_LENGTH];
+	str_format(aFilename, sizeof(aFilename), "%s.sqlite", Info.m_aFilename);
+	str_format(aWal, sizeof(aWal), "%s-wal", aFilename);
+	str_format(aShm, sizeof(aShm), "%s-shm", aFilename);
+
+	// like the write worker with sv_sqlite_checkpoint_interval, the log is only
+	// copied into the database by the checkpoints of the read workers
+	auto pConn = CreateSqliteConnection(aFilename, true, false);
+	char aError[256] = {};
+	ASSERT_FALSE(pConn->Connect(aError, sizeof(aError))) << aError;
+	char aName[MAX_NAME_LENGTH];
+	for(int i = 0; i < 100; i++)
+	{
+		str_format(aName, sizeof(aName), "tee%d", i);
+		ASSERT_FALSE(pConn->AddPoints(aName, i, aError, sizeof(aError))) << aError;
+	}
+	EXPECT_GT(FileSize(aWal), 0);
+	const int64_t Size = FileSize(aFilename);
+
+	EXPECT_FALSE(pConn->Checkpoint(aError, sizeof(aError))) << aError;
+	EXPECT_GT(FileSize(aFilename), Size);
+	pConn->Disconnect();
+
+	EXPECT_FALSE(fs_remove(aFilename));
+	fs_remove(aWal);
+	fs_remove(aShm);
+}
+
+struct RoundStats : public Score
+{
+	// a gametype with one summed and one highest extra column
+	// best_multi has a limit so single rows can be made to fail
+	class CTestColumns : public CExtraColumns
+	{
+	public:
+		const char *CreateTable() override { return "got_frozen INTEGER DEFAULT 0, best_multi INTEGER DEFAULT 0 CHECK (best_multi < 100),"; }
+		const char *SelectColumns() override { return ", got_frozen, best_multi"; }
+		const char *InsertColumns() override { return SelectColumns(); }
+		const char *InsertValues() override { return ", ?, ?"; }
+		void InsertBindings(int *pOffset, IDbConnection *pSqlServer, const CSqlStatsPlayer *pStats) override
+		{
+			pSqlServer->BindInt((*pOffset)++, pStats->m_GotFrozen);
+			pSqlServer->BindInt((*pOffset)++, pStats->m_BestMulti);
+		}
+		void UpsertColumns(char *pBuf, int BufferSize, IDbConnection *pSqlServer) override
+		{
+			UpsertMergeAdd(pBuf, BufferSize, pSqlServer, "got_frozen");
+			UpsertMergeHighest(pBuf, BufferSize, pSqlServer, "best_multi");
+		}
+		void Dump(const CSqlStatsPlayer *pStats, const char *pSystem = "stats") const override {}
+		void MergeStats(CSqlStatsPlayer *pOutputStats, const CSqlStatsPlayer *pNewStats) override {}
+		void ReadAndMergeStats(int *pOffset, IDbConnection *pSqlServer, CSqlStatsPlayer *pOutputStats, const CSqlStatsPlayer *pNewStats) override {}
+		bool MergeColumn(const char *pColumn, int Current, const CSqlStatsPlayer *pNewStats, int *pMerged) override { return false; }
+	};
+
+	RoundStats()
+	{
+		CSqlCreateTableRequest Request;
+		str_copy(Request.m_aName, "insta_test");
+		str_copy(Request.m_aColumns, m_Columns.CreateTable());
+		EXPECT_FALSE(CSqlStatsWorker::CreateTable(m_pConn, &Request, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+
+		// Delete all existing entries for persistent databases like MySQL
+		int NumUpdated;
+		EXPECT_FALSE(m_pConn->PrepareStatement("DELETE FROM insta_test", m_aError, sizeof(m_aError))) << m_aError;
+		EXPECT_FALSE(m_pConn->ExecuteUpdate(&NumUpdated, m_aError, sizeof(m_aError))) << m_aError;
+	}
+
+	CSqlStatsPlayer Stats(int Points, int Spree, int BestMulti)
+	{
+		CSqlStatsPlayer Stats;
+		Stats.Reset();
+		Stats.m_Points = Points;
+		Stats.m_BestSpree = Spree;
+		Stats.m_GotFrozen = 1;
+		Stats.m_BestMulti = BestMulti;
+		return Stats;
+	}
+
+	void Add(const char *pName, const CSqlStatsPlayer &Stats)
+	{
+		auto pFull = m_Batch.Add(pName, "insta_test", &Stats, &m_Columns, 0);
+		EXPECT_EQ(pFull, nullptr);
+	}
+
+	// returns true if a row failed
+	bool Save()
+	{
+		auto pData = m_Batch.Take();
+		EXPECT_NE(pData, nullptr);
+		return CSqlStatsWorker::SaveRoundStats(m_pConn, pData.get(), Write::NORMAL, m_aError, sizeof(m_aError));
+	}
+
+	void ExpectRow(const char *pName, int Points, int Spree, int GotFrozen, int BestMulti)
+	{
+		ASSERT_FALSE(m_pConn->PrepareStatement("SELECT points, spree, got_frozen, best_multi FROM insta_test WHERE name = ?", m_aError, sizeof(m_aError))) << m_aError;
+		m_pConn->BindString(1, pName);
+		bool End;
+		ASSERT_FALSE(m_pConn->Step(&End, m_aError, sizeof(m_aError))) << m_aError;
+		ASSERT_FALSE(End) << pName << " has no row";
+		EXPECT_EQ(m_pConn->GetInt(1), Points);
+		EXPECT_EQ(m_pConn->GetInt(2), Spree);
+		EXPECT_EQ(m_pConn->GetInt(3), GotFrozen);
+		EXPECT_EQ(m_pConn->GetInt(4), BestMulti);
+	}
+
+	void ExpectNoRow(const char *pName)
+	{
+		ASSERT_FALSE(m_pConn->PrepareStatement("SELECT points FROM insta_test WHERE name = ?", m_aError, sizeof(m_aError))) << m_aError;
+		m_pConn->BindString(1, pName);
+		bool End;
+		ASSERT_FALSE(m_pConn->Step(&End, m_aError, sizeof(m_aError))) << m_aError;
+		EXPECT_TRUE(End);
+	}
+
+	CTestColumns m_Columns;
+	CRoundStatsBatch m_Batch;
+};
+
+TEST_P(RoundStats, MergeRounds)
+{
+	Add("nameless tee", Stats(3, 5, 2));
+	Add("brainless tee", Stats(1, 1, 1));
+	EXPECT_FALSE(Save()) << m_aError;
+	ExpectRow("nameless tee", 3, 5, 1, 2);
+
+	// points are added, spree and best_multi keep the highest value
+	Add("nameless tee", Stats(4, 2, 7));
+	EXPECT_FALSE(Save()) << m_aError;
+	ExpectRow("nameless tee", 7, 5, 2, 7);
+
+	Add("nameless tee", Stats(1, 9, 3));
+	EXPECT_FALSE(Save()) << m_aError;
+	ExpectRow("nameless tee", 8, 9, 3, 7);
+	ExpectRow("brainless tee", 1, 1, 1, 1);
+}
+
+TEST_P(RoundStats, BrokenRowKeepsOthers)
+{
+	// the broken row fails the transaction, the others are saved one by one
+	Add("nameless tee", Stats(3, 5, 2));
+	Add("broken tee", Stats(1, 1, 100));
+	Add("brainless tee", Stats(1, 1, 1));
+	EXPECT_TRUE(Save());
+	ExpectRow("nameless tee", 3, 5, 1, 2);
+	ExpectRow("brainless tee", 1, 1, 1, 1);
+	ExpectNoRow("broken tee");
+}
+
+TEST_P(RoundStats, BatchSplits)
+{
+	CSqlStatsPlayer Player = Stats(1, 1, 1);
+	char aName[MAX_NAME_LENGTH];
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		str_format(aName, sizeof(aName), "tee %d", i);
+		Add(aName, Player);
+	}
+
+	// full batches are returned before the next player is added
+	auto pFull = m_Batch.Add("late tee", "insta_test", &Player, &m_Columns, 0);
+	ASSERT_NE(pFull, nullptr);
+	EXPECT_EQ(pFull->m_NumPlayers, MAX_CLIENTS);
+	EXPECT_STREQ(pFull->m_aaNames[MAX_CLIENTS - 1], aName);
+	EXPECT_FALSE(CSqlStatsWorker::SaveRoundStats(m_pConn, pFull.get(), Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+
+	// so are the stats of another table
+	pFull = m_Batch.Add("nameless tee", "insta_other", &Player, &m_Columns, 0);
+	ASSERT_NE(pFull, nullptr);
+	EXPECT_EQ(pFull->m_NumPlayers, 1);
+	EXPECT_STREQ(pFull->m_aTable, "insta_test");
+	EXPECT_STREQ(pFull->m_aaNames[0], "late tee");
+
+	auto pLast = m_Batch.Take();
+	ASSERT_NE(pLast, nullptr);
+	EXPECT_EQ(pLast->m_NumPlayers, 1);
+	EXPECT_STREQ(pLast->m_aTable, "insta_other");
+	EXPECT_EQ(m_Batch.Take(), nullptr);
+
+	ExpectRow("tee 0", 1, 1, 1, 1);
+	ExpectRow(aName, 1, 1, 1, 1);
+	ExpectNoRow("late tee");
+}
+
+TEST_P(RoundStats, LoadLeaderboards)
+{
+	Add("nameless tee", Stats(3, 5, 2));
+	Add("brainless tee", Stats(1, 7, 1));
+	EXPECT_FALSE(Save()) << m_aError;
+
+	// all columns of a table are loaded with one query
+	auto pResult = std::make_shared<CLeaderboardResult>();
+	CSqlLoadLeaderboardRequest Request(pResult);
+	str_copy(Request.m_aTable, "insta_test");
+	for(const char *pColumn : {"points", "spree", "best_multi"})
+	{
+		CLeaderboardColumn &Column = Request.m_vColumns.emplace_back();
+		str_copy(Column.m_aColumn, pColumn);
+		Column.m_Descending = true;
+	}
+	Request.m_vColumns.push_back(Request.m_vColumns[0]);
+	Request.m_vColumns.back().m_Descending = false;
+	ASSERT_FALSE(CSqlStatsWorker::LoadLeaderboard(m_pConn, &Request, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+	ASSERT_EQ(pResult->m_vpLeaderboards.size(), 4u);
+
+	int Value;
+	EXPECT_STREQ(pResult->m_vpLeaderboards[0]->Nth(0, &Value), "nameless tee");
+	EXPECT_EQ(Value, 3);
+	EXPECT_STREQ(pResult->m_vpLeaderboards[1]->Nth(0, &Value), "brainless tee");
+	EXPECT_EQ(Value, 7);
+	EXPECT_STREQ(pResult->m_vpLeaderboards[2]->Nth(0, &Value), "nameless tee");
+	EXPECT_EQ(Value, 2);
+	EXPECT_STREQ(pResult->m_vpLeaderboards[3]->Nth(0, &Value), "brainless tee");
+	EXPECT_EQ(Value, 1);
+	for(const auto &pLeaderboard : pResult->m_vpLeaderboards)
+		EXPECT_EQ(pLeaderboard->Size(), 2);
+}
+
 auto g_pSqliteConn = CreateSqliteConnection(":memory:", true);
 #if defined(CONF_TEST_MYSQL)
 CMysqlConfig gMysqlConfig{
@@ -668,3 +1019,7 @@ INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
 INSTANTIATE(RandomMap);
+INSTANTIATE(StatementCache);
+INSTANTIATE(Upsert);
+INSTANTIATE(Schema);
+INSTANTIATE(RoundStats);
@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/shared/snapshot.h>
 #include <game/generated/protocol.h>
 
+#include <vector>
+
 TEST(Snapshot, CrcOneInt)
 {
 	CSnapshotBuilder Builder;
@@ -83,3 +86,273 @@ TEST(Snapshot, CrcOverflow)
 
 	ASSERT_EQ(pSnapshot->Crc(), 1);
 }
+
+TEST(Snapshot, DiffItem)
+{
+	int aPast[37];
+	int aCurrent[37];
+	int aDiff[37];
+	for(int Size = 0; Size <= 37; Size++)
+	{
+		for(int i = 0; i < Size; i++)
+		{
+			aPast[i] = secure_rand();
+			aCurrent[i] = i % 3 == 0 ? aPast[i] : (int)secure_rand();
+		}
+		int Needed = CSnapshotDelta::DiffItem(aPast, aCurrent, aDiff, Size);
+		int ExpectedNeeded = 0;
+		for(int i = 0; i < Size; i++)
+		{
+			EXPECT_EQ(aDiff[i], (int)((unsigned)aCurrent[i] - (unsigned)aPast[i]));
+			ExpectedNeeded |= aDiff[i];
+		}
+		EXPECT_EQ(Needed, ExpectedNeeded);
+
+		mem_copy(aCurrent, aPast, sizeof(int) * Size);
+		EXPECT_EQ(CSnapshotDelta::DiffItem(aPast, aCurrent, aDiff, Size), 0);
+	}
+}
+
+static void AddRandomItem(CSnapshotBuilder *pBuilder, int Key)
+{
+	const int Size = (1 + Key % 6) * sizeof(int32_t);
+	int *pData = (int *)pBuilder->NewItem(1 + Key / 256, Key % 256, Size);
+	ASSERT_TRUE(pData);
+	for(int j = 0; j < Size / (int)sizeof(int32_t); j++)
+		pData[j] = secure_rand() % 4 == 0 ? (int)secure_rand() : j;
+}
+
+// with duplicate keys if Unique is false
+static void BuildRandomSnapshot(CSnapshot *pSnapshot, bool Unique)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	const int NumItems = secure_rand() % 300;
+	if(Unique)
+	{
+		// a random selection of keys in random order
+		int aKeys[1024];
+		for(int i = 0; i < 1024; i++)
+			aKeys[i] = i;
+		for(int i = 0; i < NumItems; i++)
+		{
+			std::swap(aKeys[i], aKeys[i + secure_rand() % (1024 - i)]);
+			AddRandomItem(&Builder, aKeys[i]);
+		}
+	}
+	else
+	{
+		for(int i = 0; i < NumItems; i++)
+			AddRandomItem(&Builder, secure_rand() % 64);
+	}
+	Builder.Finish(pSnapshot);
+}
+
+// straight forward delta creation to compare the optimized one against
+static std::vector<int> ReferenceDelta(const CSnapshot *pFrom, const CSnapshot *pTo)
+{
+	auto FindItem = [](const CSnapshot *pSnapshot, int Key) {
+		for(int i = 0; i < pSnapshot->NumItems(); i++)
+			if(pSnapshot->GetItem(i)->Key() == Key)
+				return i;
+		return -1;
+	};
+
+	std::vector<int> vDeleted;
+	std::vector<int> vUpdates;
+	int NumUpdates = 0;
+	for(int i = 0; i < pFrom->NumItems(); i++)
+		if(FindItem(pTo, pFrom->GetItem(i)->Key()) == -1)
+			vDeleted.push_back(pFrom->GetItem(i)->Key());
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pTo->GetItem(i);
+		const int Size = pTo->GetItemSize(i) / sizeof(int32_t);
+		const int PastIndex = FindItem(pFrom, pItem->Key());
+		std::vector<int> vData(pItem->Data(), pItem->Data() + Size);
+		if(PastIndex != -1)
+		{
+			bool Changed = false;
+			for(int j = 0; j < Size; j++)
+			{
+				vData[j] = (unsigned)vData[j] - (unsigned)pFrom->GetItem(PastIndex)->Data()[j];
+				Changed |= vData[j] != 0;
+			}
+			if(!Changed)
+				continue;
+		}
+		vUpdates.push_back(pItem->Type());
+		vUpdates.push_back(pItem->Id());
+		vUpdates.push_back(Size);
+		vUpdates.insert(vUpdates.end(), vData.begin(), vData.end());
+		NumUpdates++;
+	}
+
+	std::vector<int> vDelta = {(int)vDeleted.size(), NumUpdates, 0};
+	vDelta.insert(vDelta.end(), vDeleted.begin(), vDeleted.end());
+	vDelta.insert(vDelta.end(), vUpdates.begin(), vUpdates.end());
+	return vDelta;
+}
+
+TEST(Snapshot, CreateDeltaMatchesReference)
+{
+	static char s_aFrom[CSnapshot::MAX_SIZE];
+	static char s_aTo[CSnapshot::MAX_SIZE];
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	CSnapshot *pFrom = (CSnapshot *)s_aFrom;
+	CSnapshot *pTo = (CSnapshot *)s_aTo;
+	CSnapshotDelta Delta;
+
+	for(int Run = 0; Run < 100; Run++)
+	{
+		const bool Unique = Run % 2 == 0;
+		BuildRandomSnapshot(pFrom, Unique);
+		BuildRandomSnapshot(pTo, Unique);
+
+		const int DeltaSize = Delta.CreateDelta(pFrom, pTo, s_aDelta);
+		const std::vector<int> vExpected = ReferenceDelta(pFrom, pTo);
+		if(vExpected[0] == 0 && vExpected[1] == 0)
+		{
+			EXPECT_EQ(DeltaSize, 0);
+			continue;
+		}
+		ASSERT_EQ(DeltaSize, (int)(vExpected.size() * sizeof(int32_t)));
+		ASSERT_EQ(mem_comp(s_aDelta, vExpected.data(), DeltaSize), 0);
+
+		// without duplicates the delta has to restore the snapshot
+		if(Unique)
+		{
+			const int Size = Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, s_aDelta, DeltaSize, false);
+			ASSERT_GT(Size, 0);
+			EXPECT_EQ(((CSnapshot *)s_aUnpacked)->Crc(), pTo->Crc());
+		}
+	}
+}
+
+TEST(Snapshot, StorageReusesPurgedHolders)
+{
+	CSnapshotStorage Storage;
+	char aData[1024];
+	char aAltData[512];
+
+	// keep three seconds of snapshots like the server does, for longer than the tick index covers
+	const int NumTicks = 1000;
+	const int KeepTicks = 150;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		const int DataSize = 256 + (Tick % 7) * 64;
+		mem_zero(aData, sizeof(aData));
+		mem_copy(aData, &Tick, sizeof(Tick));
+		mem_zero(aAltData, sizeof(aAltData));
+		const int AltTick = -Tick;
+		mem_copy(aAltData, &AltTick, sizeof(AltTick));
+
+		Storage.PurgeUntil(Tick - KeepTicks);
+		Storage.Add(Tick, Tick * 10, DataSize, aData, Tick % 2 ? sizeof(aAltData) : 0, aAltData);
+
+		// the oldest and the newest snapshot must still be found
+		for(int Lookup : {maximum(0, Tick - KeepTicks), Tick})
+		{
+			int64_t Tagtime;
+			const CSnapshot *pData;
+			const CSnapshot *pAltData;
+			ASSERT_EQ(Storage.Get(Lookup, &Tagtime, &pData, &pAltData), 256 + (Lookup % 7) * 64);
+			EXPECT_EQ(Tagtime, Lookup * 10);
+			int StoredTick;
+			mem_copy(&StoredTick, pData, sizeof(StoredTick));
+			EXPECT_EQ(StoredTick, Lookup);
+			if(Lookup % 2)
+			{
+				ASSERT_NE(pAltData, nullptr);
+				int StoredAltTick;
+				mem_copy(&StoredAltTick, pAltData, sizeof(StoredAltTick));
+				EXPECT_EQ(StoredAltTick, -Lookup);
+			}
+			else
+			{
+				EXPECT_EQ(pAltData, nullptr);
+			}
+		}
+		EXPECT_EQ(Storage.Get(Tick - KeepTicks - 1, nullptr, nullptr, nullptr), -1);
+		EXPECT_EQ(Storage.Get(Tick + 1, nullptr, nullptr, nullptr), -1);
+	}
+
+	const CSnapshotStorage::CStats &Stats = Storage.Stats();
+	EXPECT_EQ(Stats.m_NumReused + Stats.m_NumAllocated, (uint64_t)NumTicks);
+	EXPECT_GT(Stats.m_NumReused, Stats.m_NumAllocated);
+	EXPECT_GE(Stats.m_PeakBytes, Stats.m_CurrentBytes);
+
+	Storage.PurgeAll();
+	EXPECT_EQ(Storage.m_pFirst, nullptr);
+	EXPECT_EQ(Storage.m_pLast, nullptr);
+	EXPECT_EQ(Storage.Stats().m_CurrentBytes, 0u);
+	EXPECT_EQ(Storage.Get(NumTicks - 1, nullptr, nullptr, nullptr), -1);
+}
+
+TEST(Snapshot, StorageSharesIdenticalSnapshots)
+{
+	CSnapshotSharedPool Pool;
+	CSnapshotStorage aStorages[3];
+	for(auto &Storage : aStorages)
+		Storage.SetSharedPool(&Pool);
+
+	// build snapshots of 16 ints each so the crc sums are valid
+	auto BuildSnapshot = [](CSnapshotBuilder &Builder, int Value, bool KeepCrc = false) {
+		Builder.Init();
+		int *pItem = static_cast<int *>(Builder.NewItem(NETOBJTYPE_FLAG, 0, 16 * sizeof(int)));
+		for(int i = 0; i < 16; i++)
+			pItem[i] = Value + i;
+		// change the contents without changing the crc sum
+		if(KeepCrc)
+		{
+			pItem[0]++;
+			pItem[1]--;
+		}
+	};
+	CSnapshotBuilder Builder;
+	char aSame[CSnapshot::MAX_SIZE];
+	char aOther[CSnapshot::MAX_SIZE];
+	char aCollision[CSnapshot::MAX_SIZE];
+	BuildSnapshot(Builder, 1);
+	const int SameSize = Builder.Finish(aSame);
+	BuildSnapshot(Builder, 2);
+	const int OtherSize = Builder.Finish(aOther);
+	BuildSnapshot(Builder, 1, true);
+	ASSERT_EQ(Builder.Finish(aCollision), SameSize);
+	ASSERT_EQ(reinterpret_cast<CSnapshot *>(aCollision)->Crc(), reinterpret_cast<CSnapshot *>(aSame)->Crc());
+
+	aStorages[0].Add(1, 0, SameSize, aSame, 0, nullptr);
+	aStorages[1].Add(1, 0, SameSize, aSame, 0, nullptr);
+	aStorages[2].Add(1, 0, SameSize, aCollision, 0, nullptr);
+	aStorages[2].Add(2, 0, OtherSize, aOther, 0, nullptr);
+
+	const CSnapshot *apSnaps[3];
+	for(int i = 0; i < 3; i++)
+		ASSERT_EQ(aStorages[i].Get(1, nullptr, &apSnaps[i], nullptr), SameSize);
+	EXPECT_EQ(apSnaps[0], apSnaps[1]);
+	EXPECT_NE(apSnaps[0], apSnaps[2]);
+	EXPECT_EQ(mem_comp(apSnaps[0], aSame, SameSize), 0);
+	EXPECT_EQ(mem_comp(apSnaps[2], aCollision, SameSize), 0);
+	EXPECT_EQ(Pool.Stats().m_NumShared, 1u);
+	EXPECT_EQ(Pool.Stats().m_SavedBytes, (size_t)SameSize);
+
+	// the shared copy stays alive until the last storage drops it
+	aStorages[0].PurgeUntil(2);
+	ASSERT_EQ(aStorages[1].Get(1, nullptr, &apSnaps[1], nullptr), SameSize);
+	EXPECT_EQ(mem_comp(apSnaps[1], aSame, SameSize), 0);
+	EXPECT_EQ(Pool.Stats().m_SavedBytes, 0u);
+
+	aStorages[1].PurgeAll();
+	aStorages[2].PurgeUntil(2);
+	ASSERT_EQ(aStorages[2].Get(2, nullptr, &apSnaps[2], nullptr), OtherSize);
+	EXPECT_EQ(mem_comp(apSnaps[2], aOther, OtherSize), 0);
+
+	// snapshots with alternative are never shared
+	aStorages[0].Add(3, 0, SameSize, aSame, SameSize, aSame);
+	const size_t PoolBytes = Pool.Stats().m_CurrentBytes;
+	aStorages[2].PurgeAll();
+	EXPECT_LT(Pool.Stats().m_CurrentBytes, PoolBytes);
+	aStorages[0].PurgeAll();
+	EXPECT_EQ(Pool.Stats().m_CurrentBytes, 0u);
+}
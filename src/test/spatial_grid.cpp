@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <game/server/spatial_grid.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+class CTestEntity
+{
+public:
+	vec2 m_Pos;
+	float m_ProximityRadius;
+	CSpatialGridHandle m_GridHandle;
+};
+
+vec2 RandomPos(float Width, float Height)
+{
+	// some entities are outside of the map
+	return vec2(random_float(-200.0f, Width + 200.0f), random_float(-200.0f, Height + 200.0f));
+}
+
+// whether the circle of the entity overlaps the box, every exact
+// condition of the game world queries implies this
+bool Overlaps(const CTestEntity *pEnt, vec2 Min, vec2 Max)
+{
+	const vec2 Closest = vec2(clamp(pEnt->m_Pos.x, Min.x, Max.x), clamp(pEnt->m_Pos.y, Min.y, Max.y));
+	return distance(pEnt->m_Pos, Closest) <= pEnt->m_ProximityRadius;
+}
+
+std::vector<CTestEntity *> Filter(const std::vector<CTestEntity *> &vpEntities, vec2 Min, vec2 Max)
+{
+	std::vector<CTestEntity *> vpResult;
+	for(CTestEntity *pEnt : vpEntities)
+	{
+		if(Overlaps(pEnt, Min, Max))
+			vpResult.push_back(pEnt);
+	}
+	return vpResult;
+}
+
+} // namespace
+
+// the grid has to return every entity overlapping the box in the order
+// of the game world's entity list, newest first
+TEST(SpatialGrid, QueryMatchesList)
+{
+	const float Width = 200 * 32.0f;
+	const float Height = 100 * 32.0f;
+
+	for(int Round = 0; Round < 20; Round++)
+	{
+		std::vector<CTestEntity> vEntities(64);
+		std::vector<CTestEntity *> vpList;
+		CSpatialGrid<CTestEntity> Grid;
+		Grid.Init(Width, Height, 8 * 32.0f);
+		uint64_t NextSeq = 0;
+		auto Insert = [&](CTestEntity *pEnt) {
+			vpList.insert(vpList.begin(), pEnt);
+			Grid.Insert(pEnt, pEnt->m_Pos, pEnt->m_ProximityRadius, NextSeq++);
+		};
+
+		// clump the entities so that many hits are common
+		const float Spread = Round % 2 ? Width : 600.0f;
+		for(auto &Entity : vEntities)
+		{
+			Entity.m_Pos = vec2(random_float(Spread), random_float(minimum(Spread, Height)));
+			// entities exactly on cell borders
+			if(secure_rand_below(2))
+				Entity.m_Pos = vec2(std::round(Entity.m_Pos.x / 64.0f) * 64.0f, std::round(Entity.m_Pos.y / 64.0f) * 64.0f);
+			Entity.m_ProximityRadius = Round % 3 ? 28.0f : random_float(1.0f, 100.0f);
+			Insert(&Entity);
+		}
+
+		std::vector<CTestEntity *> vpQuery;
+		for(int Step = 0; Step < 200; Step++)
+		{
+			// move, respawn and teleport some entities
+			for(auto &Entity : vEntities)
+			{
+				const int Action = secure_rand_below(20);
+				if(Action == 0)
+				{
+					vpList.erase(std::find(vpList.begin(), vpList.end(), &Entity));
+					Grid.Remove(&Entity);
+					Insert(&Entity);
+				}
+				else if(Action == 1)
+					Entity.m_Pos = RandomPos(Width, Height);
+				else
+					Entity.m_Pos += vec2(random_float(-40.0f, 40.0f), random_float(-40.0f, 40.0f));
+				Grid.Move(&Entity, Entity.m_Pos);
+			}
+
+			// boxes of radius queries and of lines, some longer than any laser
+			const vec2 Pos = RandomPos(Width, Height);
+			const vec2 To = Step % 4 ? Pos + direction(random_float(2 * pi)) * random_float(900.0f) : RandomPos(Width, Height);
+			const float Radius = Step % 2 ? 0.0f : random_float(800.0f);
+			const vec2 Min = vec2(minimum(Pos.x, To.x), minimum(Pos.y, To.y)) - vec2(Radius, Radius);
+			const vec2 Max = vec2(maximum(Pos.x, To.x), maximum(Pos.y, To.y)) + vec2(Radius, Radius);
+
+			Grid.Query(Min, Max, vpQuery);
+			EXPECT_EQ(Filter(vpQuery, Min, Max), Filter(vpList, Min, Max));
+		}
+	}
+}
+
+TEST(SpatialGrid, RemoveKeepsOtherItems)
+{
+	std::vector<CTestEntity> vEntities(10);
+	CSpatialGrid<CTestEntity> Grid;
+	Grid.Init(1000.0f, 1000.0f, 100.0f);
+	for(int i = 0; i < (int)vEntities.size(); i++)
+	{
+		vEntities[i].m_Pos = vec2(50.0f, 50.0f);
+		Grid.Insert(&vEntities[i], vEntities[i].m_Pos, 0.0f, i);
+	}
+	Grid.Remove(&vEntities[3]);
+	Grid.Remove(&vEntities[3]);
+	Grid.Remove(&vEntities[9]);
+
+	std::vector<CTestEntity *> vpResult;
+	Grid.Query(vec2(0.0f, 0.0f), vec2(10.0f, 10.0f), vpResult);
+	ASSERT_EQ(vpResult.size(), 8u);
+	// newest first
+	EXPECT_EQ(vpResult.front(), &vEntities[8]);
+	EXPECT_EQ(vpResult.back(), &vEntities[0]);
+	EXPECT_EQ(vEntities[3].m_GridHandle.m_Cell, -1);
+
+	Grid.Move(&vEntities[0], vec2(950.0f, 950.0f));
+	Grid.Query(vec2(0.0f, 0.0f), vec2(10.0f, 10.0f), vpResult);
+	EXPECT_EQ(vpResult.size(), 7u);
+	Grid.Query(vec2(2000.0f, 2000.0f), vec2(3000.0f, 3000.0f), vpResult);
+	ASSERT_EQ(vpResult.size(), 1u);
+	EXPECT_EQ(vpResult[0], &vEntities[0]);
+}
+
+TEST(SpatialGrid, QueryGrowsByLargestRadius)
+{
+	CTestEntity Small = {vec2(50.0f, 50.0f), 10.0f, {}};
+	CTestEntity Big = {vec2(550.0f, 50.0f), 150.0f, {}};
+	CSpatialGrid<CTestEntity> Grid;
+	Grid.Init(1000.0f, 1000.0f, 100.0f);
+	Grid.Insert(&Small, Small.m_Pos, Small.m_ProximityRadius, 0);
+
+	// the box is two cells away from the small entity
+	std::vector<CTestEntity *> vpResult;
+	Grid.Query(vec2(250.0f, 0.0f), vec2(300.0f, 100.0f), vpResult);
+	EXPECT_TRUE(vpResult.empty());
+
+	// the big entity reaches into the box from the cell next to it
+	Grid.Insert(&Big, Big.m_Pos, Big.m_ProximityRadius, 1);
+	EXPECT_TRUE(Overlaps(&Big, vec2(380.0f, 0.0f), vec2(420.0f, 100.0f)));
+	Grid.Query(vec2(380.0f, 0.0f), vec2(420.0f, 100.0f), vpResult);
+	ASSERT_EQ(vpResult.size(), 1u);
+	EXPECT_EQ(vpResult[0], &Big);
+}
@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <game/server/spawn_danger.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+typedef CSpawnDanger::CCharacterPos CCharacterPos;
+
+// spawn points clumped into a few rooms, like the dense spawn areas of fng and zCatch maps
+void DenseSpawnPoints(std::vector<vec2> *pavSpawnPoints, int NumRooms)
+{
+	for(int Type = 0; Type < CSpawnDanger::NUM_SPAWN_TYPES; Type++)
+	{
+		pavSpawnPoints[Type].clear();
+		for(int Room = 0; Room < NumRooms; Room++)
+		{
+			const vec2 Corner = vec2(random_float(6000.0f), random_float(3000.0f));
+			for(int y = 0; y < 4; y++)
+				for(int x = 0; x < 8; x++)
+					pavSpawnPoints[Type].push_back(Corner + vec2(x * 64.0f + 16.0f, y * 96.0f + 16.0f));
+		}
+	}
+}
+
+// the danger summed in doubles with the characters on the position counted apart
+double ExactScore(vec2 Pos, const std::vector<CCharacterPos> &vCharacters)
+{
+	double Sum = 0.0;
+	int NumOnTop = 0;
+	for(const CCharacterPos &Character : vCharacters)
+	{
+		const float d = distance(Pos, Character.m_Pos);
+		if(d == 0)
+			NumOnTop++;
+		else
+			Sum += 1.0 / d;
+	}
+	return NumOnTop * 1000000000.0 + Sum;
+}
+
+// occupancy like IGameController::FreeSpawnPos with player collision on
+bool FreePos(const std::vector<CCharacterPos> &vCharacters, vec2 SpawnPoint, int *pOffset)
+{
+	for(int Offset = 0; Offset < CSpawnDanger::NUM_OFFSETS; Offset++)
+	{
+		bool Free = true;
+		for(const CCharacterPos &Character : vCharacters)
+		{
+			if(distance(Character.m_Pos, SpawnPoint + CSpawnDanger::SpawnOffset(Offset)) <= 28.0f)
+			{
+				Free = false;
+				break;
+			}
+		}
+		if(Free)
+		{
+			*pOffset = Offset;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ExpectScores(const CSpawnDanger &Danger, const std::vector<vec2> *pavSpawnPoints, const std::vector<CCharacterPos> &vCharacters)
+{
+	for(int Type = 0; Type < CSpawnDanger::NUM_SPAWN_TYPES; Type++)
+	{
+		for(size_t i = 0; i < pavSpawnPoints[Type].size(); i++)
+		{
+			for(int Offset = 0; Offset < CSpawnDanger::NUM_OFFSETS; Offset++)
+			{
+				const double Expected = ExactScore(pavSpawnPoints[Type][i] + CSpawnDanger::SpawnOffset(Offset), vCharacters);
+				ASSERT_NEAR(Danger.Score(Type, i, Offset), Expected, Expected * 1e-12);
+			}
+		}
+	}
+}
+
+// the order of IGameController::CanSpawn without teams
+CSpawnEval Spawn(const std::vector<vec2> *pavSpawnPoints, const std::vector<CCharacterPos> &vCharacters, const CSpawnDanger *pScores)
+{
+	CSpawnEval Eval;
+	const CSpawnDanger::FFreePos Free = [&](vec2 SpawnPoint, int *pOffset) { return FreePos(vCharacters, SpawnPoint, pOffset); };
+	for(int Type = 0; Type < CSpawnDanger::NUM_SPAWN_TYPES; Type++)
+		CSpawnDanger::EvaluateSpawnType(&Eval, pavSpawnPoints, Type, vCharacters.data(), vCharacters.size(), pScores, Free);
+	return Eval;
+}
+
+} // namespace
+
+TEST(SpawnDanger, RebuildMatchesExactScore)
+{
+	std::vector<vec2> avSpawnPoints[CSpawnDanger::NUM_SPAWN_TYPES];
+	DenseSpawnPoints(avSpawnPoints, 3);
+
+	std::vector<CCharacterPos> vCharacters;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		vCharacters.push_back({i, vec2(random_float(6000.0f), random_float(3000.0f))});
+	// a character standing exactly on a spawn point
+	vCharacters[5].m_Pos = avSpawnPoints[1][7];
+
+	CSpawnDanger Danger;
+	Danger.Rebuild(avSpawnPoints, vCharacters.data(), vCharacters.size(), 100, 0);
+	EXPECT_TRUE(Danger.Valid(100, 0));
+	EXPECT_FALSE(Danger.Valid(101, 0));
+	EXPECT_FALSE(Danger.Valid(100, 1));
+
+	ExpectScores(Danger, avSpawnPoints, vCharacters);
+
+	// the character on the spawn point does not swallow the others
+	std::vector<CCharacterPos> vOthers = vCharacters;
+	vOthers.erase(vOthers.begin() + 5);
+	const double Others = ExactScore(avSpawnPoints[1][7], vOthers);
+	EXPECT_NEAR(Danger.Score(1, 7) - 1000000000.0, Others, 1e-6);
+
+	// and leaves no trace when it is gone
+	Danger.Update(vOthers.data(), vOthers.size());
+	EXPECT_NEAR(Danger.Score(1, 7), Others, Others * 1e-12);
+
+	Danger.Invalidate();
+	EXPECT_FALSE(Danger.Valid(100, 0));
+}
+
+TEST(SpawnDanger, MassRespawnMatchesFullEvaluation)
+{
+	std::vector<vec2> avSpawnPoints[CSpawnDanger::NUM_SPAWN_TYPES];
+	CSpawnDanger Danger;
+
+	for(int Round = 0; Round < 20; Round++)
+	{
+		DenseSpawnPoints(avSpawnPoints, 1 + Round % 4);
+
+		// some players are still alive at the round start, newest first
+		std::vector<CCharacterPos> vCharacters;
+		for(int i = 0; i < MAX_CLIENTS; i += 1 + secure_rand_below(4))
+			vCharacters.insert(vCharacters.begin(), {i, vec2(random_float(6000.0f), random_float(3000.0f))});
+		Danger.Rebuild(avSpawnPoints, vCharacters.data(), vCharacters.size(), Round, 0);
+
+		for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+		{
+			auto It = std::find_if(vCharacters.begin(), vCharacters.end(), [&](const CCharacterPos &Character) { return Character.m_ClientId == ClientId; });
+			if(It != vCharacters.end())
+			{
+				// the others die or move while the tick goes on
+				if(secure_rand_below(3) == 0)
+					vCharacters.erase(It);
+				else if(secure_rand_below(2) == 0)
+					It->m_Pos += vec2(random_float(-50.0f, 50.0f), random_float(-50.0f, 50.0f));
+				continue;
+			}
+
+			Danger.Update(vCharacters.data(), vCharacters.size());
+			ExpectScores(Danger, avSpawnPoints, vCharacters);
+
+			// sv_spawn_danger_cache 1 and 0 pick the same position unless two
+			// were equally dangerous up to the float sums of the uncached scores
+			const CSpawnEval Cached = Spawn(avSpawnPoints, vCharacters, &Danger);
+			const CSpawnEval Full = Spawn(avSpawnPoints, vCharacters, nullptr);
+			ASSERT_TRUE(Cached.m_Got);
+			ASSERT_TRUE(Full.m_Got);
+			EXPECT_EQ(Full.m_Score, CSpawnDanger::PositionScore(Full.m_Pos, vCharacters.data(), vCharacters.size()));
+			EXPECT_NEAR(Cached.m_Score, ExactScore(Cached.m_Pos, vCharacters), Cached.m_Score * 1e-12);
+			if(Cached.m_Pos != Full.m_Pos)
+			{
+				EXPECT_NEAR(Cached.m_Score, ExactScore(Full.m_Pos, vCharacters), Full.m_Score * 1e-5);
+			}
+
+			// spawn there, most of the time shifted next to an occupied spawn point
+			vCharacters.insert(vCharacters.begin(), {ClientId, Cached.m_Pos});
+		}
+	}
+}
+
+TEST(SpawnDanger, FullSpawnTakesFirstSpawnPoint)
+{
+	std::vector<vec2> avSpawnPoints[CSpawnDanger::NUM_SPAWN_TYPES];
+	avSpawnPoints[1] = {vec2(100.0f, 100.0f), vec2(1000.0f, 100.0f), vec2(2000.0f, 100.0f)};
+	avSpawnPoints[2] = {vec2(3000.0f, 100.0f)};
+
+	// characters stand on every position of every spawn point, type 0 has none
+	std::vector<CCharacterPos> vCharacters;
+	int ClientId = 0;
+	for(int Type = 1; Type < CSpawnDanger::NUM_SPAWN_TYPES; Type++)
+		for(const vec2 &SpawnPoint : avSpawnPoints[Type])
+			for(const vec2 Offset : {vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f)})
+				vCharacters.push_back({ClientId++, SpawnPoint + Offset});
+
+	CSpawnDanger Danger;
+	Danger.Rebuild(avSpawnPoints, vCharacters.data(), vCharacters.size(), 1, 0);
+	for(const CSpawnDanger *pScores : {(const CSpawnDanger *)&Danger, (const CSpawnDanger *)nullptr})
+	{
+		const CSpawnEval Eval = Spawn(avSpawnPoints, vCharacters, pScores);
+		EXPECT_TRUE(Eval.m_Got);
+		EXPECT_EQ(Eval.m_Pos, avSpawnPoints[1][0]);
+		if(pScores)
+			EXPECT_EQ(Eval.m_Score, ExactScore(avSpawnPoints[1][0], vCharacters));
+		else
+			EXPECT_EQ(Eval.m_Score, CSpawnDanger::PositionScore(avSpawnPoints[1][0], vCharacters.data(), vCharacters.size()));
+	}
+
+	// the only free position is taken
+	vCharacters.erase(vCharacters.begin() + 5 * 2 + 3);
+	Danger.Update(vCharacters.data(), vCharacters.size());
+	for(const CSpawnDanger *pScores : {(const CSpawnDanger *)&Danger, (const CSpawnDanger *)nullptr})
+	{
+		const CSpawnEval Eval = Spawn(avSpawnPoints, vCharacters, pScores);
+		EXPECT_EQ(Eval.m_Pos, avSpawnPoints[1][2] + vec2(32.0f, 0.0f));
+	}
+}
@@ -6,6 +6,7 @@
 #include <engine/shared/config.h>
 #include <game/gamecore.h>
 #include <game/server/teehistorian.h>
+#include <game/server/teehistorian_reader.h>
 
 #include <vector>
 
@@ -904,3 +905,108 @@ TEST_F(TeeHistorian, PrevGameUuid)
 	EXPECT_STREQ(JsonPrevGameUuid, "fe19c218-f555-4002-a273-126c59ccc17a");
 	json_value_free(pJson);
 }
+
+TEST_F(TeeHistorian, ReadBack)
+{
+	CNetObj_PlayerInput Input = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	const unsigned char aMessage[] = {0x2a, 0x00};
+
+	m_TH.RecordPlayerJoin(3, CTeeHistorian::PROTOCOL_7);
+	Tick(1);
+	Player(0, 4, 5);
+	Player(3, 100, 200);
+	Inputs();
+	m_TH.RecordPlayerInput(3, 1, &Input);
+	Tick(2);
+	// implicit tick, player 0 did not move
+	Player(0, 4, 5);
+	Player(3, 110, 190);
+	Inputs();
+	Input.m_Direction = -1;
+	m_TH.RecordPlayerInput(3, 1, &Input);
+	m_TH.RecordPlayerMessage(3, aMessage, sizeof(aMessage));
+	Tick(3);
+	// explicit tick, a higher client id than in the previous tick
+	Player(0, 4, 5);
+	Player(3, 110, 190);
+	Player(5, 7, 8);
+	Tick(40);
+	DeadPlayer(3);
+	Inputs();
+	m_TH.RecordPlayerDrop(3, "too many pancakes");
+	Finish();
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Open(m_vBuffer.data(), m_vBuffer.size())) << Reader.ErrorMessage();
+	EXPECT_STREQ(Reader.HeaderString("map_name"), "Kobra 3 Solo");
+	EXPECT_STREQ(Reader.HeaderString("prng_description"), "test-prng:02468ace");
+	EXPECT_EQ(Reader.HeaderString("no_such_field"), nullptr);
+
+	for(int Pass = 0; Pass < 2; Pass++)
+	{
+		CTeeHistorianReader::CChunk Chunk;
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_EX);
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_JOIN);
+		EXPECT_EQ(Chunk.m_ClientId, 3);
+		EXPECT_EQ(Reader.Tick(), 0);
+
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_PLAYER);
+		EXPECT_EQ(Chunk.m_ClientId, 0);
+		EXPECT_EQ(Chunk.m_X, 4);
+		EXPECT_EQ(Chunk.m_Y, 5);
+		EXPECT_EQ(Reader.Tick(), 1);
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_ClientId, 3);
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_INPUT);
+		EXPECT_EQ(Chunk.m_Input.m_Direction, 1);
+		EXPECT_EQ(Chunk.m_Input.m_TargetX, 2);
+
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_PLAYER);
+		EXPECT_EQ(Chunk.m_ClientId, 3);
+		EXPECT_EQ(Chunk.m_X, 110);
+		EXPECT_EQ(Chunk.m_Y, 190);
+		EXPECT_EQ(Reader.Tick(), 2);
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_INPUT);
+		EXPECT_EQ(mem_comp(&Chunk.m_Input, &Input, sizeof(Input)), 0);
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_MESSAGE);
+		ASSERT_EQ(Chunk.m_DataSize, (int)sizeof(aMessage));
+		EXPECT_EQ(mem_comp(Chunk.m_pData, aMessage, sizeof(aMessage)), 0);
+
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_PLAYER);
+		EXPECT_EQ(Chunk.m_ClientId, 5);
+		EXPECT_EQ(Reader.Tick(), 3);
+
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_PLAYER_DEAD);
+		EXPECT_EQ(Chunk.m_ClientId, 3);
+		EXPECT_EQ(Reader.Tick(), 40);
+		ASSERT_TRUE(Reader.Next(&Chunk));
+		EXPECT_EQ(Chunk.m_Type, CTeeHistorianReader::CHUNK_DROP);
+		EXPECT_STREQ(Chunk.m_pString, "too many pancakes");
+
+		EXPECT_FALSE(Reader.Next(&Chunk));
+		EXPECT_TRUE(Reader.Finished());
+		EXPECT_FALSE(Reader.Error());
+		Reader.Rewind();
+	}
+
+	// a cut off file ends with an error
+	ASSERT_TRUE(Reader.Open(m_vBuffer.data(), m_vBuffer.size() - 3));
+	CTeeHistorianReader::CChunk Chunk;
+	while(Reader.Next(&Chunk))
+	{
+	}
+	EXPECT_FALSE(Reader.Finished());
+	EXPECT_TRUE(Reader.Error());
+
+	const unsigned char aGarbage[] = "not a teehistorian file";
+	EXPECT_FALSE(Reader.Open(aGarbage, sizeof(aGarbage)));
+}
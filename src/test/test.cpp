@@ -3,6 +3,8 @@
 
 #include <base/logger.h>
 #include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/shared/map.h>
 #include <engine/storage.h>
 
 #include <algorithm>
@@ -132,6 +134,25 @@ CTestInfo::~CTestInfo()
 	}
 }
 
+CTestMapLoader::CTestMapLoader() :
+	m_pKernel(IKernel::Create()), m_pStorage(CreateLocalStorage()), m_pMap(std::make_unique<CMap>())
+{
+	m_pKernel->RegisterInterface(m_pStorage.get(), false);
+	m_pKernel->RegisterInterface(static_cast<IEngineMap *>(m_pMap.get()), false);
+}
+
+CTestMapLoader::~CTestMapLoader() = default;
+
+bool CTestMapLoader::Load(const char *pMapName)
+{
+	return m_pStorage && m_pMap->Load(pMapName);
+}
+
+IMap *CTestMapLoader::Map()
+{
+	return m_pMap.get();
+}
+
 int main(int argc, const char **argv)
 {
 	CCmdlineFix CmdlineFix(&argc, &argv);
@@ -2,7 +2,11 @@
 #define TEST_TEST_H
 
 #include <cstddef>
+#include <memory>
 
+class CMap;
+class IKernel;
+class IMap;
 class IStorage;
 
 class CTestInfo
@@ -16,4 +20,18 @@ public:
 	char m_aFilenamePrefix[128];
 	char m_aFilename[128];
 };
+
+// loads a map from the data directory the way the server does
+class CTestMapLoader
+{
+	std::unique_ptr<IKernel> m_pKernel;
+	std::unique_ptr<IStorage> m_pStorage;
+	std::unique_ptr<CMap> m_pMap;
+
+public:
+	CTestMapLoader();
+	~CTestMapLoader();
+	bool Load(const char *pMapName);
+	IMap *Map();
+};
 #endif // TEST_TEST_H
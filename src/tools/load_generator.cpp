@@ -0,0 +1,584 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/message.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/protocol7.h>
+#include <engine/shared/protocol_ex.h>
+
+#include <game/generated/protocol.h>
+#include <game/generated/protocol7.h>
+#include <game/version.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+static const char *TOOL_NAME = "load_generator";
+
+enum
+{
+	INPUTS_IDLE,
+	INPUTS_SCRIPTED,
+	INPUTS_RANDOM,
+};
+
+static int64_t TickTime()
+{
+	return time_freq() / SERVER_TICK_SPEED;
+}
+
+static double ToMs(int64_t Time)
+{
+	return Time * 1000.0 / time_freq();
+}
+
+// sorts the samples
+static int64_t Percentile(std::vector<int64_t> &vSamples, double Fraction)
+{
+	if(vSamples.empty())
+		return 0;
+	std::sort(vSamples.begin(), vSamples.end());
+	return vSamples[std::min<size_t>(vSamples.size() * Fraction, vSamples.size() - 1)];
+}
+
+class CLoadClient
+{
+public:
+	enum
+	{
+		STATE_OFFLINE,
+		STATE_CONNECTING,
+		STATE_LOADING,
+		STATE_INGAME,
+		STATE_DROPPED,
+	};
+
+	int m_Id;
+	bool m_Sixup;
+	int m_State = STATE_OFFLINE;
+	CNetClient m_Net;
+
+	CNetObj_PlayerInput m_Input = {};
+	int m_InputMargin = 2;
+	int m_NumInputs = 0;
+	int m_NumLateInputs = 0;
+
+	// snapshot that is being received
+	int m_PartsTick = -1;
+	int m_NumPartsReceived = 0;
+
+	int m_AckTick = -1;
+	int64_t m_AckTime = 0;
+	int m_NumSnapshots = 0;
+	int m_aNumTickDeltas[3] = {};
+	uint64_t m_SnapBytes = 0;
+	uint64_t m_TotalBytes = 0;
+	// receive time minus the tick start, relative to an arbitrary base
+	std::vector<int64_t> m_vSnapOffsets;
+	// difference between the snapshot intervals and their ticks
+	std::vector<int64_t> m_vSnapJitter;
+
+	CLoadClient(int Id, bool Sixup) :
+		m_Id(Id), m_Sixup(Sixup)
+	{
+	}
+
+	bool Connect(const NETADDR &Addr)
+	{
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = NETTYPE_ALL;
+		if(!m_Net.Open(BindAddr))
+			return false;
+		if(m_Sixup)
+			m_Net.Connect7(&Addr, 1);
+		else
+			m_Net.Connect(&Addr, 1);
+		m_State = STATE_CONNECTING;
+		return true;
+	}
+
+	void SendMsg(CMsgPacker *pMsg, int Flags)
+	{
+		// the ids are already the ones of the client's protocol
+		CPacker Packer;
+		Packer.Reset();
+		if(pMsg->m_MsgId < OFFSET_UUID)
+		{
+			Packer.AddInt((pMsg->m_MsgId << 1) | (pMsg->m_System ? 1 : 0));
+		}
+		else
+		{
+			Packer.AddInt(pMsg->m_System ? 1 : 0); // NETMSG_EX, NETMSGTYPE_EX
+			g_UuidManager.PackUuid(pMsg->m_MsgId, &Packer);
+		}
+		Packer.AddRaw(pMsg->Data(), pMsg->Size());
+
+		CNetChunk Packet;
+		mem_zero(&Packet, sizeof(Packet));
+		Packet.m_ClientId = 0;
+		Packet.m_pData = Packer.Data();
+		Packet.m_DataSize = Packer.Size();
+		Packet.m_Flags = Flags;
+		m_Net.Send(&Packet);
+	}
+
+	void SendInfo()
+	{
+		if(m_Sixup)
+		{
+			CMsgPacker Msg(protocol7::NETMSG_INFO, true);
+			Msg.AddString(GAME_NETVERSION7, 128);
+			Msg.AddString("");
+			Msg.AddInt(CLIENT_VERSION7);
+			SendMsg(&Msg, NETSENDFLAG_VITAL | NETSENDFLAG_FLUSH);
+			return;
+		}
+
+		const CUuid ConnectionId = RandomUuid();
+		CMsgPacker MsgVer(NETMSG_CLIENTVER, true);
+		MsgVer.AddRaw(&ConnectionId, sizeof(ConnectionId));
+		MsgVer.AddInt(DDNET_VERSION_NUMBER);
+		MsgVer.AddString(GAME_NAME " " GAME_RELEASE_VERSION);
+		SendMsg(&MsgVer, NETSENDFLAG_VITAL);
+
+		CMsgPacker Msg(NETMSG_INFO, true);
+		Msg.AddString(GAME_NETVERSION);
+		Msg.AddString("");
+		SendMsg(&Msg, NETSENDFLAG_VITAL | NETSENDFLAG_FLUSH);
+	}
+
+	void SendStartInfo()
+	{
+		char aName[16];
+		str_format(aName, sizeof(aName), "load %d", m_Id);
+		if(m_Sixup)
+		{
+			protocol7::CNetMsg_Cl_StartInfo Info;
+			Info.m_pName = aName;
+			Info.m_pClan = "";
+			Info.m_Country = -1;
+			static const char *s_apSkinParts[protocol7::NUM_SKINPARTS] = {"standard", "", "", "standard", "standard", "standard"};
+			for(int Part = 0; Part < protocol7::NUM_SKINPARTS; Part++)
+			{
+				Info.m_apSkinPartNames[Part] = s_apSkinParts[Part];
+				Info.m_aUseCustomColors[Part] = 0;
+				Info.m_aSkinPartColors[Part] = 0;
+			}
+			CMsgPacker Msg(protocol7::NETMSGTYPE_CL_STARTINFO, false);
+			Info.Pack(&Msg);
+			SendMsg(&Msg, NETSENDFLAG_VITAL | NETSENDFLAG_FLUSH);
+			return;
+		}
+
+		CNetMsg_Cl_StartInfo Info;
+		Info.m_pName = aName;
+		Info.m_pClan = "";
+		Info.m_Country = -1;
+		Info.m_pSkin = "default";
+		Info.m_UseCustomColor = 0;
+		Info.m_ColorBody = 0;
+		Info.m_ColorFeet = 0;
+		CMsgPacker Msg(NETMSGTYPE_CL_STARTINFO, false);
+		Info.Pack(&Msg);
+		SendMsg(&Msg, NETSENDFLAG_VITAL | NETSENDFLAG_FLUSH);
+	}
+
+	void UpdateInput(int Inputs, int Tick)
+	{
+		CNetObj_PlayerInput &Input = m_Input;
+		Input.m_PlayerFlags = m_Sixup ? 0 : PLAYERFLAG_PLAYING;
+		bool Fire = false;
+		if(Inputs == INPUTS_IDLE)
+		{
+			Input.m_TargetX = 100;
+			Input.m_TargetY = 0;
+		}
+		else if(Inputs == INPUTS_SCRIPTED)
+		{
+			// shifted per client so they do not move in lockstep
+			const int t = Tick + m_Id * 7;
+			Input.m_Direction = (t / 50) % 2 ? 1 : -1;
+			Input.m_Jump = t % 40 < 5;
+			Input.m_Hook = t % 60 < 10;
+			Fire = t % 25 == 0;
+			const float Angle = t * 0.05f;
+			Input.m_TargetX = round_to_int(std::cos(Angle) * 200.0f);
+			Input.m_TargetY = round_to_int(std::sin(Angle) * 200.0f);
+		}
+		else
+		{
+			if(rand() % 10 == 0)
+				Input.m_Direction = rand() % 3 - 1;
+			if(rand() % 10 == 0)
+				Input.m_Jump = !Input.m_Jump;
+			if(rand() % 20 == 0)
+				Input.m_Hook = !Input.m_Hook;
+			Fire = rand() % 10 == 0;
+			Input.m_TargetX = std::clamp(Input.m_TargetX + rand() % 41 - 20, -300, 300);
+			Input.m_TargetY = std::clamp(Input.m_TargetY + rand() % 41 - 20, -300, 300);
+			if(Input.m_TargetX == 0 && Input.m_TargetY == 0)
+				Input.m_TargetX = 1;
+		}
+		// the fire count is odd while the button is held
+		if(Fire != (bool)(Input.m_Fire & 1))
+			Input.m_Fire++;
+	}
+
+	void SendInput(int64_t Now)
+	{
+		// estimate the current server tick from the last snapshot
+		if(m_AckTick < 0)
+			return;
+		const int ServerTick = m_AckTick + (Now - m_AckTime) / TickTime();
+		CMsgPacker Msg(m_Sixup ? (int)protocol7::NETMSG_INPUT : (int)NETMSG_INPUT, true);
+		Msg.AddInt(m_AckTick);
+		Msg.AddInt(ServerTick + m_InputMargin);
+		Msg.AddInt(sizeof(m_Input));
+		const int *pData = (const int *)&m_Input;
+		for(size_t i = 0; i < sizeof(m_Input) / sizeof(int); i++)
+			Msg.AddInt(pData[i]);
+		SendMsg(&Msg, NETSENDFLAG_FLUSH);
+		m_NumInputs++;
+	}
+
+	void OnSnapshotPart(int Msg, CUnpacker *pUnpacker, int64_t Now)
+	{
+		const int Tick = pUnpacker->GetInt();
+		pUnpacker->GetInt(); // delta tick
+		int NumParts = 1;
+		if(Msg == NETMSG_SNAP)
+		{
+			NumParts = pUnpacker->GetInt();
+			pUnpacker->GetInt(); // part
+		}
+		if(pUnpacker->Error() || Tick <= m_AckTick)
+			return;
+
+		if(Tick != m_PartsTick)
+		{
+			m_PartsTick = Tick;
+			m_NumPartsReceived = 0;
+		}
+		if(++m_NumPartsReceived < NumParts)
+			return;
+
+		// the snapshot is not unpacked, acking it makes the server send
+		// deltas like to a real client
+		if(m_AckTick >= 0)
+		{
+			const int TickDelta = Tick - m_AckTick;
+			m_aNumTickDeltas[std::min(TickDelta, 3) - 1]++;
+			m_vSnapJitter.push_back(absolute((Now - m_AckTime) - TickDelta * TickTime()));
+		}
+		m_vSnapOffsets.push_back(Now - Tick * TickTime());
+		m_AckTick = Tick;
+		m_AckTime = Now;
+		m_NumSnapshots++;
+	}
+
+	void OnMessage(CNetChunk *pPacket, int64_t Now)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(pPacket->m_pData, pPacket->m_DataSize);
+		CMsgPacker Packer(NETMSG_EX, true);
+		int Msg;
+		bool Sys;
+		CUuid Uuid;
+		const int Result = UnpackMessageId(&Msg, &Sys, &Uuid, &Unpacker, &Packer);
+		if(Result == UNPACKMESSAGE_ERROR)
+			return;
+		if(Result == UNPACKMESSAGE_ANSWER)
+			SendMsg(&Packer, NETSENDFLAG_VITAL);
+
+		m_TotalBytes += pPacket->m_DataSize;
+		const bool Vital = pPacket->m_Flags & NET_CHUNKFLAG_VITAL;
+		if(!Sys)
+		{
+			if(Msg == (m_Sixup ? (int)protocol7::NETMSGTYPE_SV_READYTOENTER : (int)NETMSGTYPE_SV_READYTOENTER) && Vital)
+			{
+				CMsgPacker Enter(m_Sixup ? (int)protocol7::NETMSG_ENTERGAME : (int)NETMSG_ENTERGAME, true);
+				SendMsg(&Enter, NETSENDFLAG_VITAL | NETSENDFLAG_FLUSH);
+				m_State = STATE_INGAME;
+			}
+			return;
+		}
+
+		// 0.7 inserts NETMSG_SERVERINFO before them
+		if(m_Sixup && Msg >= protocol7::NETMSG_CON_READY && Msg <= protocol7::NETMSG_INPUTTIMING)
+			Msg -= 1;
+		else if(m_Sixup && Msg == protocol7::NETMSG_SERVERINFO)
+			return;
+
+		if(Msg == NETMSG_MAP_CHANGE && Vital)
+		{
+			// the map is not downloaded
+			CMsgPacker Ready(m_Sixup ? (int)protocol7::NETMSG_READY : (int)NETMSG_READY, true);
+			SendMsg(&Ready, NETSENDFLAG_VITAL | NETSENDFLAG_FLUSH);
+			m_State = STATE_LOADING;
+		}
+		else if(Msg == NETMSG_CON_READY && Vital)
+		{
+			SendStartInfo();
+		}
+		else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
+		{
+			m_SnapBytes += pPacket->m_DataSize;
+			OnSnapshotPart(Msg, &Unpacker, Now);
+		}
+		else if(Msg == NETMSG_INPUTTIMING)
+		{
+			Unpacker.GetInt(); // intended tick
+			const int TimeLeft = Unpacker.GetInt();
+			if(Unpacker.Error())
+				return;
+			// keep the inputs arriving before their tick, like the client's prediction margin
+			if(TimeLeft < 0)
+			{
+				m_NumLateInputs++;
+				m_InputMargin = std::min(m_InputMargin + 1, 10);
+			}
+			else if(TimeLeft > 3 * 1000 / SERVER_TICK_SPEED)
+			{
+				m_InputMargin = std::max(m_InputMargin - 1, 1);
+			}
+		}
+	}
+
+	void Update(int64_t Now)
+	{
+		if(m_State == STATE_OFFLINE || m_State == STATE_DROPPED)
+			return;
+
+		m_Net.Update();
+		if(m_State == STATE_CONNECTING && m_Net.State() == NETSTATE_ONLINE)
+		{
+			SendInfo();
+			m_State = STATE_LOADING;
+		}
+		else if(m_Net.State() == NETSTATE_OFFLINE)
+		{
+			log_warn(TOOL_NAME, "client %d dropped: %s", m_Id, m_Net.ErrorString());
+			m_State = STATE_DROPPED;
+			return;
+		}
+
+		CNetChunk Packet;
+		SECURITY_TOKEN ResponseToken;
+		while(m_Net.Recv(&Packet, &ResponseToken, m_Sixup))
+		{
+			if(!(Packet.m_Flags & NETSENDFLAG_CONNLESS))
+				OnMessage(&Packet, Now);
+		}
+	}
+
+	void Disconnect()
+	{
+		if(m_State != STATE_OFFLINE && m_State != STATE_DROPPED)
+		{
+			m_Net.Disconnect("load test finished");
+			m_Net.Update();
+		}
+		m_Net.Close();
+	}
+};
+
+static void PrintReport(std::vector<std::unique_ptr<CLoadClient>> &vpClients, int64_t Duration)
+{
+	const double Seconds = Duration / (double)time_freq();
+	int aNumStates[CLoadClient::STATE_DROPPED + 1] = {};
+	int NumSnapshots = 0;
+	int NumInputs = 0;
+	int NumLateInputs = 0;
+	int aNumTickDeltas[3] = {};
+	uint64_t SnapBytes = 0;
+	uint64_t TotalBytes = 0;
+	std::vector<int64_t> vJitter;
+	std::vector<int64_t> vLateness;
+	for(auto &pClient : vpClients)
+	{
+		aNumStates[pClient->m_State]++;
+		NumSnapshots += pClient->m_NumSnapshots;
+		NumInputs += pClient->m_NumInputs;
+		NumLateInputs += pClient->m_NumLateInputs;
+		for(int i = 0; i < 3; i++)
+			aNumTickDeltas[i] += pClient->m_aNumTickDeltas[i];
+		SnapBytes += pClient->m_SnapBytes;
+		TotalBytes += pClient->m_TotalBytes;
+		vJitter.insert(vJitter.end(), pClient->m_vSnapJitter.begin(), pClient->m_vSnapJitter.end());
+
+		// the earliest snapshot is taken as on time, the server was
+		// late with the others by as much as they were received later
+		if(!pClient->m_vSnapOffsets.empty())
+		{
+			const int64_t OnTime = *std::min_element(pClient->m_vSnapOffsets.begin(), pClient->m_vSnapOffsets.end());
+			for(int64_t Offset : pClient->m_vSnapOffsets)
+				vLateness.push_back(Offset - OnTime);
+		}
+	}
+
+	log_info(TOOL_NAME, "%d clients in game, %d still joining, %d dropped after %.1fs",
+		aNumStates[CLoadClient::STATE_INGAME], aNumStates[CLoadClient::STATE_CONNECTING] + aNumStates[CLoadClient::STATE_LOADING],
+		aNumStates[CLoadClient::STATE_DROPPED], Seconds);
+	if(vpClients.empty() || !NumSnapshots)
+		return;
+
+	log_info(TOOL_NAME, "snapshots: %d, %.1f/s per client", NumSnapshots, NumSnapshots / Seconds / vpClients.size());
+	log_info(TOOL_NAME, "snapshot bandwidth: %.1f kbit/s per client, %.1f kbit/s total, all messages %.1f kbit/s total",
+		SnapBytes * 8 / 1000.0 / Seconds / vpClients.size(), SnapBytes * 8 / 1000.0 / Seconds, TotalBytes * 8 / 1000.0 / Seconds);
+
+	const int64_t MeanJitter = vJitter.empty() ? 0 : std::accumulate(vJitter.begin(), vJitter.end(), (int64_t)0) / (int64_t)vJitter.size();
+	log_info(TOOL_NAME, "snapshot jitter: mean=%.2fms p50=%.2fms p99=%.2fms max=%.2fms",
+		ToMs(MeanJitter), ToMs(Percentile(vJitter, 0.5)), ToMs(Percentile(vJitter, 0.99)), ToMs(Percentile(vJitter, 1.0)));
+
+	// a snapshot a whole tick late means the server overran its tick
+	// time, it sends only one snapshot for the ticks it catches up on
+	const int64_t NumOverruns = std::count_if(vLateness.begin(), vLateness.end(), [](int64_t Lateness) { return Lateness > TickTime(); });
+	const bool HighBandwidth = aNumTickDeltas[0] > aNumTickDeltas[1];
+	const int NumSkipped = HighBandwidth ? aNumTickDeltas[1] + aNumTickDeltas[2] : aNumTickDeltas[2];
+	log_info(TOOL_NAME, "server tick lateness: p50=%.2fms p99=%.2fms max=%.2fms, %" PRId64 " snapshots over a tick late, %d gaps between snapshots",
+		ToMs(Percentile(vLateness, 0.5)), ToMs(Percentile(vLateness, 0.99)), ToMs(Percentile(vLateness, 1.0)), NumOverruns, NumSkipped);
+	log_info(TOOL_NAME, "inputs: %d sent, %d arrived after their tick", NumInputs, NumLateInputs);
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+
+	log_set_global_logger_default();
+	if(secure_random_init() != 0)
+	{
+		log_error(TOOL_NAME, "could not initialize secure RNG");
+		return -1;
+	}
+
+	if(argc < 3 || argc > 6)
+	{
+		log_error(TOOL_NAME, "usage: %s server[:port] <num_clients> [num_07_clients] [seconds] [idle|scripted|random]", argv[0]);
+		log_error(TOOL_NAME, "the server needs sv_max_clients_per_ip of at least num_clients and sv_connlimit 0");
+		return -1;
+	}
+
+	// used by the connections, the tool has no config manager
+	g_Config.m_ConnTimeout = CConfig::ms_ConnTimeout;
+	g_Config.m_ConnTimeoutProtection = CConfig::ms_ConnTimeoutProtection;
+
+	net_init();
+	NETADDR Addr;
+	if(net_host_lookup(argv[1], &Addr, NETTYPE_ALL))
+	{
+		log_error(TOOL_NAME, "host lookup failed");
+		return -1;
+	}
+	if(Addr.port == 0)
+		Addr.port = 8303;
+
+	const int NumClients = std::clamp(str_toint(argv[2]), 1, (int)MAX_CLIENTS);
+	const int NumSixup = argc > 3 ? std::clamp(str_toint(argv[3]), 0, NumClients) : 0;
+	const int Seconds = argc > 4 ? maximum(str_toint(argv[4]), 1) : 60;
+	int Inputs = INPUTS_RANDOM;
+	if(argc > 5)
+	{
+		if(!str_comp(argv[5], "idle"))
+			Inputs = INPUTS_IDLE;
+		else if(!str_comp(argv[5], "scripted"))
+			Inputs = INPUTS_SCRIPTED;
+		else if(str_comp(argv[5], "random"))
+		{
+			log_error(TOOL_NAME, "unknown inputs '%s'", argv[5]);
+			return -1;
+		}
+	}
+
+	std::vector<std::unique_ptr<CLoadClient>> vpClients;
+	for(int i = 0; i < NumClients; i++)
+		vpClients.push_back(std::make_unique<CLoadClient>(i, i >= NumClients - NumSixup));
+	log_info(TOOL_NAME, "connecting %d clients (%d 0.7) for %ds", NumClients, NumSixup, Seconds);
+
+	const int64_t Start = time_get();
+	const int64_t End = Start + Seconds * time_freq();
+	int64_t NextConnect = Start;
+	int64_t NextTick = Start;
+	int64_t MeasureStart = 0;
+	int NumConnected = 0;
+	int Tick = 0;
+	while(true)
+	{
+		const int64_t Now = time_get();
+		if(Now >= End)
+			break;
+
+		// one new connection per tick to not look like a flood
+		if(NumConnected < NumClients && Now >= NextConnect)
+		{
+			if(!vpClients[NumConnected]->Connect(Addr))
+			{
+				log_error(TOOL_NAME, "failed to open socket for client %d", NumConnected);
+				return -1;
+			}
+			NumConnected++;
+			NextConnect += TickTime();
+		}
+
+		for(auto &pClient : vpClients)
+			pClient->Update(Now);
+
+		if(Now >= NextTick)
+		{
+			bool AllInGame = NumConnected == NumClients;
+			for(auto &pClient : vpClients)
+			{
+				if(pClient->m_State != CLoadClient::STATE_INGAME)
+				{
+					AllInGame = AllInGame && pClient->m_State == CLoadClient::STATE_DROPPED;
+					continue;
+				}
+				pClient->UpdateInput(Inputs, Tick);
+				pClient->SendInput(Now);
+			}
+
+			// only measure once everyone joined, joins are expensive
+			if(AllInGame && !MeasureStart)
+			{
+				log_info(TOOL_NAME, "all clients joined after %.1fs", (Now - Start) / (double)time_freq());
+				for(auto &pClient : vpClients)
+				{
+					pClient->m_NumSnapshots = 0;
+					pClient->m_SnapBytes = 0;
+					pClient->m_TotalBytes = 0;
+					pClient->m_NumInputs = 0;
+					pClient->m_NumLateInputs = 0;
+					mem_zero(pClient->m_aNumTickDeltas, sizeof(pClient->m_aNumTickDeltas));
+					pClient->m_vSnapOffsets.clear();
+					pClient->m_vSnapJitter.clear();
+				}
+				MeasureStart = Now;
+			}
+
+			Tick++;
+			NextTick += TickTime();
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+	}
+
+	if(!MeasureStart)
+	{
+		log_warn(TOOL_NAME, "not all clients joined, the results include the joins");
+		MeasureStart = Start;
+	}
+	PrintReport(vpClients, time_get() - MeasureStart);
+
+	for(auto &pClient : vpClients)
+		pClient->Disconnect();
+	secure_random_uninit();
+	return 0;
+}
@@ -0,0 +1,253 @@
+#include <base/logger.h>
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/server/databases/connection.h>
+#include <engine/shared/config.h>
+
+#include <game/server/instagib/sql_stats_worker.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const char *TOOL_NAME = "sqlite_stats_bench";
+
+static const char *TABLE = "bench_stats";
+
+// the rounds are written back to back, so the background checkpoints
+// run more often than with the default sv_sqlite_checkpoint_interval
+static const int CHECKPOINT_INTERVAL_MS = 100;
+
+struct CProfile
+{
+	const char *m_pName;
+	int m_Synchronous;
+	int m_CacheSize;
+	int m_MmapSize;
+	bool m_BackgroundCheckpoint;
+	bool m_RankIndexes;
+};
+
+// the settings before the sv_sqlite_* variables, the current defaults and
+// the current defaults with sv_leaderboard_cache 0, which adds the indexes
+// of the rank columns
+static const CProfile s_aProfiles[] = {
+	{"before", 2, 0, 0, false, false},
+	{"after", 1, 8192, 64, true, false},
+	{"nocache", 1, 8192, 64, true, true},
+};
+
+static double ToMs(int64_t Time)
+{
+	return Time * 1000.0 / time_freq();
+}
+
+// sorts the samples
+static int64_t Percentile(std::vector<int64_t> &vSamples, double Fraction)
+{
+	if(vSamples.empty())
+		return 0;
+	std::sort(vSamples.begin(), vSamples.end());
+	return vSamples[std::min<size_t>(vSamples.size() * Fraction, vSamples.size() - 1)];
+}
+
+static void RemoveDatabase(const char *pFilename)
+{
+	char aBuf[IO_MAX_PATH_LENGTH];
+	fs_remove(pFilename);
+	str_format(aBuf, sizeof(aBuf), "%s-wal", pFilename);
+	fs_remove(aBuf);
+	str_format(aBuf, sizeof(aBuf), "%s-shm", pFilename);
+	fs_remove(aBuf);
+}
+
+static int64_t WalSize(const char *pFilename)
+{
+	char aBuf[IO_MAX_PATH_LENGTH];
+	str_format(aBuf, sizeof(aBuf), "%s-wal", pFilename);
+	IOHANDLE File = io_open(aBuf, IOFLAG_READ);
+	if(!File)
+		return 0;
+	int64_t Size = io_length(File);
+	io_close(File);
+	return Size;
+}
+
+static bool CreateTable(IDbConnection *pSqlServer, bool RankIndexes, char *pError, int ErrorSize)
+{
+	// the base columns of the stats table without a gametype
+	CSqlCreateTableRequest Request;
+	str_copy(Request.m_aName, TABLE);
+	Request.m_aColumns[0] = '\0';
+	Request.m_RankIndexes = RankIndexes;
+	return CSqlStatsWorker::CreateTable(pSqlServer, &Request, Write::NORMAL, pError, ErrorSize);
+}
+
+static bool SaveRoundStats(IDbConnection *pSqlServer, std::unique_ptr<CSqlSaveRoundStatsData> pData, char *pError, int ErrorSize)
+{
+	return pData && CSqlStatsWorker::SaveRoundStats(pSqlServer, pData.get(), Write::NORMAL, pError, ErrorSize);
+}
+
+// like CSqlStats::FlushRoundStats, one transaction with an upsert per player
+// rounds with more than MAX_CLIENTS players are split like on the server
+static bool FlushRound(IDbConnection *pSqlServer, const std::vector<int> &vPlayers, unsigned *pSeed, char *pError, int ErrorSize)
+{
+	// the workers print every statement, keep them out of the results
+	const std::unique_ptr<ILogger> pQuiet = log_logger_noop();
+	CLogScope LogScope(pQuiet.get());
+
+	CRoundStatsBatch Batch;
+	for(int Player : vPlayers)
+	{
+		char aName[MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "tee%d", Player);
+		*pSeed = *pSeed * 1103515245 + 12345;
+		CSqlStatsPlayer Stats;
+		Stats.Reset();
+		Stats.m_Kills = (*pSeed >> 16) % 30;
+		Stats.m_Points = Stats.m_Kills;
+		Stats.m_Deaths = (*pSeed >> 8) % 30;
+		Stats.m_BestSpree = Stats.m_Kills / 3;
+		Stats.m_Wins = Stats.m_Kills > 15;
+		Stats.m_Losses = Stats.m_Kills <= 15;
+		Stats.m_ShotsFired = Stats.m_Kills * 3;
+		Stats.m_ShotsHit = Stats.m_Kills;
+		if(SaveRoundStats(pSqlServer, Batch.Add(aName, TABLE, &Stats, nullptr, 0), pError, ErrorSize))
+			return true;
+	}
+	return SaveRoundStats(pSqlServer, Batch.Take(), pError, ErrorSize);
+}
+
+static bool RunProfile(const CProfile &Profile, const char *pFilename, int NumRounds, int NumPlayers, int NumNames, int PauseMs)
+{
+	g_Config.m_SvSqliteSynchronous = Profile.m_Synchronous;
+	g_Config.m_SvSqliteCacheSize = Profile.m_CacheSize;
+	g_Config.m_SvSqliteMmapSize = Profile.m_MmapSize;
+
+	RemoveDatabase(pFilename);
+	auto pWrite = CreateSqliteConnection(pFilename, true, !Profile.m_BackgroundCheckpoint);
+	char aError[256] = "";
+	if(pWrite->Connect(aError, sizeof(aError)) || CreateTable(pWrite.get(), Profile.m_RankIndexes, aError, sizeof(aError)))
+	{
+		log_error(TOOL_NAME, "%s: %s", Profile.m_pName, aError);
+		return true;
+	}
+
+	// fill the table first, so that most flushes update existing players
+	unsigned Seed = 1;
+	std::vector<int> vPlayers;
+	for(int i = 0; i < NumNames; i++)
+		vPlayers.push_back(i);
+	if(FlushRound(pWrite.get(), vPlayers, &Seed, aError, sizeof(aError)))
+	{
+		log_error(TOOL_NAME, "%s: %s", Profile.m_pName, aError);
+		pWrite->Disconnect();
+		return true;
+	}
+	pWrite->Disconnect();
+
+	// a reader that asks for the top players all the time, and checkpoints
+	// the write-ahead log like the read workers if enabled
+	std::atomic_bool Stop{false};
+	// only accessed by the reader until it is joined
+	std::vector<int64_t> vReadLatencies;
+	std::thread Reader([&]() {
+		auto pRead = CreateSqliteConnection(pFilename, false);
+		char aReadError[256];
+		char aQuery[256];
+		str_format(aQuery, sizeof(aQuery), "SELECT name, points FROM %s ORDER BY points DESC LIMIT 5;", TABLE);
+		int64_t NextCheckpoint = time_get();
+		while(!Stop)
+		{
+			if(pRead->Connect(aReadError, sizeof(aReadError)))
+				break;
+			if(Profile.m_BackgroundCheckpoint && time_get() >= NextCheckpoint)
+			{
+				NextCheckpoint = time_get() + CHECKPOINT_INTERVAL_MS * time_freq() / 1000;
+				if(pRead->Checkpoint(aReadError, sizeof(aReadError)))
+					log_error(TOOL_NAME, "checkpoint failed: %s", aReadError);
+			}
+			const int64_t ReadStart = time_get();
+			bool End = false;
+			if(!pRead->PrepareStatement(aQuery, aReadError, sizeof(aReadError)))
+				while(!pRead->Step(&End, aReadError, sizeof(aReadError)) && !End)
+					;
+			pRead->Disconnect();
+			vReadLatencies.push_back(time_get() - ReadStart);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+
+	std::vector<int64_t> vLatencies;
+	bool Failed = false;
+	for(int Round = 0; Round < NumRounds && !Failed; Round++)
+	{
+		vPlayers.clear();
+		for(int i = 0; i < NumPlayers; i++)
+		{
+			Seed = Seed * 1103515245 + 12345;
+			vPlayers.push_back((Seed >> 8) % NumNames);
+		}
+		const int64_t FlushStart = time_get();
+		Failed = pWrite->Connect(aError, sizeof(aError)) || FlushRound(pWrite.get(), vPlayers, &Seed, aError, sizeof(aError));
+		pWrite->Disconnect();
+		vLatencies.push_back(time_get() - FlushStart);
+		// real rounds are minutes apart, give the checkpoints a chance to
+		// catch up so the write-ahead log can start over
+		std::this_thread::sleep_for(std::chrono::milliseconds(PauseMs));
+	}
+	Stop = true;
+	Reader.join();
+	if(Failed)
+	{
+		log_error(TOOL_NAME, "%s: %s", Profile.m_pName, aError);
+		return true;
+	}
+
+	int64_t Sum = 0;
+	for(int64_t Latency : vLatencies)
+		Sum += Latency;
+	const int64_t Median = Percentile(vLatencies, 0.5);
+	const int64_t P99 = Percentile(vLatencies, 0.99);
+	log_info(TOOL_NAME, "%-7s synchronous=%d cache=%dKiB mmap=%dMiB checkpoint=%s rank_indexes=%d",
+		Profile.m_pName, Profile.m_Synchronous, Profile.m_CacheSize, Profile.m_MmapSize,
+		Profile.m_BackgroundCheckpoint ? "background" : "auto", Profile.m_RankIndexes);
+	log_info(TOOL_NAME, "        flush mean=%.2fms p50=%.2fms p99=%.2fms max=%.2fms, top5 p50=%.2fms, wal=%" PRId64 "KiB",
+		ToMs(Sum / (int64_t)vLatencies.size()),
+		ToMs(Median),
+		ToMs(P99),
+		ToMs(vLatencies.back()),
+		ToMs(Percentile(vReadLatencies, 0.5)),
+		WalSize(pFilename) / 1024);
+	return false;
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	if(argc < 2 || argc > 6)
+	{
+		log_error(TOOL_NAME, "usage: %s <database_file> [rounds] [players_per_round] [players_total] [pause_ms]", argv[0]);
+		log_error(TOOL_NAME, "the database file is overwritten");
+		return -1;
+	}
+	const char *pFilename = argv[1];
+	const int NumRounds = argc > 2 ? maximum(str_toint(argv[2]), 1) : 500;
+	const int NumPlayers = argc > 3 ? std::clamp(str_toint(argv[3]), 1, (int)MAX_CLIENTS) : 16;
+	const int NumNames = argc > 4 ? maximum(str_toint(argv[4]), NumPlayers) : 10000;
+	const int PauseMs = argc > 5 ? maximum(str_toint(argv[5]), 0) : 5;
+
+	log_info(TOOL_NAME, "%d round end flushes of %d players out of %d, %dms apart", NumRounds, NumPlayers, NumNames, PauseMs);
+	for(const CProfile &Profile : s_aProfiles)
+		if(RunProfile(Profile, pFilename, NumRounds, NumPlayers, NumNames, PauseMs))
+			return -1;
+	RemoveDatabase(pFilename);
+	return 0;
+}
@@ -0,0 +1,573 @@
+#include <base/hash_ctxt.h>
+#include <base/logger.h>
+#include <base/system.h>
+
+#include <engine/config.h>
+#include <engine/console.h>
+#include <engine/engine.h>
+#include <engine/map.h>
+#include <engine/server/antibot.h>
+#include <engine/server/databases/connection.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/shared/json.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol_ex.h>
+#include <engine/shared/teehistorian_ex.h>
+#include <engine/storage.h>
+
+#include <game/server/entities/character.h>
+#include <game/server/gamecontext.h>
+#include <game/server/player.h>
+#include <game/server/teehistorian_reader.h>
+#include <game/version.h>
+
+#include <iterator>
+#include <thread>
+#include <vector>
+
+static const char *TOOL_NAME = "teehistorian_replay";
+
+// the server checks this in its main loop, which the replay does not use
+bool IsInterrupted()
+{
+	return false;
+}
+
+class CTeeHistorianReplay
+{
+	CServer *m_pServer;
+	CGameContext *m_pGameServer;
+	CTeeHistorianReader m_Reader;
+
+	class CJoinInfo
+	{
+	public:
+		bool m_Sixup = false;
+		bool m_HasDDNetVersion = false;
+		CUuid m_ConnectionId = UUID_ZEROED;
+		int m_DDNetVersion = VERSION_NONE;
+		char m_aDDNetVersionStr[64] = "";
+	};
+	// one entry per join in the file, known before the client enters the game
+	std::vector<CJoinInfo> m_vJoins;
+	int m_NextJoin = 0;
+
+	int m_NumTicks = 0;
+	int m_NumMismatches = 0;
+	int m_NumCommandsSkipped = 0;
+
+	static int UnpackClientId(const CTeeHistorianReader::CChunk &Chunk)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(Chunk.m_pData, Chunk.m_DataSize);
+		const int ClientId = Unpacker.GetInt();
+		return !Unpacker.Error() && ClientId >= 0 && ClientId < MAX_CLIENTS ? ClientId : -1;
+	}
+
+	void CollectJoins()
+	{
+		int aJoin[MAX_CLIENTS];
+		bool aSixup[MAX_CLIENTS] = {};
+		for(int &Join : aJoin)
+			Join = -1;
+
+		CTeeHistorianReader::CChunk Chunk;
+		while(m_Reader.Next(&Chunk))
+		{
+			if(Chunk.m_Type == CTeeHistorianReader::CHUNK_JOIN)
+			{
+				aJoin[Chunk.m_ClientId] = m_vJoins.size();
+				m_vJoins.emplace_back().m_Sixup = aSixup[Chunk.m_ClientId];
+				continue;
+			}
+			if(Chunk.m_Type != CTeeHistorianReader::CHUNK_EX)
+				continue;
+
+			const int Type = g_UuidManager.LookupUuid(Chunk.m_Uuid);
+			const int ClientId = UnpackClientId(Chunk);
+			if(ClientId < 0)
+				continue;
+			if(Type == TEEHISTORIAN_JOINVER6 || Type == TEEHISTORIAN_JOINVER7)
+			{
+				aSixup[ClientId] = Type == TEEHISTORIAN_JOINVER7;
+			}
+			else if((Type == TEEHISTORIAN_DDNETVER || Type == TEEHISTORIAN_DDNETVER_OLD) && aJoin[ClientId] >= 0)
+			{
+				CJoinInfo &Join = m_vJoins[aJoin[ClientId]];
+				CUnpacker Unpacker;
+				Unpacker.Reset(Chunk.m_pData, Chunk.m_DataSize);
+				Unpacker.GetInt();
+				if(Type == TEEHISTORIAN_DDNETVER)
+				{
+					const CUuid *pConnectionId = (const CUuid *)Unpacker.GetRaw(sizeof(CUuid));
+					Join.m_DDNetVersion = Unpacker.GetInt();
+					str_copy(Join.m_aDDNetVersionStr, Unpacker.GetString(CUnpacker::SANITIZE_CC));
+					Join.m_HasDDNetVersion = !Unpacker.Error();
+					if(Join.m_HasDDNetVersion)
+						Join.m_ConnectionId = *pConnectionId;
+				}
+				else
+				{
+					// old clients send their version in a game message, which is replayed
+					Join.m_DDNetVersion = Unpacker.GetInt();
+				}
+			}
+		}
+		m_Reader.Rewind();
+	}
+
+	void ApplyHeaderConfig()
+	{
+		const json_value *pConfig = json_object_get(m_Reader.Header(), "config");
+		if(pConfig->type == json_object)
+		{
+			for(unsigned i = 0; i < pConfig->u.object.length; i++)
+			{
+				const json_value *pValue = pConfig->u.object.values[i].value;
+				if(pValue->type != json_string)
+					continue;
+				char aValue[1024];
+				char *pDst = aValue;
+				str_escape(&pDst, json_string_get(pValue), aValue + sizeof(aValue));
+				char aLine[1200];
+				str_format(aLine, sizeof(aLine), "%s \"%s\"", pConfig->u.object.values[i].name, aValue);
+				m_pServer->Console()->ExecuteLine(aLine);
+			}
+		}
+
+		const json_value *pTuning = json_object_get(m_Reader.Header(), "tuning");
+		if(pTuning->type == json_object)
+		{
+			for(unsigned i = 0; i < pTuning->u.object.length; i++)
+			{
+				const json_value *pValue = pTuning->u.object.values[i].value;
+				if(pValue->type != json_string)
+					continue;
+				// tuning values are stored multiplied by 100
+				char aLine[256];
+				str_format(aLine, sizeof(aLine), "tune %s %.2f", pTuning->u.object.values[i].name, str_toint(json_string_get(pValue)) / 100.0f);
+				m_pServer->Console()->ExecuteLine(aLine);
+			}
+		}
+	}
+
+	// seeds the game like the recorded one, see CPrng::Description
+	void SeedPrng()
+	{
+		const char *pDescription = m_Reader.HeaderString("prng_description");
+		const char *pSeeds = pDescription ? str_find(pDescription, ":") : nullptr;
+		uint64_t aSeed[2];
+		for(uint64_t &Seed : aSeed)
+		{
+			char aHex[17];
+			unsigned char aBytes[8];
+			if(!pSeeds || str_length(pSeeds) < 17)
+			{
+				log_warn(TOOL_NAME, "unknown prng description '%s', random events will differ", pDescription ? pDescription : "");
+				return;
+			}
+			str_copy(aHex, pSeeds + 1, sizeof(aHex));
+			if(str_hex_decode(aBytes, sizeof(aBytes), aHex))
+			{
+				log_warn(TOOL_NAME, "unknown prng description '%s', random events will differ", pDescription);
+				return;
+			}
+			Seed = 0;
+			for(unsigned char Byte : aBytes)
+				Seed = (Seed << 8) | Byte;
+			pSeeds += 17;
+		}
+		m_pGameServer->Prng()->Seed(aSeed);
+	}
+
+	void ClientReady(int ClientId)
+	{
+		CServer::CClient &Client = m_pServer->m_aClients[ClientId];
+		if(Client.m_State != CServer::CClient::STATE_CONNECTING)
+			return;
+		Client.m_State = CServer::CClient::STATE_READY;
+		m_pGameServer->OnClientConnected(ClientId, nullptr);
+	}
+
+	void OnJoin(int ClientId)
+	{
+		if(m_pServer->m_aClients[ClientId].m_State != CServer::CClient::STATE_EMPTY)
+			CServer::DelClientCallback(ClientId, "rejoined", m_pServer);
+
+		const CJoinInfo &Join = m_vJoins[m_NextJoin++];
+		CServer::NewClientCallback(ClientId, m_pServer, Join.m_Sixup);
+		CServer::CClient &Client = m_pServer->m_aClients[ClientId];
+		if(Join.m_HasDDNetVersion)
+		{
+			Client.m_ConnectionId = Join.m_ConnectionId;
+			Client.m_DDNetVersion = Join.m_DDNetVersion;
+			str_copy(Client.m_aDDNetVersionStr, Join.m_aDDNetVersionStr);
+			Client.m_DDNetVersionSettled = true;
+			Client.m_GotDDNetVersionPacket = true;
+		}
+		// the connection and map download are not replayed
+		Client.m_State = CServer::CClient::STATE_CONNECTING;
+	}
+
+	void OnMessage(const CTeeHistorianReader::CChunk &Chunk)
+	{
+		if(m_pServer->m_aClients[Chunk.m_ClientId].m_State < CServer::CClient::STATE_CONNECTING)
+			return;
+		// only game messages are recorded, the first one means the client got ready
+		ClientReady(Chunk.m_ClientId);
+
+		CUnpacker Unpacker;
+		Unpacker.Reset(Chunk.m_pData, Chunk.m_DataSize);
+		CMsgPacker Packer(NETMSG_EX, true);
+		int Msg;
+		bool Sys;
+		CUuid Uuid;
+		if(UnpackMessageId(&Msg, &Sys, &Uuid, &Unpacker, &Packer) != UNPACKMESSAGE_OK || Sys)
+			return;
+		m_pGameServer->OnMessage(Msg, &Unpacker, Chunk.m_ClientId);
+	}
+
+	void OnEx(const CTeeHistorianReader::CChunk &Chunk)
+	{
+		// the other extra chunks are results of the game logic
+		if(g_UuidManager.LookupUuid(Chunk.m_Uuid) != TEEHISTORIAN_PLAYER_READY)
+			return;
+
+		const int ClientId = UnpackClientId(Chunk);
+		if(ClientId < 0)
+			return;
+		ClientReady(ClientId);
+		if(m_pServer->m_aClients[ClientId].m_State != CServer::CClient::STATE_READY)
+			return;
+		m_pServer->m_aClients[ClientId].m_State = CServer::CClient::STATE_INGAME;
+		m_pGameServer->OnClientEnter(ClientId);
+	}
+
+	void OnInput(const CTeeHistorianReader::CChunk &Chunk)
+	{
+		CServer::CClient &Client = m_pServer->m_aClients[Chunk.m_ClientId];
+		if(Client.m_State != CServer::CClient::STATE_INGAME)
+			return;
+
+		// the recorded input is the one applied to the next tick, store it
+		// like the server does for NETMSG_INPUT
+		CServer::CClient::CInput *pInput = &Client.m_aInputs[Client.m_CurrentInput];
+		pInput->m_GameTick = m_pServer->Tick() + 1;
+		mem_zero(pInput->m_aData, sizeof(pInput->m_aData));
+		mem_copy(pInput->m_aData, &Chunk.m_Input, sizeof(Chunk.m_Input));
+		Client.m_LatestInput = *pInput;
+		Client.m_CurrentInput = (Client.m_CurrentInput + 1) % std::size(Client.m_aInputs);
+
+		m_pGameServer->OnClientDirectInput(Chunk.m_ClientId, Client.m_LatestInput.m_aData);
+	}
+
+	void CheckPlayer(const CTeeHistorianReader::CChunk &Chunk)
+	{
+		CCharacter *pChr = m_pGameServer->GetPlayerChar(Chunk.m_ClientId);
+		bool Match;
+		if(Chunk.m_Type == CTeeHistorianReader::CHUNK_PLAYER_DEAD)
+		{
+			Match = !pChr;
+		}
+		else
+		{
+			CNetObj_CharacterCore Core;
+			if(pChr)
+				pChr->GetCore().Write(&Core);
+			Match = pChr && Core.m_X == Chunk.m_X && Core.m_Y == Chunk.m_Y;
+		}
+
+		if(!Match && m_NumMismatches++ == 0)
+		{
+			log_warn(TOOL_NAME, "replay differs from the recording first at tick %d, cid=%d recorded=%s", m_Reader.Tick(), Chunk.m_ClientId,
+				Chunk.m_Type == CTeeHistorianReader::CHUNK_PLAYER_DEAD ? "dead" : "alive");
+		}
+	}
+
+	// the steps of the main loop of CServer::Run that do not need the network
+	void Tick()
+	{
+		m_pServer->GameTick();
+
+		if(m_pServer->Config()->m_SvHighBandwidth || (m_pServer->Tick() % 2) == 0)
+			m_pServer->DoSnapshot();
+
+		m_pServer->Antibot()->OnEngineTick();
+		m_pServer->FrameProfiler()->EndFrame(m_pServer->Tick());
+		m_NumTicks++;
+	}
+
+	SHA256_DIGEST WorldHash()
+	{
+		SHA256_CTX Ctx;
+		sha256_init(&Ctx);
+		for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+		{
+			const CPlayer *pPlayer = m_pGameServer->m_apPlayers[ClientId];
+			if(!pPlayer)
+				continue;
+			const int aPlayer[] = {ClientId, pPlayer->GetTeam(), m_pGameServer->GetDDRaceTeam(ClientId), pPlayer->m_Score.value_or(-1)};
+			sha256_update(&Ctx, aPlayer, sizeof(aPlayer));
+
+			CCharacter *pChr = m_pGameServer->GetPlayerChar(ClientId);
+			if(pChr)
+			{
+				CNetObj_CharacterCore Core;
+				pChr->GetCore().Write(&Core);
+				sha256_update(&Ctx, &Core, sizeof(Core));
+			}
+		}
+		for(int Type = 0; Type < CGameWorld::NUM_ENTTYPES; Type++)
+		{
+			for(CEntity *pEnt = m_pGameServer->m_World.FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+			{
+				const int aEntity[] = {Type, round_to_int(pEnt->GetPos().x), round_to_int(pEnt->GetPos().y)};
+				sha256_update(&Ctx, aEntity, sizeof(aEntity));
+			}
+		}
+		return sha256_finish(&Ctx);
+	}
+
+	void PrintReport(int64_t Duration)
+	{
+		const double Seconds = Duration / (double)time_freq();
+		log_info(TOOL_NAME, "replayed %d ticks in %.3fs, %.0f ticks/s, %.1fx real time",
+			m_NumTicks, Seconds, m_NumTicks / Seconds, m_NumTicks / Seconds / SERVER_TICK_SPEED);
+
+		const CFrameProfiler &Profiler = *m_pServer->FrameProfiler();
+		for(int Phase = 0; Phase < CFrameProfiler::NUM_PHASES; Phase++)
+		{
+			const CFrameProfiler::CHistogram &Histogram = Profiler.PhaseHistogram(Phase);
+			if(!Histogram.Count())
+				continue;
+			log_info(TOOL_NAME, "%-12s frames=%" PRIu64 " total=%.3fs mean=%.1fus p50=%.1fus p99=%.1fus max=%.1fus",
+				CFrameProfiler::PhaseName(Phase), Histogram.Count(), Histogram.Count() * Histogram.Mean() / 1e9, Histogram.Mean() / 1000.0,
+				Histogram.Percentile(0.5) / 1000.0, Histogram.Percentile(0.99) / 1000.0, Histogram.Max() / 1000.0);
+		}
+
+		if(m_NumCommandsSkipped)
+			log_info(TOOL_NAME, "skipped %d console commands", m_NumCommandsSkipped);
+		if(m_NumMismatches)
+			log_warn(TOOL_NAME, "%d player positions differ from the recording", m_NumMismatches);
+		else
+			log_info(TOOL_NAME, "all player positions match the recording");
+
+		char aHash[SHA256_MAXSTRSIZE];
+		sha256_str(WorldHash(), aHash, sizeof(aHash));
+		log_info(TOOL_NAME, "world hash %s", aHash);
+	}
+
+public:
+	CTeeHistorianReplay(CServer *pServer) :
+		m_pServer(pServer),
+		m_pGameServer(static_cast<CGameContext *>(pServer->GameServer()))
+	{
+	}
+
+	bool Open(const unsigned char *pData, int Size)
+	{
+		if(!m_Reader.Open(pData, Size))
+		{
+			log_error(TOOL_NAME, "failed to read teehistorian header: %s", m_Reader.ErrorMessage());
+			return false;
+		}
+		CollectJoins();
+		return true;
+	}
+
+	// parts of CServer::Run without network, register and console input
+	bool Init(int argc, const char **argv)
+	{
+		const char *pMapName = m_Reader.HeaderString("map_name");
+		if(!pMapName)
+		{
+			log_error(TOOL_NAME, "teehistorian header has no map name");
+			return false;
+		}
+
+		ApplyHeaderConfig();
+		str_copy(m_pServer->Config()->m_SvMap, pMapName);
+		// the remaining arguments are console commands, to compare configurations
+		if(argc > 0)
+			m_pServer->Console()->ParseArguments(argc, argv);
+		m_pServer->Config()->m_SvTeeHistorian = 0;
+		m_pServer->FrameProfiler()->SetEnabled(true);
+
+		if(!m_pServer->InitGame())
+			return false;
+		char aSha256[SHA256_MAXSTRSIZE];
+		sha256_str(m_pServer->m_aCurrentMapSha256[CServer::MAP_TYPE_SIX], aSha256, sizeof(aSha256));
+		const char *pRecordedSha256 = m_Reader.HeaderString("map_sha256");
+		if(pRecordedSha256 && str_comp(pRecordedSha256, aSha256) != 0)
+			log_warn(TOOL_NAME, "map differs from the recorded one. recorded=%s loaded=%s", pRecordedSha256, aSha256);
+
+		// the slots are never online, everything sent to them is dropped
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = NETTYPE_IPV4;
+		BindAddr.ip[0] = 127;
+		BindAddr.ip[3] = 1;
+		if(!m_pServer->m_NetServer.Open(BindAddr, &m_pServer->m_ServerBan, m_pServer->Config()->m_SvMaxClients, m_pServer->Config()->m_SvMaxClientsPerIp))
+		{
+			log_error(TOOL_NAME, "couldn't open the client slots");
+			return false;
+		}
+
+		m_pServer->StartGame();
+		SeedPrng();
+		m_pServer->m_GameStartTime = time_get();
+		return !m_pServer->ErrorShutdown();
+	}
+
+	bool Run()
+	{
+		const int64_t Start = time_get();
+		CTeeHistorianReader::CChunk Chunk;
+		while(m_Reader.Next(&Chunk))
+		{
+			while(m_pServer->Tick() < m_Reader.Tick() && !m_pServer->ErrorShutdown())
+				Tick();
+			if(m_pServer->ErrorShutdown())
+				break;
+
+			switch(Chunk.m_Type)
+			{
+			case CTeeHistorianReader::CHUNK_PLAYER:
+			case CTeeHistorianReader::CHUNK_PLAYER_DEAD:
+				CheckPlayer(Chunk);
+				break;
+			case CTeeHistorianReader::CHUNK_INPUT:
+				OnInput(Chunk);
+				break;
+			case CTeeHistorianReader::CHUNK_MESSAGE:
+				OnMessage(Chunk);
+				break;
+			case CTeeHistorianReader::CHUNK_JOIN:
+				OnJoin(Chunk.m_ClientId);
+				break;
+			case CTeeHistorianReader::CHUNK_DROP:
+				if(m_pServer->m_aClients[Chunk.m_ClientId].m_State != CServer::CClient::STATE_EMPTY)
+					CServer::DelClientCallback(Chunk.m_ClientId, Chunk.m_pString, m_pServer);
+				break;
+			case CTeeHistorianReader::CHUNK_CONSOLE_COMMAND:
+				// most are chat commands and votes, which the replayed
+				// messages execute again
+				m_NumCommandsSkipped++;
+				break;
+			case CTeeHistorianReader::CHUNK_EX:
+				OnEx(Chunk);
+				break;
+			}
+		}
+		const int64_t Duration = time_get() - Start;
+
+		if(m_Reader.Error())
+			log_error(TOOL_NAME, "failed to read teehistorian: %s", m_Reader.ErrorMessage());
+		else if(!m_Reader.Finished())
+			log_warn(TOOL_NAME, "teehistorian file is not finished, the server was probably still running");
+		if(m_pServer->ErrorShutdown())
+			log_error(TOOL_NAME, "shutdown from game server (%s)", m_pServer->m_aErrorShutdownReason);
+
+		PrintReport(Duration);
+		return !m_Reader.Error() && !m_pServer->ErrorShutdown();
+	}
+
+	void Shutdown()
+	{
+		for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+		{
+			if(m_pServer->m_aClients[ClientId].m_State != CServer::CClient::STATE_EMPTY)
+				CServer::DelClientCallback(ClientId, "replay finished", m_pServer);
+		}
+		m_pServer->StopGame();
+		m_pServer->m_NetServer.Close();
+	}
+};
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	if(argc < 2)
+	{
+		log_error(TOOL_NAME, "Usage: %s <teehistorian_file> [console commands]", TOOL_NAME);
+		return -1;
+	}
+
+	if(secure_random_init() != 0)
+	{
+		log_error("secure", "could not initialize secure RNG");
+		return -1;
+	}
+	if(MysqlInit() != 0)
+	{
+		log_error("mysql", "failed to initialize MySQL library");
+		return -1;
+	}
+
+	CServer *pServer = CreateServer();
+	IKernel *pKernel = IKernel::Create();
+	pKernel->RegisterInterface(pServer);
+
+	IEngine *pEngine = CreateEngine(GAME_NAME, nullptr, 2 * std::thread::hardware_concurrency() + 2);
+	pKernel->RegisterInterface(pEngine);
+
+	// only the first argument, the rest are console commands
+	IStorage *pStorage = CreateStorage(IStorage::EInitializationType::SERVER, 1, argv);
+	if(!pStorage)
+	{
+		log_error(TOOL_NAME, "failed to initialize storage");
+		return -1;
+	}
+	pKernel->RegisterInterface(pStorage);
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_ECON).release();
+	pKernel->RegisterInterface(pConsole);
+
+	IConfigManager *pConfigManager = CreateConfigManager();
+	pKernel->RegisterInterface(pConfigManager);
+
+	IEngineMap *pEngineMap = CreateEngineMap();
+	pKernel->RegisterInterface(pEngineMap); // IEngineMap
+	pKernel->RegisterInterface(static_cast<IMap *>(pEngineMap), false);
+
+	IEngineAntibot *pEngineAntibot = CreateEngineAntibot();
+	pKernel->RegisterInterface(pEngineAntibot); // IEngineAntibot
+	pKernel->RegisterInterface(static_cast<IAntibot *>(pEngineAntibot), false);
+
+	IGameServer *pGameServer = CreateGameServer();
+	pKernel->RegisterInterface(pGameServer);
+
+	pEngine->Init();
+	pConsole->Init();
+	pConfigManager->Init();
+	pServer->RegisterCommands();
+
+	void *pData;
+	unsigned Size;
+	int Result = -1;
+	if(!pStorage->ReadFile(argv[1], IStorage::TYPE_ALL_OR_ABSOLUTE, &pData, &Size))
+	{
+		log_error(TOOL_NAME, "failed to open '%s'", argv[1]);
+	}
+	else
+	{
+		CTeeHistorianReplay Replay(pServer);
+		if(Replay.Open((const unsigned char *)pData, Size) && Replay.Init(argc - 2, argv + 2))
+		{
+			Result = Replay.Run() ? 0 : -1;
+			Replay.Shutdown();
+		}
+		free(pData);
+	}
+
+	pEngine->ShutdownJobs();
+	delete pKernel;
+
+	MysqlUninit();
+	secure_random_uninit();
+
+	return Result;
+}